@@ -0,0 +1,253 @@
+#include "batch_evaluator.h"
+#include "portfolio/common/parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define PORTFOLIO_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace portfolio {
+    namespace {
+        /// Portfolios evaluated together, sharing the loads of the returns
+        constexpr size_t portfolio_block = 4;
+        /// Periods in the accumulators of a block
+        constexpr size_t period_tile = 8;
+        /// Most portfolios per task when evaluating in parallel
+        constexpr size_t max_portfolios_per_task = 256;
+
+        /// Scalar dot products of one portfolio with two vectors
+        void weighted_sums(const double *w, const double *a, const double *b,
+                           size_t n, double &sum_a, double &sum_b) {
+            size_t k = 0;
+            sum_a = 0.0;
+            sum_b = 0.0;
+#ifdef PORTFOLIO_HAS_AVX2
+            __m256d acc_a = _mm256_setzero_pd();
+            __m256d acc_b = _mm256_setzero_pd();
+            for (; k + 4 <= n; k += 4) {
+                __m256d wk = _mm256_loadu_pd(w + k);
+                acc_a = _mm256_fmadd_pd(wk, _mm256_load_pd(a + k), acc_a);
+                acc_b = _mm256_fmadd_pd(wk, _mm256_load_pd(b + k), acc_b);
+            }
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, acc_a);
+            sum_a = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            _mm256_store_pd(lanes, acc_b);
+            sum_b = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+            for (; k < n; ++k) {
+                sum_a += w[k] * a[k];
+                sum_b += w[k] * b[k];
+            }
+        }
+
+        /// Sum of the absolute deviations of P portfolios, whose weights
+        /// start at w and are n_assets apart. Each tile of periods is
+        /// accumulated over all assets before moving to the next tile.
+        template <size_t P>
+        void portfolio_deviations(const double *w, size_t n_assets,
+                                  const double *centered, size_t stride,
+                                  double *deviations) {
+            for (size_t j = 0; j < P; ++j) {
+                deviations[j] = 0.0;
+            }
+            for (size_t t = 0; t < stride; t += period_tile) {
+                double acc[P][period_tile] = {};
+                for (size_t k = 0; k < n_assets; ++k) {
+                    const double *c = centered + k * stride + t;
+                    for (size_t j = 0; j < P; ++j) {
+                        double wk = w[j * n_assets + k];
+                        for (size_t i = 0; i < period_tile; ++i) {
+                            acc[j][i] += wk * c[i];
+                        }
+                    }
+                }
+                for (size_t j = 0; j < P; ++j) {
+                    for (size_t i = 0; i < period_tile; ++i) {
+                        deviations[j] += std::abs(acc[j][i]);
+                    }
+                }
+            }
+        }
+
+#ifdef PORTFOLIO_HAS_AVX2
+        template <>
+        void portfolio_deviations<portfolio_block>(const double *w,
+                                                   size_t n_assets,
+                                                   const double *centered,
+                                                   size_t stride,
+                                                   double *deviations) {
+            const double *w0 = w;
+            const double *w1 = w + n_assets;
+            const double *w2 = w + 2 * n_assets;
+            const double *w3 = w + 3 * n_assets;
+            // Clearing the sign bit is the absolute value
+            const __m256d abs_mask =
+                _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFF));
+            __m256d dev0 = _mm256_setzero_pd();
+            __m256d dev1 = _mm256_setzero_pd();
+            __m256d dev2 = _mm256_setzero_pd();
+            __m256d dev3 = _mm256_setzero_pd();
+            for (size_t t = 0; t < stride; t += period_tile) {
+                __m256d a0 = _mm256_setzero_pd();
+                __m256d b0 = _mm256_setzero_pd();
+                __m256d a1 = _mm256_setzero_pd();
+                __m256d b1 = _mm256_setzero_pd();
+                __m256d a2 = _mm256_setzero_pd();
+                __m256d b2 = _mm256_setzero_pd();
+                __m256d a3 = _mm256_setzero_pd();
+                __m256d b3 = _mm256_setzero_pd();
+                for (size_t k = 0; k < n_assets; ++k) {
+                    const double *c = centered + k * stride + t;
+                    __m256d lo = _mm256_load_pd(c);
+                    __m256d hi = _mm256_load_pd(c + 4);
+                    __m256d x = _mm256_broadcast_sd(w0 + k);
+                    a0 = _mm256_fmadd_pd(x, lo, a0);
+                    b0 = _mm256_fmadd_pd(x, hi, b0);
+                    x = _mm256_broadcast_sd(w1 + k);
+                    a1 = _mm256_fmadd_pd(x, lo, a1);
+                    b1 = _mm256_fmadd_pd(x, hi, b1);
+                    x = _mm256_broadcast_sd(w2 + k);
+                    a2 = _mm256_fmadd_pd(x, lo, a2);
+                    b2 = _mm256_fmadd_pd(x, hi, b2);
+                    x = _mm256_broadcast_sd(w3 + k);
+                    a3 = _mm256_fmadd_pd(x, lo, a3);
+                    b3 = _mm256_fmadd_pd(x, hi, b3);
+                }
+                dev0 = _mm256_add_pd(dev0, _mm256_and_pd(a0, abs_mask));
+                dev0 = _mm256_add_pd(dev0, _mm256_and_pd(b0, abs_mask));
+                dev1 = _mm256_add_pd(dev1, _mm256_and_pd(a1, abs_mask));
+                dev1 = _mm256_add_pd(dev1, _mm256_and_pd(b1, abs_mask));
+                dev2 = _mm256_add_pd(dev2, _mm256_and_pd(a2, abs_mask));
+                dev2 = _mm256_add_pd(dev2, _mm256_and_pd(b2, abs_mask));
+                dev3 = _mm256_add_pd(dev3, _mm256_and_pd(a3, abs_mask));
+                dev3 = _mm256_add_pd(dev3, _mm256_and_pd(b3, abs_mask));
+            }
+            alignas(32) double lanes[4];
+            __m256d devs[portfolio_block] = {dev0, dev1, dev2, dev3};
+            for (size_t j = 0; j < portfolio_block; ++j) {
+                _mm256_store_pd(lanes, devs[j]);
+                deviations[j] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            }
+        }
+#endif
+    } // namespace
+
+    batch_evaluator::batch_evaluator(const return_panel &panel,
+                                     interval_points interval, int n_periods)
+        : n_assets_(panel.n_assets()) {
+        size_t last = panel.find(interval);
+        if (last == panel.n_periods()) {
+            throw std::runtime_error(
+                "BATCH_EVALUATOR constructor error: interval not found.");
+        }
+        if (n_periods < 1 || last + 1 < static_cast<size_t>(n_periods)) {
+            throw std::runtime_error("BATCH_EVALUATOR constructor error: "
+                                     "n_periods out of market_data.");
+        }
+        n_periods_ = n_periods;
+        stride_ = (n_periods_ + period_tile - 1) / period_tile * period_tile;
+        size_t first = last + 1 - n_periods_;
+
+        // Vectors over the assets are padded for the vector loads
+        size_t padded_assets = (n_assets_ + 3) / 4 * 4;
+        mean_.assign(padded_assets, 0.0);
+        mad_.assign(padded_assets, 0.0);
+        centered_.assign(n_assets_ * stride_, 0.0);
+        for (size_t k = 0; k < n_assets_; ++k) {
+            auto returns = panel.returns(k).subspan(first, n_periods_);
+            auto mask = panel.mask(k).subspan(first, n_periods_);
+            size_t n = 0;
+            double sum = 0.0;
+            for (size_t t = 0; t < n_periods_; ++t) {
+                n += mask[t];
+                sum += returns[t];
+            }
+            if (n == 0) {
+                throw std::runtime_error("BATCH_EVALUATOR constructor error: "
+                                         "no returns in the periods.");
+            }
+            double mean = sum / n;
+            double mad = 0.0;
+            double *centered = centered_.data() + k * stride_;
+            for (size_t t = 0; t < n_periods_; ++t) {
+                if (mask[t]) {
+                    centered[t] = returns[t] - mean;
+                    mad += std::abs(centered[t]);
+                }
+            }
+            mean_[k] = mean;
+            mad_[k] = mad / n;
+        }
+    }
+
+    batch_evaluator::batch_evaluator(const market_data &data,
+                                     interval_points interval, int n_periods)
+        : batch_evaluator(data.returns(), interval, n_periods) {}
+
+    void batch_evaluator::evaluate(std::span<const double> weights,
+                                   std::span<double> risk,
+                                   std::span<double> expected_return,
+                                   mad_kind kind, size_t n_threads) const {
+        size_t n_portfolios = risk.size();
+        if (expected_return.size() != n_portfolios ||
+            weights.size() != n_portfolios * n_assets_) {
+            throw std::runtime_error("BATCH_EVALUATOR evaluate error: "
+                                     "weights and results do not match.");
+        }
+        // Small batches, such as the population of an optimizer, are still
+        // split between the threads. Tasks hold whole blocks, so the blocks
+        // and the results do not depend on the number of threads.
+        size_t n_workers = worker_count(n_threads, n_portfolios);
+        size_t portfolios_per_task = std::clamp(
+            (n_portfolios + 4 * n_workers - 1) / (4 * n_workers),
+            portfolio_block, max_portfolios_per_task);
+        portfolios_per_task = (portfolios_per_task + portfolio_block - 1) /
+                              portfolio_block * portfolio_block;
+        size_t n_tasks =
+            (n_portfolios + portfolios_per_task - 1) / portfolios_per_task;
+        parallel_for(n_tasks, n_threads, [&](size_t task) {
+            size_t begin = task * portfolios_per_task;
+            size_t end = std::min(begin + portfolios_per_task, n_portfolios);
+            for (size_t p = begin; p < end; ++p) {
+                double mad_sum;
+                weighted_sums(weights.data() + p * n_assets_, mad_.data(),
+                              mean_.data(), n_assets_, mad_sum,
+                              expected_return[p]);
+                risk[p] = mad_sum;
+            }
+            if (kind != mad_kind::portfolio) {
+                return;
+            }
+            size_t p = begin;
+            for (; p + portfolio_block <= end; p += portfolio_block) {
+                portfolio_deviations<portfolio_block>(
+                    weights.data() + p * n_assets_, n_assets_,
+                    centered_.data(), stride_, risk.data() + p);
+            }
+            for (; p < end; ++p) {
+                portfolio_deviations<1>(weights.data() + p * n_assets_,
+                                        n_assets_, centered_.data(), stride_,
+                                        risk.data() + p);
+            }
+            for (p = begin; p < end; ++p) {
+                risk[p] /= static_cast<double>(n_periods_);
+            }
+        });
+    }
+
+    size_t batch_evaluator::n_assets() const { return n_assets_; }
+
+    size_t batch_evaluator::n_periods() const { return n_periods_; }
+
+    double batch_evaluator::asset_risk(size_t asset) const {
+        return mad_[asset];
+    }
+
+    double batch_evaluator::asset_return(size_t asset) const {
+        return mean_[asset];
+    }
+} // namespace portfolio
@@ -0,0 +1,81 @@
+#ifndef PORTFOLIO_BATCH_EVALUATOR_H
+#define PORTFOLIO_BATCH_EVALUATOR_H
+
+#include "market_data.h"
+#include "portfolio/common/aligned_allocator.h"
+#include "portfolio/core/return_panel.h"
+#include <span>
+namespace portfolio {
+    /// \brief MAD used as risk measure by the batch_evaluator.
+    enum class mad_kind {
+        /// \brief Weighted sum of the MAD of each asset, as in
+        /// portfolio::evaluate_mad.
+        asset_weighted,
+        /// \brief MAD of the returns of the portfolio itself, which
+        /// accounts for the assets moving together or against each other.
+        portfolio
+    };
+
+    /// \brief Evaluate many portfolios against the same returns window.
+    ///
+    /// Portfolios are rows of a dense weights matrix whose columns follow
+    /// the assets of the return panel. The per-asset means, MADs and the
+    /// centered returns of the window are computed once, and portfolios are
+    /// evaluated in blocks with vectorized kernels. The kernels use AVX2
+    /// when the library is compiled with BUILD_WITH_AVX2.
+    class batch_evaluator {
+      public /* constructors */:
+        /// \brief Constructor of batch_evaluator
+        /// \param panel Returns of the assets.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        batch_evaluator(const return_panel &panel, interval_points interval,
+                        int n_periods);
+
+        /// \brief Constructor of batch_evaluator
+        /// \param data Market data whose return panel is used.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        batch_evaluator(const market_data &data, interval_points interval,
+                        int n_periods);
+
+      public /* evaluation */:
+        /// \brief Evaluate a batch of portfolios.
+        /// \param weights Row-major portfolios x assets matrix of weights.
+        /// \param risk Risk of each portfolio, one per row of weights.
+        /// \param expected_return Expected return of each portfolio.
+        /// \param kind MAD used as risk measure.
+        /// \param n_threads Number of threads. 0 uses one thread per
+        /// hardware thread.
+        void evaluate(std::span<const double> weights, std::span<double> risk,
+                      std::span<double> expected_return,
+                      mad_kind kind = mad_kind::asset_weighted,
+                      size_t n_threads = 1) const;
+
+      public /* getters */:
+        /// \brief Number of assets, which is the number of weights of each
+        /// portfolio.
+        [[nodiscard]] size_t n_assets() const;
+
+        /// \brief Number of periods in the window.
+        [[nodiscard]] size_t n_periods() const;
+
+        /// \brief MAD of the returns of an asset in the window.
+        [[nodiscard]] double asset_risk(size_t asset) const;
+
+        /// \brief Mean of the returns of an asset in the window.
+        [[nodiscard]] double asset_return(size_t asset) const;
+
+      private:
+        size_t n_assets_;
+        size_t n_periods_;
+        /// \brief Window length padded to whole vector tiles.
+        size_t stride_;
+        aligned_vector<double> mean_;
+        aligned_vector<double> mad_;
+        /// \brief Returns minus the mean of their asset, zero when masked.
+        aligned_vector<double> centered_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_BATCH_EVALUATOR_H
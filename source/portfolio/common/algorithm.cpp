@@ -3,12 +3,27 @@
 //
 
 #include "algorithm.h"
+#include <charconv>
 #include <iostream>
 #include <regex>
 #include <stdexcept>
 #include <vector>
 
 namespace portfolio {
+    namespace {
+        /// Decimal number with exactly the digits in str
+        bool parse_digits(std::string_view str, int &value) {
+            int result = 0;
+            for (char c : str) {
+                if (c < '0' || c > '9') {
+                    return false;
+                }
+                result = result * 10 + (c - '0');
+            }
+            value = result;
+            return !str.empty();
+        }
+    } // namespace
 
     std::string minute_point_to_string(minute_point mp) {
         return date::format("%Y-%m-%d_%H-%M", mp);
@@ -21,23 +36,68 @@ namespace portfolio {
     }
 
     minute_point string_to_minute_point(std::string_view str_mp) {
-        std::string str(str_mp);
-        std::chrono::system_clock::time_point dt;
-        std::stringstream ss(str);
-        ss >> date::parse("%Y-%m-%d_%H-%M", dt);
-        return std::chrono::floor<std::chrono::minutes>(dt);
+        minute_point mp;
+        parse_minute_point(str_mp, mp);
+        return mp;
     }
 
     interval_points string_to_interval_points(std::string_view str_interval) {
-        std::string str(str_interval);
-        std::replace(str.begin(), str.end(), '|', ' ');
-        std::istringstream iss(str);
-        std::vector<std::string> result(std::istream_iterator<std::string>{iss},
-                                        std::istream_iterator<std::string>());
-        minute_point start = string_to_minute_point(result[0]);
-        minute_point end = string_to_minute_point(result[1]);
+        size_t bar = str_interval.find('|');
+        minute_point start =
+            string_to_minute_point(str_interval.substr(0, bar));
+        minute_point end;
+        if (bar != std::string_view::npos) {
+            end = string_to_minute_point(str_interval.substr(bar + 1));
+        }
         return std::make_pair(start, end);
     }
+
+    bool parse_double(std::string_view str, double &value) {
+        // std::from_chars does not accept the plus sign
+        if (!str.empty() && str.front() == '+') {
+            str.remove_prefix(1);
+            if (!str.empty() && str.front() == '-') {
+                return false;
+            }
+        }
+        double result;
+        const char *last = str.data() + str.size();
+        auto [ptr, ec] = std::from_chars(str.data(), last, result);
+        if (ec != std::errc() || ptr != last || !std::isfinite(result)) {
+            return false;
+        }
+        value = result;
+        return true;
+    }
+
+    bool parse_date(std::string_view str, date::sys_days &day) {
+        int y, m, d;
+        if (str.size() != 10 || str[4] != '-' || str[7] != '-' ||
+            !parse_digits(str.substr(0, 4), y) ||
+            !parse_digits(str.substr(5, 2), m) ||
+            !parse_digits(str.substr(8, 2), d)) {
+            return false;
+        }
+        date::year_month_day ymd{date::year(y), date::month(m), date::day(d)};
+        if (!ymd.ok()) {
+            return false;
+        }
+        day = date::sys_days{ymd};
+        return true;
+    }
+
+    bool parse_minute_point(std::string_view str, minute_point &mp) {
+        date::sys_days day;
+        int h, m;
+        if (str.size() != 16 || str[10] != '_' || str[13] != '-' ||
+            !parse_date(str.substr(0, 10), day) ||
+            !parse_digits(str.substr(11, 2), h) ||
+            !parse_digits(str.substr(14, 2), m) || h > 23 || m > 59) {
+            return false;
+        }
+        mp = day + std::chrono::hours(h) + std::chrono::minutes(m);
+        return true;
+    }
     std::string set_filename(std::string_view asset_code,
                              std::string_view start_period,
                              std::string_view end_period, timeframe tf) {
@@ -85,6 +145,9 @@ namespace portfolio {
         }
         return start_filename;
     }
+    std::string series_filename(std::string_view asset_code, timeframe tf) {
+        return start_filename(asset_code, tf) + ".series";
+    }
     bool is_floating(std::string_view str_view) {
         std::string str(str_view);
         const unsigned int len = str.length();
@@ -8,6 +8,7 @@
 #include <chrono>
 #include <cmath>
 #include <string>
+#include <string_view>
 
 namespace portfolio {
     using minute_point = std::chrono::time_point<std::chrono::system_clock,
@@ -19,6 +20,32 @@ namespace portfolio {
     /// \return True if is in floating-point format or false otherwise.
     bool is_floating(std::string_view str_view);
 
+    /// \brief Conversion from std::string_view to double without allocating.
+    /// Unlike is_floating, exponents (such as "1.5e-3"), a leading "+" and
+    /// forms such as ".5" are accepted. The decimal separator is always ".",
+    /// regardless of the global locale.
+    /// \param str String to be converted. Surrounding whitespace is not
+    /// accepted.
+    /// \param value Double where the result is saved.
+    /// \return True if str is a finite floating-point number or false
+    /// otherwise. value is not changed in case of errors.
+    bool parse_double(std::string_view str, double &value);
+
+    /// \brief Conversion from a date in the format "%Y-%m-%d" to sys_days.
+    /// \param str String to be converted, such as "2021-03-15".
+    /// \param day Day where the result is saved.
+    /// \return True if str is a valid date or false otherwise. day is not
+    /// changed in case of errors.
+    bool parse_date(std::string_view str, date::sys_days &day);
+
+    /// \brief Conversion from a time point in the format "%Y-%m-%d_%H-%M" to
+    /// minute_point.
+    /// \param str String to be converted, such as "2021-03-15_10-00".
+    /// \param mp Minute_point where the result is saved.
+    /// \return True if str is a valid time point or false otherwise. mp is
+    /// not changed in case of errors.
+    bool parse_minute_point(std::string_view str, minute_point &mp);
+
     /// \brief Conversion from std::string to minute_point.
     /// \param str_mp std::string to be converted. To work correctly, a string
     /// in the format "%Y-%m-%d_%H-%M" must be used. \return minute_point
@@ -59,6 +86,12 @@ namespace portfolio {
     /// \return Initial part of local data file used to search for this file.
     std::string start_filename(std::string_view asset_code, timeframe tf);
 
+    /// \brief Defines the name of the binary series file of an asset.
+    /// \param asset_code Symbol of asset.
+    /// \param tf Timeframe of data.
+    /// \return Name used for the series file, such as "IBM.WEEKLY.series".
+    std::string series_filename(std::string_view asset_code, timeframe tf);
+
     template <class T>
     typename std::enable_if<!std::numeric_limits<T>::is_integer, bool>::type
     almost_equal(T x, T y, int precision = 5) {
@@ -0,0 +1,48 @@
+#ifndef PORTFOLIO_ALIGNED_ALLOCATOR_H
+#define PORTFOLIO_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+namespace portfolio {
+    /// \brief Size of a cache line, in bytes.
+    constexpr size_t cache_line_size = 64;
+
+    /// \brief Allocator whose allocations start at a multiple of Alignment.
+    template <class T, size_t Alignment = cache_line_size>
+    class aligned_allocator {
+      public:
+        using value_type = T;
+
+        template <class U> struct rebind {
+            using other = aligned_allocator<U, Alignment>;
+        };
+
+      public /* constructors */:
+        aligned_allocator() noexcept = default;
+
+        template <class U>
+        aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept {}
+
+      public /* allocation */:
+        T *allocate(size_t n) {
+            return static_cast<T *>(
+                ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T *p, size_t) noexcept {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+
+        template <class U>
+        bool operator==(const aligned_allocator<U, Alignment> &) const {
+            return true;
+        }
+    };
+
+    /// \brief Vector whose data starts at the beginning of a cache line.
+    template <class T>
+    using aligned_vector = std::vector<T, aligned_allocator<T>>;
+} // namespace portfolio
+
+#endif // PORTFOLIO_ALIGNED_ALLOCATOR_H
@@ -0,0 +1,64 @@
+#include "file_lock.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+namespace portfolio {
+#ifdef _WIN32
+    file_lock::file_lock(const std::filesystem::path &path) {
+        HANDLE file = CreateFileW(
+            path.c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        OVERLAPPED overlapped{};
+        if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0,
+                        &overlapped)) {
+            CloseHandle(file);
+            return;
+        }
+        handle_ = file;
+    }
+
+    file_lock::~file_lock() {
+        if (handle_ != nullptr) {
+            OVERLAPPED overlapped{};
+            UnlockFileEx(handle_, 0, 1, 0, &overlapped);
+            CloseHandle(handle_);
+        }
+    }
+
+    bool file_lock::owns_lock() const { return handle_ != nullptr; }
+#else
+    file_lock::file_lock(const std::filesystem::path &path) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return;
+        }
+        int result;
+        do {
+            result = ::flock(fd, LOCK_EX);
+        } while (result != 0 && errno == EINTR);
+        if (result != 0) {
+            ::close(fd);
+            return;
+        }
+        fd_ = fd;
+    }
+
+    file_lock::~file_lock() {
+        if (fd_ >= 0) {
+            // closing the file releases the lock
+            ::close(fd_);
+        }
+    }
+
+    bool file_lock::owns_lock() const { return fd_ >= 0; }
+#endif
+} // namespace portfolio
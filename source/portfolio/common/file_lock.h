@@ -0,0 +1,34 @@
+#ifndef PORTFOLIO_FILE_LOCK_H
+#define PORTFOLIO_FILE_LOCK_H
+
+#include <filesystem>
+namespace portfolio {
+    /// \brief Exclusive lock of a file shared by processes.
+    ///
+    /// The lock file is created if it does not exist and is never removed,
+    /// so all processes lock the same file. The lock is released by the
+    /// destructor or when the process ends.
+    class file_lock {
+      public /* constructors */:
+        /// \brief Wait until the lock of a file is acquired.
+        /// \param path Path of the lock file.
+        explicit file_lock(const std::filesystem::path &path);
+        file_lock(const file_lock &) = delete;
+        file_lock &operator=(const file_lock &) = delete;
+        ~file_lock();
+
+      public /* getters */:
+        /// \brief Check if the lock was acquired. It might not be if the
+        /// lock file cannot be created.
+        [[nodiscard]] bool owns_lock() const;
+
+      private:
+#ifdef _WIN32
+        void *handle_{nullptr};
+#else
+        int fd_{-1};
+#endif
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_FILE_LOCK_H
@@ -0,0 +1,178 @@
+#include "mapped_file.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace portfolio {
+    namespace {
+        constexpr uint32_t file_byte_order = 0x01020304;
+    } // namespace
+
+    mapped_file::mapped_file(mapped_file &&rhs) noexcept { swap(rhs); }
+
+    mapped_file &mapped_file::operator=(mapped_file &&rhs) noexcept {
+        if (this != &rhs) {
+            close();
+            swap(rhs);
+        }
+        return *this;
+    }
+
+    mapped_file::~mapped_file() { close(); }
+
+    void mapped_file::swap(mapped_file &rhs) noexcept {
+        std::swap(data_, rhs.data_);
+        std::swap(size_, rhs.size_);
+#ifdef _WIN32
+        std::swap(file_handle_, rhs.file_handle_);
+        std::swap(mapping_handle_, rhs.mapping_handle_);
+#endif
+    }
+
+#ifdef _WIN32
+    bool mapped_file::open(const std::filesystem::path &path) {
+        close();
+        HANDLE file =
+            CreateFileW(path.c_str(), GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                        nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping =
+            CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CloseHandle(file);
+            return false;
+        }
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        file_handle_ = file;
+        mapping_handle_ = mapping;
+        data_ = static_cast<const std::byte *>(view);
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        return true;
+    }
+
+    void mapped_file::close() {
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+            CloseHandle(mapping_handle_);
+            CloseHandle(file_handle_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        file_handle_ = nullptr;
+        mapping_handle_ = nullptr;
+    }
+#else
+    bool mapped_file::open(const std::filesystem::path &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *view = ::mmap(nullptr, static_cast<size_t>(st.st_size),
+                            PROT_READ, MAP_SHARED, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+        data_ = static_cast<const std::byte *>(view);
+        size_ = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    void mapped_file::close() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::byte *>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+#endif
+
+    bool mapped_file::is_open() const { return data_ != nullptr; }
+
+    const std::byte *mapped_file::data() const { return data_; }
+
+    size_t mapped_file::size() const { return size_; }
+
+    file_preamble file_preamble::of(std::string_view magic,
+                                    uint32_t version) {
+        file_preamble p{};
+        magic.copy(p.magic, sizeof(p.magic));
+        p.version = version;
+        p.byte_order = file_byte_order;
+        return p;
+    }
+
+    bool file_preamble::matches(std::string_view magic,
+                                uint32_t version) const {
+        return std::string_view(this->magic, sizeof(this->magic)) == magic &&
+               this->version == version && byte_order == file_byte_order;
+    }
+
+    bool write_file_atomically(
+        const std::filesystem::path &path,
+        std::span<const std::span<const std::byte>> chunks) {
+        // The process id tells processes apart and the counter tells
+        // calls of this process apart
+        static std::atomic<uint64_t> n_calls{0};
+#ifdef _WIN32
+        uint64_t process = GetCurrentProcessId();
+#else
+        uint64_t process = static_cast<uint64_t>(::getpid());
+#endif
+        std::filesystem::path tmp_path = path;
+        tmp_path += ".";
+        tmp_path += std::to_string(process);
+        tmp_path += ".";
+        tmp_path += std::to_string(n_calls.fetch_add(1));
+        tmp_path += ".tmp";
+        std::ofstream fout(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!fout.is_open()) {
+            return false;
+        }
+        for (std::span<const std::byte> chunk : chunks) {
+            fout.write(reinterpret_cast<const char *>(chunk.data()),
+                       static_cast<std::streamsize>(chunk.size()));
+        }
+        fout.close();
+        std::error_code ec;
+        if (fout) {
+            std::filesystem::rename(tmp_path, path, ec);
+            if (!ec) {
+                return true;
+            }
+        }
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+} // namespace portfolio
@@ -0,0 +1,103 @@
+#ifndef PORTFOLIO_MAPPED_FILE_H
+#define PORTFOLIO_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+namespace portfolio {
+    /// \brief Read-only memory mapping of a whole file.
+    ///
+    /// Pages are only loaded by the operating system when they are touched,
+    /// so reading a small part of a large file is cheap.
+    class mapped_file {
+      public /* constructors */:
+        mapped_file() = default;
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+        mapped_file(mapped_file &&rhs) noexcept;
+        mapped_file &operator=(mapped_file &&rhs) noexcept;
+        ~mapped_file();
+
+      public /* modifiers */:
+        /// \brief Map a file into memory.
+        /// \param path Path of the file.
+        /// \return True if the file is mapped or false otherwise. Empty files
+        /// cannot be mapped.
+        bool open(const std::filesystem::path &path);
+
+        /// \brief Unmap the file.
+        void close();
+
+      public /* getters */:
+        /// \brief Check if a file is mapped.
+        [[nodiscard]] bool is_open() const;
+
+        /// \brief Get the first byte of the mapping.
+        [[nodiscard]] const std::byte *data() const;
+
+        /// \brief Get the number of bytes mapped.
+        [[nodiscard]] size_t size() const;
+
+      private:
+        void swap(mapped_file &rhs) noexcept;
+
+        const std::byte *data_{nullptr};
+        size_t size_{0};
+#ifdef _WIN32
+        void *file_handle_{nullptr};
+        void *mapping_handle_{nullptr};
+#endif
+    };
+
+    /// \brief First fields of the header of the binary files: the magic of
+    /// the format, its version and a byte order mark, which is only
+    /// valid on machines with the byte order of the writer.
+    struct file_preamble {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+
+        /// \brief Preamble of a format written by this machine.
+        /// \param magic Eight characters identifying the format.
+        /// \param version Version of the format.
+        static file_preamble of(std::string_view magic, uint32_t version);
+
+        /// \brief Check if a file has the format, version and byte order
+        /// of this machine.
+        [[nodiscard]] bool matches(std::string_view magic,
+                                   uint32_t version) const;
+    };
+    static_assert(sizeof(file_preamble) == 16);
+
+    /// \brief Header at the beginning of a mapped file.
+    /// \tparam Header Header whose first member is a file_preamble.
+    /// \return Header or nullptr if the file is smaller than the header or
+    /// its preamble does not match.
+    template <class Header>
+    const Header *mapped_header(const mapped_file &file,
+                                std::string_view magic, uint32_t version) {
+        if (file.size() < sizeof(Header)) {
+            return nullptr;
+        }
+        const auto *h = reinterpret_cast<const Header *>(file.data());
+        return h->preamble.matches(magic, version) ? h : nullptr;
+    }
+
+    /// \brief Replace a file with the concatenation of some chunks.
+    ///
+    /// The chunks are written to a temporary file next to the path, whose
+    /// name is unique to the process and the call, and this file is renamed
+    /// over the path. Readers, including those that mapped the old file,
+    /// never see a partially written file, and concurrent writers of the
+    /// same path never share a temporary file: the last rename wins.
+    /// \param path Path of the file.
+    /// \param chunks Bytes of the file, in order.
+    /// \return True if the file was replaced or false otherwise.
+    bool write_file_atomically(
+        const std::filesystem::path &path,
+        std::span<const std::span<const std::byte>> chunks);
+} // namespace portfolio
+
+#endif // PORTFOLIO_MAPPED_FILE_H
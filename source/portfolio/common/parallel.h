@@ -0,0 +1,71 @@
+#ifndef PORTFOLIO_PARALLEL_H
+#define PORTFOLIO_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+namespace portfolio {
+    /// \brief Number of worker threads to use when the user asks for
+    /// n_threads.
+    /// \param n_threads Number of threads requested. 0 means one thread per
+    /// hardware thread.
+    /// \param n_tasks Number of tasks to run.
+    /// \return Number of threads between 1 and n_tasks.
+    inline size_t worker_count(size_t n_threads, size_t n_tasks) {
+        if (n_threads == 0) {
+            n_threads =
+                std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        return std::max<size_t>(std::min(n_threads, n_tasks), 1);
+    }
+
+    /// \brief Call f(i) for every i in [0, n) using up to n_threads threads.
+    /// Tasks are handed out one at a time, so slow tasks do not hold back
+    /// the other workers. If a task throws, no new tasks are started and
+    /// the exception of the task with the lowest index is rethrown. Tasks
+    /// start in index order, so this is the same exception a sequential
+    /// loop would throw.
+    /// \param n Number of tasks.
+    /// \param n_threads Number of threads. 0 means one thread per hardware
+    /// thread and 1 runs all tasks in the calling thread.
+    /// \param f Function called with the index of each task.
+    template <class F>
+    void parallel_for(size_t n, size_t n_threads, F &&f) {
+        n_threads = worker_count(n_threads, n);
+        std::vector<std::exception_ptr> errors(n);
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        auto worker = [&]() {
+            for (size_t i = next++; i < n && !failed; i = next++) {
+                try {
+                    f(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+        if (n_threads == 1) {
+            worker();
+        } else {
+            std::vector<std::thread> threads;
+            threads.reserve(n_threads - 1);
+            for (size_t t = 1; t < n_threads; ++t) {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (auto &thread : threads) {
+                thread.join();
+            }
+        }
+        for (const auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+} // namespace portfolio
+#endif // PORTFOLIO_PARALLEL_H
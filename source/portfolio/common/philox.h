@@ -0,0 +1,93 @@
+#ifndef PORTFOLIO_PHILOX_H
+#define PORTFOLIO_PHILOX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+namespace portfolio {
+    /// \brief Philox4x32-10 counter-based random number generator.
+    ///
+    /// Each number is a function of the seed, the stream and its position
+    /// in the stream, so streams are independent and reproducible without
+    /// sharing any state between threads. The engine satisfies
+    /// UniformRandomBitGenerator and can be used with the standard
+    /// distributions.
+    class philox_engine {
+      public:
+        using result_type = uint32_t;
+        using block_type = std::array<uint32_t, 4>;
+
+      public /* constructors */:
+        /// \brief Constructor of philox_engine
+        /// \param seed Key shared by all streams.
+        /// \param stream Index of the stream.
+        explicit philox_engine(uint64_t seed = 0, uint64_t stream = 0)
+            : key_{static_cast<uint32_t>(seed),
+                   static_cast<uint32_t>(seed >> 32)},
+              stream_(stream) {}
+
+      public /* generation */:
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        /// \brief Next number of the stream.
+        result_type operator()() {
+            if (index_ == 4) {
+                block_ = block(key_, counter_++, stream_);
+                index_ = 0;
+            }
+            return block_[index_++];
+        }
+
+        /// \brief Skip the next n numbers of the stream.
+        void discard(uint64_t n) {
+            uint64_t position = counter_ * 4 - (4 - index_) + n;
+            counter_ = position / 4;
+            index_ = 4;
+            for (uint64_t i = position % 4; i != 0; --i) {
+                (*this)();
+            }
+        }
+
+        /// \brief Uniform double in [0, 1) with 53 random bits.
+        double uniform() {
+            uint64_t hi = (*this)();
+            uint64_t lo = (*this)();
+            return static_cast<double>(((hi << 32) | lo) >> 11) * 0x1.0p-53;
+        }
+
+        /// \brief The four numbers of a counter of a stream.
+        static block_type block(std::array<uint32_t, 2> key,
+                                uint64_t counter, uint64_t stream) {
+            block_type ctr = {static_cast<uint32_t>(counter),
+                              static_cast<uint32_t>(counter >> 32),
+                              static_cast<uint32_t>(stream),
+                              static_cast<uint32_t>(stream >> 32)};
+            for (int round = 0; round < 10; ++round) {
+                if (round != 0) {
+                    key[0] += 0x9E3779B9;
+                    key[1] += 0xBB67AE85;
+                }
+                uint64_t p0 = uint64_t(0xD2511F53) * ctr[0];
+                uint64_t p1 = uint64_t(0xCD9E8D57) * ctr[2];
+                ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                       static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                       static_cast<uint32_t>(p0)};
+            }
+            return ctr;
+        }
+
+      private:
+        std::array<uint32_t, 2> key_;
+        uint64_t stream_;
+        uint64_t counter_{0};
+        block_type block_{};
+        size_t index_{4};
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_PHILOX_H
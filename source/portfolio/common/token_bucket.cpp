@@ -0,0 +1,58 @@
+#include "token_bucket.h"
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio {
+
+    token_bucket::token_bucket(double capacity, double tokens_per_second,
+                               clock::time_point now)
+        : capacity_(capacity), tokens_per_second_(tokens_per_second),
+          tokens_(capacity), last_refill_(now) {
+        if (capacity < 1.0 || tokens_per_second <= 0.0) {
+            throw std::runtime_error(
+                "TOKEN_BUCKET constructor error: capacity must be at least "
+                "1 and tokens_per_second must be positive.");
+        }
+    }
+
+    bool token_bucket::try_acquire(clock::time_point now) {
+        refill(now);
+        if (tokens_ < 1.0) {
+            return false;
+        }
+        tokens_ -= 1.0;
+        return true;
+    }
+
+    token_bucket::clock::time_point
+    token_bucket::available_at(clock::time_point now) {
+        refill(now);
+        if (tokens_ >= 1.0) {
+            return now;
+        }
+        std::chrono::duration<double> wait((1.0 - tokens_) /
+                                           tokens_per_second_);
+        // round up, so the token is there at the time point
+        return now + std::chrono::ceil<clock::duration>(wait);
+    }
+
+    double token_bucket::tokens(clock::time_point now) {
+        refill(now);
+        return tokens_;
+    }
+
+    double token_bucket::capacity() const { return capacity_; }
+
+    double token_bucket::tokens_per_second() const {
+        return tokens_per_second_;
+    }
+
+    void token_bucket::refill(clock::time_point now) {
+        if (now <= last_refill_) {
+            return;
+        }
+        std::chrono::duration<double> elapsed = now - last_refill_;
+        tokens_ =
+            std::min(capacity_, tokens_ + elapsed.count() * tokens_per_second_);
+        last_refill_ = now;
+    }
+} // namespace portfolio
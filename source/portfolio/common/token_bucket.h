@@ -0,0 +1,53 @@
+#ifndef PORTFOLIO_TOKEN_BUCKET_H
+#define PORTFOLIO_TOKEN_BUCKET_H
+
+#include <chrono>
+namespace portfolio {
+    /// \brief Token bucket rate limiter.
+    ///
+    /// The bucket holds up to capacity tokens and gains tokens_per_second
+    /// tokens continuously. Each operation takes one token, so at most
+    /// capacity operations happen in a burst and the long run rate never
+    /// exceeds tokens_per_second. The bucket is not synchronized.
+    class token_bucket {
+      public:
+        using clock = std::chrono::steady_clock;
+
+      public /* constructors */:
+        /// \brief Constructor of token_bucket. The bucket starts full.
+        /// \param capacity Maximum number of tokens.
+        /// \param tokens_per_second Tokens added to the bucket per second.
+        /// \param now Current time point.
+        token_bucket(double capacity, double tokens_per_second,
+                     clock::time_point now = clock::now());
+
+      public /* getters and setters */:
+        /// \brief Take a token from the bucket if there is one.
+        /// \param now Current time point.
+        /// \return True if a token was taken or false otherwise.
+        bool try_acquire(clock::time_point now = clock::now());
+
+        /// \brief Time point when the next token is available.
+        /// \param now Current time point.
+        /// \return now if there is a token available.
+        clock::time_point available_at(clock::time_point now = clock::now());
+
+        /// \brief Number of tokens in the bucket.
+        /// \param now Current time point.
+        double tokens(clock::time_point now = clock::now());
+
+        [[nodiscard]] double capacity() const;
+
+        [[nodiscard]] double tokens_per_second() const;
+
+      private:
+        /// \brief Add the tokens gained since the last refill.
+        void refill(clock::time_point now);
+
+        double capacity_;
+        double tokens_per_second_;
+        double tokens_;
+        clock::time_point last_refill_;
+    };
+} // namespace portfolio
+#endif // PORTFOLIO_TOKEN_BUCKET_H
@@ -3,9 +3,9 @@
 //
 #include "ohlc_prices.h"
 #include "portfolio/common/algorithm.h"
+#include <algorithm>
 #include <iomanip>
 #include <string>
-#include <vector>
 namespace portfolio {
 
     double ohlc_prices::open() const { return open_price_; }
@@ -40,37 +40,25 @@ namespace portfolio {
         return open_str + " " + high_str + " " + low_str + " " + close_str;
     }
     bool ohlc_prices::from_string(std::string_view str_ohlc) {
-        std::string str(str_ohlc);
-        std::istringstream iss(str);
-        std::vector<std::string> result(std::istream_iterator<std::string>{iss},
-                                        std::istream_iterator<std::string>());
-        std::string st_open = result[0];
-        std::string st_high = result[1];
-        std::string st_low = result[2];
-        std::string st_close = result[3];
-
-        std::string::size_type sz; // alias of size_t
-
-        if (is_floating(st_open)) {
-            open_price_ = std::stod(st_open, &sz);
-        } else {
-            return false;
-        }
-        if (is_floating(st_high)) {
-            high_price_ = std::stod(st_high, &sz);
-        } else {
-            return false;
-        }
-        if (is_floating(st_low)) {
-            low_price_ = std::stod(st_low, &sz);
-        } else {
-            return false;
+        // Four prices separated by whitespace
+        double prices[4];
+        for (double &price : prices) {
+            size_t first = str_ohlc.find_first_not_of(" \t\n\r");
+            if (first == std::string_view::npos) {
+                return false;
+            }
+            str_ohlc.remove_prefix(first);
+            size_t last = std::min(str_ohlc.find_first_of(" \t\n\r"),
+                                   str_ohlc.size());
+            if (!parse_double(str_ohlc.substr(0, last), price)) {
+                return false;
+            }
+            str_ohlc.remove_prefix(last);
         }
-        if (is_floating(st_close)) {
-            close_price_ = std::stod(st_close, &sz);
-        } else {
+        if (str_ohlc.find_first_not_of(" \t\n\r") != std::string_view::npos) {
             return false;
         }
+        set_prices(prices[0], prices[1], prices[2], prices[3]);
         return true;
     }
     bool ohlc_prices::operator==(const ohlc_prices &rhs) const {
@@ -0,0 +1,118 @@
+#include "price_series.h"
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio {
+
+    price_series::price_series(const price_map &prices) {
+        reserve(prices.size());
+        for (const auto &[interval, ohlc] : prices) {
+            push_back(interval, ohlc);
+        }
+    }
+
+    bool price_series::operator==(const price_series &rhs) const {
+        return starts_ == rhs.starts_ && ends_ == rhs.ends_ &&
+               opens_ == rhs.opens_ && highs_ == rhs.highs_ &&
+               lows_ == rhs.lows_ && closes_ == rhs.closes_;
+    }
+
+    bool price_series::operator!=(const price_series &rhs) const {
+        return !(rhs == *this);
+    }
+
+    void price_series::reserve(size_t n) {
+        starts_.reserve(n);
+        ends_.reserve(n);
+        opens_.reserve(n);
+        highs_.reserve(n);
+        lows_.reserve(n);
+        closes_.reserve(n);
+    }
+
+    void price_series::push_back(interval_points interval,
+                                 const ohlc_prices &prices) {
+        push_back(interval.first, interval.second, prices.open(),
+                  prices.high(), prices.low(), prices.close());
+    }
+
+    void price_series::push_back(minute_point start, minute_point end,
+                                 double open, double high, double low,
+                                 double close) {
+        if (!starts_.empty() && start <= starts_.back()) {
+            throw std::runtime_error("PRICE_SERIES push_back error: bars "
+                                     "must be in chronological order.");
+        }
+        starts_.push_back(start);
+        ends_.push_back(end);
+        opens_.push_back(open);
+        highs_.push_back(high);
+        lows_.push_back(low);
+        closes_.push_back(close);
+    }
+
+    size_t price_series::size() const { return starts_.size(); }
+
+    bool price_series::empty() const { return starts_.empty(); }
+
+    interval_points price_series::interval(size_t i) const {
+        return std::make_pair(starts_[i], ends_[i]);
+    }
+
+    ohlc_prices price_series::prices(size_t i) const {
+        return ohlc_prices(opens_[i], highs_[i], lows_[i], closes_[i]);
+    }
+
+    size_t price_series::find(interval_points interval) const {
+        size_t i = lower_bound(interval.first);
+        if (i != size() && starts_[i] == interval.first &&
+            ends_[i] == interval.second) {
+            return i;
+        }
+        return size();
+    }
+
+    size_t price_series::lower_bound(minute_point mp) const {
+        return std::lower_bound(starts_.begin(), starts_.end(), mp) -
+               starts_.begin();
+    }
+
+    price_series price_series::slice(minute_point start_period,
+                                     minute_point end_period) const {
+        // Bars are sorted and do not overlap, so both columns are sorted
+        size_t first = lower_bound(start_period);
+        size_t last =
+            std::upper_bound(ends_.begin(), ends_.end(), end_period) -
+            ends_.begin();
+        price_series result;
+        if (first < last) {
+            result.starts_.assign(starts_.begin() + first,
+                                  starts_.begin() + last);
+            result.ends_.assign(ends_.begin() + first, ends_.begin() + last);
+            result.opens_.assign(opens_.begin() + first,
+                                 opens_.begin() + last);
+            result.highs_.assign(highs_.begin() + first,
+                                 highs_.begin() + last);
+            result.lows_.assign(lows_.begin() + first, lows_.begin() + last);
+            result.closes_.assign(closes_.begin() + first,
+                                  closes_.begin() + last);
+        }
+        return result;
+    }
+
+    std::span<const minute_point> price_series::starts() const {
+        return starts_;
+    }
+    std::span<const minute_point> price_series::ends() const { return ends_; }
+    std::span<const double> price_series::opens() const { return opens_; }
+    std::span<const double> price_series::highs() const { return highs_; }
+    std::span<const double> price_series::lows() const { return lows_; }
+    std::span<const double> price_series::closes() const { return closes_; }
+
+    price_series::const_iterator price_series::begin() const {
+        return const_iterator(this, 0);
+    }
+
+    price_series::const_iterator price_series::end() const {
+        return const_iterator(this, size());
+    }
+} // namespace portfolio
@@ -0,0 +1,194 @@
+#ifndef PORTFOLIO_PRICE_SERIES_H
+#define PORTFOLIO_PRICE_SERIES_H
+
+#include "portfolio/core/ohlc_prices.h"
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <span>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    using minute_point = std::chrono::time_point<std::chrono::system_clock,
+                                                 std::chrono::minutes>;
+    using interval_points = std::pair<minute_point, minute_point>;
+    using price_map = std::map<interval_points, ohlc_prices>;
+
+    /// \brief Random access iterator presenting each bar of a series as a
+    /// (interval_points, ohlc_prices) pair, like a price_map iterator.
+    /// \tparam Series Price_series or price_view.
+    template <class Series> class series_iterator {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::pair<interval_points, ohlc_prices>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+
+        /// \brief Holds the bar so that it->second works on a proxy.
+        struct pointer {
+            value_type value;
+            const value_type *operator->() const { return &value; }
+        };
+
+        series_iterator() = default;
+        series_iterator(const Series *series, size_t index)
+            : series_(series), index_(index) {}
+
+        reference operator*() const {
+            return {series_->interval(index_), series_->prices(index_)};
+        }
+        pointer operator->() const { return {**this}; }
+        reference operator[](difference_type n) const { return *(*this + n); }
+
+        series_iterator &operator++() {
+            ++index_;
+            return *this;
+        }
+        series_iterator operator++(int) {
+            series_iterator tmp = *this;
+            ++index_;
+            return tmp;
+        }
+        series_iterator &operator--() {
+            --index_;
+            return *this;
+        }
+        series_iterator operator--(int) {
+            series_iterator tmp = *this;
+            --index_;
+            return tmp;
+        }
+        series_iterator &operator+=(difference_type n) {
+            index_ += n;
+            return *this;
+        }
+        series_iterator &operator-=(difference_type n) {
+            index_ -= n;
+            return *this;
+        }
+        friend series_iterator operator+(series_iterator it,
+                                         difference_type n) {
+            return it += n;
+        }
+        friend series_iterator operator+(difference_type n,
+                                         series_iterator it) {
+            return it += n;
+        }
+        friend series_iterator operator-(series_iterator it,
+                                         difference_type n) {
+            return it -= n;
+        }
+        friend difference_type operator-(const series_iterator &lhs,
+                                         const series_iterator &rhs) {
+            return static_cast<difference_type>(lhs.index_) -
+                   static_cast<difference_type>(rhs.index_);
+        }
+        friend bool operator==(const series_iterator &lhs,
+                               const series_iterator &rhs) {
+            return lhs.index_ == rhs.index_;
+        }
+        friend auto operator<=>(const series_iterator &lhs,
+                                const series_iterator &rhs) {
+            return lhs.index_ <=> rhs.index_;
+        }
+
+        /// \brief Position of the bar in the series or view.
+        [[nodiscard]] size_t index() const { return index_; }
+
+      private:
+        const Series *series_{nullptr};
+        size_t index_{0};
+    };
+
+    /// \brief Chronological OHLC series stored as contiguous columns.
+    ///
+    /// Each bar is split across six parallel columns (start, end, open,
+    /// high, low, close) so scans over a single column are contiguous and
+    /// interval lookups are binary searches over the start column.
+    class price_series {
+      public:
+        using const_iterator = series_iterator<price_series>;
+
+      public /* constructors */:
+        price_series() = default;
+
+        /// \brief Build a series from a price map.
+        /// \param prices Bars to be copied. The map order is chronological.
+        explicit price_series(const price_map &prices);
+
+        bool operator==(const price_series &rhs) const;
+        bool operator!=(const price_series &rhs) const;
+
+      public /* modifiers */:
+        /// \brief Reserve space for n bars in all columns.
+        /// \param n Number of bars.
+        void reserve(size_t n);
+
+        /// \brief Append a bar to the end of the series.
+        /// \param interval Interval of the bar. Its start must be after the
+        /// start of the last bar in the series.
+        /// \param prices Prices of the bar.
+        void push_back(interval_points interval, const ohlc_prices &prices);
+
+        /// \brief Append a bar to the end of the series.
+        /// \param start Start of the bar.
+        /// \param end End of the bar.
+        /// \param open Open price.
+        /// \param high High price.
+        /// \param low Low price.
+        /// \param close Close price.
+        void push_back(minute_point start, minute_point end, double open,
+                       double high, double low, double close);
+
+      public /* getters */:
+        /// \brief Number of bars in the series.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Check if the series has no bars.
+        [[nodiscard]] bool empty() const;
+
+        /// \brief Get the interval of the i-th bar.
+        [[nodiscard]] interval_points interval(size_t i) const;
+
+        /// \brief Get the prices of the i-th bar.
+        [[nodiscard]] ohlc_prices prices(size_t i) const;
+
+        /// \brief Find the index of the bar with exactly this interval.
+        /// \param interval Interval for searching.
+        /// \return Index of the bar or size() if not found.
+        [[nodiscard]] size_t find(interval_points interval) const;
+
+        /// \brief Index of the first bar whose start is not before mp.
+        [[nodiscard]] size_t lower_bound(minute_point mp) const;
+
+        /// \brief Copy the bars inside a period into a new series.
+        /// \param start_period Bars starting before this are ignored.
+        /// \param end_period Bars ending after this are ignored.
+        /// \return Price_series with the bars inside the period.
+        [[nodiscard]] price_series slice(minute_point start_period,
+                                         minute_point end_period) const;
+
+        /// \brief Columns of the series.
+        [[nodiscard]] std::span<const minute_point> starts() const;
+        [[nodiscard]] std::span<const minute_point> ends() const;
+        [[nodiscard]] std::span<const double> opens() const;
+        [[nodiscard]] std::span<const double> highs() const;
+        [[nodiscard]] std::span<const double> lows() const;
+        [[nodiscard]] std::span<const double> closes() const;
+
+      public /* iterators */:
+        [[nodiscard]] const_iterator begin() const;
+        [[nodiscard]] const_iterator end() const;
+
+      private:
+        std::vector<minute_point> starts_;
+        std::vector<minute_point> ends_;
+        std::vector<double> opens_;
+        std::vector<double> highs_;
+        std::vector<double> lows_;
+        std::vector<double> closes_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_PRICE_SERIES_H
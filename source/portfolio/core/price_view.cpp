@@ -0,0 +1,138 @@
+#include "price_view.h"
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        template <class A, class B> bool same_bars(const A &a, const B &b) {
+            return std::ranges::equal(a.starts(), b.starts()) &&
+                   std::ranges::equal(a.ends(), b.ends()) &&
+                   std::ranges::equal(a.opens(), b.opens()) &&
+                   std::ranges::equal(a.highs(), b.highs()) &&
+                   std::ranges::equal(a.lows(), b.lows()) &&
+                   std::ranges::equal(a.closes(), b.closes());
+        }
+    } // namespace
+
+    price_view::price_view(price_series series)
+        : price_view(std::make_shared<const price_series>(std::move(series))) {
+    }
+
+    price_view::price_view(std::shared_ptr<const price_series> series)
+        : series_(std::move(series)) {
+        last_ = series_ ? series_->size() : 0;
+    }
+
+    price_view::price_view(std::shared_ptr<const price_series> series,
+                           size_t first, size_t last)
+        : series_(std::move(series)), first_(first), last_(last) {
+        size_t n = series_ ? series_->size() : 0;
+        if (first > last || last > n) {
+            throw std::runtime_error(
+                "PRICE_VIEW constructor error: range out of the series.");
+        }
+    }
+
+    bool price_view::operator==(const price_view &rhs) const {
+        return same_bars(*this, rhs);
+    }
+
+    bool price_view::operator==(const price_series &rhs) const {
+        return same_bars(*this, rhs);
+    }
+
+    size_t price_view::size() const { return last_ - first_; }
+
+    bool price_view::empty() const { return first_ == last_; }
+
+    interval_points price_view::interval(size_t i) const {
+        return series_->interval(first_ + i);
+    }
+
+    ohlc_prices price_view::prices(size_t i) const {
+        return series_->prices(first_ + i);
+    }
+
+    size_t price_view::find(interval_points interval) const {
+        size_t i = lower_bound(interval.first);
+        if (i != size() && starts()[i] == interval.first &&
+            ends()[i] == interval.second) {
+            return i;
+        }
+        return size();
+    }
+
+    size_t price_view::lower_bound(minute_point mp) const {
+        auto s = starts();
+        return std::lower_bound(s.begin(), s.end(), mp) - s.begin();
+    }
+
+    price_view price_view::slice(minute_point start_period,
+                                 minute_point end_period) const {
+        // Bars are sorted and do not overlap, so both columns are sorted
+        auto e = ends();
+        size_t first = lower_bound(start_period);
+        size_t last =
+            std::upper_bound(e.begin(), e.end(), end_period) - e.begin();
+        return subview(first, std::max(first, last));
+    }
+
+    price_view price_view::subview(size_t first, size_t last) const {
+        if (first > last || last > size()) {
+            throw std::runtime_error(
+                "PRICE_VIEW subview error: range out of the view.");
+        }
+        return price_view(series_, first_ + first, first_ + last);
+    }
+
+    std::span<const minute_point> price_view::starts() const {
+        return empty() ? std::span<const minute_point>()
+                       : series_->starts().subspan(first_, size());
+    }
+
+    std::span<const minute_point> price_view::ends() const {
+        return empty() ? std::span<const minute_point>()
+                       : series_->ends().subspan(first_, size());
+    }
+
+    std::span<const double> price_view::opens() const {
+        return empty() ? std::span<const double>()
+                       : series_->opens().subspan(first_, size());
+    }
+
+    std::span<const double> price_view::highs() const {
+        return empty() ? std::span<const double>()
+                       : series_->highs().subspan(first_, size());
+    }
+
+    std::span<const double> price_view::lows() const {
+        return empty() ? std::span<const double>()
+                       : series_->lows().subspan(first_, size());
+    }
+
+    std::span<const double> price_view::closes() const {
+        return empty() ? std::span<const double>()
+                       : series_->closes().subspan(first_, size());
+    }
+
+    price_series price_view::to_series() const {
+        price_series series;
+        series.reserve(size());
+        for (size_t i = 0; i < size(); ++i) {
+            series.push_back(interval(i), prices(i));
+        }
+        return series;
+    }
+
+    const std::shared_ptr<const price_series> &
+    price_view::shared_series() const {
+        return series_;
+    }
+
+    price_view::const_iterator price_view::begin() const {
+        return const_iterator(this, 0);
+    }
+
+    price_view::const_iterator price_view::end() const {
+        return const_iterator(this, size());
+    }
+} // namespace portfolio
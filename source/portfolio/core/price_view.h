@@ -0,0 +1,96 @@
+#ifndef PORTFOLIO_PRICE_VIEW_H
+#define PORTFOLIO_PRICE_VIEW_H
+
+#include "portfolio/core/price_series.h"
+#include <memory>
+#include <span>
+namespace portfolio {
+    /// \brief Immutable range of bars of a shared price_series.
+    ///
+    /// The bars are held by a reference counted price_series that never
+    /// changes once it is in a view. Copying a view or taking a slice of it
+    /// only copies a pointer and two offsets, so every consumer of a series
+    /// can share the same columns.
+    class price_view {
+      public:
+        using const_iterator = series_iterator<price_view>;
+
+      public /* constructors */:
+        price_view() = default;
+
+        /// \brief View of all bars of a series.
+        /// \param series Series to be shared by the view and its slices.
+        explicit price_view(price_series series);
+
+        /// \brief View of all bars of a shared series.
+        /// \param series Series to be shared by the view and its slices.
+        explicit price_view(std::shared_ptr<const price_series> series);
+
+        /// \brief View of the bars [first, last) of a shared series.
+        /// \param series Series to be shared by the view and its slices.
+        /// \param first Index of the first bar in the view.
+        /// \param last Index after the last bar in the view.
+        price_view(std::shared_ptr<const price_series> series, size_t first,
+                   size_t last);
+
+        bool operator==(const price_view &rhs) const;
+        bool operator==(const price_series &rhs) const;
+
+      public /* getters */:
+        /// \brief Number of bars in the view.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Check if the view has no bars.
+        [[nodiscard]] bool empty() const;
+
+        /// \brief Get the interval of the i-th bar of the view.
+        [[nodiscard]] interval_points interval(size_t i) const;
+
+        /// \brief Get the prices of the i-th bar of the view.
+        [[nodiscard]] ohlc_prices prices(size_t i) const;
+
+        /// \brief Find the index of the bar with exactly this interval.
+        /// \param interval Interval for searching.
+        /// \return Index of the bar in the view or size() if not found.
+        [[nodiscard]] size_t find(interval_points interval) const;
+
+        /// \brief Index of the first bar whose start is not before mp.
+        [[nodiscard]] size_t lower_bound(minute_point mp) const;
+
+        /// \brief View of the bars inside a period, without copying them.
+        /// \param start_period Bars starting before this are ignored.
+        /// \param end_period Bars ending after this are ignored.
+        /// \return Price_view with the bars inside the period.
+        [[nodiscard]] price_view slice(minute_point start_period,
+                                       minute_point end_period) const;
+
+        /// \brief View of the bars [first, last) of this view.
+        [[nodiscard]] price_view subview(size_t first, size_t last) const;
+
+        /// \brief Columns of the view.
+        [[nodiscard]] std::span<const minute_point> starts() const;
+        [[nodiscard]] std::span<const minute_point> ends() const;
+        [[nodiscard]] std::span<const double> opens() const;
+        [[nodiscard]] std::span<const double> highs() const;
+        [[nodiscard]] std::span<const double> lows() const;
+        [[nodiscard]] std::span<const double> closes() const;
+
+        /// \brief Copy the bars of the view into a new series.
+        [[nodiscard]] price_series to_series() const;
+
+        /// \brief Series shared by this view.
+        [[nodiscard]] const std::shared_ptr<const price_series> &
+        shared_series() const;
+
+      public /* iterators */:
+        [[nodiscard]] const_iterator begin() const;
+        [[nodiscard]] const_iterator end() const;
+
+      private:
+        std::shared_ptr<const price_series> series_;
+        size_t first_{0};
+        size_t last_{0};
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_PRICE_VIEW_H
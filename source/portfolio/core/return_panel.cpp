@@ -0,0 +1,162 @@
+#include "return_panel.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        std::vector<interval_points> intervals_of(const price_view &series) {
+            std::vector<interval_points> intervals(series.size());
+            for (size_t i = 0; i < series.size(); ++i) {
+                intervals[i] = series.interval(i);
+            }
+            return intervals;
+        }
+
+        /// \brief Bars of the panel, before the first return
+        std::vector<interval_points>
+        common_calendar(const std::vector<price_view> &series,
+                        missing_bar_policy policy) {
+            std::vector<interval_points> calendar;
+            if (series.empty()) {
+                return calendar;
+            }
+            calendar = intervals_of(series.front());
+            for (size_t k = 1; k < series.size(); ++k) {
+                // Both lists are sorted because bars do not overlap
+                std::vector<interval_points> asset = intervals_of(series[k]);
+                std::vector<interval_points> merged;
+                if (policy == missing_bar_policy::drop) {
+                    std::set_intersection(calendar.begin(), calendar.end(),
+                                          asset.begin(), asset.end(),
+                                          std::back_inserter(merged));
+                } else {
+                    std::set_union(calendar.begin(), calendar.end(),
+                                   asset.begin(), asset.end(),
+                                   std::back_inserter(merged));
+                }
+                calendar = std::move(merged);
+            }
+            if (policy == missing_bar_policy::forward_fill) {
+                // There is nothing to fill before the first bar of an asset
+                minute_point first_start = minute_point::min();
+                for (const price_view &s : series) {
+                    if (s.empty()) {
+                        return {};
+                    }
+                    first_start = std::max(first_start, s.starts().front());
+                }
+                auto first = std::find_if(
+                    calendar.begin(), calendar.end(),
+                    [&](const auto &i) { return i.first >= first_start; });
+                calendar.erase(calendar.begin(), first);
+            }
+            return calendar;
+        }
+    } // namespace
+
+    return_panel::return_panel(std::vector<std::string> assets,
+                               const std::vector<price_view> &series,
+                               missing_bar_policy policy)
+        : assets_(std::move(assets)), policy_(policy) {
+        if (assets_.size() != series.size()) {
+            throw std::runtime_error("RETURN_PANEL constructor error: one "
+                                     "series is needed per asset.");
+        }
+        std::vector<interval_points> calendar =
+            common_calendar(series, policy);
+        if (calendar.size() < 2) {
+            calendar.clear();
+        } else {
+            intervals_.assign(calendar.begin() + 1, calendar.end());
+        }
+
+        // Rows are padded to whole cache lines
+        constexpr size_t line = cache_line_size / sizeof(double);
+        stride_ = (intervals_.size() + line - 1) / line * line;
+        returns_.assign(assets_.size() * stride_, 0.0);
+        mask_.assign(assets_.size() * stride_, 0);
+
+        std::vector<double> closes(calendar.size());
+        std::vector<uint8_t> known(calendar.size());
+        for (size_t k = 0; k < series.size(); ++k) {
+            // Closes of the asset on the calendar
+            const price_view &s = series[k];
+            auto starts = s.starts();
+            auto ends = s.ends();
+            auto asset_closes = s.closes();
+            size_t j = 0;
+            for (size_t t = 0; t < calendar.size(); ++t) {
+                while (j < s.size() && starts[j] < calendar[t].first) {
+                    ++j;
+                }
+                known[t] = j < s.size() && starts[j] == calendar[t].first &&
+                           ends[j] == calendar[t].second;
+                closes[t] = known[t] ? asset_closes[j] : 0.0;
+                if (!known[t] && policy == missing_bar_policy::forward_fill) {
+                    if (t != 0) {
+                        known[t] = known[t - 1];
+                        closes[t] = closes[t - 1];
+                    } else if (j != 0) {
+                        // The calendar starts at the first bar of another
+                        // asset, so fill it from the last earlier bar
+                        known[t] = 1;
+                        closes[t] = asset_closes[j - 1];
+                    }
+                }
+            }
+            double *row = returns_.data() + k * stride_;
+            uint8_t *row_mask = mask_.data() + k * stride_;
+            for (size_t t = 0; t < intervals_.size(); ++t) {
+                // There is no return from a zero close
+                if (known[t] && known[t + 1] && closes[t] != 0.0) {
+                    row[t] = (closes[t + 1] - closes[t]) / closes[t];
+                    row_mask[t] = 1;
+                }
+            }
+        }
+    }
+
+    size_t return_panel::n_assets() const { return assets_.size(); }
+
+    size_t return_panel::n_periods() const { return intervals_.size(); }
+
+    size_t return_panel::stride() const { return stride_; }
+
+    missing_bar_policy return_panel::policy() const { return policy_; }
+
+    const std::vector<std::string> &return_panel::assets() const {
+        return assets_;
+    }
+
+    size_t return_panel::asset_index(std::string_view asset) const {
+        return std::find(assets_.begin(), assets_.end(), asset) -
+               assets_.begin();
+    }
+
+    std::span<const interval_points> return_panel::intervals() const {
+        return intervals_;
+    }
+
+    size_t return_panel::find(interval_points interval) const {
+        auto it =
+            std::lower_bound(intervals_.begin(), intervals_.end(), interval);
+        if (it != intervals_.end() && *it == interval) {
+            return it - intervals_.begin();
+        }
+        return n_periods();
+    }
+
+    std::span<const double> return_panel::returns(size_t asset) const {
+        return {returns_.data() + asset * stride_, n_periods()};
+    }
+
+    std::span<const uint8_t> return_panel::mask(size_t asset) const {
+        return {mask_.data() + asset * stride_, n_periods()};
+    }
+
+    bool return_panel::valid(size_t asset, size_t period) const {
+        return mask_[asset * stride_ + period] != 0;
+    }
+
+    const double *return_panel::data() const { return returns_.data(); }
+} // namespace portfolio
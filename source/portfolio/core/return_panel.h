@@ -0,0 +1,95 @@
+#ifndef PORTFOLIO_RETURN_PANEL_H
+#define PORTFOLIO_RETURN_PANEL_H
+
+#include "portfolio/common/aligned_allocator.h"
+#include "portfolio/core/price_view.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace portfolio {
+    /// \brief What to do with bars an asset does not have in the common
+    /// calendar of a return_panel.
+    enum class missing_bar_policy {
+        /// \brief The calendar only has the bars all assets have.
+        drop,
+        /// \brief The calendar has the bars any asset has, starting when
+        /// all assets have data. Missing closes repeat the previous close.
+        forward_fill,
+        /// \brief The calendar has the bars any asset has. Returns that
+        /// need a missing close are zero and marked as invalid.
+        mask
+    };
+
+    /// \brief Close-to-close returns of several assets on a common calendar.
+    ///
+    /// The returns are stored in one asset x time matrix. Each asset row is
+    /// contiguous and starts at a cache line, so computations over an asset
+    /// or a window of periods are strided reads over the same buffer.
+    /// Period t is the return from the close of the bar before intervals()[t]
+    /// to the close of intervals()[t].
+    class return_panel {
+      public /* constructors */:
+        return_panel() = default;
+
+        /// \brief Constructor of return_panel
+        /// \param assets Symbols of the assets.
+        /// \param series Bars of each asset.
+        /// \param policy How to treat the bars some assets do not have.
+        return_panel(std::vector<std::string> assets,
+                     const std::vector<price_view> &series,
+                     missing_bar_policy policy = missing_bar_policy::drop);
+
+      public /* getters */:
+        /// \brief Number of assets (rows) in the panel.
+        [[nodiscard]] size_t n_assets() const;
+
+        /// \brief Number of periods (columns) in the panel.
+        [[nodiscard]] size_t n_periods() const;
+
+        /// \brief Distance, in elements, between the rows of two assets.
+        [[nodiscard]] size_t stride() const;
+
+        /// \brief Policy used for the missing bars.
+        [[nodiscard]] missing_bar_policy policy() const;
+
+        /// \brief Symbols of the assets, in the order of the rows.
+        [[nodiscard]] const std::vector<std::string> &assets() const;
+
+        /// \brief Row of an asset.
+        /// \return Index of the asset or n_assets() if not found.
+        [[nodiscard]] size_t asset_index(std::string_view asset) const;
+
+        /// \brief Interval of the bar where each period ends.
+        [[nodiscard]] std::span<const interval_points> intervals() const;
+
+        /// \brief Find the period ending with exactly this interval.
+        /// \return Index of the period or n_periods() if not found.
+        [[nodiscard]] size_t find(interval_points interval) const;
+
+        /// \brief Returns of an asset in all periods.
+        [[nodiscard]] std::span<const double> returns(size_t asset) const;
+
+        /// \brief Validity of the returns of an asset: 1 when the return
+        /// is known and 0 when the return is masked.
+        [[nodiscard]] std::span<const uint8_t> mask(size_t asset) const;
+
+        /// \brief Check if the return of an asset in a period is known.
+        [[nodiscard]] bool valid(size_t asset, size_t period) const;
+
+        /// \brief Beginning of the matrix, with n_assets() rows of stride()
+        /// elements.
+        [[nodiscard]] const double *data() const;
+
+      private:
+        std::vector<std::string> assets_;
+        std::vector<interval_points> intervals_;
+        missing_bar_policy policy_{missing_bar_policy::drop};
+        size_t stride_{0};
+        aligned_vector<double> returns_;
+        std::vector<uint8_t> mask_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_RETURN_PANEL_H
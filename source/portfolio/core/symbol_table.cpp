@@ -0,0 +1,43 @@
+#include "symbol_table.h"
+#include <stdexcept>
+namespace portfolio {
+    symbol_table::symbol_table(const std::vector<std::string> &symbols) {
+        for (const auto &symbol : symbols) {
+            insert(symbol);
+        }
+    }
+
+    asset_id symbol_table::insert(std::string_view symbol) {
+        auto it = ids_.find(symbol);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        if (symbols_.size() == npos) {
+            throw std::runtime_error(
+                "SYMBOL_TABLE insert error: too many symbols.");
+        }
+        asset_id id = static_cast<asset_id>(symbols_.size());
+        symbols_.emplace_back(symbol);
+        ids_.emplace(symbols_.back(), id);
+        return id;
+    }
+
+    asset_id symbol_table::find(std::string_view symbol) const {
+        auto it = ids_.find(symbol);
+        return it != ids_.end() ? it->second : npos;
+    }
+
+    bool symbol_table::contains(std::string_view symbol) const {
+        return ids_.find(symbol) != ids_.end();
+    }
+
+    const std::string &symbol_table::symbol(asset_id id) const {
+        return symbols_[id];
+    }
+
+    const std::vector<std::string> &symbol_table::symbols() const {
+        return symbols_;
+    }
+
+    size_t symbol_table::size() const { return symbols_.size(); }
+} // namespace portfolio
@@ -0,0 +1,67 @@
+#ifndef PORTFOLIO_SYMBOL_TABLE_H
+#define PORTFOLIO_SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+namespace portfolio {
+    /// \brief Dense identifier of an asset in a symbol_table.
+    using asset_id = uint32_t;
+
+    /// \brief Table assigning each asset symbol a dense asset_id.
+    ///
+    /// Ids are given in insertion order, starting at 0, so data about the
+    /// assets can be stored in vectors indexed by id. Symbols are found
+    /// from a string_view without allocating a std::string.
+    class symbol_table {
+      public:
+        /// \brief Id returned when a symbol is not in the table.
+        static constexpr asset_id npos = std::numeric_limits<asset_id>::max();
+
+      public /* constructors */:
+        symbol_table() = default;
+
+        /// \brief Table with the given symbols. Repeated symbols get the
+        /// id of their first occurrence.
+        explicit symbol_table(const std::vector<std::string> &symbols);
+
+      public /* symbols */:
+        /// \brief Get the id of a symbol, adding it if needed.
+        asset_id insert(std::string_view symbol);
+
+        /// \brief Find the id of a symbol.
+        /// \return Id of the symbol or npos if not found.
+        [[nodiscard]] asset_id find(std::string_view symbol) const;
+
+        /// \brief Check if the table has a symbol.
+        [[nodiscard]] bool contains(std::string_view symbol) const;
+
+        /// \brief Get the symbol of an id.
+        [[nodiscard]] const std::string &symbol(asset_id id) const;
+
+        /// \brief Symbols, indexed by id.
+        [[nodiscard]] const std::vector<std::string> &symbols() const;
+
+        /// \brief Number of symbols.
+        [[nodiscard]] size_t size() const;
+
+      private:
+        struct symbol_hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view symbol) const {
+                return std::hash<std::string_view>{}(symbol);
+            }
+        };
+
+        std::vector<std::string> symbols_;
+        std::unordered_map<std::string, asset_id, symbol_hash,
+                           std::equal_to<>>
+            ids_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_SYMBOL_TABLE_H
@@ -0,0 +1,346 @@
+#include "covariance_matrix.h"
+#include "portfolio/common/parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define PORTFOLIO_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace portfolio {
+    namespace {
+        /// Assets interleaved in a packed panel
+        constexpr size_t panel_width = 8;
+        /// Panels in the rows and columns of a task tile
+        constexpr size_t tile_panels = 8;
+        /// Periods of two tiles kept in cache while they are multiplied
+        constexpr size_t period_block = 256;
+
+        /// Add the products of two panels over n periods to an 8 x 8 block
+        /// of c, whose rows are ldc apart. Row r of the block is the asset
+        /// r of panel a and column j the asset j of panel b.
+        void panel_product(const double *a, const double *b, size_t n,
+                           double *c, size_t ldc) {
+#ifdef PORTFOLIO_HAS_AVX2
+            for (size_t h = 0; h < panel_width; h += 4) {
+                __m256d lo0 = _mm256_setzero_pd();
+                __m256d hi0 = _mm256_setzero_pd();
+                __m256d lo1 = _mm256_setzero_pd();
+                __m256d hi1 = _mm256_setzero_pd();
+                __m256d lo2 = _mm256_setzero_pd();
+                __m256d hi2 = _mm256_setzero_pd();
+                __m256d lo3 = _mm256_setzero_pd();
+                __m256d hi3 = _mm256_setzero_pd();
+                for (size_t t = 0; t < n; ++t) {
+                    const double *at = a + t * panel_width + h;
+                    const double *bt = b + t * panel_width;
+                    __m256d blo = _mm256_load_pd(bt);
+                    __m256d bhi = _mm256_load_pd(bt + 4);
+                    __m256d x = _mm256_broadcast_sd(at);
+                    lo0 = _mm256_fmadd_pd(x, blo, lo0);
+                    hi0 = _mm256_fmadd_pd(x, bhi, hi0);
+                    x = _mm256_broadcast_sd(at + 1);
+                    lo1 = _mm256_fmadd_pd(x, blo, lo1);
+                    hi1 = _mm256_fmadd_pd(x, bhi, hi1);
+                    x = _mm256_broadcast_sd(at + 2);
+                    lo2 = _mm256_fmadd_pd(x, blo, lo2);
+                    hi2 = _mm256_fmadd_pd(x, bhi, hi2);
+                    x = _mm256_broadcast_sd(at + 3);
+                    lo3 = _mm256_fmadd_pd(x, blo, lo3);
+                    hi3 = _mm256_fmadd_pd(x, bhi, hi3);
+                }
+                __m256d rows[4][2] = {
+                    {lo0, hi0}, {lo1, hi1}, {lo2, hi2}, {lo3, hi3}};
+                for (size_t r = 0; r < 4; ++r) {
+                    double *cr = c + (h + r) * ldc;
+                    _mm256_store_pd(
+                        cr, _mm256_add_pd(_mm256_load_pd(cr), rows[r][0]));
+                    _mm256_store_pd(cr + 4, _mm256_add_pd(
+                                                _mm256_load_pd(cr + 4),
+                                                rows[r][1]));
+                }
+            }
+#else
+            for (size_t h = 0; h < panel_width; h += 4) {
+                double acc[4][panel_width] = {};
+                for (size_t t = 0; t < n; ++t) {
+                    const double *at = a + t * panel_width + h;
+                    const double *bt = b + t * panel_width;
+                    for (size_t r = 0; r < 4; ++r) {
+                        for (size_t j = 0; j < panel_width; ++j) {
+                            acc[r][j] += at[r] * bt[j];
+                        }
+                    }
+                }
+                for (size_t r = 0; r < 4; ++r) {
+                    for (size_t j = 0; j < panel_width; ++j) {
+                        c[(h + r) * ldc + j] += acc[r][j];
+                    }
+                }
+            }
+#endif
+        }
+
+        /// Lower triangle of the product of the packed panels with
+        /// themselves. The result is a stride x stride row-major matrix,
+        /// where stride is the number of panels times their width.
+        aligned_vector<double> panel_syrk(const aligned_vector<double> &panels,
+                                          size_t n_panels, size_t n_periods,
+                                          size_t n_threads) {
+            size_t stride = n_panels * panel_width;
+            aligned_vector<double> c(stride * stride, 0.0);
+            size_t n_tiles = (n_panels + tile_panels - 1) / tile_panels;
+            std::vector<std::pair<size_t, size_t>> tiles;
+            tiles.reserve(n_tiles * (n_tiles + 1) / 2);
+            for (size_t i = 0; i < n_tiles; ++i) {
+                for (size_t j = 0; j <= i; ++j) {
+                    tiles.emplace_back(i, j);
+                }
+            }
+            const size_t panel_size = n_periods * panel_width;
+            parallel_for(tiles.size(), n_threads, [&](size_t task) {
+                auto [ti, tj] = tiles[task];
+                size_t i_end = std::min((ti + 1) * tile_panels, n_panels);
+                size_t j_end = std::min((tj + 1) * tile_panels, n_panels);
+                for (size_t t = 0; t < n_periods; t += period_block) {
+                    size_t n = std::min(period_block, n_periods - t);
+                    for (size_t i = ti * tile_panels; i < i_end; ++i) {
+                        const double *a =
+                            panels.data() + i * panel_size + t * panel_width;
+                        size_t j_last = std::min(j_end, i + 1);
+                        for (size_t j = tj * tile_panels; j < j_last; ++j) {
+                            const double *b = panels.data() + j * panel_size +
+                                              t * panel_width;
+                            panel_product(a, b, n,
+                                          c.data() +
+                                              i * panel_width * stride +
+                                              j * panel_width,
+                                          stride);
+                        }
+                    }
+                }
+            });
+            return c;
+        }
+    } // namespace
+
+    covariance_matrix::covariance_matrix(const return_panel &panel,
+                                         interval_points interval,
+                                         int n_periods,
+                                         covariance_options options)
+        : n_assets_(panel.n_assets()) {
+        size_t last = panel.find(interval);
+        if (last == panel.n_periods()) {
+            throw std::runtime_error(
+                "COVARIANCE_MATRIX constructor error: interval not found.");
+        }
+        if (n_periods < 2 || last + 1 < static_cast<size_t>(n_periods)) {
+            throw std::runtime_error("COVARIANCE_MATRIX constructor error: "
+                                     "n_periods out of market_data.");
+        }
+        if (options.shrinkage == shrinkage_method::fixed &&
+            !(options.intensity >= 0.0 && options.intensity <= 1.0)) {
+            throw std::runtime_error("COVARIANCE_MATRIX constructor error: "
+                                     "intensity out of [0, 1].");
+        }
+        n_periods_ = n_periods;
+        size_t first = last + 1 - n_periods_;
+        size_t n_panels = (n_assets_ + panel_width - 1) / panel_width;
+        stride_ = n_panels * panel_width;
+        const size_t panel_size = n_periods_ * panel_width;
+
+        // Centered returns and masks interleaved by period in each panel.
+        // Padding assets are zero and do not change the products.
+        mean_.assign(stride_, 0.0);
+        aligned_vector<double> centered(n_panels * panel_size, 0.0);
+        aligned_vector<double> valid;
+        bool masked = false;
+        for (size_t k = 0; k < n_assets_; ++k) {
+            auto mask = panel.mask(k).subspan(first, n_periods_);
+            if (std::find(mask.begin(), mask.end(), 0) != mask.end()) {
+                masked = true;
+                break;
+            }
+        }
+        if (masked) {
+            valid.assign(n_panels * panel_size, 0.0);
+        }
+        for (size_t k = 0; k < n_assets_; ++k) {
+            auto returns = panel.returns(k).subspan(first, n_periods_);
+            auto mask = panel.mask(k).subspan(first, n_periods_);
+            size_t n = 0;
+            double sum = 0.0;
+            for (size_t t = 0; t < n_periods_; ++t) {
+                n += mask[t];
+                sum += returns[t];
+            }
+            if (n < 2) {
+                throw std::runtime_error(
+                    "COVARIANCE_MATRIX constructor error: fewer than two "
+                    "returns in the periods.");
+            }
+            mean_[k] = sum / n;
+            size_t offset = k / panel_width * panel_size + k % panel_width;
+            for (size_t t = 0; t < n_periods_; ++t) {
+                if (mask[t]) {
+                    centered[offset + t * panel_width] = returns[t] - mean_[k];
+                    if (masked) {
+                        valid[offset + t * panel_width] = 1.0;
+                    }
+                }
+            }
+        }
+
+        // Squared norm of the centered returns of each period, which the
+        // shrinkage intensities need
+        std::vector<double> norms(n_periods_, 0.0);
+        for (size_t p = 0; p < n_panels; ++p) {
+            const double *x = centered.data() + p * panel_size;
+            for (size_t t = 0; t < n_periods_; ++t) {
+                for (size_t j = 0; j < panel_width; ++j) {
+                    norms[t] += x[t * panel_width + j] * x[t * panel_width + j];
+                }
+            }
+        }
+
+        covariance_ =
+            panel_syrk(centered, n_panels, n_periods_, options.n_threads);
+        aligned_vector<double> counts;
+        if (masked) {
+            counts = panel_syrk(valid, n_panels, n_periods_, options.n_threads);
+        }
+        const double periods = static_cast<double>(n_periods_);
+        for (size_t i = 0; i < n_assets_; ++i) {
+            double *ci = covariance_.data() + i * stride_;
+            for (size_t j = 0; j <= i; ++j) {
+                // Pairs with fewer than two common periods have no
+                // information on their covariance
+                double n = masked ? counts[i * stride_ + j] : periods;
+                ci[j] = n > 1.5 ? ci[j] / (n - 1.0) : 0.0;
+                covariance_[j * stride_ + i] = ci[j];
+            }
+        }
+        shrink(options, norms);
+    }
+
+    covariance_matrix::covariance_matrix(const market_data &data,
+                                         interval_points interval,
+                                         int n_periods,
+                                         covariance_options options)
+        : covariance_matrix(data.returns(), interval, n_periods, options) {}
+
+    double covariance_matrix::operator()(size_t i, size_t j) const {
+        return covariance_[i * stride_ + j];
+    }
+
+    std::span<const double> covariance_matrix::row(size_t i) const {
+        return {covariance_.data() + i * stride_, n_assets_};
+    }
+
+    double covariance_matrix::variance(size_t i) const {
+        return covariance_[i * stride_ + i];
+    }
+
+    double covariance_matrix::correlation(size_t i, size_t j) const {
+        double scale = std::sqrt(variance(i) * variance(j));
+        if (!(scale > 0.0)) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return (*this)(i, j) / scale;
+    }
+
+    std::vector<double> covariance_matrix::correlation_matrix() const {
+        std::vector<double> deviation(n_assets_);
+        for (size_t i = 0; i < n_assets_; ++i) {
+            deviation[i] = std::sqrt(variance(i));
+        }
+        std::vector<double> result(n_assets_ * n_assets_);
+        for (size_t i = 0; i < n_assets_; ++i) {
+            const double *ci = covariance_.data() + i * stride_;
+            for (size_t j = 0; j < n_assets_; ++j) {
+                double scale = deviation[i] * deviation[j];
+                result[i * n_assets_ + j] =
+                    scale > 0.0 ? ci[j] / scale
+                                : std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+        return result;
+    }
+
+    size_t covariance_matrix::n_assets() const { return n_assets_; }
+
+    size_t covariance_matrix::n_periods() const { return n_periods_; }
+
+    double covariance_matrix::mean(size_t i) const { return mean_[i]; }
+
+    double covariance_matrix::shrinkage_intensity() const {
+        return intensity_;
+    }
+
+    void covariance_matrix::shrink(const covariance_options &options,
+                                   std::span<const double> centered_norms) {
+        if (options.shrinkage == shrinkage_method::none) {
+            return;
+        }
+        // The intensities are defined on the maximum likelihood estimate,
+        // which divides by the number of periods
+        const double n = static_cast<double>(n_assets_);
+        const double periods = static_cast<double>(n_periods_);
+        const double ml = (periods - 1.0) / periods;
+        double trace = 0.0;
+        double squared_norm = 0.0;
+        for (size_t i = 0; i < n_assets_; ++i) {
+            const double *ci = covariance_.data() + i * stride_;
+            trace += ci[i];
+            for (size_t j = 0; j < n_assets_; ++j) {
+                squared_norm += ci[j] * ci[j];
+            }
+        }
+        const double average_variance = trace / n;
+        trace *= ml;
+        squared_norm *= ml * ml;
+
+        switch (options.shrinkage) {
+        case shrinkage_method::none:
+            break;
+        case shrinkage_method::fixed:
+            intensity_ = options.intensity;
+            break;
+        case shrinkage_method::ledoit_wolf: {
+            // Distance of the sample to the target and variance of the
+            // sample, both in the Frobenius norm divided by n
+            double m = trace / n;
+            double d2 = squared_norm / n - m * m;
+            double fourth = 0.0;
+            for (double norm : centered_norms) {
+                fourth += norm * norm;
+            }
+            double b2 =
+                (fourth - periods * squared_norm) / (periods * periods * n);
+            b2 = std::clamp(b2, 0.0, d2);
+            intensity_ = d2 > 0.0 ? b2 / d2 : 0.0;
+            break;
+        }
+        case shrinkage_method::oracle_approximating: {
+            double num = (1.0 - 2.0 / n) * squared_norm + trace * trace;
+            double den = (periods + 1.0 - 2.0 / n) *
+                         (squared_norm - trace * trace / n);
+            intensity_ = den > 0.0 ? std::min(num / den, 1.0) : 1.0;
+            break;
+        }
+        }
+
+        for (size_t i = 0; i < n_assets_; ++i) {
+            double *ci = covariance_.data() + i * stride_;
+            for (size_t j = 0; j < n_assets_; ++j) {
+                ci[j] *= 1.0 - intensity_;
+            }
+            ci[i] += intensity_ * average_variance;
+        }
+    }
+} // namespace portfolio
@@ -0,0 +1,108 @@
+#ifndef PORTFOLIO_COVARIANCE_MATRIX_H
+#define PORTFOLIO_COVARIANCE_MATRIX_H
+
+#include "market_data.h"
+#include "portfolio/common/aligned_allocator.h"
+#include "portfolio/core/return_panel.h"
+#include <span>
+namespace portfolio {
+    /// \brief Shrinkage of the sample covariance towards a scaled identity.
+    ///
+    /// The estimate is (1 - d) S + d m I, where S is the sample covariance,
+    /// m is the average variance and d is the intensity in [0, 1].
+    enum class shrinkage_method {
+        /// \brief Sample covariance.
+        none,
+        /// \brief Intensity given by covariance_options::intensity.
+        fixed,
+        /// \brief Intensity of Ledoit and Wolf (2004), which minimizes the
+        /// expected Frobenius loss.
+        ledoit_wolf,
+        /// \brief Oracle approximating shrinkage of Chen et al. (2010),
+        /// which converges faster for Gaussian returns.
+        oracle_approximating
+    };
+
+    /// \brief Options of the covariance_matrix estimator.
+    struct covariance_options {
+        shrinkage_method shrinkage{shrinkage_method::none};
+        /// \brief Intensity of shrinkage_method::fixed.
+        double intensity{0.0};
+        /// \brief Number of threads. 0 uses one thread per hardware thread.
+        size_t n_threads{1};
+    };
+
+    /// \brief Covariance matrix of the asset returns over a window.
+    ///
+    /// The centered returns are packed in panels of 8 assets, interleaved
+    /// by period, and the lower triangle of the product of the panels with
+    /// themselves is computed in tiles of assets and periods that fit in
+    /// cache. Tiles are independent and computed in parallel, and the
+    /// upper triangle is mirrored. The kernels use AVX2 when the library is
+    /// compiled with BUILD_WITH_AVX2.
+    ///
+    /// Masked returns count as no deviation. When the window has masked
+    /// returns, each covariance is divided by the number of periods both
+    /// assets have minus one.
+    class covariance_matrix {
+      public /* constructors */:
+        /// \brief Constructor of covariance_matrix
+        /// \param panel Returns of the assets.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \param options Shrinkage and threads of the estimator.
+        covariance_matrix(const return_panel &panel, interval_points interval,
+                          int n_periods, covariance_options options = {});
+
+        /// \brief Constructor of covariance_matrix
+        /// \param data Market data whose return panel is used.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \param options Shrinkage and threads of the estimator.
+        covariance_matrix(const market_data &data, interval_points interval,
+                          int n_periods, covariance_options options = {});
+
+      public /* element access */:
+        /// \brief Covariance of the returns of two assets.
+        [[nodiscard]] double operator()(size_t i, size_t j) const;
+
+        /// \brief Covariances of an asset with all assets.
+        [[nodiscard]] std::span<const double> row(size_t i) const;
+
+        /// \brief Variance of the returns of an asset.
+        [[nodiscard]] double variance(size_t i) const;
+
+        /// \brief Correlation of the returns of two assets, or NaN if one
+        /// of them has no variance.
+        [[nodiscard]] double correlation(size_t i, size_t j) const;
+
+        /// \brief Row-major n_assets x n_assets correlation matrix.
+        [[nodiscard]] std::vector<double> correlation_matrix() const;
+
+      public /* getters */:
+        [[nodiscard]] size_t n_assets() const;
+        [[nodiscard]] size_t n_periods() const;
+
+        /// \brief Mean of the returns of an asset in the window.
+        [[nodiscard]] double mean(size_t i) const;
+
+        /// \brief Shrinkage intensity applied to the sample covariance.
+        [[nodiscard]] double shrinkage_intensity() const;
+
+      private:
+        /// \brief Shrink the sample covariance towards the scaled identity.
+        void shrink(const covariance_options &options,
+                    std::span<const double> centered_norms);
+
+        size_t n_assets_;
+        size_t n_periods_;
+        /// \brief Distance between rows, padded to whole panels.
+        size_t stride_;
+        double intensity_{0.0};
+        aligned_vector<double> mean_;
+        /// \brief Full symmetric matrix, stride_ x stride_.
+        aligned_vector<double> covariance_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_COVARIANCE_MATRIX_H
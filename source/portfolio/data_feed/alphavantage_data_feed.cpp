@@ -4,39 +4,43 @@
 
 #include "alphavantage_data_feed.h"
 #include "portfolio/common/algorithm.h"
+#include "portfolio/data_feed/alphavantage_parser.h"
+#include "portfolio/data_feed/series_file.h"
 #include <chrono>
-#include <cpr/cpr.h>
 #include <filesystem>
 #include <iostream>
+#include <nlohmann/json.hpp>
 namespace portfolio {
 
     alphavantage_data_feed::alphavantage_data_feed(
         const std::string_view &apiKey, bool api_key_is_free)
         : api_key_(apiKey), api_key_is_free_(api_key_is_free) {
-        std::string path = "./";
-        bool data_folder_exists = false;
-        for (const auto &entry : std::filesystem::directory_iterator(path)) {
-            std::string filename(entry.path().filename().string());
-            if (filename == "stock_data") {
-                data_folder_exists = true;
-                break;
-            }
-        }
-        if (!data_folder_exists) {
-            std::filesystem::create_directory("./stock_data");
-        }
-        last_request_tp_ =
-            std::chrono::system_clock::now() - std::chrono::seconds(20);
+        std::filesystem::create_directories("./stock_data");
+        manifest_ = cache_manifest::open("./stock_data");
+        // Feeds with the same key share the quota
+        scheduler_ = request_scheduler::for_api_key(
+            api_key_, api_key_is_free ? free_requests_per_minute
+                                      : premium_requests_per_minute);
+    }
+
+    request_priority alphavantage_data_feed::priority() const {
+        return priority_;
+    }
+
+    void alphavantage_data_feed::set_priority(request_priority priority) {
+        priority_ = priority;
     }
     std::string
     alphavantage_data_feed::generate_url(std::string_view asset_code,
-                                         portfolio::timeframe tf) {
+                                         portfolio::timeframe tf,
+                                         bool compact) {
         std::string url = "https://www.alphavantage.co/query?function=";
         switch (tf) {
         case timeframe::minutes_15:
             return "15min";
         case timeframe::daily:
-            url += "TIME_SERIES_DAILY_ADJUSTED&outputsize=full";
+            url += "TIME_SERIES_DAILY_ADJUSTED&outputsize=";
+            url += compact ? "compact" : "full";
             break;
         case timeframe::hourly:
             return "60min";
@@ -58,132 +62,91 @@ namespace portfolio {
                                                    minute_point start_period,
                                                    minute_point end_period,
                                                    timeframe tf) {
-        bool has_previous_data = false;
-        bool need_online_search = true;
-        std::string path = "./stock_data";
-        std::string file_path;
-        std::string filename;
-        price_map price_from_file;
-
-        for (const auto &entry : std::filesystem::directory_iterator(path)) {
-            filename = entry.path().filename().string();
-            if (filename.starts_with(start_filename(asset_code, tf))) {
-                file_path = entry.path().string();
-                has_previous_data = true;
-                break;
-            }
-        }
-
-        if (has_previous_data) {
-            std::string text = filename;
-            std::replace(text.begin(), text.end(), '.', ' ');
-            std::istringstream iss(text);
-            std::vector<std::string> results(
-                std::istream_iterator<std::string>{iss},
-                std::istream_iterator<std::string>());
-            minute_point file_start_point;
-            minute_point file_end_point;
-            if (results.size() == 5) {
-                file_start_point = string_to_minute_point(results[2]);
-                file_end_point = string_to_minute_point(results[3]);
-            } else {
-                file_start_point = string_to_minute_point(results[3]);
-                file_end_point = string_to_minute_point(results[4]);
-            }
-
-            if (file_start_point <= start_period &&
-                file_end_point >= end_period) {
-                need_online_search = false;
-            } else {
-                std::filesystem::remove(file_path);
+        std::optional<cache_entry> entry = manifest_->find(asset_code, tf);
+        if (entry) {
+            if (entry->covers(start_period, end_period)) {
+                series_file cache;
+                if (cache.open(manifest_->directory() / entry->filename)) {
+                    return data_feed_result(
+                        cache.slice(start_period, end_period));
+                }
+            } else if (entry->first_start <= start_period) {
+                // Only the bars after the cached ones are missing
+                std::optional<data_feed_result> result = fetch_tail(
+                    asset_code, start_period, end_period, tf, *entry);
+                if (result) {
+                    return *result;
+                }
             }
         }
-        if (need_online_search) {
-            price_map hist;
-            if (!request_online(hist, asset_code, start_period, end_period,
-                                tf)) {
+        // The cached file is only replaced once all bars are downloaded,
+        // and its bars are better than none if the download fails
+        price_series all_data;
+        bool downloaded = request_online(all_data, asset_code, tf, false);
+        if (!downloaded || all_data.empty()) {
+            series_file cache;
+            if (entry && cache.open(manifest_->directory() / entry->filename)) {
+                return data_feed_result(cache.slice(start_period, end_period));
+            }
+            if (!downloaded) {
                 std::cerr << "Error on data requesting." << std::endl;
             }
-            return data_feed_result(hist);
-        } else {
-            std::string line;
-            std::ifstream fin(file_path);
-            if (fin.is_open()) {
-                std::getline(fin, line);
-                fin.close();
-            }
-            nlohmann::json json_from_file = nlohmann::json::parse(line);
-            bool has_error = false;
-            for (auto &el : json_from_file.items()) {
-                std::string value = el.value();
-                ohlc_prices ohlc;
-                has_error = !ohlc.from_string(value);
-                if (has_error) {
-                    std::cerr << "Error on data reading." << std::endl;
-                    break;
-                }
-                price_from_file[string_to_interval_points(el.key())] = ohlc;
-            }
-            price_map historical;
-            if (!has_error) {
-                for (auto &item : price_from_file) {
-                    if (item.first.first >= start_period &&
-                        item.first.second <= end_period) {
-                        historical[item.first] = item.second;
-                    }
-                }
+            return data_feed_result(price_series());
+        }
+        std::string filename = series_filename(asset_code, tf);
+        // leave room for the bars of the next requests
+        if (series_file::write(manifest_->directory() / filename, all_data, tf,
+                               all_data.size() + all_data.size() / 4)) {
+            manifest_->insert(asset_code, tf,
+                              cache_entry{filename, all_data.starts().front(),
+                                          all_data.ends().back(),
+                                          all_data.size()});
+            if (entry && entry->filename != filename) {
+                std::filesystem::remove(manifest_->directory() /
+                                        entry->filename);
             }
-            return data_feed_result(historical);
         }
+        return data_feed_result(
+            price_view(std::move(all_data)).slice(start_period, end_period));
     }
-    bool alphavantage_data_feed::request_online(price_map &historical_data,
-                                                std::string_view asset_code,
-                                                minute_point start_period,
-                                                minute_point end_period,
-                                                timeframe tf) {
-        // If the API key is free, wait 20 seconds to ensure that there will be
-        // a maximum of 5 requests per minute.
-        if (api_key_is_free_) {
-            std::chrono::duration<double> diff =
-                std::chrono::system_clock::now() - last_request_tp_;
-            std::this_thread::sleep_for(
-                std::chrono::seconds(20) -
-                std::chrono::duration_cast<std::chrono::seconds>(diff));
+    std::optional<data_feed_result> alphavantage_data_feed::fetch_tail(
+        std::string_view asset_code, minute_point start_period,
+        minute_point end_period, timeframe tf, const cache_entry &entry) {
+        using namespace std::chrono_literals;
+        // The compact output has the latest 100 bars, which is enough if
+        // the cache is less than 100 days old
+        bool compact = tf == timeframe::daily &&
+                       std::chrono::system_clock::now() - entry.last_end <
+                           100 * 24h;
+        price_series tail;
+        if (!request_online(tail, asset_code, tf, compact)) {
+            return std::nullopt;
         }
-        std::string url = generate_url(asset_code, tf);
-        cpr::Response r = cpr::Get(cpr::Url{url});
-        last_request_tp_ = std::chrono::system_clock::now();
-        if (r.status_code != 200) {
-            throw std::runtime_error("Cannot request data: " + url);
+        if (compact && (tail.empty() ||
+                        tail.starts().front() > entry.last_end)) {
+            // there would be a hole between the cache and the new bars
+            if (!request_online(tail, asset_code, tf, false)) {
+                return std::nullopt;
+            }
         }
-        nlohmann::json j_from_alphavantage = nlohmann::json::parse(r.text);
-        if (!j_from_alphavantage.contains("Meta Data")) {
-            throw std::runtime_error(
-                "Request return error message: " +
-                j_from_alphavantage.begin().value().get<std::string>() +
-                " - URL: " + url + " - Verify if asset_code is valid.");
+        std::filesystem::path file_path =
+            manifest_->directory() / entry.filename;
+        if (!series_file::extend(file_path, tail)) {
+            return std::nullopt;
         }
-        using namespace date::literals;
-        using namespace std::chrono_literals;
-        std::map<std::string, std::string> to_serialize;
-        bool has_error;
-        switch (tf) {
-        case (timeframe::monthly):
-            has_error =
-                !set_monthly_data(historical_data, to_serialize, start_period,
-                                  end_period, j_from_alphavantage);
-            break;
-        case (timeframe::weekly):
-            has_error =
-                !set_weekly_data(historical_data, to_serialize, start_period,
-                                 end_period, j_from_alphavantage);
-            break;
-        case (timeframe::daily):
-            has_error =
-                !set_daily_data(historical_data, to_serialize, start_period,
-                                end_period, j_from_alphavantage);
-            break;
-        default:
+        series_file cache;
+        if (!cache.open(file_path)) {
+            return std::nullopt;
+        }
+        manifest_->insert(asset_code, tf,
+                          cache_entry{entry.filename, cache.first_start(),
+                                      cache.last_end(), cache.size()});
+        return data_feed_result(cache.slice(start_period, end_period));
+    }
+    bool alphavantage_data_feed::request_online(price_series &all_data,
+                                                std::string_view asset_code,
+                                                timeframe tf, bool compact) {
+        if (tf == timeframe::minutes_15 || tf == timeframe::hourly) {
             std::string str_tf;
             tf == timeframe::minutes_15 ? str_tf = "15 minutes"
                                         : str_tf = "Hourly";
@@ -191,276 +154,26 @@ namespace portfolio {
                 str_tf +
                 " timeframe for B3 data is not supported by Alphavantage");
         }
-        if (has_error) {
-            return false;
-        } else {
-            nlohmann::json j_to_serialize(to_serialize);
-            std::string start_interval = to_serialize.begin()->first;
-            std::string end_interval = to_serialize.rbegin()->first;
-            std::replace(start_interval.begin(), start_interval.end(), '|',
-                         ' ');
-            std::replace(end_interval.begin(), end_interval.end(), '|', ' ');
-            std::istringstream iss_start(start_interval);
-            std::istringstream iss_end(end_interval);
-            std::vector<std::string> start_result(
-                std::istream_iterator<std::string>{iss_start},
-                std::istream_iterator<std::string>());
-            std::vector<std::string> end_result(
-                std::istream_iterator<std::string>{iss_end},
-                std::istream_iterator<std::string>());
-            std::string fp = "./stock_data/";
-            fp += set_filename(asset_code, start_result[0], end_result[1], tf);
-            std::ofstream fout(fp);
-            fout << j_to_serialize.dump();
-            fout.close();
-            return true;
+        std::string url = generate_url(asset_code, tf, compact);
+        http_response r = scheduler_->submit(url, priority_).get();
+        if (r.status_code != 200) {
+            throw std::runtime_error("Cannot request data: " + url);
         }
-    }
-    bool alphavantage_data_feed::set_daily_data(
-        price_map &hist, std::map<std::string, std::string> &to_serialize,
-        minute_point start_period, minute_point end_period,
-        nlohmann::json j_data) {
-        using namespace std::chrono_literals;
-        for (auto &[key, value] : j_data["Time Series (Daily)"].items()) {
-            std::string text = key;
-            std::replace(text.begin(), text.end(), '-', ' ');
-            std::istringstream iss(text);
-            std::vector<std::string> results(
-                std::istream_iterator<std::string>{iss},
-                std::istream_iterator<std::string>());
-            minute_point mp;
-            mp = date::sys_days{date::year(std::stoi(results[0])) /
-                                date::month(std::stoi(results[1])) /
-                                date::day(std::stoi(results[2]))};
-            std::string st_open;
-            std::string st_high;
-            std::string st_low;
-            std::string st_close;
-            try {
-                st_open = value["1. open"];
-                st_high = value["2. high"];
-                st_low = value["3. low"];
-                st_close = value["4. close"];
-            } catch (nlohmann::json::exception &e) {
-                throw std::runtime_error("Fatal error: " +
-                                         std::string(e.what()));
-            }
-            std::string::size_type sz; // alias of size_t
-            double open, high, low, close;
-            if (is_floating(st_open)) {
-                open = std::stod(st_open, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_high)) {
-                high = std::stod(st_high, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_low)) {
-                low = std::stod(st_low, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_close)) {
-                close = std::stod(st_close, &sz);
-            } else {
-                return false;
-            }
-
-            interval_points interval;
-            ohlc_prices ohlc;
-            if (mp >= start_period && mp <= end_period) {
-                interval = std::make_pair(mp + 10h, mp + 18h);
-                ohlc.set_prices(open, high, low, close);
-                hist[interval] = ohlc;
-                to_serialize[interval_points_to_string(interval)] =
-                    ohlc.to_string();
-            } else {
-                interval = std::make_pair(mp + 10h, mp + 18h);
-                ohlc.set_prices(open, high, low, close);
-                to_serialize[interval_points_to_string(interval)] =
-                    ohlc.to_string();
-            }
+        // bars go straight to the parser, without building a JSON document
+        alphavantage_parser parser(tf);
+        if (!nlohmann::json::sax_parse(r.text, &parser)) {
+            return false;
         }
-        return true;
-    }
-    bool alphavantage_data_feed::set_weekly_data(
-        price_map &hist, std::map<std::string, std::string> &to_serialize,
-        minute_point start_period, minute_point end_period,
-        nlohmann::json j_data) {
-        using namespace std::chrono_literals;
-        interval_points interval;
-        ohlc_prices ohlc;
-        for (auto &[key, value] :
-             j_data["Weekly Adjusted Time Series"].items()) {
-            std::string text = key;
-            std::replace(text.begin(), text.end(), '-', ' ');
-            std::istringstream iss(text);
-            std::vector<std::string> results(
-                std::istream_iterator<std::string>{iss},
-                std::istream_iterator<std::string>());
-            minute_point mp;
-            mp = date::sys_days{date::year(std::stoi(results[0])) /
-                                date::month(std::stoi(results[1])) /
-                                date::day(std::stoi(results[2]))};
-            std::string st_open;
-            std::string st_high;
-            std::string st_low;
-            std::string st_close;
-            try {
-                st_open = value["1. open"];
-                st_high = value["2. high"];
-                st_low = value["3. low"];
-                st_close = value["4. close"];
-            } catch (nlohmann::json::exception &e) {
-                throw std::runtime_error("Fatal error: " +
-                                         std::string(e.what()));
-            }
-            std::string::size_type sz; // alias of size_t
-            double open, high, low, close;
-
-            if (is_floating(st_open)) {
-                open = std::stod(st_open, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_high)) {
-                high = std::stod(st_high, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_low)) {
-                low = std::stod(st_low, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_close)) {
-                close = std::stod(st_close, &sz);
-            } else {
-                return false;
-            }
-            std::chrono::hours increment_open;
-            std::chrono::hours increment_close;
-            date::weekday wd{std::chrono::time_point_cast<date::days>(mp)};
-            switch (wd.c_encoding()) {
-            case (date::Friday.c_encoding()):
-                increment_open = -86h;
-                increment_close = 18h;
-                break;
-            case (date::Thursday.c_encoding()):
-                increment_open = -62h;
-                increment_close = 42h;
-                break;
-            case (date::Wednesday.c_encoding()):
-                increment_open = -38h;
-                increment_close = 66h;
-                break;
-            case (date::Tuesday.c_encoding()):
-                increment_open = -14h;
-                increment_close = 90h;
-                break;
-            case (date::Monday.c_encoding()):
-                increment_open = 8h;
-                increment_close = 114h;
-            }
-            interval =
-                std::make_pair(mp + increment_open, mp + increment_close);
-            ohlc.set_prices(open, high, low, close);
-            if (mp >= start_period && mp <= end_period) {
-                hist[interval] = ohlc;
-                to_serialize[interval_points_to_string(interval)] =
-                    ohlc.to_string();
-            } else {
-                to_serialize[interval_points_to_string(interval)] =
-                    ohlc.to_string();
-            }
+        if (!parser.has_meta_data()) {
+            throw std::runtime_error(
+                "Request return error message: " + parser.message() +
+                " - URL: " + url + " - Verify if asset_code is valid.");
         }
-        return true;
-    }
-    bool alphavantage_data_feed::set_monthly_data(
-        price_map &hist, std::map<std::string, std::string> &to_serialize,
-        minute_point start_period, minute_point end_period,
-        nlohmann::json j_data) {
-        using namespace std::chrono_literals;
-        interval_points interval;
-        ohlc_prices ohlc;
-        for (auto &[key, value] :
-             j_data["Monthly Adjusted Time Series"].items()) {
-            std::string text = key;
-            std::replace(text.begin(), text.end(), '-', ' ');
-            std::istringstream iss(text);
-            std::vector<std::string> results(
-                std::istream_iterator<std::string>{iss},
-                std::istream_iterator<std::string>());
-            minute_point mp_start, mp_end;
-            mp_start = date::sys_days{date::year(std::stoi(results[0])) /
-                                      date::month(std::stoi(results[1])) /
-                                      date::day(1)};
-            mp_end = date::sys_days{date::year(std::stoi(results[0])) /
-                                    date::month(std::stoi(results[1])) /
-                                    date::day(std::stoi(results[2]))};
-            std::string st_open;
-            std::string st_high;
-            std::string st_low;
-            std::string st_close;
-            try {
-                st_open = value["1. open"];
-                st_high = value["2. high"];
-                st_low = value["3. low"];
-                st_close = value["4. close"];
-            } catch (nlohmann::json::exception &e) {
-                throw std::runtime_error("Fatal error: " +
-                                         std::string(e.what()));
-            }
-            std::string::size_type sz; // alias of size_t
-            double open, high, low, close;
-
-            if (is_floating(st_open)) {
-                open = std::stod(st_open, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_high)) {
-                high = std::stod(st_high, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_low)) {
-                low = std::stod(st_low, &sz);
-            } else {
-                return false;
-            }
-            if (is_floating(st_close)) {
-                close = std::stod(st_close, &sz);
-            } else {
-                return false;
-            }
-            std::chrono::hours increment_open;
-            date::weekday wd{
-                std::chrono::time_point_cast<date::days>(mp_start)};
-            switch (wd.c_encoding()) {
-            case (date::Saturday.c_encoding()):
-                increment_open = 58h;
-                break;
-            case (date::Monday.c_encoding()):
-                increment_open = 34h;
-                break;
-            default:
-                increment_open = 10h;
-            }
-            interval = std::make_pair(mp_start + increment_open, mp_end + 18h);
-            ohlc.set_prices(open, high, low, close);
-            if (mp_end >= start_period && mp_end <= end_period) {
-                hist[interval] = ohlc;
-                to_serialize[interval_points_to_string(interval)] =
-                    ohlc.to_string();
-            } else {
-                to_serialize[interval_points_to_string(interval)] =
-                    ohlc.to_string();
-            }
+        if (!parser.valid()) {
+            return false;
         }
+        all_data = parser.release_series();
         return true;
     }
 
-} // namespace portfolio
\ No newline at end of file
+} // namespace portfolio
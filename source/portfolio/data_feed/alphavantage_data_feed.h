@@ -6,16 +6,28 @@
 #define PORTFOLIO_ALPHAVANTAGE_DATA_FEED_H
 
 #include <map>
-#include <nlohmann/json.hpp>
+#include <memory>
+#include <optional>
+#include <portfolio/data_feed/cache_manifest.h>
 #include <portfolio/data_feed/data_feed.h>
+#include <portfolio/data_feed/request_scheduler.h>
+#include <string>
 namespace portfolio {
     class alphavantage_data_feed : public data_feed {
       public:
+        /// \brief Requests per minute allowed for free API keys.
+        static constexpr double free_requests_per_minute = 5.0;
+
+        /// \brief Requests per minute allowed for the smallest premium plan.
+        static constexpr double premium_requests_per_minute = 75.0;
+
         /// \brief Constructor of alphavantage_data_feed
         /// \param apiKey - API key used to access data from:
         /// https://www.alphavantage.co/
         /// \param api_key_is_free Indicates whether API key is free or not. If
-        /// it is free, it restricts a maximum of 5 requests per minute.
+        /// it is free, it restricts a maximum of 5 requests per minute, or 75
+        /// requests per minute otherwise. The limit is shared by all feeds
+        /// using the same key.
         explicit alphavantage_data_feed(const std::string_view &apiKey,
                                         bool api_key_is_free);
 
@@ -28,70 +40,57 @@ namespace portfolio {
                                minute_point start_period,
                                minute_point end_period, timeframe tf) override;
 
+        /// \brief Priority of the requests of this feed.
+        [[nodiscard]] request_priority priority() const;
+
+        /// \brief Set the priority of the requests of this feed. Feeds used
+        /// for bulk backfills should use request_priority::bulk, so requests
+        /// of interactive feeds with the same key go first.
+        void set_priority(request_priority priority);
+
       private:
         /// Generates url to download data from alphavantage.
         /// \param asset_code Symbol of asset. For B3 assets_proportions_ add
-        /// ".SAO" after the code. Example: "PETR4.SAO". \param tf Timeframe
-        /// used on url./// \return URL used to download alphavantage data.
-        std::string generate_url(std::string_view asset_code, timeframe tf);
-
-        /// \brief Access and download alphavantage data.
-        /// \param historical_data Price_map where the query data will be saved.
-        /// \param asset_code Symbol of asset. For B3 assets_proportions_ add
-        /// ".SAO" after the code. Example: "PETR4.SAO". \param start_period
-        /// Initial/// minute_point. \param end_period Final minute_point.
-        /// \param tf Timeframe used on request. \return Price_map "filled"
-        /// according to the input parameters.
-        bool request_online(price_map &historical_data,
-                            std::string_view asset_code,
-                            minute_point start_period, minute_point end_period,
-                            timeframe tf);
-
-        /// \brief Handles data received from alphavantage for a monthly
-        /// timeframe by saving it to a price_map and preparing the data to be
-        /// serialized. \param hist Price_map where the query data will be
-        /// saved. \param to_serialize Map used in the data serialization step.
-        /// \param start_period Initial minute_point.
-        /// \param end_period Final minute_point.
-        /// \param j_data Data received from alphavantage.
-        /// \return True if not occurs errors or false otherwise.
-        static bool
-        set_monthly_data(price_map &hist,
-                         std::map<std::string, std::string> &to_serialize,
-                         minute_point start_period, minute_point end_period,
-                         nlohmann::json j_data);
+        /// ".SAO" after the code. Example: "PETR4.SAO".
+        /// \param tf Timeframe used on url.
+        /// \param compact Request only the latest 100 bars when the
+        /// timeframe supports it.
+        /// \return URL used to download alphavantage data.
+        std::string generate_url(std::string_view asset_code, timeframe tf,
+                                 bool compact);
 
-        /// \brief Handles data received from alphavantage for a weekly
-        /// timeframe by saving it to a price_map and preparing the data to be
-        /// serialized. \param hist Price_map where the query data will be
-        /// saved. \param to_serialize Map used in the data serialization step.
+        /// \brief Download the bars after a cached series file and append
+        /// them to the file.
+        /// \param asset_code Symbol of asset.
         /// \param start_period Initial minute_point.
         /// \param end_period Final minute_point.
-        /// \param j_data Data received from alphavantage.
-        /// \return True if not occurs errors or false otherwise.
-        static bool
-        set_weekly_data(price_map &hist,
-                        std::map<std::string, std::string> &to_serialize,
-                        minute_point start_period, minute_point end_period,
-                        nlohmann::json j_data);
+        /// \param tf Timeframe used on request.
+        /// \param entry Manifest entry of the cached file.
+        /// \return Data_feed_result with the requested period or
+        /// std::nullopt if the file could not be extended.
+        std::optional<data_feed_result>
+        fetch_tail(std::string_view asset_code, minute_point start_period,
+                   minute_point end_period, timeframe tf,
+                   const cache_entry &entry);
 
-        /// \brief Handles data received from alphavantage for a daily timeframe
-        /// by saving it to a price_map and preparing the data to be serialized.
-        /// \param hist Price_map where the query data will be saved.
-        /// \param to_serialize Map used in the data serialization step.
-        /// \param start_period Initial minute_point.
-        /// \param end_period Final minute_point.
-        /// \param j_data Data received from alphavantage.
+        /// \brief Access and download alphavantage data.
+        /// \param all_data Price_series where all bars received will be
+        /// saved.
+        /// \param asset_code Symbol of asset. For B3 assets_proportions_ add
+        /// ".SAO" after the code. Example: "PETR4.SAO".
+        /// \param tf Timeframe used on request.
+        /// \param compact Request only the latest 100 bars when the
+        /// timeframe supports it.
         /// \return True if not occurs errors or false otherwise.
-        static bool
-        set_daily_data(price_map &hist,
-                       std::map<std::string, std::string> &to_serialize,
-                       minute_point start_period, minute_point end_period,
-                       nlohmann::json j_data);
+        bool request_online(price_series &all_data,
+                            std::string_view asset_code, timeframe tf,
+                            bool compact);
 
-        std::string_view api_key_;
+        std::string api_key_;
         bool api_key_is_free_;
-        std::chrono::time_point<std::chrono::system_clock> last_request_tp_;
+        request_priority priority_{request_priority::interactive};
+        std::shared_ptr<cache_manifest> manifest_;
+        std::shared_ptr<request_scheduler> scheduler_;
     };
 } // namespace portfolio
 #endif // PORTFOLIO_ALPHAVANTAGE_DATA_FEED_H
@@ -0,0 +1,210 @@
+#include "alphavantage_parser.h"
+#include "portfolio/common/algorithm.h"
+#include <algorithm>
+namespace portfolio {
+    namespace {
+        constexpr std::string_view price_keys[4] = {"1. open", "2. high",
+                                                    "3. low", "4. close"};
+        constexpr int all_fields = 0b1111;
+    } // namespace
+
+    alphavantage_parser::alphavantage_parser(timeframe tf)
+        : tf_(tf), series_key_(series_key(tf)) {}
+
+    bool alphavantage_parser::null() { return true; }
+
+    bool alphavantage_parser::boolean(bool) { return true; }
+
+    bool alphavantage_parser::number_integer(std::int64_t val) {
+        set_field(static_cast<double>(val));
+        return true;
+    }
+
+    bool alphavantage_parser::number_unsigned(std::uint64_t val) {
+        set_field(static_cast<double>(val));
+        return true;
+    }
+
+    bool alphavantage_parser::number_float(double val, const std::string &) {
+        set_field(val);
+        return true;
+    }
+
+    bool alphavantage_parser::string(std::string &val) {
+        if (depth_ == 1 && section_ == section::other && message_.empty()) {
+            message_ = val;
+        } else if (depth_ == 3 && section_ == section::series && field_ >= 0) {
+            double price;
+            if (parse_double(val, price)) {
+                set_field(price);
+            } else {
+                valid_ = false;
+            }
+        }
+        return true;
+    }
+
+    bool alphavantage_parser::start_object(std::size_t) {
+        ++depth_;
+        if (depth_ == 3 && section_ == section::series) {
+            field_ = -1;
+            fields_set_ = 0;
+        }
+        return true;
+    }
+
+    bool alphavantage_parser::key(std::string &val) {
+        if (depth_ == 1) {
+            if (val == "Meta Data") {
+                section_ = section::meta_data;
+                has_meta_data_ = true;
+            } else if (val == series_key_) {
+                section_ = section::series;
+            } else {
+                section_ = section::other;
+            }
+        } else if (section_ == section::series) {
+            if (depth_ == 2) {
+                day_ok_ = parse_date(val, day_);
+            } else if (depth_ == 3) {
+                auto it = std::find(std::begin(price_keys),
+                                    std::end(price_keys), val);
+                field_ = it == std::end(price_keys)
+                             ? -1
+                             : static_cast<int>(it - std::begin(price_keys));
+            }
+        }
+        return true;
+    }
+
+    bool alphavantage_parser::end_object() {
+        if (depth_ == 3 && section_ == section::series) {
+            if (day_ok_ && fields_set_ == all_fields) {
+                bars_.emplace_back(bar_interval(day_, tf_),
+                                   ohlc_prices(fields_[0], fields_[1],
+                                               fields_[2], fields_[3]));
+            } else {
+                valid_ = false;
+            }
+        }
+        --depth_;
+        return true;
+    }
+
+    bool alphavantage_parser::start_array(std::size_t) {
+        ++depth_;
+        return true;
+    }
+
+    bool alphavantage_parser::end_array() {
+        --depth_;
+        return true;
+    }
+
+    std::string_view alphavantage_parser::series_key(timeframe tf) {
+        switch (tf) {
+        case timeframe::daily:
+            return "Time Series (Daily)";
+        case timeframe::weekly:
+            return "Weekly Adjusted Time Series";
+        case timeframe::monthly:
+            return "Monthly Adjusted Time Series";
+        case timeframe::hourly:
+            return "Time Series (60min)";
+        case timeframe::minutes_15:
+            return "Time Series (15min)";
+        }
+        return "";
+    }
+
+    interval_points alphavantage_parser::bar_interval(date::sys_days day,
+                                                      timeframe tf) {
+        using namespace std::chrono_literals;
+        switch (tf) {
+        case timeframe::weekly: {
+            // the date is the last trading day of the week
+            std::chrono::hours increment_open;
+            std::chrono::hours increment_close;
+            date::weekday wd{day};
+            switch (wd.c_encoding()) {
+            case (date::Friday.c_encoding()):
+                increment_open = -86h;
+                increment_close = 18h;
+                break;
+            case (date::Thursday.c_encoding()):
+                increment_open = -62h;
+                increment_close = 42h;
+                break;
+            case (date::Wednesday.c_encoding()):
+                increment_open = -38h;
+                increment_close = 66h;
+                break;
+            case (date::Tuesday.c_encoding()):
+                increment_open = -14h;
+                increment_close = 90h;
+                break;
+            default:
+                increment_open = 8h;
+                increment_close = 114h;
+            }
+            return std::make_pair(day + increment_open, day + increment_close);
+        }
+        case timeframe::monthly: {
+            // the date is the last trading day of the month
+            date::year_month_day ymd{day};
+            date::sys_days first_day{ymd.year() / ymd.month() / date::day(1)};
+            std::chrono::hours increment_open;
+            date::weekday wd{first_day};
+            switch (wd.c_encoding()) {
+            case (date::Saturday.c_encoding()):
+                increment_open = 58h;
+                break;
+            case (date::Monday.c_encoding()):
+                increment_open = 34h;
+                break;
+            default:
+                increment_open = 10h;
+            }
+            return std::make_pair(first_day + increment_open, day + 18h);
+        }
+        default:
+            return std::make_pair(day + 10h, day + 18h);
+        }
+    }
+
+    bool alphavantage_parser::has_meta_data() const { return has_meta_data_; }
+
+    const std::string &alphavantage_parser::message() const {
+        return message_;
+    }
+
+    bool alphavantage_parser::valid() const { return valid_; }
+
+    price_series alphavantage_parser::release_series() {
+        // alphavantage sends the newest bars first
+        std::reverse(bars_.begin(), bars_.end());
+        auto by_start = [](const auto &a, const auto &b) {
+            return a.first.first < b.first.first;
+        };
+        if (!std::is_sorted(bars_.begin(), bars_.end(), by_start)) {
+            std::stable_sort(bars_.begin(), bars_.end(), by_start);
+        }
+        price_series series;
+        series.reserve(bars_.size());
+        for (const auto &[interval, ohlc] : bars_) {
+            if (series.empty() || series.starts().back() < interval.first) {
+                series.push_back(interval, ohlc);
+            }
+        }
+        bars_.clear();
+        bars_.shrink_to_fit();
+        return series;
+    }
+
+    void alphavantage_parser::set_field(double val) {
+        if (depth_ == 3 && section_ == section::series && field_ >= 0) {
+            fields_[field_] = val;
+            fields_set_ |= 1 << field_;
+        }
+    }
+} // namespace portfolio
@@ -0,0 +1,97 @@
+#ifndef PORTFOLIO_ALPHAVANTAGE_PARSER_H
+#define PORTFOLIO_ALPHAVANTAGE_PARSER_H
+
+#include "portfolio/core/price_series.h"
+#include "portfolio/data_feed/data_feed.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    /// \brief SAX handler for the time series returned by alphavantage.
+    ///
+    /// The handler is given to nlohmann::json::sax_parse and keeps only
+    /// the bars of the time series, so responses are read without building
+    /// a JSON document. A response looks like:
+    ///
+    /// {"Meta Data": {...},
+    ///  "Time Series (Daily)": {"2021-03-12": {"1. open": "10.0", ...}}}
+    class alphavantage_parser {
+      public /* constructors */:
+        /// \brief Constructor of alphavantage_parser
+        /// \param tf Timeframe of the response.
+        explicit alphavantage_parser(timeframe tf);
+
+      public /* SAX interface */:
+        bool null();
+        bool boolean(bool val);
+        bool number_integer(std::int64_t val);
+        bool number_unsigned(std::uint64_t val);
+        bool number_float(double val, const std::string &s);
+        bool string(std::string &val);
+        template <class Binary> bool binary(Binary &) { return true; }
+        bool start_object(std::size_t elements);
+        bool key(std::string &val);
+        bool end_object();
+        bool start_array(std::size_t elements);
+        bool end_array();
+        template <class Exception>
+        bool parse_error(std::size_t, const std::string &, const Exception &) {
+            return false;
+        }
+
+      public /* getters and setters */:
+        /// \brief Name of the object with the bars in responses of a
+        /// timeframe, such as "Time Series (Daily)".
+        static std::string_view series_key(timeframe tf);
+
+        /// \brief Interval of a bar received from alphavantage.
+        /// \param day Date of the bar in the response.
+        /// \param tf Timeframe of the response.
+        /// \return Interval between the open and close of the bar.
+        static interval_points bar_interval(date::sys_days day, timeframe tf);
+
+        /// \brief Check if the response has the "Meta Data" object, which
+        /// alphavantage only sends with valid requests.
+        [[nodiscard]] bool has_meta_data() const;
+
+        /// \brief First message of a response without data, such as the
+        /// "Error Message" of an invalid request.
+        [[nodiscard]] const std::string &message() const;
+
+        /// \brief Check if all bars received have a valid date and prices.
+        [[nodiscard]] bool valid() const;
+
+        /// \brief Move the bars received to a price_series.
+        /// \return Bars in chronological order.
+        price_series release_series();
+
+      private:
+        /// \brief Save a price of the current bar.
+        void set_field(double val);
+
+        /// \brief Objects of the response where the parser is.
+        enum class section { none, meta_data, series, other };
+
+        timeframe tf_;
+        std::string_view series_key_;
+        size_t depth_{0};
+        section section_{section::none};
+        bool has_meta_data_{false};
+        bool valid_{true};
+        std::string message_;
+
+        /// \brief Bar being parsed.
+        date::sys_days day_;
+        bool day_ok_{false};
+        int field_{-1};
+        double fields_[4]{};
+        int fields_set_{0};
+
+        /// \brief Bars in the order they were received.
+        std::vector<std::pair<interval_points, ohlc_prices>> bars_;
+    };
+} // namespace portfolio
+#endif // PORTFOLIO_ALPHAVANTAGE_PARSER_H
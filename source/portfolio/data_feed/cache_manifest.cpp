@@ -0,0 +1,253 @@
+#include "cache_manifest.h"
+#include "portfolio/common/algorithm.h"
+#include "portfolio/common/file_lock.h"
+#include "portfolio/common/mapped_file.h"
+#include "portfolio/data_feed/series_file.h"
+#include <array>
+#include <fstream>
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <vector>
+namespace portfolio {
+    namespace {
+        /// First line of the manifest file, followed by its generation
+        constexpr std::string_view manifest_header =
+            "portfolio-cache-manifest 2";
+        /// Records of the manifest file allowed besides one per entry
+        /// before it is compacted
+        constexpr size_t stale_records = 64;
+
+        /// Write the record of an entry. Removals have no bars.
+        void write_record(std::ostream &out, std::string_view asset_code,
+                          timeframe tf, const cache_entry &entry) {
+            out << asset_code << '\t' << static_cast<int>(tf) << '\t'
+                << entry.first_start.time_since_epoch().count() << '\t'
+                << entry.last_end.time_since_epoch().count() << '\t'
+                << entry.size << '\t'
+                << (entry.filename.empty() ? "-" : entry.filename) << '\n';
+        }
+    } // namespace
+
+    bool cache_entry::covers(minute_point start_period,
+                             minute_point end_period) const {
+        return size != 0 && first_start <= start_period &&
+               last_end >= end_period;
+    }
+
+    std::shared_ptr<cache_manifest>
+    cache_manifest::open(const std::filesystem::path &directory) {
+        static std::mutex registry_mutex;
+        static std::map<std::filesystem::path, std::weak_ptr<cache_manifest>>
+            registry;
+        std::filesystem::path key =
+            std::filesystem::weakly_canonical(directory);
+        std::lock_guard lock(registry_mutex);
+        if (auto manifest = registry[key].lock()) {
+            return manifest;
+        }
+        auto manifest = std::make_shared<cache_manifest>(directory);
+        std::lock_guard manifest_lock(manifest->mutex_);
+        if (!manifest->refresh()) {
+            // Another process might be rebuilding the same manifest
+            file_lock writers(directory / lock_filename);
+            if (!manifest->refresh()) {
+                manifest->rebuild();
+                if (writers.owns_lock()) {
+                    manifest->compact();
+                }
+            }
+        }
+        registry[key] = manifest;
+        return manifest;
+    }
+
+    cache_manifest::cache_manifest(std::filesystem::path directory)
+        : directory_(std::move(directory)) {}
+
+    std::optional<cache_entry>
+    cache_manifest::find(std::string_view asset_code, timeframe tf) const {
+        std::lock_guard lock(mutex_);
+        refresh();
+        auto it = entries_.find(std::make_pair(std::string(asset_code), tf));
+        if (it == entries_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void cache_manifest::insert(std::string_view asset_code, timeframe tf,
+                                cache_entry entry) {
+        std::lock_guard lock(mutex_);
+        update(std::make_pair(std::string(asset_code), tf), std::move(entry));
+    }
+
+    void cache_manifest::erase(std::string_view asset_code, timeframe tf) {
+        std::lock_guard lock(mutex_);
+        update(std::make_pair(std::string(asset_code), tf), std::nullopt);
+    }
+
+    size_t cache_manifest::size() const {
+        std::lock_guard lock(mutex_);
+        refresh();
+        return entries_.size();
+    }
+
+    const std::filesystem::path &cache_manifest::directory() const {
+        return directory_;
+    }
+
+    bool cache_manifest::refresh() const {
+        std::ifstream fin(directory_ / manifest_filename, std::ios::binary);
+        if (!fin.is_open()) {
+            return false;
+        }
+        // <header> <generation>
+        std::string line;
+        uint64_t generation;
+        std::istringstream header;
+        if (!std::getline(fin, line) || !line.starts_with(manifest_header)) {
+            return false;
+        }
+        header.str(line.substr(manifest_header.size()));
+        if (header.peek() != ' ' || !(header >> generation)) {
+            return false;
+        }
+        if (!loaded_ || generation != generation_) {
+            entries_.clear();
+            n_records_ = 0;
+            generation_ = generation;
+            offset_ = fin.tellg();
+            loaded_ = true;
+        } else {
+            fin.seekg(offset_);
+        }
+        // asset code, timeframe, first start, last end, size and filename
+        // separated by tabs
+        while (std::getline(fin, line)) {
+            if (fin.eof()) {
+                // The record is still being appended
+                break;
+            }
+            std::istringstream iss(line);
+            std::string asset_code;
+            int tf;
+            cache_entry entry;
+            int64_t first_start;
+            int64_t last_end;
+            if (!std::getline(iss, asset_code, '\t') ||
+                !(iss >> tf >> first_start >> last_end >> entry.size) ||
+                !(iss >> std::ws) || !std::getline(iss, entry.filename)) {
+                loaded_ = false;
+                return false;
+            }
+            auto key = std::make_pair(asset_code, static_cast<timeframe>(tf));
+            if (entry.size == 0) {
+                entries_.erase(key);
+            } else {
+                entry.first_start =
+                    minute_point(std::chrono::minutes(first_start));
+                entry.last_end = minute_point(std::chrono::minutes(last_end));
+                entries_[key] = std::move(entry);
+            }
+            offset_ = fin.tellg();
+            ++n_records_;
+        }
+        return true;
+    }
+
+    void cache_manifest::rebuild() {
+        entries_.clear();
+        if (!std::filesystem::is_directory(directory_)) {
+            return;
+        }
+        convert_json_cache(directory_);
+        for (const auto &entry :
+             std::filesystem::directory_iterator(directory_)) {
+            if (entry.path().extension() != ".series") {
+                continue;
+            }
+            series_file f;
+            if (!f.open(entry.path()) || f.size() == 0) {
+                continue;
+            }
+            // <asset code>.<TIMEFRAME>.series
+            std::string stem = entry.path().stem().string();
+            size_t dot = stem.rfind('.');
+            if (dot == std::string::npos) {
+                continue;
+            }
+            std::string asset_code = stem.substr(0, dot);
+            if (series_filename(asset_code, f.tf()) !=
+                entry.path().filename().string()) {
+                continue;
+            }
+            entries_[std::make_pair(asset_code, f.tf())] =
+                cache_entry{entry.path().filename().string(), f.first_start(),
+                            f.last_end(), f.size()};
+        }
+    }
+
+    void cache_manifest::update(const key_type &key,
+                                std::optional<cache_entry> entry) {
+        file_lock writers(directory_ / lock_filename);
+        // Records appended by other processes come first, so the last
+        // record is this one
+        bool valid = refresh();
+        if (!valid) {
+            rebuild();
+        }
+        if (entry) {
+            entries_[key] = *entry;
+        } else if (entries_.erase(key) == 0 && valid) {
+            return;
+        }
+        if (!writers.owns_lock()) {
+            return;
+        }
+        // A record cut short by a crashed writer is rewritten away
+        const std::filesystem::path path = directory_ / manifest_filename;
+        std::error_code ec;
+        auto file_size = std::filesystem::file_size(path, ec);
+        if (!valid || ec || static_cast<std::streamoff>(file_size) != offset_ ||
+            n_records_ >= 2 * entries_.size() + stale_records) {
+            compact();
+            return;
+        }
+        std::ostringstream out;
+        write_record(out, key.first, key.second,
+                     entry ? *entry : cache_entry{});
+        std::string record = out.str();
+        std::ofstream fout(path, std::ios::binary | std::ios::app);
+        fout << record;
+        fout.close();
+        if (fout) {
+            offset_ += static_cast<std::streamoff>(record.size());
+            ++n_records_;
+        } else {
+            loaded_ = false;
+        }
+    }
+
+    void cache_manifest::compact() {
+        if (!std::filesystem::is_directory(directory_)) {
+            return;
+        }
+        std::ostringstream out;
+        out << manifest_header << ' ' << generation_ + 1 << '\n';
+        for (const auto &[key, entry] : entries_) {
+            write_record(out, key.first, key.second, entry);
+        }
+        std::string text = out.str();
+        const std::array<std::span<const std::byte>, 1> chunks = {
+            std::as_bytes(std::span(text))};
+        if (write_file_atomically(directory_ / manifest_filename, chunks)) {
+            ++generation_;
+            offset_ = static_cast<std::streamoff>(text.size());
+            n_records_ = entries_.size();
+            loaded_ = true;
+        } else {
+            loaded_ = false;
+        }
+    }
+} // namespace portfolio
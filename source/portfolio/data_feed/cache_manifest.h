@@ -0,0 +1,131 @@
+#ifndef PORTFOLIO_CACHE_MANIFEST_H
+#define PORTFOLIO_CACHE_MANIFEST_H
+
+#include "portfolio/data_feed/data_feed.h"
+#include <cstdint>
+#include <filesystem>
+#include <ios>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+namespace portfolio {
+    /// \brief Entry of the cache manifest describing one series file.
+    struct cache_entry {
+        /// \brief Name of the series file inside the cache directory.
+        std::string filename;
+        /// \brief Start of the first bar in the file.
+        minute_point first_start;
+        /// \brief End of the last bar in the file.
+        minute_point last_end;
+        /// \brief Number of bars in the file.
+        size_t size{0};
+
+        /// \brief Check if the file has all bars from start_period to
+        /// end_period.
+        [[nodiscard]] bool covers(minute_point start_period,
+                                  minute_point end_period) const;
+    };
+
+    /// \brief Index of the series files in a cache directory.
+    ///
+    /// The manifest maps (asset, timeframe) to the file holding its bars
+    /// and the range this file covers, so fetching data never needs to
+    /// walk the cache directory. It is loaded once per directory and
+    /// process.
+    ///
+    /// The manifest file is a log of records, where the last record of an
+    /// asset wins. A change appends one record under a lock file, and
+    /// queries first read the records other processes appended, so
+    /// processes sharing the directory never lose each other's entries.
+    /// The log is compacted when most of its records are stale.
+    class cache_manifest {
+      public:
+        /// \brief Name of the manifest file inside the cache directory.
+        static constexpr std::string_view manifest_filename = "manifest";
+
+        /// \brief Name of the file locked by the writers of the manifest.
+        static constexpr std::string_view lock_filename = "manifest.lock";
+
+      public /* constructors */:
+        /// \brief Get the manifest of a cache directory.
+        /// The first call for a directory loads its manifest file. If there
+        /// is no manifest file yet, the manifest is rebuilt from the series
+        /// files in the directory, after converting JSON files from older
+        /// versions. Later calls share the same manifest.
+        /// \param directory Cache directory, such as "./stock_data".
+        /// \return Manifest shared by all users of the directory.
+        static std::shared_ptr<cache_manifest>
+        open(const std::filesystem::path &directory);
+
+        explicit cache_manifest(std::filesystem::path directory);
+
+      public /* getters and setters */:
+        /// \brief Find the series file of an asset.
+        /// \param asset_code Symbol of asset.
+        /// \param tf Timeframe of data.
+        /// \return Entry of the file or std::nullopt if there is no file.
+        [[nodiscard]] std::optional<cache_entry>
+        find(std::string_view asset_code, timeframe tf) const;
+
+        /// \brief Insert or replace the entry of an asset and append it to
+        /// the manifest file.
+        /// \param asset_code Symbol of asset.
+        /// \param tf Timeframe of data.
+        /// \param entry Description of the series file.
+        void insert(std::string_view asset_code, timeframe tf,
+                    cache_entry entry);
+
+        /// \brief Remove the entry of an asset and append the removal to
+        /// the manifest file.
+        /// \param asset_code Symbol of asset.
+        /// \param tf Timeframe of data.
+        void erase(std::string_view asset_code, timeframe tf);
+
+        /// \brief Number of entries in the manifest.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Cache directory of the manifest.
+        [[nodiscard]] const std::filesystem::path &directory() const;
+
+      private:
+        using key_type = std::pair<std::string, timeframe>;
+
+        /// \brief Read the records appended to the manifest file since the
+        /// last call, or all records if the file was compacted since. The
+        /// mutex must be locked.
+        /// \return True if the manifest file exists and is valid.
+        bool refresh() const;
+
+        /// \brief Rebuild the entries from the series files in the
+        /// directory.
+        void rebuild();
+
+        /// \brief Insert or remove an entry and append its record to the
+        /// manifest file. The mutex must be locked.
+        /// \param key Asset and timeframe of the entry.
+        /// \param entry Entry to insert, or std::nullopt to remove it.
+        void update(const key_type &key, std::optional<cache_entry> entry);
+
+        /// \brief Atomically replace the manifest file with one record per
+        /// entry. The mutex and the lock file must be locked.
+        void compact();
+
+        std::filesystem::path directory_;
+        /// \brief Entries, updated by the queries from the manifest file.
+        mutable std::map<key_type, cache_entry> entries_;
+        /// \brief Compactions of the manifest file when it was read.
+        mutable uint64_t generation_{0};
+        /// \brief Bytes of the manifest file read.
+        mutable std::streamoff offset_{0};
+        /// \brief Records read from the manifest file.
+        mutable size_t n_records_{0};
+        /// \brief False if the file must be read from the start.
+        mutable bool loaded_{false};
+        mutable std::mutex mutex_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_CACHE_MANIFEST_H
@@ -0,0 +1,124 @@
+#include "cached_data_feed.h"
+#include <stdexcept>
+namespace portfolio {
+
+    cached_data_feed::cached_data_feed(data_feed &upstream, size_t capacity)
+        : upstream_(upstream), capacity_(capacity) {
+        if (capacity == 0) {
+            throw std::runtime_error("CACHED_DATA_FEED constructor error: "
+                                     "capacity must be at least 1.");
+        }
+    }
+
+    data_feed_result cached_data_feed::fetch(std::string_view asset_code,
+                                             minute_point start_period,
+                                             minute_point end_period,
+                                             timeframe tf) {
+        key_type key(std::string(asset_code), tf);
+        std::shared_future<price_view> series;
+        std::promise<price_view> promise;
+        uint64_t id = 0;
+        bool owner = false;
+        bool exact = false;
+        {
+            std::lock_guard lock(mutex_);
+            auto it = find(key, start_period, end_period);
+            if (it != entries_.end()) {
+                ++hits_;
+                entries_.splice(entries_.begin(), entries_, it);
+                series = it->series;
+                exact = it->start_period == start_period &&
+                        it->end_period == end_period;
+            } else {
+                ++misses_;
+                // Series inside the new period are not needed anymore
+                auto [first, last] = index_.equal_range(key);
+                while (first != last) {
+                    auto e = (first++)->second;
+                    if (e->start_period >= start_period &&
+                        e->end_period <= end_period) {
+                        erase(e);
+                    }
+                }
+                id = next_id_++;
+                series = promise.get_future().share();
+                entries_.push_front(
+                    entry{key, start_period, end_period, id, series});
+                index_.emplace(key, entries_.begin());
+                while (entries_.size() > capacity_) {
+                    erase(std::prev(entries_.end()));
+                    ++evictions_;
+                }
+                owner = true;
+            }
+        }
+        if (owner) {
+            try {
+                data_feed_result result =
+                    upstream_.fetch(asset_code, start_period, end_period, tf);
+                promise.set_value(result.series());
+                return result;
+            } catch (...) {
+                // Errors are not cached
+                promise.set_exception(std::current_exception());
+                std::lock_guard lock(mutex_);
+                for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                    if (it->id == id) {
+                        erase(it);
+                        break;
+                    }
+                }
+                throw;
+            }
+        }
+        const price_view &cached = series.get();
+        if (exact) {
+            return data_feed_result(cached);
+        }
+        return data_feed_result(cached.slice(start_period, end_period));
+    }
+
+    size_t cached_data_feed::hits() const { return hits_; }
+
+    size_t cached_data_feed::misses() const { return misses_; }
+
+    size_t cached_data_feed::evictions() const { return evictions_; }
+
+    size_t cached_data_feed::size() const {
+        std::lock_guard lock(mutex_);
+        return entries_.size();
+    }
+
+    size_t cached_data_feed::capacity() const { return capacity_; }
+
+    void cached_data_feed::clear() {
+        std::lock_guard lock(mutex_);
+        entries_.clear();
+        index_.clear();
+    }
+
+    cached_data_feed::entry_list::iterator
+    cached_data_feed::find(const key_type &key, minute_point start_period,
+                           minute_point end_period) {
+        auto [first, last] = index_.equal_range(key);
+        for (; first != last; ++first) {
+            auto e = first->second;
+            if (e->start_period <= start_period &&
+                e->end_period >= end_period) {
+                return e;
+            }
+        }
+        return entries_.end();
+    }
+
+    void cached_data_feed::erase(entry_list::iterator it) {
+        auto [first, last] = index_.equal_range(it->key);
+        for (; first != last; ++first) {
+            if (first->second == it) {
+                index_.erase(first);
+                break;
+            }
+        }
+        entries_.erase(it);
+    }
+} // namespace portfolio
@@ -0,0 +1,96 @@
+#ifndef PORTFOLIO_CACHED_DATA_FEED_H
+#define PORTFOLIO_CACHED_DATA_FEED_H
+
+#include "portfolio/data_feed/data_feed.h"
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+namespace portfolio {
+    /// \brief Data feed keeping the latest series fetched from another
+    /// data feed in memory.
+    ///
+    /// Series are kept in a bounded LRU list and never change once fetched.
+    /// Results share the cached series instead of copying it.
+    /// A request is served from any cached series of the same asset and
+    /// timeframe whose period contains the requested period. Concurrent
+    /// requests that miss the cache with the same period wait for a single
+    /// fetch from the upstream feed.
+    class cached_data_feed : public data_feed {
+      public /* constructors */:
+        /// \brief Constructor of cached_data_feed
+        /// \param upstream Data feed used when the cache does not have the
+        /// data. It must outlive the cached_data_feed.
+        /// \param capacity Maximum number of series in the cache.
+        explicit cached_data_feed(data_feed &upstream, size_t capacity = 256);
+
+      public /* data_feed interface */:
+        /// \brief Get data from the cache or from the upstream feed.
+        /// \param asset_code Symbol of asset.
+        /// \param start_period Initial minute_point.
+        /// \param end_period Final minute_point.
+        /// \param tf Timeframe used on request.
+        /// \return Data_feed_result "filled" according to the input parameters.
+        data_feed_result fetch(std::string_view asset_code,
+                               minute_point start_period,
+                               minute_point end_period, timeframe tf) override;
+
+      public /* getters and setters */:
+        /// \brief Number of requests served without an upstream fetch.
+        [[nodiscard]] size_t hits() const;
+
+        /// \brief Number of requests that fetched from the upstream feed.
+        [[nodiscard]] size_t misses() const;
+
+        /// \brief Number of series removed to respect the capacity.
+        [[nodiscard]] size_t evictions() const;
+
+        /// \brief Number of series in the cache.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Maximum number of series in the cache.
+        [[nodiscard]] size_t capacity() const;
+
+        /// \brief Remove all series from the cache.
+        void clear();
+
+      private:
+        using key_type = std::pair<std::string, timeframe>;
+
+        /// \brief Series of an asset fetched for a period.
+        struct entry {
+            key_type key;
+            minute_point start_period;
+            minute_point end_period;
+            uint64_t id;
+            /// \brief Series, which might still be being fetched.
+            std::shared_future<price_view> series;
+        };
+        using entry_list = std::list<entry>;
+
+        /// \brief Find a series whose period contains the requested period.
+        entry_list::iterator find(const key_type &key,
+                                  minute_point start_period,
+                                  minute_point end_period);
+
+        /// \brief Remove an entry from the list and the index.
+        void erase(entry_list::iterator it);
+
+        data_feed &upstream_;
+        size_t capacity_;
+        mutable std::mutex mutex_;
+        /// \brief Entries from the most to the least recently used.
+        entry_list entries_;
+        std::multimap<key_type, entry_list::iterator> index_;
+        uint64_t next_id_{0};
+        std::atomic<size_t> hits_{0};
+        std::atomic<size_t> misses_{0};
+        std::atomic<size_t> evictions_{0};
+    };
+} // namespace portfolio
+#endif // PORTFOLIO_CACHED_DATA_FEED_H
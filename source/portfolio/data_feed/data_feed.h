@@ -15,11 +15,12 @@ namespace portfolio {
                                                  std::chrono::minutes>;
     using interval_points = std::pair<minute_point, minute_point>;
     using price_map = std::map<interval_points, ohlc_prices>;
-    using price_iterator = price_map::iterator;
     enum class timeframe { daily, weekly, monthly, hourly, minutes_15 };
     class data_feed {
       public:
         /// \brief Get data and save in data_feed_result.
+        /// market_data might call fetch for different assets from several
+        /// threads at the same time.
         /// \param asset_code Symbol of asset.
         /// \param start_period Initial minute_point.
         /// \param end_period Final minute_point.
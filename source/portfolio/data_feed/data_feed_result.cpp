@@ -3,46 +3,58 @@
 //
 
 #include "data_feed_result.h"
+#include <algorithm>
 #include <chrono>
 #include <utility>
 namespace portfolio {
 
-    data_feed_result::data_feed_result(price_map historical_data)
+    data_feed_result::data_feed_result(const price_map &historical_data)
+        : historical_data_(price_series(historical_data)) {}
+
+    data_feed_result::data_feed_result(price_series historical_data)
         : historical_data_(std::move(historical_data)) {}
 
-    price_iterator data_feed_result::end() { return historical_data_.end(); }
+    data_feed_result::data_feed_result(price_view historical_data)
+        : historical_data_(std::move(historical_data)) {}
 
-    bool data_feed_result::empty() { return historical_data_.empty(); }
+    price_iterator data_feed_result::end() const {
+        return historical_data_.end();
+    }
+
+    bool data_feed_result::empty() const { return historical_data_.empty(); }
+
+    const price_view &data_feed_result::series() const {
+        return historical_data_;
+    }
 
     ohlc_prices data_feed_result::latest_prices() const {
         // return last price in historical data
-        return historical_data_.rbegin()->second;
+        return historical_data_.prices(historical_data_.size() - 1);
     }
 
     price_iterator
-    data_feed_result::find_prices_from(interval_points interval) {
-        return historical_data_.find(interval);
+    data_feed_result::find_prices_from(interval_points interval) const {
+        return historical_data_.begin() + historical_data_.find(interval);
     }
 
     ohlc_prices data_feed_result::closest_prices(minute_point date_time) const {
-        if (date_time <= historical_data_.begin()->first.first) {
-            return historical_data_.begin()->second;
-        } else if (date_time >= historical_data_.rbegin()->first.second) {
-            return historical_data_.rbegin()->second;
-        }
-        auto it = historical_data_.begin();
-        auto previous_it = it;
-        while (date_time > it->first.second) {
-            previous_it = it;
-            it++;
+        const size_t last = historical_data_.size() - 1;
+        if (date_time <= historical_data_.starts().front()) {
+            return historical_data_.prices(0);
+        } else if (date_time >= historical_data_.ends().back()) {
+            return historical_data_.prices(last);
         }
-        if (date_time >= it->first.first && date_time <= it->first.second) {
-            return it->second;
+        // first bar that does not end before date_time
+        auto ends = historical_data_.ends();
+        size_t i = std::lower_bound(ends.begin(), ends.end(), date_time) -
+                   ends.begin();
+        if (date_time >= historical_data_.starts()[i]) {
+            return historical_data_.prices(i);
         } else {
-            return previous_it->second;
+            return historical_data_.prices(i == 0 ? 0 : i - 1);
         }
     }
-    price_iterator data_feed_result::begin() {
+    price_iterator data_feed_result::begin() const {
         return historical_data_.begin();
     }
     bool data_feed_result::operator==(const data_feed_result &rhs) const {
@@ -52,8 +64,8 @@ namespace portfolio {
         return !(rhs == *this);
     }
     bool data_feed_result::operator<(const data_feed_result &rhs) const {
-        return historical_data_.begin()->first.first <
-               rhs.historical_data_.begin()->first.first;
+        return historical_data_.starts().front() <
+               rhs.historical_data_.starts().front();
     }
     bool data_feed_result::operator>(const data_feed_result &rhs) const {
         return rhs < *this;
@@ -64,13 +76,4 @@ namespace portfolio {
     bool data_feed_result::operator>=(const data_feed_result &rhs) const {
         return !(*this < rhs);
     }
-    data_feed_result &data_feed_result::operator=(const data_feed_result &rhs) {
-        if (this == &rhs)
-            return *this;
-        this->historical_data_ = rhs.historical_data_;
-        return *this;
-    }
-    data_feed_result::data_feed_result(const data_feed_result &rhs) {
-        this->historical_data_ = rhs.historical_data_;
-    }
-} // namespace portfolio
\ No newline at end of file
+} // namespace portfolio
@@ -6,6 +6,8 @@
 #define PORTFOLIO_DATA_FEED_RESULT_H
 
 #include "portfolio/core/ohlc_prices.h"
+#include "portfolio/core/price_series.h"
+#include "portfolio/core/price_view.h"
 #include <chrono>
 #include <date/date.h>
 #include <map>
@@ -14,7 +16,7 @@ namespace portfolio {
                                                  std::chrono::minutes>;
     using interval_points = std::pair<minute_point, minute_point>;
     using price_map = std::map<interval_points, ohlc_prices>;
-    using price_iterator = price_map::iterator;
+    using price_iterator = price_view::const_iterator;
     class data_feed_result {
       public /* constructors */:
         bool operator==(const data_feed_result &rhs) const;
@@ -23,11 +25,18 @@ namespace portfolio {
         bool operator>(const data_feed_result &rhs) const;
         bool operator<=(const data_feed_result &rhs) const;
         bool operator>=(const data_feed_result &rhs) const;
-        data_feed_result &operator=(const data_feed_result &rhs);
-        data_feed_result(const data_feed_result &rhs);
         /// \brief Class constructor
         /// \param historical_data Asset data to be stored.
-        explicit data_feed_result(price_map historical_data);
+        explicit data_feed_result(const price_map &historical_data);
+
+        /// \brief Class constructor
+        /// \param historical_data Asset data to be stored.
+        explicit data_feed_result(price_series historical_data);
+
+        /// \brief Class constructor
+        /// \param historical_data Asset data to be shared with other
+        /// results.
+        explicit data_feed_result(price_view historical_data);
 
       public /* getters and setters */:
         /// \brief Get latest prices stored.
@@ -38,15 +47,16 @@ namespace portfolio {
         /// \param interval Interval point for searching.
         /// \return A iterator for price of interval or returns end() if not
         /// founded.
-        price_iterator find_prices_from(interval_points interval);
+        [[nodiscard]] price_iterator
+        find_prices_from(interval_points interval) const;
 
-        /// \brief Get a iterator for begin of price_map.
-        /// \return A iterator for begin of price_map.
-        price_iterator begin();
+        /// \brief Get a iterator for begin of the price series.
+        /// \return A iterator for begin of the price series.
+        [[nodiscard]] price_iterator begin() const;
 
-        /// \brief Get a iterator for end of price_map.
-        /// \return A iterator for end of price_map.
-        price_iterator end();
+        /// \brief Get a iterator for end of the price series.
+        /// \return A iterator for end of the price series.
+        [[nodiscard]] price_iterator end() const;
 
         /// \brief Find ohlc_prices of a closest minute_point.
         /// \param date_time Minute point for searching.
@@ -56,10 +66,15 @@ namespace portfolio {
         /// \brief Check if data feed result is empty.
         /// \return If the data feed result is empty returns true or false
         /// otherwise.
-        bool empty();
+        [[nodiscard]] bool empty() const;
+
+        /// \brief Get the columns with all prices stored.
+        /// \return View of the prices, which might be shared with other
+        /// results.
+        [[nodiscard]] const price_view &series() const;
 
       private:
-        price_map historical_data_;
+        price_view historical_data_;
     };
 } // namespace portfolio
 
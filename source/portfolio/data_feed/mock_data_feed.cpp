@@ -32,9 +32,9 @@ namespace portfolio {
         return data_feed_result(
             generate_historical_data(start_period, end_period, tf));
     }
-    price_map mock_data_feed::generate_historical_data(
+    price_series mock_data_feed::generate_historical_data(
         minute_point start_period, minute_point end_period, timeframe tf) {
-        price_map historical_data;
+        price_series historical_data;
         switch (tf) {
         case (timeframe::monthly):
             historical_data = monthly(start_period, end_period);
@@ -47,13 +47,14 @@ namespace portfolio {
         }
         return historical_data;
     }
-    price_map mock_data_feed::daily_intraday(minute_point start_period,
-                                             minute_point end_period,
-                                             timeframe tf) {
+    price_series mock_data_feed::daily_intraday(minute_point start_period,
+                                                minute_point end_period,
+                                                timeframe tf) {
         std::chrono::minutes increment = increment_by(tf);
-        price_map historical_data;
-        static std::random_device r;
-        static std::default_random_engine generator(r());
+        price_series historical_data;
+        // one generator per thread, as assets might be fetched in parallel
+        static thread_local std::default_random_engine generator(
+            std::random_device{}());
         std::uniform_int_distribution<int> ud_int(10, 50);
         std::uniform_real_distribution<double> ud_double(1, 2);
         // initial price between 10.00 and 100.00
@@ -97,16 +98,17 @@ namespace portfolio {
                     }
                     ohlc_prices ohlc(open_price, high_price, low_price,
                                      close_price);
-                    historical_data[std::make_pair(i, i + increment)] = ohlc;
+                    historical_data.push_back(
+                        std::make_pair(i, i + increment), ohlc);
                     open_price = close_price;
                 }
             }
         }
         return historical_data;
     }
-    price_map mock_data_feed::weekly(minute_point start_period,
-                                     minute_point end_period) {
-        price_map historical_data;
+    price_series mock_data_feed::weekly(minute_point start_period,
+                                        minute_point end_period) {
+        price_series historical_data;
         using namespace std::chrono_literals;
         date::sys_days dp_start = date::floor<date::days>(start_period);
         date::sys_days dp_end = date::floor<date::days>(end_period);
@@ -116,8 +118,9 @@ namespace portfolio {
         while (dp_end != date::Friday) {
             dp_end = dp_end + date::days(1);
         }
-        static std::random_device r;
-        static std::default_random_engine generator(r());
+        // one generator per thread, as assets might be fetched in parallel
+        static thread_local std::default_random_engine generator(
+            std::random_device{}());
         std::uniform_int_distribution<int> ud_int(10, 50);
         std::uniform_real_distribution<double> ud_double(1, 2);
         // initial price between 10.00 and 100.00
@@ -145,22 +148,23 @@ namespace portfolio {
                 high_price = open_price + (open_price * (volatility / 100));
             }
             ohlc_prices ohlc(open_price, high_price, low_price, close_price);
-            historical_data[std::make_pair(start, end)] = ohlc;
+            historical_data.push_back(std::make_pair(start, end), ohlc);
             open_price = close_price;
         }
         return historical_data;
     }
-    price_map mock_data_feed::monthly(minute_point start_period,
-                                      minute_point end_period) {
-        price_map historical_data;
+    price_series mock_data_feed::monthly(minute_point start_period,
+                                         minute_point end_period) {
+        price_series historical_data;
         date::year_month_day date_start = date::floor<date::days>(start_period);
         date::year_month_day date_end = date::floor<date::days>(end_period);
         date_start =
             date::year_month_day{date_start.year() / date_start.month() / 1};
         date_end = date::year_month_day{date_end.year() / date_end.month() /
                                         date::last};
-        static std::random_device r;
-        static std::default_random_engine generator(r());
+        // one generator per thread, as assets might be fetched in parallel
+        static thread_local std::default_random_engine generator(
+            std::random_device{}());
         std::uniform_int_distribution<int> ud_int(10, 50);
         std::uniform_real_distribution<double> ud_double(1, 2);
         // initial price between 10.00 and 100.00
@@ -193,7 +197,7 @@ namespace portfolio {
                 high_price = open_price + (open_price * (volatility / 100));
             }
             ohlc_prices ohlc(open_price, high_price, low_price, close_price);
-            historical_data[std::make_pair(start, end)] = ohlc;
+            historical_data.push_back(std::make_pair(start, end), ohlc);
             open_price = close_price;
         }
         return historical_data;
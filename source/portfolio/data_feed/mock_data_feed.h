@@ -23,35 +23,37 @@ namespace portfolio {
                                minute_point end_period, timeframe tf) override;
 
       private:
-        /// \brief Generates random price data and saves it in price_map.
+        /// \brief Generates random price data and saves it in price_series.
         /// \param start_period Initial minute_point.
         /// \param end_period Final minute_point.
         /// \param tf Timeframe used on request.
-        /// \return Price_map "filled" according to the input parameters.
-        static price_map generate_historical_data(minute_point start_period,
-                                                  minute_point end_period,
-                                                  timeframe tf);
-        /// \brief Fill in price_map when using intraday or daily timeframes.
+        /// \return Price_series "filled" according to the input parameters.
+        static price_series
+        generate_historical_data(minute_point start_period,
+                                 minute_point end_period, timeframe tf);
+        /// \brief Fill in price_series when using intraday or daily
+        /// timeframes.
         /// \param start_period Initial minute_point.
         /// \param end_period Final minute_point.
         /// \param tf Timeframe used on request.
-        /// \return Price_map "filled" according to the input parameters.
-        static price_map daily_intraday(minute_point start_period,
-                                        minute_point end_period, timeframe tf);
+        /// \return Price_series "filled" according to the input parameters.
+        static price_series daily_intraday(minute_point start_period,
+                                           minute_point end_period,
+                                           timeframe tf);
 
-        /// \brief Fill in price_map when using weekly timeframe.
+        /// \brief Fill in price_series when using weekly timeframe.
         /// \param start_period Initial minute_point.
         /// \param end_period Final minute_point.
-        /// \return Price_map "filled" according to the input parameters.
-        static price_map weekly(minute_point start_period,
-                                minute_point end_period);
+        /// \return Price_series "filled" according to the input parameters.
+        static price_series weekly(minute_point start_period,
+                                   minute_point end_period);
 
-        /// \brief Fill in price_map when using monthly timeframe.
+        /// \brief Fill in price_series when using monthly timeframe.
         /// \param start_period Initial minute_point.
         /// \param end_period Final minute_point.
-        /// \return Price_map "filled" according to the input parameters.
-        static price_map monthly(minute_point start_period,
-                                 minute_point end_period);
+        /// \return Price_series "filled" according to the input parameters.
+        static price_series monthly(minute_point start_period,
+                                    minute_point end_period);
 
         /// \brief Calculates increment for interval_points based on timeframe.
         /// \param tf Timeframe used for increment.
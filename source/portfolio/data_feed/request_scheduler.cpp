@@ -0,0 +1,150 @@
+#include "request_scheduler.h"
+#include <algorithm>
+#include <cpr/cpr.h>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        http_response cpr_get(const std::string &url) {
+            cpr::Response r = cpr::Get(cpr::Url{url});
+            return http_response{r.status_code, std::move(r.text)};
+        }
+    } // namespace
+
+    std::shared_ptr<request_scheduler>
+    request_scheduler::for_api_key(const std::string &api_key,
+                                   double requests_per_minute,
+                                   size_t connections) {
+        static std::mutex registry_mutex;
+        // requests per minute and scheduler of each key
+        static std::map<std::string,
+                        std::pair<double, std::weak_ptr<request_scheduler>>>
+            registry;
+        std::lock_guard lock(registry_mutex);
+        auto &[rate, weak_scheduler] = registry[api_key];
+        if (auto scheduler = weak_scheduler.lock()) {
+            if (rate != requests_per_minute) {
+                throw std::runtime_error(
+                    "REQUEST_SCHEDULER error: the API key is already "
+                    "scheduled with another rate limit.");
+            }
+            return scheduler;
+        }
+        auto scheduler = std::make_shared<request_scheduler>(
+            quota_bucket(requests_per_minute, std::chrono::minutes(1)),
+            connections);
+        rate = requests_per_minute;
+        weak_scheduler = scheduler;
+        return scheduler;
+    }
+
+    token_bucket
+    request_scheduler::quota_bucket(double requests,
+                                    token_bucket::clock::duration window) {
+        // requests + 1 requests take longer than the window, with room
+        // for delays between taking a token and sending the request
+        constexpr double pace_margin = 1.01;
+        std::chrono::duration<double> seconds = window;
+        return token_bucket(1.0, requests / (seconds.count() * pace_margin));
+    }
+
+    request_scheduler::request_scheduler(token_bucket bucket,
+                                         size_t connections, transport send)
+        : transport_(send ? std::move(send) : transport(cpr_get)),
+          bucket_(bucket) {
+        connections = std::max<size_t>(connections, 1);
+        connections_.reserve(connections);
+        for (size_t i = 0; i < connections; ++i) {
+            connections_.emplace_back([this]() { work(); });
+        }
+    }
+
+    request_scheduler::~request_scheduler() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &connection : connections_) {
+            connection.join();
+        }
+        for (auto &[key, r] : pending_) {
+            std::runtime_error error(
+                "REQUEST_SCHEDULER error: scheduler destroyed before the "
+                "request was sent.");
+            if (r.on_response) {
+                r.on_response(http_response{0, error.what()});
+            } else {
+                r.promise.set_exception(std::make_exception_ptr(error));
+            }
+        }
+    }
+
+    std::future<http_response>
+    request_scheduler::submit(std::string url, request_priority priority) {
+        request r{std::move(url), {}, nullptr};
+        std::future<http_response> result = r.promise.get_future();
+        push(priority, std::move(r));
+        return result;
+    }
+
+    void request_scheduler::submit(std::string url, request_priority priority,
+                                   callback on_response) {
+        push(priority, request{std::move(url), {}, std::move(on_response)});
+    }
+
+    size_t request_scheduler::pending() const {
+        std::lock_guard lock(mutex_);
+        return pending_.size();
+    }
+
+    void request_scheduler::push(request_priority priority, request r) {
+        {
+            std::lock_guard lock(mutex_);
+            pending_.emplace(std::make_pair(priority, sequence_++),
+                             std::move(r));
+        }
+        cv_.notify_one();
+    }
+
+    void request_scheduler::work() {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+            if (stop_) {
+                return;
+            }
+            token_bucket::clock::time_point now = token_bucket::clock::now();
+            if (!bucket_.try_acquire(now)) {
+                // the first request in the queue might change while waiting
+                cv_.wait_until(lock, bucket_.available_at(now));
+                continue;
+            }
+            auto node = pending_.extract(pending_.begin());
+            lock.unlock();
+            send(node.mapped());
+            lock.lock();
+        }
+    }
+
+    void request_scheduler::send(request &r) {
+        http_response response;
+        std::exception_ptr error;
+        try {
+            response = transport_(r.url);
+        } catch (std::exception &e) {
+            error = std::current_exception();
+            response = http_response{0, e.what()};
+        } catch (...) {
+            error = std::current_exception();
+            response = http_response{0, "REQUEST_SCHEDULER error: unknown "
+                                        "error sending the request."};
+        }
+        if (r.on_response) {
+            r.on_response(response);
+        } else if (error) {
+            r.promise.set_exception(error);
+        } else {
+            r.promise.set_value(std::move(response));
+        }
+    }
+} // namespace portfolio
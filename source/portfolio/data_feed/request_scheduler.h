@@ -0,0 +1,133 @@
+#ifndef PORTFOLIO_REQUEST_SCHEDULER_H
+#define PORTFOLIO_REQUEST_SCHEDULER_H
+
+#include "portfolio/common/token_bucket.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    /// \brief Priority of a request. Interactive requests are sent before
+    /// any bulk request waiting in the queue.
+    enum class request_priority { interactive, bulk };
+
+    /// \brief Response of a HTTP request.
+    struct http_response {
+        long status_code{0};
+        std::string text;
+    };
+
+    /// \brief Queue of HTTP requests sent at the rate allowed by an API key.
+    ///
+    /// Requests wait in a priority queue and are sent by a fixed number of
+    /// connection threads, each taking a token from a token bucket before
+    /// sending a request. Callers get a future or a callback, so no caller
+    /// thread sleeps to respect the rate limit, and the quota is used as
+    /// soon as a token is available.
+    class request_scheduler {
+      public:
+        /// \brief Function sending a GET request to the url.
+        using transport = std::function<http_response(const std::string &)>;
+
+        /// \brief Function called with the response of a request. If the
+        /// transport throws, the callback gets a response with status code
+        /// 0 and the error message as text. Callbacks must not throw.
+        using callback = std::function<void(const http_response &)>;
+
+      public /* constructors */:
+        /// \brief Get the scheduler shared by all users of an API key.
+        /// The connections are only used when the scheduler of the key is
+        /// created.
+        /// \param api_key API key identifying the quota.
+        /// \param requests_per_minute Maximum number of requests in any
+        /// minute. It must be the same for all users of the key.
+        /// \param connections Maximum number of requests in flight.
+        /// \return Scheduler shared by all users of the key.
+        static std::shared_ptr<request_scheduler>
+        for_api_key(const std::string &api_key, double requests_per_minute,
+                    size_t connections = 4);
+
+        /// \brief Token bucket that never sends more than a number of
+        /// requests in any window of a duration.
+        /// A bucket with capacity c and rate r allows c + r t requests in t
+        /// seconds, so a full bucket of the quota would allow almost twice
+        /// the quota in the first window. The bucket holds a single token
+        /// and paces the requests instead. At exactly the rate of the
+        /// quota, a closed window would hold its first and last requests,
+        /// one more than the quota, so the pace is slightly slower.
+        /// \param requests Maximum number of requests in a window.
+        /// \param window Duration of the window.
+        static token_bucket quota_bucket(double requests,
+                                         token_bucket::clock::duration window);
+
+        /// \brief Constructor of request_scheduler
+        /// \param bucket Token bucket with the rate limit of the requests.
+        /// \param connections Maximum number of requests in flight.
+        /// \param send Function that sends the requests. The default uses
+        /// cpr.
+        explicit request_scheduler(token_bucket bucket, size_t connections = 4,
+                                   transport send = nullptr);
+
+        /// \brief Destructor of request_scheduler. Requests still in the
+        /// queue fail with a std::runtime_error.
+        ~request_scheduler();
+
+        request_scheduler(const request_scheduler &) = delete;
+        request_scheduler &operator=(const request_scheduler &) = delete;
+
+      public /* requests */:
+        /// \brief Queue a request.
+        /// \param url URL of the request.
+        /// \param priority Priority of the request.
+        /// \return Future with the response. If the transport throws, the
+        /// future holds the exception.
+        std::future<http_response>
+        submit(std::string url,
+               request_priority priority = request_priority::interactive);
+
+        /// \brief Queue a request and call on_response from a connection
+        /// thread with its response.
+        /// \param url URL of the request.
+        /// \param priority Priority of the request.
+        /// \param on_response Function called with the response.
+        void submit(std::string url, request_priority priority,
+                    callback on_response);
+
+        /// \brief Number of requests waiting for a token or a connection.
+        [[nodiscard]] size_t pending() const;
+
+      private:
+        struct request {
+            std::string url;
+            std::promise<http_response> promise;
+            callback on_response;
+        };
+
+        /// \brief Loop of the connection threads.
+        void work();
+
+        /// \brief Send a request and deliver its response.
+        void send(request &r);
+
+        /// \brief Add a request to the queue.
+        void push(request_priority priority, request r);
+
+        transport transport_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        token_bucket bucket_;
+        bool stop_{false};
+        uint64_t sequence_{0};
+        /// \brief Requests ordered by priority and then by arrival.
+        std::map<std::pair<request_priority, uint64_t>, request> pending_;
+        std::vector<std::thread> connections_;
+    };
+} // namespace portfolio
+#endif // PORTFOLIO_REQUEST_SCHEDULER_H
@@ -0,0 +1,354 @@
+#include "series_file.h"
+#include "portfolio/common/algorithm.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <vector>
+namespace portfolio {
+    namespace {
+        constexpr std::string_view series_file_magic = "PFSERIES";
+        // start, end, open, high, low, close
+        constexpr size_t series_file_columns = 6;
+
+        int64_t to_int64(minute_point mp) {
+            return mp.time_since_epoch().count();
+        }
+
+        minute_point to_minute_point(int64_t minutes) {
+            return minute_point(std::chrono::minutes(minutes));
+        }
+
+        template <class T>
+        std::span<const std::byte> bytes_of(std::span<const T> column) {
+            return std::as_bytes(column);
+        }
+
+        template <class Series>
+        bool write_series(const std::filesystem::path &path,
+                          const Series &series, timeframe tf,
+                          size_t capacity) {
+            series_file_header h{};
+            h.preamble = file_preamble::of(series_file_magic,
+                                           series_file::format_version);
+            h.timeframe = static_cast<uint32_t>(tf);
+            h.size = series.size();
+            h.capacity = std::max(series.size(), capacity);
+
+            std::vector<int64_t> starts(series.size());
+            std::vector<int64_t> ends(series.size());
+            std::transform(series.starts().begin(), series.starts().end(),
+                           starts.begin(), to_int64);
+            std::transform(series.ends().begin(), series.ends().end(),
+                           ends.begin(), to_int64);
+            // zeros filling the columns up to their capacity
+            std::vector<std::byte> slack((h.capacity - h.size) * 8);
+
+            const std::array<std::span<const std::byte>, 13> chunks = {
+                std::as_bytes(std::span(&h, 1)),
+                bytes_of<int64_t>(starts),
+                slack,
+                bytes_of<int64_t>(ends),
+                slack,
+                bytes_of(series.opens()),
+                slack,
+                bytes_of(series.highs()),
+                slack,
+                bytes_of(series.lows()),
+                slack,
+                bytes_of(series.closes()),
+                slack};
+            return write_file_atomically(path, chunks);
+        }
+    } // namespace
+
+    bool series_file::open(const std::filesystem::path &path) {
+        if (!file_.open(path)) {
+            return false;
+        }
+        const auto *h = mapped_header<series_file_header>(
+            file_, series_file_magic, format_version);
+        // The capacity of a corrupt header might overflow the column sizes
+        bool valid = h != nullptr && h->size <= h->capacity &&
+                     h->capacity <= (file_.size() - sizeof(*h)) / 8 /
+                                        series_file_columns;
+        if (!valid) {
+            file_.close();
+        }
+        return valid;
+    }
+
+    void series_file::close() { file_.close(); }
+
+    bool series_file::is_open() const { return file_.is_open(); }
+
+    size_t series_file::size() const { return header().size; }
+
+    timeframe series_file::tf() const {
+        return static_cast<timeframe>(header().timeframe);
+    }
+
+    minute_point series_file::first_start() const {
+        return to_minute_point(time_column(0).front());
+    }
+
+    minute_point series_file::last_end() const {
+        return to_minute_point(time_column(1).back());
+    }
+
+    bool series_file::covers(minute_point start_period,
+                             minute_point end_period) const {
+        return size() != 0 && first_start() <= start_period &&
+               last_end() >= end_period;
+    }
+
+    price_series series_file::slice(minute_point start_period,
+                                    minute_point end_period) const {
+        // Bars are sorted and do not overlap, so both columns are sorted
+        auto starts = time_column(0);
+        auto ends = time_column(1);
+        size_t first = std::lower_bound(starts.begin(), starts.end(),
+                                        to_int64(start_period)) -
+                       starts.begin();
+        size_t last =
+            std::upper_bound(ends.begin(), ends.end(), to_int64(end_period)) -
+            ends.begin();
+        return copy(first, std::max(first, last));
+    }
+
+    price_series series_file::read() const { return copy(0, size()); }
+
+    price_series series_file::copy(size_t first, size_t last) const {
+        auto starts = time_column(0);
+        auto ends = time_column(1);
+        auto opens = price_column(2);
+        auto highs = price_column(3);
+        auto lows = price_column(4);
+        auto closes = price_column(5);
+        price_series series;
+        series.reserve(last - first);
+        for (size_t i = first; i < last; ++i) {
+            series.push_back(to_minute_point(starts[i]),
+                             to_minute_point(ends[i]), opens[i], highs[i],
+                             lows[i], closes[i]);
+        }
+        return series;
+    }
+
+    const series_file_header &series_file::header() const {
+        return *reinterpret_cast<const series_file_header *>(file_.data());
+    }
+
+    std::span<const int64_t> series_file::time_column(size_t k) const {
+        const std::byte *column = file_.data() + sizeof(series_file_header) +
+                                  k * header().capacity * 8;
+        return {reinterpret_cast<const int64_t *>(column), header().size};
+    }
+
+    std::span<const double> series_file::price_column(size_t k) const {
+        const std::byte *column = file_.data() + sizeof(series_file_header) +
+                                  k * header().capacity * 8;
+        return {reinterpret_cast<const double *>(column), header().size};
+    }
+
+    bool series_file::write(const std::filesystem::path &path,
+                            const price_series &series, timeframe tf,
+                            size_t capacity) {
+        return write_series(path, series, tf, capacity);
+    }
+
+    bool series_file::write(const std::filesystem::path &path,
+                            const price_view &series, timeframe tf,
+                            size_t capacity) {
+        return write_series(path, series, tf, capacity);
+    }
+
+    bool series_file::extend(const std::filesystem::path &path,
+                             const price_series &bars) {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!f.is_open()) {
+            return false;
+        }
+        series_file_header h{};
+        f.read(reinterpret_cast<char *>(&h), sizeof(h));
+        if (!f || !h.preamble.matches(series_file_magic, format_version) ||
+            h.size > h.capacity) {
+            return false;
+        }
+        auto column_offset = [&h](size_t k, size_t i) {
+            return static_cast<std::streamoff>(sizeof(series_file_header) +
+                                               (k * h.capacity + i) * 8);
+        };
+
+        // Find where the new bars go: the last bar is replaced by a bar
+        // with the same start, and older bars are already in the file
+        size_t first = 0;
+        size_t index = h.size;
+        if (h.size != 0) {
+            // start and end, then open, high, low and close
+            std::array<int64_t, 2> last_times{};
+            std::array<double, 4> last_prices{};
+            for (size_t k = 0; k < series_file_columns; ++k) {
+                f.seekg(column_offset(k, h.size - 1));
+                char *value = k < 2 ? reinterpret_cast<char *>(&last_times[k])
+                                    : reinterpret_cast<char *>(
+                                          &last_prices[k - 2]);
+                f.read(value, 8);
+            }
+            if (!f) {
+                return false;
+            }
+            int64_t last_start = last_times[0];
+            first = bars.lower_bound(to_minute_point(last_start));
+            if (first < bars.size() &&
+                to_int64(bars.starts()[first]) == last_start) {
+                // A bar that did not change is not replaced
+                bool same = to_int64(bars.ends()[first]) == last_times[1] &&
+                            bars.prices(first) ==
+                                ohlc_prices(last_prices[0], last_prices[1],
+                                            last_prices[2], last_prices[3]);
+                if (same) {
+                    ++first;
+                } else {
+                    index = h.size - 1;
+                }
+            }
+        }
+        size_t n = bars.size() - first;
+        if (n == 0) {
+            return true;
+        }
+        size_t new_size = index + n;
+
+        if (index == h.size && new_size <= h.capacity) {
+            // Append to the slack of the columns and then publish the new
+            // size. Readers that mapped the file only see the bars below
+            // the size they read, which are never written in place.
+            std::vector<int64_t> times(n);
+            auto write_at = [&](size_t k, const void *data) {
+                f.seekp(column_offset(k, index));
+                f.write(static_cast<const char *>(data),
+                        static_cast<std::streamsize>(n * 8));
+            };
+            auto new_starts = bars.starts().subspan(first);
+            std::transform(new_starts.begin(), new_starts.end(),
+                           times.begin(), to_int64);
+            write_at(0, times.data());
+            auto new_ends = bars.ends().subspan(first);
+            std::transform(new_ends.begin(), new_ends.end(), times.begin(),
+                           to_int64);
+            write_at(1, times.data());
+            write_at(2, bars.opens().data() + first);
+            write_at(3, bars.highs().data() + first);
+            write_at(4, bars.lows().data() + first);
+            write_at(5, bars.closes().data() + first);
+            f.flush();
+            h.size = new_size;
+            f.seekp(0);
+            f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+            f.close();
+            return !f.fail();
+        }
+
+        // Rewrite the file, growing it if the bars do not fit. A replaced
+        // bar is never patched in place, so readers never see a bar that
+        // mixes old and new columns.
+        f.close();
+        series_file current;
+        if (!current.open(path)) {
+            return false;
+        }
+        price_series merged = current.copy(0, index);
+        for (size_t i = first; i < bars.size(); ++i) {
+            merged.push_back(bars.interval(i), bars.prices(i));
+        }
+        timeframe tf = current.tf();
+        current.close();
+        size_t capacity = new_size <= h.capacity
+                              ? h.capacity
+                              : std::max(new_size, 2 * h.capacity);
+        return write(path, merged, tf, capacity);
+    }
+
+    bool convert_json_series_file(const std::filesystem::path &json_path,
+                                  const std::filesystem::path &series_path,
+                                  timeframe tf) {
+        std::string line;
+        std::ifstream fin(json_path);
+        if (!fin.is_open()) {
+            return false;
+        }
+        std::getline(fin, line);
+        fin.close();
+        nlohmann::json json_from_file =
+            nlohmann::json::parse(line, nullptr, false);
+        if (json_from_file.is_discarded() || !json_from_file.is_object()) {
+            return false;
+        }
+        price_map prices;
+        for (auto &el : json_from_file.items()) {
+            if (!el.value().is_string()) {
+                return false;
+            }
+            ohlc_prices ohlc;
+            if (!ohlc.from_string(el.value().get<std::string>())) {
+                return false;
+            }
+            prices[string_to_interval_points(el.key())] = ohlc;
+        }
+        return series_file::write(series_path, price_series(prices), tf);
+    }
+
+    size_t convert_json_cache(const std::filesystem::path &directory) {
+        if (!std::filesystem::is_directory(directory)) {
+            return 0;
+        }
+        std::vector<std::filesystem::path> json_files;
+        for (const auto &entry :
+             std::filesystem::directory_iterator(directory)) {
+            if (entry.path().extension() == ".data") {
+                json_files.emplace_back(entry.path());
+            }
+        }
+        size_t converted = 0;
+        for (const auto &json_path : json_files) {
+            // <asset code>.<TIMEFRAME>.<start>.<end>.data, where the asset
+            // code might contain dots, such as in "PETR4.SAO"
+            std::string text = json_path.stem().string();
+            std::replace(text.begin(), text.end(), '.', ' ');
+            std::istringstream iss(text);
+            std::vector<std::string> results(
+                std::istream_iterator<std::string>{iss},
+                std::istream_iterator<std::string>());
+            if (results.size() < 4) {
+                continue;
+            }
+            const std::string &tf_name = results[results.size() - 3];
+            timeframe tf;
+            if (tf_name == "DAILY") {
+                tf = timeframe::daily;
+            } else if (tf_name == "WEEKLY") {
+                tf = timeframe::weekly;
+            } else if (tf_name == "MONTHLY") {
+                tf = timeframe::monthly;
+            } else if (tf_name == "HOURLY") {
+                tf = timeframe::hourly;
+            } else {
+                continue;
+            }
+            std::string asset_code = results[0];
+            for (size_t i = 1; i + 3 < results.size(); ++i) {
+                asset_code += '.';
+                asset_code += results[i];
+            }
+            std::filesystem::path series_path =
+                directory / series_filename(asset_code, tf);
+            if (convert_json_series_file(json_path, series_path, tf)) {
+                std::filesystem::remove(json_path);
+                ++converted;
+            }
+        }
+        return converted;
+    }
+} // namespace portfolio
@@ -0,0 +1,139 @@
+#ifndef PORTFOLIO_SERIES_FILE_H
+#define PORTFOLIO_SERIES_FILE_H
+
+#include "portfolio/common/mapped_file.h"
+#include "portfolio/core/price_series.h"
+#include "portfolio/core/price_view.h"
+#include "portfolio/data_feed/data_feed.h"
+#include <cstdint>
+#include <filesystem>
+#include <span>
+namespace portfolio {
+    /// \brief Fixed header at the beginning of a binary series file.
+    ///
+    /// The header is followed by six columns of `capacity` elements each,
+    /// in this order: start and end timestamps (int64 minutes since epoch)
+    /// and open, high, low and close prices (double). Only the first `size`
+    /// elements of each column hold bars.
+    struct series_file_header {
+        file_preamble preamble;
+        uint32_t timeframe;
+        uint32_t padding;
+        uint64_t size;
+        uint64_t capacity;
+        uint8_t reserved[24];
+    };
+    static_assert(sizeof(series_file_header) == 64);
+
+    /// \brief Binary cache file of a price series opened with mmap.
+    ///
+    /// Opening a file only validates its header, and slicing a range only
+    /// touches the pages of the columns that hold that range.
+    class series_file {
+      public:
+        /// \brief Current version of the file format.
+        static constexpr uint32_t format_version = 1;
+
+      public /* constructors */:
+        series_file() = default;
+
+      public /* reading */:
+        /// \brief Map a series file into memory.
+        /// \param path Path of the file.
+        /// \return True if the file exists and has a valid header or false
+        /// otherwise.
+        bool open(const std::filesystem::path &path);
+
+        /// \brief Unmap the file.
+        void close();
+
+        /// \brief Check if a valid file is open.
+        [[nodiscard]] bool is_open() const;
+
+        /// \brief Number of bars in the file.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Timeframe of the bars in the file.
+        [[nodiscard]] timeframe tf() const;
+
+        /// \brief Start of the first bar in the file.
+        [[nodiscard]] minute_point first_start() const;
+
+        /// \brief End of the last bar in the file.
+        [[nodiscard]] minute_point last_end() const;
+
+        /// \brief Check if the file has all bars from start_period to
+        /// end_period.
+        /// \param start_period Initial minute_point.
+        /// \param end_period Final minute_point.
+        /// \return True if the file covers the period or false otherwise.
+        [[nodiscard]] bool covers(minute_point start_period,
+                                  minute_point end_period) const;
+
+        /// \brief Copy the bars inside a period into a price series.
+        /// \param start_period Bars starting before this are ignored.
+        /// \param end_period Bars ending after this are ignored.
+        /// \return Price_series with the bars inside the period.
+        [[nodiscard]] price_series slice(minute_point start_period,
+                                         minute_point end_period) const;
+
+        /// \brief Copy all bars into a price series.
+        [[nodiscard]] price_series read() const;
+
+      public /* writing */:
+        /// \brief Write a series to a file with write_file_atomically.
+        /// \param path Path of the file.
+        /// \param series Bars to be written.
+        /// \param tf Timeframe of the bars.
+        /// \param capacity Number of bars each column can hold before the
+        /// file needs to be rewritten. It is at least the series size.
+        /// \return True if not occurs errors or false otherwise.
+        static bool write(const std::filesystem::path &path,
+                          const price_series &series, timeframe tf,
+                          size_t capacity = 0);
+
+        /// \brief Write the bars of a view to a file.
+        static bool write(const std::filesystem::path &path,
+                          const price_view &series, timeframe tf,
+                          size_t capacity = 0);
+
+        /// \brief Merge new bars into the end of an existing file.
+        /// Bars before the last bar in the file are ignored, a bar with the
+        /// same start as the last bar replaces it if it differs, and later
+        /// bars are appended. Appended bars are written in place when the
+        /// columns have room for them and the size in the header is only
+        /// updated after that. Otherwise, or when the last bar is replaced,
+        /// the file is rewritten, with twice the capacity if it is full.
+        /// \param path Path of the file.
+        /// \param bars Bars to be merged into the file.
+        /// \return True if not occurs errors or false otherwise.
+        static bool extend(const std::filesystem::path &path,
+                           const price_series &bars);
+
+      private:
+        [[nodiscard]] const series_file_header &header() const;
+        [[nodiscard]] std::span<const int64_t> time_column(size_t k) const;
+        [[nodiscard]] std::span<const double> price_column(size_t k) const;
+        [[nodiscard]] price_series copy(size_t first, size_t last) const;
+
+        mapped_file file_;
+    };
+
+    /// \brief Convert a JSON data file from older versions of
+    /// alphavantage_data_feed into a binary series file.
+    /// \param json_path Path of the JSON data file.
+    /// \param series_path Path of the series file to be created.
+    /// \param tf Timeframe of the bars in the data file.
+    /// \return True if not occurs errors or false otherwise.
+    bool convert_json_series_file(const std::filesystem::path &json_path,
+                                  const std::filesystem::path &series_path,
+                                  timeframe tf);
+
+    /// \brief Convert all JSON data files in a directory into series files.
+    /// Converted JSON files are removed.
+    /// \param directory Directory with the data files, such as "./stock_data".
+    /// \return Number of files converted.
+    size_t convert_json_cache(const std::filesystem::path &directory);
+} // namespace portfolio
+
+#endif // PORTFOLIO_SERIES_FILE_H
@@ -0,0 +1,170 @@
+#include "delta_evaluator.h"
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+namespace portfolio {
+    namespace {
+        /// Moves between refreshes of the totals
+        constexpr size_t refresh_interval = size_t(1) << 16;
+        /// Common factors outside this range are folded into the weights
+        constexpr double min_scale = 1e-100;
+        constexpr double max_scale = 1e100;
+    } // namespace
+
+    delta_evaluator::delta_evaluator(
+        std::shared_ptr<const portfolio_mad> model,
+        std::span<const double> weights)
+        : model_(std::move(model)),
+          unscaled_weights_(weights.begin(), weights.end()) {
+        if (unscaled_weights_.size() != model_->n_assets()) {
+            throw std::runtime_error("DELTA_EVALUATOR constructor error: one "
+                                     "weight is needed per asset.");
+        }
+        if (std::any_of(unscaled_weights_.begin(), unscaled_weights_.end(),
+                        [](double w) { return !(w >= 0.0); })) {
+            throw std::runtime_error("DELTA_EVALUATOR constructor error: "
+                                     "weights cannot be negative.");
+        }
+        refresh();
+    }
+
+    delta_evaluator::delta_evaluator(const market_data &data,
+                                     interval_points interval, int n_periods,
+                                     std::span<const double> weights)
+        : delta_evaluator(data.mad(interval, n_periods), weights) {}
+
+    std::pair<double, double>
+    delta_evaluator::evaluate_transfer(asset_id from, asset_id to,
+                                       double amount) const {
+        amount = std::clamp(amount, -weight(to), weight(from));
+        return std::make_pair(
+            risk_ + amount * (model_->risk(to) - model_->risk(from)),
+            expected_return_ + amount * (model_->expected_return(to) -
+                                         model_->expected_return(from)));
+    }
+
+    double delta_evaluator::transfer(asset_id from, asset_id to,
+                                     double amount) {
+        amount = std::clamp(amount, -weight(to), weight(from));
+        std::tie(risk_, expected_return_) =
+            evaluate_transfer(from, to, amount);
+        unscaled_weights_[from] =
+            std::max(unscaled_weights_[from] - amount / scale_, 0.0);
+        unscaled_weights_[to] =
+            std::max(unscaled_weights_[to] + amount / scale_, 0.0);
+        count_move();
+        return amount;
+    }
+
+    void delta_evaluator::set_weight(asset_id id, double weight) {
+        if (!(weight >= 0.0 && weight <= 1.0)) {
+            throw std::runtime_error("DELTA_EVALUATOR set_weight error: "
+                                     "weight out of [0, 1].");
+        }
+        double current = this->weight(id);
+        double others = 1.0 - current;
+        if (weight == 1.0 || others <= 0.0) {
+            // The other weights are all zero before or after the move, so
+            // they cannot be scaled
+            if (weight != 1.0 && unscaled_weights_.size() == 1) {
+                throw std::runtime_error("DELTA_EVALUATOR set_weight error: "
+                                         "the only asset has all weight.");
+            }
+            double rest = unscaled_weights_.size() > 1
+                              ? (1.0 - weight) /
+                                    static_cast<double>(
+                                        unscaled_weights_.size() - 1)
+                              : 0.0;
+            std::fill(unscaled_weights_.begin(), unscaled_weights_.end(),
+                      weight == 1.0 ? 0.0 : rest);
+            unscaled_weights_[id] = weight;
+            scale_ = 1.0;
+            refresh();
+            return;
+        }
+        // Each other weight is multiplied by the same factor
+        double factor = (1.0 - weight) / others;
+        risk_ = factor * (risk_ - current * model_->risk(id)) +
+                weight * model_->risk(id);
+        expected_return_ =
+            factor * (expected_return_ -
+                      current * model_->expected_return(id)) +
+            weight * model_->expected_return(id);
+        scale_ *= factor;
+        unscaled_weights_[id] = weight / scale_;
+        if (scale_ < min_scale || scale_ > max_scale) {
+            rescale();
+        }
+        count_move();
+    }
+
+    void delta_evaluator::refresh() {
+        rescale();
+        double total = 0.0;
+        for (double w : unscaled_weights_) {
+            total += w;
+        }
+        if (!(total > 0.0)) {
+            throw std::runtime_error(
+                "DELTA_EVALUATOR error: weights sum to zero.");
+        }
+        risk_ = 0.0;
+        expected_return_ = 0.0;
+        for (asset_id id = 0; id < unscaled_weights_.size(); ++id) {
+            unscaled_weights_[id] /= total;
+            risk_ += unscaled_weights_[id] * model_->risk(id);
+            expected_return_ +=
+                unscaled_weights_[id] * model_->expected_return(id);
+        }
+        moves_ = 0;
+    }
+
+    std::pair<double, double> delta_evaluator::evaluate() const {
+        return std::make_pair(risk_, expected_return_);
+    }
+
+    double delta_evaluator::risk() const { return risk_; }
+
+    double delta_evaluator::expected_return() const {
+        return expected_return_;
+    }
+
+    double delta_evaluator::weight(asset_id id) const {
+        return scale_ * unscaled_weights_[id];
+    }
+
+    double delta_evaluator::weight(std::string_view asset) const {
+        asset_id id = model_->symbols().find(asset);
+        if (id == symbol_table::npos) {
+            throw std::out_of_range("DELTA_EVALUATOR error: asset not found.");
+        }
+        return weight(id);
+    }
+
+    std::vector<double> delta_evaluator::weights() const {
+        std::vector<double> result(unscaled_weights_.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            result[i] = scale_ * unscaled_weights_[i];
+        }
+        return result;
+    }
+
+    size_t delta_evaluator::n_assets() const {
+        return unscaled_weights_.size();
+    }
+
+    const portfolio_mad &delta_evaluator::model() const { return *model_; }
+
+    void delta_evaluator::rescale() {
+        for (double &w : unscaled_weights_) {
+            w *= scale_;
+        }
+        scale_ = 1.0;
+    }
+
+    void delta_evaluator::count_move() {
+        if (++moves_ == refresh_interval) {
+            refresh();
+        }
+    }
+} // namespace portfolio
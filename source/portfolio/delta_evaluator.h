@@ -0,0 +1,89 @@
+#ifndef PORTFOLIO_DELTA_EVALUATOR_H
+#define PORTFOLIO_DELTA_EVALUATOR_H
+
+#include "market_data.h"
+#include "portfolio_mad.h"
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    /// \brief Risk and expected return of a portfolio kept up to date
+    /// through local-search moves.
+    ///
+    /// The evaluator holds the weighted sums of the asset MADs and expected
+    /// returns, as portfolio::evaluate_mad computes them. A transfer of
+    /// weight between two assets keeps the sum of the weights and updates
+    /// the totals in O(1). Setting one weight rescales all the others
+    /// through a common factor instead of touching each of them, so the
+    /// renormalization is also O(1).
+    class delta_evaluator {
+      public /* constructors */:
+        /// \brief Constructor of delta_evaluator
+        /// \param model Risk model of the assets.
+        /// \param weights Weight of each asset by id. They are normalized
+        /// to sum 1.
+        delta_evaluator(std::shared_ptr<const portfolio_mad> model,
+                        std::span<const double> weights);
+
+        /// \brief Constructor of delta_evaluator with the model cached by
+        /// market_data
+        delta_evaluator(const market_data &data, interval_points interval,
+                        int n_periods, std::span<const double> weights);
+
+      public /* moves */:
+        /// \brief Risk and expected return after a transfer, which is not
+        /// applied.
+        [[nodiscard]] std::pair<double, double>
+        evaluate_transfer(asset_id from, asset_id to, double amount) const;
+
+        /// \brief Move weight from one asset to another
+        /// \param from Asset losing the weight.
+        /// \param to Asset receiving the weight.
+        /// \param amount Weight moved. Negative amounts move from `to` to
+        /// `from`.
+        /// \return The amount moved, clamped so that no weight becomes
+        /// negative.
+        double transfer(asset_id from, asset_id to, double amount);
+
+        /// \brief Set the weight of an asset and scale the other weights
+        /// so that they sum 1.
+        /// \param id Asset.
+        /// \param weight New weight in [0, 1].
+        void set_weight(asset_id id, double weight);
+
+        /// \brief Recompute the totals from the weights, which removes the
+        /// rounding errors accumulated by the moves. This is also done
+        /// periodically.
+        void refresh();
+
+      public /* getters */:
+        /// \brief Risk and expected return of the current weights.
+        [[nodiscard]] std::pair<double, double> evaluate() const;
+        [[nodiscard]] double risk() const;
+        [[nodiscard]] double expected_return() const;
+        [[nodiscard]] double weight(asset_id id) const;
+        [[nodiscard]] double weight(std::string_view asset) const;
+        [[nodiscard]] std::vector<double> weights() const;
+        [[nodiscard]] size_t n_assets() const;
+        [[nodiscard]] const portfolio_mad &model() const;
+
+      private:
+        /// \brief Bring the common factor back to 1
+        void rescale();
+
+        /// \brief Count a move and refresh the totals periodically
+        void count_move();
+
+        std::shared_ptr<const portfolio_mad> model_;
+        /// Weights are the common scale times these values
+        std::vector<double> unscaled_weights_;
+        double scale_{1.0};
+        double risk_{0.0};
+        double expected_return_{0.0};
+        size_t moves_{0};
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_DELTA_EVALUATOR_H
@@ -0,0 +1,178 @@
+#include "ewma_model.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+namespace portfolio {
+    namespace {
+        /// Offset of row i in a lower triangle stored row by row
+        size_t triangle_row(size_t i) { return i * (i + 1) / 2; }
+    } // namespace
+
+    ewma_model::ewma_model(std::shared_ptr<const symbol_table> symbols,
+                           double decay)
+        : symbols_(std::move(symbols)), decay_(decay) {
+        if (!(decay_ > 0.0 && decay_ < 1.0)) {
+            throw std::runtime_error(
+                "EWMA_MODEL constructor error: decay out of (0, 1).");
+        }
+        size_t n = symbols_->size();
+        mean_.assign(n, 0.0);
+        mad_.assign(n, 0.0);
+        covariance_.assign(triangle_row(n), 0.0);
+        initialized_.assign(n, 0);
+        deviation_.assign(n, 0.0);
+        column_decay_.assign(n, decay_);
+    }
+
+    ewma_model::ewma_model(const market_data &data, double decay)
+        : ewma_model(data.shared_symbols(), decay) {
+        update(data.returns());
+    }
+
+    double ewma_model::decay_from_half_life(double half_life) {
+        if (!(half_life > 0.0)) {
+            throw std::runtime_error(
+                "EWMA_MODEL error: half life must be positive.");
+        }
+        return std::pow(0.5, 1.0 / half_life);
+    }
+
+    void ewma_model::update(interval_points interval,
+                            std::span<const double> returns,
+                            std::span<const uint8_t> mask) {
+        const size_t n = n_assets();
+        if (returns.size() != n || (!mask.empty() && mask.size() != n)) {
+            throw std::runtime_error("EWMA_MODEL update error: one return "
+                                     "is needed per asset.");
+        }
+        if (n_bars_ != 0 && !(interval_ < interval)) {
+            throw std::runtime_error("EWMA_MODEL update error: bars must "
+                                     "arrive in order.");
+        }
+        const double alpha = 1.0 - decay_;
+        for (size_t k = 0; k < n; ++k) {
+            if (!mask.empty() && !mask[k]) {
+                deviation_[k] = 0.0;
+                column_decay_[k] = 1.0;
+                continue;
+            }
+            column_decay_[k] = decay_;
+            if (!initialized_[k]) {
+                mean_[k] = returns[k];
+                initialized_[k] = 1;
+            }
+            deviation_[k] = returns[k] - mean_[k];
+            mean_[k] += alpha * deviation_[k];
+            mad_[k] = decay_ * mad_[k] + alpha * std::abs(deviation_[k]);
+        }
+        // Rows of masked assets are unchanged, and so are their columns,
+        // since their decay is 1 and their deviation is 0
+        for (size_t i = 0; i < n; ++i) {
+            if (column_decay_[i] == 1.0) {
+                continue;
+            }
+            double *row = covariance_.data() + triangle_row(i);
+            const double di = decay_ * alpha * deviation_[i];
+            const double *d = deviation_.data();
+            const double *c = column_decay_.data();
+            for (size_t j = 0; j <= i; ++j) {
+                row[j] = c[j] * row[j] + di * d[j];
+            }
+        }
+        interval_ = interval;
+        ++n_bars_;
+    }
+
+    size_t ewma_model::update(const return_panel &panel) {
+        if (panel.assets() != symbols_->symbols()) {
+            throw std::runtime_error("EWMA_MODEL update error: the panel "
+                                     "has other assets.");
+        }
+        auto intervals = panel.intervals();
+        size_t first = 0;
+        if (n_bars_ != 0) {
+            first = std::upper_bound(intervals.begin(), intervals.end(),
+                                     interval_) -
+                    intervals.begin();
+        }
+        const size_t n = n_assets();
+        std::vector<double> returns(n);
+        std::vector<uint8_t> mask(n);
+        for (size_t t = first; t < intervals.size(); ++t) {
+            for (size_t k = 0; k < n; ++k) {
+                returns[k] = panel.returns(k)[t];
+                mask[k] = panel.mask(k)[t];
+            }
+            update(intervals[t], returns, mask);
+        }
+        return intervals.size() - first;
+    }
+
+    double ewma_model::risk(asset_id id) const { return mad_[id]; }
+
+    double ewma_model::risk(std::string_view asset) const {
+        return risk(id_of(asset));
+    }
+
+    double ewma_model::expected_return(asset_id id) const {
+        return mean_[id];
+    }
+
+    double ewma_model::expected_return(std::string_view asset) const {
+        return expected_return(id_of(asset));
+    }
+
+    double ewma_model::covariance(asset_id i, asset_id j) const {
+        if (i < j) {
+            std::swap(i, j);
+        }
+        return covariance_[triangle_row(i) + j];
+    }
+
+    double ewma_model::variance(asset_id id) const {
+        return covariance_[triangle_row(id) + id];
+    }
+
+    double
+    ewma_model::portfolio_variance(std::span<const double> weights) const {
+        const size_t n = n_assets();
+        if (weights.size() != n) {
+            throw std::runtime_error("EWMA_MODEL error: one weight is "
+                                     "needed per asset.");
+        }
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            const double *row = covariance_.data() + triangle_row(i);
+            double off_diagonal = 0.0;
+            for (size_t j = 0; j < i; ++j) {
+                off_diagonal += row[j] * weights[j];
+            }
+            total += weights[i] * (2.0 * off_diagonal + row[i] * weights[i]);
+        }
+        return total;
+    }
+
+    std::pair<double, double>
+    ewma_model::evaluate(std::span<const double> weights) const {
+        return weighted_sums(weights);
+    }
+
+    size_t ewma_model::n_assets() const { return symbols_->size(); }
+
+    const symbol_table &ewma_model::symbols() const { return *symbols_; }
+
+    double ewma_model::decay() const { return decay_; }
+
+    size_t ewma_model::n_bars() const { return n_bars_; }
+
+    interval_points ewma_model::interval() const { return interval_; }
+
+    asset_id ewma_model::id_of(std::string_view asset) const {
+        asset_id id = symbols_->find(asset);
+        if (id == symbol_table::npos) {
+            throw std::out_of_range("EWMA_MODEL error: asset not found.");
+        }
+        return id;
+    }
+} // namespace portfolio
@@ -0,0 +1,119 @@
+#ifndef PORTFOLIO_EWMA_MODEL_H
+#define PORTFOLIO_EWMA_MODEL_H
+
+#include "market_data.h"
+#include "portfolio/core/return_panel.h"
+#include "risk_model.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    /// \brief Exponentially weighted means, MADs and covariances of the
+    /// asset returns, updated as new bars arrive.
+    ///
+    /// Each bar multiplies the weight of the past bars by the decay. With
+    /// d the deviation of the returns from the previous means and
+    /// a = 1 - decay, a bar updates the means by a d, the MADs to
+    /// decay * MAD + a |d| and the covariance matrix with the rank-one
+    /// update decay * (C + a d d'). A bar costs O(n^2) and the model
+    /// can be queried at any time.
+    ///
+    /// The first return of an asset initializes its mean. Masked returns
+    /// leave the statistics of their asset unchanged.
+    class ewma_model : public risk_model {
+      public /* constructors */:
+        /// \brief Constructor of an ewma_model with no bars
+        /// \param symbols Ids of the assets. Returns are indexed by these
+        /// ids.
+        /// \param decay Weight of the past bars relative to a new bar, in
+        /// (0, 1).
+        explicit ewma_model(std::shared_ptr<const symbol_table> symbols,
+                            double decay = 0.94);
+
+        /// \brief Constructor of an ewma_model with all bars of the market
+        /// data
+        /// \param data Market data whose return panel is consumed.
+        /// \param decay Weight of the past bars relative to a new bar.
+        explicit ewma_model(const market_data &data, double decay = 0.94);
+
+        /// \brief Decay whose weights halve every half_life bars.
+        static double decay_from_half_life(double half_life);
+
+      public /* updates */:
+        /// \brief Consume one bar
+        /// \param interval Interval of the bar, after the last bar consumed.
+        /// \param returns Return of each asset by id.
+        /// \param mask 1 for the known returns and 0 for the masked ones.
+        /// Empty means all returns are known.
+        void update(interval_points interval, std::span<const double> returns,
+                    std::span<const uint8_t> mask = {});
+
+        /// \brief Consume the bars of a panel after the last bar consumed,
+        /// such as the bars appended since the previous call.
+        /// \param panel Returns with one row per asset id.
+        /// \return Number of bars consumed.
+        size_t update(const return_panel &panel);
+
+      public /* queries */:
+        /// \brief Exponentially weighted MAD of an asset.
+        [[nodiscard]] double risk(asset_id id) const override;
+        [[nodiscard]] double risk(std::string_view asset) const;
+
+        /// \brief Exponentially weighted mean return of an asset.
+        [[nodiscard]] double expected_return(asset_id id) const override;
+        [[nodiscard]] double expected_return(std::string_view asset) const;
+
+        /// \brief Exponentially weighted covariance of two assets.
+        [[nodiscard]] double covariance(asset_id i, asset_id j) const;
+
+        /// \brief Exponentially weighted variance of an asset.
+        [[nodiscard]] double variance(asset_id id) const;
+
+        /// \brief Variance of the returns of a portfolio.
+        /// \param weights Weight of each asset by id.
+        [[nodiscard]] double
+        portfolio_variance(std::span<const double> weights) const;
+
+        /// \brief Weighted sums of the MADs and mean returns of the
+        /// assets.
+        /// \param weights Weight of each asset by id.
+        [[nodiscard]] std::pair<double, double>
+        evaluate(std::span<const double> weights) const override;
+
+      public /* getters */:
+        [[nodiscard]] size_t n_assets() const override;
+        [[nodiscard]] const symbol_table &symbols() const override;
+        [[nodiscard]] double decay() const;
+
+        /// \brief Number of bars consumed.
+        [[nodiscard]] size_t n_bars() const;
+
+        /// \brief Interval of the last bar consumed.
+        [[nodiscard]] interval_points interval() const;
+
+      private:
+        /// \brief Id of an asset, which must be in the model.
+        [[nodiscard]] asset_id id_of(std::string_view asset) const;
+
+        std::shared_ptr<const symbol_table> symbols_;
+        double decay_;
+        size_t n_bars_{0};
+        interval_points interval_{};
+        std::vector<double> mean_;
+        std::vector<double> mad_;
+        /// \brief Lower triangle of the covariance matrix, row by row.
+        std::vector<double> covariance_;
+        /// \brief Whether each asset had a return.
+        std::vector<uint8_t> initialized_;
+        /// \brief Deviations of the current bar.
+        std::vector<double> deviation_;
+        /// \brief Decay of the covariances with each asset in the current
+        /// bar, which is 1 for masked assets.
+        std::vector<double> column_decay_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_EWMA_MODEL_H
@@ -0,0 +1,511 @@
+#include "factor_model.h"
+#include "portfolio/common/mapped_file.h"
+#include "portfolio/common/parallel.h"
+#include "portfolio/common/philox.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        constexpr std::string_view factor_file_magic = "PFFACTOR";
+        /// Rows of a product computed by each task
+        constexpr size_t rows_per_task = 64;
+        /// Rows and columns of a product accumulated together
+        constexpr size_t row_tile = 4;
+        constexpr size_t column_tile = 8;
+        /// Rows and columns of the blocks of a transpose
+        constexpr size_t transpose_tile = 32;
+        /// Most sweeps of the Jacobi eigenvalue algorithm
+        constexpr size_t max_jacobi_sweeps = 100;
+
+        /// Y = A B, where A is n x m and B is m x l, both row-major. Each
+        /// task computes a block of rows of Y, so the sums have the same
+        /// order for any number of threads.
+        std::vector<double> product(const std::vector<double> &a,
+                                    const std::vector<double> &b, size_t n,
+                                    size_t m, size_t l, size_t n_threads) {
+            std::vector<double> y(n * l, 0.0);
+            size_t n_tasks = (n + rows_per_task - 1) / rows_per_task;
+            parallel_for(n_tasks, n_threads, [&](size_t task) {
+                size_t first = task * rows_per_task;
+                size_t last = std::min(first + rows_per_task, n);
+                size_t r = first;
+                // Tiles of rows and columns are accumulated in registers,
+                // sharing the loads of A and B
+                for (; r + row_tile <= last; r += row_tile) {
+                    const double *ar = a.data() + r * m;
+                    size_t c = 0;
+                    for (; c + column_tile <= l; c += column_tile) {
+                        double acc[row_tile][column_tile] = {};
+                        for (size_t i = 0; i < m; ++i) {
+                            const double *bi = b.data() + i * l + c;
+                            for (size_t k = 0; k < row_tile; ++k) {
+                                double x = ar[k * m + i];
+                                for (size_t j = 0; j < column_tile; ++j) {
+                                    acc[k][j] += x * bi[j];
+                                }
+                            }
+                        }
+                        for (size_t k = 0; k < row_tile; ++k) {
+                            std::copy(acc[k], acc[k] + column_tile,
+                                      y.data() + (r + k) * l + c);
+                        }
+                    }
+                    for (size_t k = 0; k < row_tile; ++k) {
+                        for (size_t i = 0; i < m; ++i) {
+                            const double *bi = b.data() + i * l;
+                            double *yr = y.data() + (r + k) * l;
+                            for (size_t j = c; j < l; ++j) {
+                                yr[j] += ar[k * m + i] * bi[j];
+                            }
+                        }
+                    }
+                }
+                for (; r < last; ++r) {
+                    const double *ar = a.data() + r * m;
+                    double *yr = y.data() + r * l;
+                    for (size_t i = 0; i < m; ++i) {
+                        const double *bi = b.data() + i * l;
+                        for (size_t j = 0; j < l; ++j) {
+                            yr[j] += ar[i] * bi[j];
+                        }
+                    }
+                }
+            });
+            return y;
+        }
+
+        /// Orthonormalize the columns of the row-major n x l matrix q with
+        /// two passes of modified Gram-Schmidt. Columns in the span of the
+        /// previous ones become zero. The columns are copied to rows, so
+        /// that the passes read contiguous memory.
+        void orthonormalize(std::vector<double> &q, size_t n, size_t l) {
+            std::vector<double> columns(l * n);
+            for (size_t k = 0; k < n; ++k) {
+                for (size_t c = 0; c < l; ++c) {
+                    columns[c * n + k] = q[k * l + c];
+                }
+            }
+            for (int pass = 0; pass < 2; ++pass) {
+                for (size_t c = 0; c < l; ++c) {
+                    double *qc = columns.data() + c * n;
+                    for (size_t p = 0; p < c; ++p) {
+                        const double *qp = columns.data() + p * n;
+                        double dot = 0.0;
+                        for (size_t k = 0; k < n; ++k) {
+                            dot += qp[k] * qc[k];
+                        }
+                        for (size_t k = 0; k < n; ++k) {
+                            qc[k] -= dot * qp[k];
+                        }
+                    }
+                    double norm = 0.0;
+                    for (size_t k = 0; k < n; ++k) {
+                        norm += qc[k] * qc[k];
+                    }
+                    norm = std::sqrt(norm);
+                    double scale = norm > 1e-300 ? 1.0 / norm : 0.0;
+                    for (size_t k = 0; k < n; ++k) {
+                        qc[k] *= scale;
+                    }
+                }
+            }
+            for (size_t k = 0; k < n; ++k) {
+                for (size_t c = 0; c < l; ++c) {
+                    q[k * l + c] = columns[c * n + k];
+                }
+            }
+        }
+
+        /// Eigenvalues and eigenvectors of the symmetric m x m matrix a
+        /// by the cyclic Jacobi method. On return, the diagonal of a holds
+        /// the eigenvalues and the columns of v the eigenvectors.
+        void jacobi_eigen(std::vector<double> &a, std::vector<double> &v,
+                          size_t m) {
+            v.assign(m * m, 0.0);
+            for (size_t i = 0; i < m; ++i) {
+                v[i * m + i] = 1.0;
+            }
+            double total = 0.0;
+            for (double x : a) {
+                total += x * x;
+            }
+            for (size_t sweep = 0; sweep < max_jacobi_sweeps; ++sweep) {
+                double off = 0.0;
+                for (size_t i = 0; i < m; ++i) {
+                    for (size_t j = i + 1; j < m; ++j) {
+                        off += a[i * m + j] * a[i * m + j];
+                    }
+                }
+                if (off <= 1e-30 * total) {
+                    return;
+                }
+                for (size_t p = 0; p < m; ++p) {
+                    for (size_t q = p + 1; q < m; ++q) {
+                        double apq = a[p * m + q];
+                        if (apq == 0.0) {
+                            continue;
+                        }
+                        // Rotation that zeroes a[p][q]
+                        double theta =
+                            (a[q * m + q] - a[p * m + p]) / (2.0 * apq);
+                        double t = (theta >= 0.0 ? 1.0 : -1.0) /
+                                   (std::abs(theta) +
+                                    std::sqrt(theta * theta + 1.0));
+                        double c = 1.0 / std::sqrt(t * t + 1.0);
+                        double s = t * c;
+                        for (size_t k = 0; k < m; ++k) {
+                            double akp = a[k * m + p];
+                            double akq = a[k * m + q];
+                            a[k * m + p] = c * akp - s * akq;
+                            a[k * m + q] = s * akp + c * akq;
+                        }
+                        for (size_t k = 0; k < m; ++k) {
+                            double apk = a[p * m + k];
+                            double aqk = a[q * m + k];
+                            a[p * m + k] = c * apk - s * aqk;
+                            a[q * m + k] = s * apk + c * aqk;
+                        }
+                        for (size_t k = 0; k < m; ++k) {
+                            double vkp = v[k * m + p];
+                            double vkq = v[k * m + q];
+                            v[k * m + p] = c * vkp - s * vkq;
+                            v[k * m + q] = s * vkp + c * vkq;
+                        }
+                    }
+                }
+            }
+        }
+
+        /// Check the header and the size of a mapped model file
+        bool valid_factor_file(const mapped_file &file) {
+            const auto *h = mapped_header<factor_model_file_header>(
+                file, factor_file_magic, factor_model::format_version);
+            if (h == nullptr || h->n_factors > h->n_assets ||
+                h->symbols_size > file.size() - sizeof(*h)) {
+                return false;
+            }
+            // The columns are n_assets x (2 + n_factors) + n_factors
+            // doubles. Counts are bounded by the file size before they
+            // are multiplied, so a corrupt header cannot overflow them.
+            uint64_t columns = file.size() - sizeof(*h) - h->symbols_size;
+            if (columns % 8 != 0) {
+                return false;
+            }
+            columns /= 8;
+            if (h->n_assets > columns ||
+                (h->n_assets != 0 &&
+                 2 + h->n_factors > columns / h->n_assets)) {
+                return false;
+            }
+            return h->n_assets * (2 + h->n_factors) + h->n_factors ==
+                   columns;
+        }
+    } // namespace
+
+    factor_model::factor_model(const return_panel &panel,
+                               interval_points interval, int n_periods,
+                               factor_model_options options)
+        : symbols_(std::make_shared<const symbol_table>(panel.assets())),
+          n_factors_(options.n_factors) {
+        size_t last = panel.find(interval);
+        if (last == panel.n_periods()) {
+            throw std::runtime_error(
+                "FACTOR_MODEL constructor error: interval not found.");
+        }
+        if (n_periods < 2 || last + 1 < static_cast<size_t>(n_periods)) {
+            throw std::runtime_error("FACTOR_MODEL constructor error: "
+                                     "n_periods out of market_data.");
+        }
+        const size_t n = panel.n_assets();
+        if (n_factors_ == 0 || n_factors_ > n) {
+            throw std::runtime_error("FACTOR_MODEL constructor error: "
+                                     "n_factors out of [1, n_assets].");
+        }
+        n_periods_ = n_periods;
+        const size_t m = n_periods_;
+        size_t first = last + 1 - m;
+
+        // Centered returns, one row per asset, and their transpose, so
+        // that both products read rows
+        mean_.assign(n, 0.0);
+        std::vector<double> x(n * m, 0.0);
+        std::vector<double> xt(m * n, 0.0);
+        std::vector<double> variance(n, 0.0);
+        for (size_t k = 0; k < n; ++k) {
+            auto returns = panel.returns(k).subspan(first, m);
+            auto mask = panel.mask(k).subspan(first, m);
+            size_t count = 0;
+            double sum = 0.0;
+            for (size_t t = 0; t < m; ++t) {
+                count += mask[t];
+                sum += returns[t];
+            }
+            if (count == 0) {
+                throw std::runtime_error("FACTOR_MODEL constructor error: "
+                                         "no returns in the periods.");
+            }
+            mean_[k] = sum / count;
+            for (size_t t = 0; t < m; ++t) {
+                if (mask[t]) {
+                    x[k * m + t] = returns[t] - mean_[k];
+                    variance[k] += x[k * m + t] * x[k * m + t];
+                }
+            }
+            variance[k] /= m - 1.0;
+        }
+        for (size_t k0 = 0; k0 < n; k0 += transpose_tile) {
+            for (size_t t0 = 0; t0 < m; t0 += transpose_tile) {
+                size_t k1 = std::min(k0 + transpose_tile, n);
+                size_t t1 = std::min(t0 + transpose_tile, m);
+                for (size_t t = t0; t < t1; ++t) {
+                    for (size_t k = k0; k < k1; ++k) {
+                        xt[t * n + k] = x[k * m + t];
+                    }
+                }
+            }
+        }
+
+        // Random subspace, one stream per asset, refined by multiplying
+        // it by the covariance X X' / (m - 1). The width of the subspace
+        // is rounded up to whole column tiles of the products.
+        const size_t l = std::min(
+            (n_factors_ + options.oversampling + column_tile - 1) /
+                column_tile * column_tile,
+            n);
+        std::vector<double> q(n * l);
+        for (size_t k = 0; k < n; ++k) {
+            philox_engine engine(options.seed, k);
+            std::normal_distribution<double> nd;
+            for (size_t c = 0; c < l; ++c) {
+                q[k * l + c] = nd(engine);
+            }
+        }
+        for (size_t it = 0; it <= options.n_power_iterations; ++it) {
+            auto z = product(xt, q, m, n, l, options.n_threads);
+            q = product(x, z, n, m, l, options.n_threads);
+            orthonormalize(q, n, l);
+        }
+
+        // Rayleigh-Ritz: eigenvectors of the covariance projected on the
+        // subspace
+        auto z = product(xt, q, m, n, l, options.n_threads);
+        std::vector<double> b(l * l, 0.0);
+        for (size_t t = 0; t < m; ++t) {
+            const double *zt = z.data() + t * l;
+            for (size_t i = 0; i < l; ++i) {
+                for (size_t j = 0; j < l; ++j) {
+                    b[i * l + j] += zt[i] * zt[j];
+                }
+            }
+        }
+        for (double &bij : b) {
+            bij /= m - 1.0;
+        }
+        std::vector<double> u;
+        jacobi_eigen(b, u, l);
+        std::vector<size_t> order(l);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+            return b[i * l + i] > b[j * l + j];
+        });
+
+        factor_variance_.resize(n_factors_);
+        for (size_t f = 0; f < n_factors_; ++f) {
+            factor_variance_[f] = std::max(b[order[f] * l + order[f]], 0.0);
+        }
+        loadings_.assign(n * n_factors_, 0.0);
+        specific_variance_.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            double explained = 0.0;
+            for (size_t f = 0; f < n_factors_; ++f) {
+                double loading = 0.0;
+                for (size_t c = 0; c < l; ++c) {
+                    loading += q[k * l + c] * u[c * l + order[f]];
+                }
+                loadings_[k * n_factors_ + f] = loading;
+                explained += loading * loading * factor_variance_[f];
+            }
+            specific_variance_[k] = std::max(variance[k] - explained, 0.0);
+        }
+    }
+
+    factor_model::factor_model(const market_data &data,
+                               interval_points interval, int n_periods,
+                               factor_model_options options)
+        : factor_model(data.returns(), interval, n_periods, options) {
+        // The rows of the panel are in the order of the ids
+        symbols_ = data.shared_symbols();
+    }
+
+    double
+    factor_model::portfolio_variance(std::span<const double> weights) const {
+        std::vector<double> e = exposures(weights);
+        double total = 0.0;
+        for (size_t f = 0; f < n_factors_; ++f) {
+            total += factor_variance_[f] * e[f] * e[f];
+        }
+        for (size_t k = 0; k < n_assets(); ++k) {
+            total += specific_variance_[k] * weights[k] * weights[k];
+        }
+        return total;
+    }
+
+    double factor_model::portfolio_risk(std::span<const double> weights) const {
+        return std::sqrt(portfolio_variance(weights));
+    }
+
+    double
+    factor_model::portfolio_return(std::span<const double> weights) const {
+        if (weights.size() != n_assets()) {
+            throw std::runtime_error("FACTOR_MODEL error: one weight is "
+                                     "needed per asset.");
+        }
+        double total = 0.0;
+        for (size_t k = 0; k < n_assets(); ++k) {
+            total += weights[k] * mean_[k];
+        }
+        return total;
+    }
+
+    std::vector<double>
+    factor_model::exposures(std::span<const double> weights) const {
+        if (weights.size() != n_assets()) {
+            throw std::runtime_error("FACTOR_MODEL error: one weight is "
+                                     "needed per asset.");
+        }
+        std::vector<double> e(n_factors_, 0.0);
+        for (size_t k = 0; k < n_assets(); ++k) {
+            const double *lk = loadings_.data() + k * n_factors_;
+            for (size_t f = 0; f < n_factors_; ++f) {
+                e[f] += weights[k] * lk[f];
+            }
+        }
+        return e;
+    }
+
+    double factor_model::covariance(size_t i, size_t j) const {
+        double total = i == j ? specific_variance_[i] : 0.0;
+        for (size_t f = 0; f < n_factors_; ++f) {
+            total += loadings_[i * n_factors_ + f] *
+                     loadings_[j * n_factors_ + f] * factor_variance_[f];
+        }
+        return total;
+    }
+
+    double factor_model::variance(size_t i) const { return covariance(i, i); }
+
+    double factor_model::specific_variance(size_t i) const {
+        return specific_variance_[i];
+    }
+
+    std::pair<double, double>
+    factor_model::evaluate(std::span<const double> weights) const {
+        return std::make_pair(portfolio_risk(weights),
+                              portfolio_return(weights));
+    }
+
+    double factor_model::risk(asset_id id) const {
+        return std::sqrt(variance(id));
+    }
+
+    double factor_model::expected_return(asset_id id) const {
+        return mean_[id];
+    }
+
+    std::span<const double> factor_model::loadings(size_t i) const {
+        return {loadings_.data() + i * n_factors_, n_factors_};
+    }
+
+    double factor_model::factor_variance(size_t f) const {
+        return factor_variance_[f];
+    }
+
+    size_t factor_model::n_assets() const { return symbols_->size(); }
+
+    size_t factor_model::n_factors() const { return n_factors_; }
+
+    size_t factor_model::n_periods() const { return n_periods_; }
+
+    const std::vector<std::string> &factor_model::assets() const {
+        return symbols_->symbols();
+    }
+
+    const symbol_table &factor_model::symbols() const { return *symbols_; }
+
+    double factor_model::explained_variance() const {
+        double explained = 0.0;
+        double total = 0.0;
+        for (size_t k = 0; k < n_assets(); ++k) {
+            total += variance(k);
+            explained += variance(k) - specific_variance_[k];
+        }
+        return total > 0.0 ? explained / total : 0.0;
+    }
+
+    bool factor_model::save(const std::filesystem::path &path) const {
+        std::string symbols;
+        for (const std::string &asset : assets()) {
+            symbols += asset;
+            symbols += '\0';
+        }
+        factor_model_file_header h{};
+        h.preamble = file_preamble::of(factor_file_magic, format_version);
+        h.n_assets = n_assets();
+        h.n_factors = n_factors_;
+        h.n_periods = n_periods_;
+        h.symbols_size = symbols.size();
+
+        const std::array<std::span<const std::byte>, 6> chunks = {
+            std::as_bytes(std::span(&h, 1)),
+            std::as_bytes(std::span(mean_)),
+            std::as_bytes(std::span(specific_variance_)),
+            std::as_bytes(std::span(factor_variance_)),
+            std::as_bytes(std::span(loadings_)),
+            std::as_bytes(std::span(symbols))};
+        return write_file_atomically(path, chunks);
+    }
+
+    bool factor_model::load(const std::filesystem::path &path) {
+        mapped_file file;
+        if (!file.open(path) || !valid_factor_file(file)) {
+            return false;
+        }
+        const auto &h =
+            *reinterpret_cast<const factor_model_file_header *>(file.data());
+        const double *column = reinterpret_cast<const double *>(
+            file.data() + sizeof(factor_model_file_header));
+        auto read = [&column](std::vector<double> &v, size_t size) {
+            v.assign(column, column + size);
+            column += size;
+        };
+        std::vector<std::string> assets;
+        const char *symbols = reinterpret_cast<const char *>(
+            column + h.n_assets * (2 + h.n_factors) + h.n_factors);
+        const char *symbols_end = symbols + h.symbols_size;
+        while (symbols != symbols_end) {
+            const char *end = std::find(symbols, symbols_end, '\0');
+            if (end == symbols_end) {
+                return false;
+            }
+            assets.emplace_back(symbols, end);
+            symbols = end + 1;
+        }
+        // Repeated symbols would share an id
+        auto table = std::make_shared<const symbol_table>(assets);
+        if (table->size() != h.n_assets) {
+            return false;
+        }
+        symbols_ = std::move(table);
+        n_factors_ = h.n_factors;
+        n_periods_ = h.n_periods;
+        read(mean_, h.n_assets);
+        read(specific_variance_, h.n_assets);
+        read(factor_variance_, h.n_factors);
+        read(loadings_, h.n_assets * h.n_factors);
+        return true;
+    }
+} // namespace portfolio
@@ -0,0 +1,163 @@
+#ifndef PORTFOLIO_FACTOR_MODEL_H
+#define PORTFOLIO_FACTOR_MODEL_H
+
+#include "market_data.h"
+#include "portfolio/common/mapped_file.h"
+#include "portfolio/core/return_panel.h"
+#include "risk_model.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    /// \brief Options of the factor_model fit.
+    struct factor_model_options {
+        /// \brief Number of principal factors.
+        size_t n_factors{10};
+        /// \brief Extra directions of the random subspace, which improve
+        /// the accuracy of the last factors.
+        size_t oversampling{10};
+        /// \brief Subspace iterations, which separate factors with close
+        /// variances.
+        size_t n_power_iterations{2};
+        /// \brief Seed of the random subspace. The fit is the same for any
+        /// number of threads.
+        uint64_t seed{0};
+        /// \brief Number of threads. 0 uses one thread per hardware thread.
+        size_t n_threads{1};
+    };
+
+    /// \brief Fixed header at the beginning of a factor model file.
+    ///
+    /// The header is followed by the mean and specific variance columns
+    /// of the assets, the variance of each factor, the row-major
+    /// n_assets x n_factors matrix of loadings (all double), and the
+    /// symbols of the assets, each followed by a null character.
+    struct factor_model_file_header {
+        file_preamble preamble;
+        uint64_t n_assets;
+        uint64_t n_factors;
+        uint64_t n_periods;
+        uint64_t symbols_size;
+        uint8_t reserved[16];
+    };
+    static_assert(sizeof(factor_model_file_header) == 64);
+
+    /// \brief Statistical factor model of the asset returns over a window.
+    ///
+    /// The covariance matrix is approximated as L F L' + D, where the
+    /// columns of L are its k principal eigenvectors, F holds their
+    /// eigenvalues and D is the variance of each asset not explained by
+    /// the factors. The eigenvectors are found by randomized subspace
+    /// iteration, which only multiplies the centered returns by thin
+    /// matrices, so the n x n covariance is never formed. Fitting costs
+    /// O(n T k) and a portfolio variance costs O(n k).
+    ///
+    /// Masked returns count as no deviation. As a risk_model, the risk is
+    /// the standard deviation.
+    class factor_model : public risk_model {
+      public /* constructors */:
+        /// \brief Empty model, to be loaded from a file
+        factor_model() = default;
+
+        /// \brief Constructor of factor_model
+        /// \param panel Returns of the assets.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \param options Number of factors and accuracy of the fit.
+        factor_model(const return_panel &panel, interval_points interval,
+                     int n_periods, factor_model_options options = {});
+
+        /// \brief Constructor of factor_model
+        /// \param data Market data whose return panel is used.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \param options Number of factors and accuracy of the fit.
+        factor_model(const market_data &data, interval_points interval,
+                     int n_periods, factor_model_options options = {});
+
+      public /* portfolios */:
+        /// \brief Variance of the returns of a portfolio, as the variance
+        /// of its factor exposures plus its specific variance.
+        /// \param weights Weight of each asset, in the order of the panel.
+        [[nodiscard]] double
+        portfolio_variance(std::span<const double> weights) const;
+
+        /// \brief Standard deviation of the returns of a portfolio.
+        [[nodiscard]] double
+        portfolio_risk(std::span<const double> weights) const;
+
+        /// \brief Mean return of a portfolio.
+        [[nodiscard]] double
+        portfolio_return(std::span<const double> weights) const;
+
+        /// \brief Exposure of a portfolio to each factor.
+        [[nodiscard]] std::vector<double>
+        exposures(std::span<const double> weights) const;
+
+        /// \brief Standard deviation and mean return of a portfolio.
+        [[nodiscard]] std::pair<double, double>
+        evaluate(std::span<const double> weights) const override;
+
+      public /* assets */:
+        /// \brief Covariance of two assets implied by the model.
+        [[nodiscard]] double covariance(size_t i, size_t j) const;
+
+        /// \brief Variance of an asset implied by the model.
+        [[nodiscard]] double variance(size_t i) const;
+
+        /// \brief Variance of an asset not explained by the factors.
+        [[nodiscard]] double specific_variance(size_t i) const;
+
+        /// \brief Standard deviation of an asset implied by the model.
+        [[nodiscard]] double risk(asset_id id) const override;
+
+        /// \brief Mean return of an asset in the window.
+        [[nodiscard]] double expected_return(asset_id id) const override;
+
+        /// \brief Loadings of an asset on each factor.
+        [[nodiscard]] std::span<const double> loadings(size_t i) const;
+
+        /// \brief Variance of a factor, by decreasing variance.
+        [[nodiscard]] double factor_variance(size_t f) const;
+
+      public /* getters */:
+        [[nodiscard]] size_t n_assets() const override;
+        [[nodiscard]] size_t n_factors() const;
+        [[nodiscard]] size_t n_periods() const;
+        [[nodiscard]] const std::vector<std::string> &assets() const;
+        [[nodiscard]] const symbol_table &symbols() const override;
+
+        /// \brief Share of the total variance explained by the factors.
+        [[nodiscard]] double explained_variance() const;
+
+      public /* files */:
+        /// \brief Current version of the file format.
+        static constexpr uint32_t format_version = 1;
+
+        /// \brief Write the model to a file with write_file_atomically.
+        /// \return True if not occurs errors or false otherwise.
+        bool save(const std::filesystem::path &path) const;
+
+        /// \brief Replace the model with the one in a file.
+        /// \return True if the file is a valid model or false otherwise.
+        bool load(const std::filesystem::path &path);
+
+      private:
+        /// \brief Shared with the market data the model was fit to.
+        std::shared_ptr<const symbol_table> symbols_{
+            std::make_shared<const symbol_table>()};
+        size_t n_factors_{0};
+        size_t n_periods_{0};
+        std::vector<double> mean_;
+        std::vector<double> specific_variance_;
+        std::vector<double> factor_variance_;
+        /// \brief Row-major n_assets x n_factors matrix.
+        std::vector<double> loadings_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_FACTOR_MODEL_H
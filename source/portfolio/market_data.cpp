@@ -4,31 +4,69 @@
 
 #include "market_data.h"
 
+#include "portfolio/common/parallel.h"
 #include "portfolio/data_feed/alphavantage_data_feed.h"
+#include <algorithm>
+#include <optional>
 #include <ranges>
 #include <utility>
 namespace portfolio {
 
     market_data::market_data(const std::vector<std::string> &asset_list,
                              data_feed &df, minute_point start_period,
-                             minute_point end_period, timeframe tf)
-        : data_feed_(df) {
-        for (auto &str : asset_list) {
-            data_feed_result data =
-                data_feed_.fetch(str, start_period, end_period, tf);
-            assets_map_.emplace(str, std::move(data));
+                             minute_point end_period, timeframe tf,
+                             size_t n_threads, missing_bar_policy policy)
+        : data_feed_(df), risk_models_(std::make_unique<risk_model_cache>()) {
+        // Ids follow the order of the symbols. Each asset is fetched once,
+        // into the slot of its id, so the data does not depend on the order
+        // the workers finish.
+        std::vector<std::string> assets;
+        for (const auto &str : asset_list) {
+            if (std::find(assets.begin(), assets.end(), str) == assets.end()) {
+                assets.emplace_back(str);
+            }
         }
+        std::vector<std::string> sorted = assets;
+        std::sort(sorted.begin(), sorted.end());
+        auto symbols = std::make_shared<symbol_table>(sorted);
+        std::vector<std::optional<data_feed_result>> results(assets.size());
+        parallel_for(assets.size(), n_threads, [&](size_t i) {
+            results[symbols->find(assets[i])].emplace(
+                data_feed_.fetch(assets[i], start_period, end_period, tf));
+        });
+        std::vector<price_view> series;
+        for (asset_id id = 0; id < symbols->size(); ++id) {
+            assets_.emplace_back(symbols->symbol(id), std::move(*results[id]));
+            series.emplace_back(assets_.back().second.series());
+        }
+        returns_ = return_panel(sorted, series, policy);
+        symbols_ = std::move(symbols);
     }
-    std::map<std::string, portfolio::data_feed_result>::const_iterator
-    market_data::assets_map_begin() const {
-        return assets_map_.cbegin();
+    market_data::asset_iterator market_data::assets_map_begin() const {
+        return assets_.cbegin();
     }
-    std::map<std::string, portfolio::data_feed_result>::const_iterator
-    market_data::assets_map_end() const {
-        return assets_map_.cend();
+    market_data::asset_iterator market_data::assets_map_end() const {
+        return assets_.cend();
     }
     bool market_data::contains(std::string_view asset) const {
-        return assets_map_.find(std::string(asset)) != assets_map_.end();
+        return symbols_->contains(asset);
+    }
+    size_t market_data::n_assets() const { return assets_.size(); }
+    const symbol_table &market_data::symbols() const { return *symbols_; }
+    const std::shared_ptr<const symbol_table> &
+    market_data::shared_symbols() const {
+        return symbols_;
+    }
+    const data_feed_result &market_data::asset(asset_id id) const {
+        return assets_[id].second;
+    }
+    const return_panel &market_data::returns() const { return returns_; }
+    std::shared_ptr<const portfolio_mad>
+    market_data::mad(interval_points interval, int n_periods) const {
+        return risk_models_->mad(*this, interval, n_periods);
+    }
+    risk_model_cache &market_data::risk_models() const {
+        return *risk_models_;
     }
 
 } // namespace portfolio
\ No newline at end of file
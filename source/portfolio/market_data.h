@@ -4,28 +4,82 @@
 
 #ifndef PORTFOLIO_MARKET_DATA_H
 #define PORTFOLIO_MARKET_DATA_H
+#include "portfolio/core/return_panel.h"
+#include "portfolio/core/symbol_table.h"
 #include "portfolio/data_feed/data_feed.h"
 #include "portfolio/data_feed/data_feed_result.h"
-#include <map>
+#include "portfolio/risk_model_cache.h"
+#include <memory>
 #include <string_view>
+#include <utility>
 #include <vector>
 namespace portfolio {
     class market_data {
       public:
+        using asset_iterator = std::vector<
+            std::pair<std::string, data_feed_result>>::const_iterator;
+
+      public /* constructors */:
+        /// \brief Constructor of market_data
+        /// \param asset_list Symbols of the assets.
+        /// \param df Data feed used to fetch the assets.
+        /// \param start_period Initial minute_point.
+        /// \param end_period Final minute_point.
+        /// \param tf Timeframe of the data.
+        /// \param n_threads Number of assets fetched in parallel. 0 uses one
+        /// thread per hardware thread. The data is the same for any number of
+        /// threads.
+        /// \param policy How the return panel treats the bars some assets
+        /// do not have.
         market_data(const std::vector<std::string> &asset_list, data_feed &df,
                     minute_point start_period, minute_point end_period,
-                    timeframe tf);
-        [[nodiscard]] std::map<std::string,
-                               portfolio::data_feed_result>::const_iterator
-        assets_map_begin() const;
-        [[nodiscard]] std::map<std::string,
-                               portfolio::data_feed_result>::const_iterator
-        assets_map_end() const;
+                    timeframe tf, size_t n_threads = 1,
+                    missing_bar_policy policy = missing_bar_policy::drop);
+
+      public /* getters */:
+        /// \brief Iterators over the (symbol, data) pairs of the assets,
+        /// sorted by symbol, which is also the order of the asset ids.
+        [[nodiscard]] asset_iterator assets_map_begin() const;
+        [[nodiscard]] asset_iterator assets_map_end() const;
+
+        /// \brief Check if the market data has an asset.
         [[nodiscard]] bool contains(std::string_view asset) const;
 
+        /// \brief Number of assets.
+        [[nodiscard]] size_t n_assets() const;
+
+        /// \brief Ids of the assets. Vectors of data about the assets, such
+        /// as the rows of the return panel, are indexed by these ids.
+        [[nodiscard]] const symbol_table &symbols() const;
+
+        /// \brief Ids of the assets, to be shared with other objects.
+        [[nodiscard]] const std::shared_ptr<const symbol_table> &
+        shared_symbols() const;
+
+        /// \brief Data of an asset.
+        [[nodiscard]] const data_feed_result &asset(asset_id id) const;
+
+        /// \brief Returns of all assets on a common calendar.
+        /// \return Panel with one row per asset id.
+        [[nodiscard]] const return_panel &returns() const;
+
+        /// \brief Get the MAD model of a window from the risk model cache.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \return Model shared by all portfolios on this market data.
+        [[nodiscard]] std::shared_ptr<const portfolio_mad>
+        mad(interval_points interval, int n_periods) const;
+
+        /// \brief Cache of the risk models computed from this market data.
+        [[nodiscard]] risk_model_cache &risk_models() const;
+
       private:
-        std::map<std::string, portfolio::data_feed_result> assets_map_;
+        /// \brief Symbol and data of each asset, indexed by id.
+        std::vector<std::pair<std::string, data_feed_result>> assets_;
+        std::shared_ptr<const symbol_table> symbols_;
         data_feed &data_feed_;
+        return_panel returns_;
+        std::unique_ptr<risk_model_cache> risk_models_;
     };
 } // namespace portfolio
 
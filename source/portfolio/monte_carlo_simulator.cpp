@@ -0,0 +1,307 @@
+#include "monte_carlo_simulator.h"
+#include "portfolio/common/parallel.h"
+#include "portfolio/common/philox.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        /// Scenarios whose shocks are reused by each portfolio
+        constexpr size_t scenario_tile = 16;
+        /// Portfolios projected or summarized by each task
+        constexpr size_t portfolios_per_task = 16;
+        /// Returns held in memory at once, which bounds the number of
+        /// portfolios simulated together
+        constexpr size_t returns_per_chunk = size_t(1) << 22;
+        /// Variance left by the other assets, relative to the variance of
+        /// an asset, below which the asset gets no shock of its own
+        constexpr double cholesky_tolerance = 1e-12;
+
+        /// Fill a buffer of even size with standard normals of a stream.
+        /// The counters of the stream are mapped to uniforms in one pass
+        /// and transformed by Box-Muller in another, so that both loops
+        /// are free of dependencies between iterations.
+        void fill_normals(uint64_t seed, uint64_t stream,
+                          std::vector<double> &normals) {
+            const std::array<uint32_t, 2> key = {
+                static_cast<uint32_t>(seed),
+                static_cast<uint32_t>(seed >> 32)};
+            const size_t n_pairs = normals.size() / 2;
+            for (size_t i = 0; i < n_pairs; ++i) {
+                auto bits = philox_engine::block(key, i, stream);
+                uint64_t a = (uint64_t(bits[0]) << 32) | bits[1];
+                uint64_t b = (uint64_t(bits[2]) << 32) | bits[3];
+                // The first uniform is in (0, 1], so its log is finite
+                normals[2 * i] = 1.0 - static_cast<double>(a >> 11) * 0x1.0p-53;
+                normals[2 * i + 1] = static_cast<double>(b >> 11) * 0x1.0p-53;
+            }
+            for (size_t i = 0; i < n_pairs; ++i) {
+                double r = std::sqrt(-2.0 * std::log(normals[2 * i]));
+                double theta = 2.0 * std::numbers::pi * normals[2 * i + 1];
+                normals[2 * i] = r * std::cos(theta);
+                normals[2 * i + 1] = r * std::sin(theta);
+            }
+        }
+
+        /// Stream of the specific shocks of a portfolio in a block of
+        /// scenarios. The streams of the common shocks are the blocks,
+        /// whose indices are below 2^32.
+        uint64_t specific_stream(size_t block, size_t portfolio) {
+            return (static_cast<uint64_t>(portfolio + 1) << 32) | block;
+        }
+    } // namespace
+
+    size_t tail_risk::size() const { return expected_return.size(); }
+
+    monte_carlo_simulator::monte_carlo_simulator(
+        const covariance_matrix &covariance, monte_carlo_options options)
+        : options_(options), n_assets_(covariance.n_assets()),
+          n_shocks_(n_assets_), triangular_(true) {
+        validate_options();
+        mean_.resize(n_assets_);
+        for (size_t i = 0; i < n_assets_; ++i) {
+            mean_[i] = covariance.mean(i);
+        }
+        // Lower Cholesky factor, row by row, so the dot products read
+        // contiguous rows. Covariances may be only semidefinite, so
+        // assets with no variance left get a zero column.
+        const size_t n = n_assets_;
+        loadings_.assign(n * n, 0.0);
+        for (size_t i = 0; i < n; ++i) {
+            double *li = loadings_.data() + i * n;
+            auto ci = covariance.row(i);
+            for (size_t j = 0; j <= i; ++j) {
+                const double *lj = loadings_.data() + j * n;
+                double s = ci[j];
+                for (size_t k = 0; k < j; ++k) {
+                    s -= li[k] * lj[k];
+                }
+                if (j < i) {
+                    li[j] = lj[j] > 0.0 ? s / lj[j] : 0.0;
+                } else {
+                    li[i] = s > cholesky_tolerance * ci[i] ? std::sqrt(s)
+                                                            : 0.0;
+                }
+            }
+        }
+    }
+
+    monte_carlo_simulator::monte_carlo_simulator(const factor_model &model,
+                                                 monte_carlo_options options)
+        : options_(options), n_assets_(model.n_assets()),
+          n_shocks_(model.n_factors()) {
+        validate_options();
+        mean_.resize(n_assets_);
+        specific_.resize(n_assets_);
+        loadings_.resize(n_assets_ * n_shocks_);
+        std::vector<double> deviation(n_shocks_);
+        for (size_t f = 0; f < n_shocks_; ++f) {
+            deviation[f] = std::sqrt(model.factor_variance(f));
+        }
+        for (size_t i = 0; i < n_assets_; ++i) {
+            mean_[i] = model.expected_return(i);
+            specific_[i] = std::sqrt(model.specific_variance(i));
+            auto loadings = model.loadings(i);
+            for (size_t f = 0; f < n_shocks_; ++f) {
+                loadings_[i * n_shocks_ + f] = loadings[f] * deviation[f];
+            }
+        }
+    }
+
+    monte_carlo_simulator::monte_carlo_simulator(const market_data &data,
+                                                 interval_points interval,
+                                                 int n_periods,
+                                                 monte_carlo_options options)
+        : monte_carlo_simulator(
+              covariance_matrix(
+                  data, interval, n_periods,
+                  {.shrinkage = shrinkage_method::ledoit_wolf,
+                   .n_threads = options.n_threads}),
+              options) {}
+
+    tail_risk monte_carlo_simulator::simulate(std::span<const double> weights,
+                                              double confidence) const {
+        if (n_assets_ == 0 || weights.size() % n_assets_ != 0) {
+            throw std::runtime_error("MONTE_CARLO_SIMULATOR simulate error: "
+                                     "one weight is needed per asset.");
+        }
+        if (!(confidence > 0.0 && confidence < 1.0)) {
+            throw std::runtime_error("MONTE_CARLO_SIMULATOR simulate error: "
+                                     "confidence out of (0, 1).");
+        }
+        const size_t n_portfolios = weights.size() / n_assets_;
+        const size_t q = n_shocks_;
+        const bool specific = !specific_.empty();
+        size_t n_portfolio_tasks =
+            (n_portfolios + portfolios_per_task - 1) / portfolios_per_task;
+
+        // Mean, exposures to the shocks and specific deviation of each
+        // portfolio
+        std::vector<double> mean(n_portfolios, 0.0);
+        std::vector<double> exposures(n_portfolios * q, 0.0);
+        std::vector<double> deviation(n_portfolios, 0.0);
+        parallel_for(n_portfolio_tasks, options_.n_threads, [&](size_t task) {
+            size_t first = task * portfolios_per_task;
+            size_t last = std::min(first + portfolios_per_task, n_portfolios);
+            for (size_t p = first; p < last; ++p) {
+                const double *w = weights.data() + p * n_assets_;
+                double *e = exposures.data() + p * q;
+                double variance = 0.0;
+                for (size_t i = 0; i < n_assets_; ++i) {
+                    if (w[i] == 0.0) {
+                        continue;
+                    }
+                    mean[p] += w[i] * mean_[i];
+                    const double *a = loadings_.data() + i * q;
+                    size_t length = triangular_ ? i + 1 : q;
+                    for (size_t c = 0; c < length; ++c) {
+                        e[c] += w[i] * a[c];
+                    }
+                    if (specific) {
+                        variance += w[i] * w[i] * specific_[i] * specific_[i];
+                    }
+                }
+                deviation[p] = std::sqrt(variance);
+            }
+        });
+
+        tail_risk result;
+        result.confidence = confidence;
+        result.expected_return.resize(n_portfolios);
+        result.volatility.resize(n_portfolios);
+        result.value_at_risk.resize(n_portfolios);
+        result.conditional_value_at_risk.resize(n_portfolios);
+        const size_t n_scenarios = options_.n_scenarios;
+        const size_t block_size = options_.scenarios_per_block;
+        const size_t dof = options_.degrees_of_freedom;
+        const size_t draws = q + dof;
+        const size_t n_blocks = (n_scenarios + block_size - 1) / block_size;
+        // Scenarios in the tail, the 1 - confidence worst ones
+        size_t n_tail = static_cast<size_t>(
+            std::ceil((1.0 - confidence) * n_scenarios - 1e-9));
+        n_tail = std::clamp<size_t>(n_tail, 1, n_scenarios);
+
+        // Portfolios are simulated in chunks whose returns fit in a
+        // bounded buffer, one row per portfolio. Each chunk draws the
+        // same common shocks again, which costs O(q) per scenario while
+        // projecting the chunk on them costs O(q) per portfolio.
+        const size_t chunk_size =
+            std::max<size_t>(returns_per_chunk / n_scenarios, 1);
+        std::vector<double> returns(std::min(chunk_size, n_portfolios) *
+                                    n_scenarios);
+        for (size_t first = 0; first < n_portfolios; first += chunk_size) {
+            const size_t last = std::min(first + chunk_size, n_portfolios);
+
+            // Each block of scenarios draws its common shocks from its
+            // own stream and writes its own columns
+            parallel_for(n_blocks, options_.n_threads, [&](size_t block) {
+                size_t s0 = block * block_size;
+                size_t n = std::min(block_size, n_scenarios - s0);
+                std::vector<double> normals((n * draws + 1) / 2 * 2);
+                fill_normals(options_.seed, block, normals);
+                // Multivariate t returns divide all shocks of a scenario
+                // by the same chi-square draw
+                std::vector<double> scale(n, 1.0);
+                if (dof != 0) {
+                    for (size_t s = 0; s < n; ++s) {
+                        const double *chi = normals.data() + s * draws + q;
+                        double sum = 0.0;
+                        for (size_t k = 0; k < dof; ++k) {
+                            sum += chi[k] * chi[k];
+                        }
+                        scale[s] = std::sqrt((dof - 2.0) / sum);
+                    }
+                }
+                for (size_t t = 0; t < n; t += scenario_tile) {
+                    size_t t_end = std::min(t + scenario_tile, n);
+                    for (size_t p = first; p < last; ++p) {
+                        const double *e = exposures.data() + p * q;
+                        double *r =
+                            returns.data() + (p - first) * n_scenarios + s0;
+                        for (size_t s = t; s < t_end; ++s) {
+                            const double *z = normals.data() + s * draws;
+                            double shock = 0.0;
+                            for (size_t c = 0; c < q; ++c) {
+                                shock += e[c] * z[c];
+                            }
+                            r[s] = shock;
+                        }
+                    }
+                }
+                // The specific shocks of a portfolio have their own
+                // stream, so they do not depend on the other portfolios
+                std::vector<double> specific_normals(specific ? (n + 1) / 2 * 2
+                                                              : 0);
+                for (size_t p = first; p < last; ++p) {
+                    double *r = returns.data() + (p - first) * n_scenarios + s0;
+                    if (specific) {
+                        fill_normals(options_.seed, specific_stream(block, p),
+                                     specific_normals);
+                        for (size_t s = 0; s < n; ++s) {
+                            r[s] += deviation[p] * specific_normals[s];
+                        }
+                    }
+                    for (size_t s = 0; s < n; ++s) {
+                        r[s] = mean[p] + scale[s] * r[s];
+                    }
+                }
+            });
+
+            size_t n_tasks =
+                (last - first + portfolios_per_task - 1) / portfolios_per_task;
+            parallel_for(n_tasks, options_.n_threads, [&](size_t task) {
+                size_t task_first = first + task * portfolios_per_task;
+                size_t task_last =
+                    std::min(task_first + portfolios_per_task, last);
+                for (size_t p = task_first; p < task_last; ++p) {
+                    double *r = returns.data() + (p - first) * n_scenarios;
+                    double sum = 0.0;
+                    for (size_t s = 0; s < n_scenarios; ++s) {
+                        sum += r[s];
+                    }
+                    double average = sum / n_scenarios;
+                    double squares = 0.0;
+                    for (size_t s = 0; s < n_scenarios; ++s) {
+                        squares += (r[s] - average) * (r[s] - average);
+                    }
+                    std::nth_element(r, r + n_tail - 1, r + n_scenarios);
+                    double tail = 0.0;
+                    for (size_t s = 0; s < n_tail; ++s) {
+                        tail += r[s];
+                    }
+                    result.expected_return[p] = average;
+                    result.volatility[p] =
+                        n_scenarios > 1
+                            ? std::sqrt(squares / (n_scenarios - 1.0))
+                            : 0.0;
+                    result.value_at_risk[p] = -r[n_tail - 1];
+                    result.conditional_value_at_risk[p] = -tail / n_tail;
+                }
+            });
+        }
+        return result;
+    }
+
+    size_t monte_carlo_simulator::n_assets() const { return n_assets_; }
+
+    size_t monte_carlo_simulator::n_shocks() const { return n_shocks_; }
+
+    const monte_carlo_options &monte_carlo_simulator::options() const {
+        return options_;
+    }
+
+    void monte_carlo_simulator::validate_options() const {
+        if (options_.n_scenarios == 0 || options_.scenarios_per_block == 0) {
+            throw std::runtime_error("MONTE_CARLO_SIMULATOR constructor "
+                                     "error: no scenarios.");
+        }
+        if (options_.degrees_of_freedom == 1 ||
+            options_.degrees_of_freedom == 2) {
+            throw std::runtime_error("MONTE_CARLO_SIMULATOR constructor "
+                                     "error: a Student t needs more than 2 "
+                                     "degrees of freedom.");
+        }
+    }
+} // namespace portfolio
@@ -0,0 +1,125 @@
+#ifndef PORTFOLIO_MONTE_CARLO_SIMULATOR_H
+#define PORTFOLIO_MONTE_CARLO_SIMULATOR_H
+
+#include "covariance_matrix.h"
+#include "factor_model.h"
+#include "market_data.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Options of the monte_carlo_simulator.
+    struct monte_carlo_options {
+        /// \brief Number of return scenarios of each portfolio.
+        size_t n_scenarios{10000};
+        /// \brief Scenarios drawn from the same random stream. Blocks are
+        /// simulated in parallel.
+        size_t scenarios_per_block{256};
+        /// \brief 0 draws Gaussian returns. Otherwise, returns follow a
+        /// multivariate Student t with these degrees of freedom, which
+        /// must be more than 2, scaled to the same covariance.
+        size_t degrees_of_freedom{0};
+        /// \brief Seed of the scenarios. Results are the same for any
+        /// number of threads.
+        uint64_t seed{0};
+        /// \brief Number of threads. 0 uses one thread per hardware thread.
+        size_t n_threads{1};
+    };
+
+    /// \brief Simulated return distribution of a batch of portfolios.
+    ///
+    /// Losses are negative returns. The value at risk is the loss not
+    /// exceeded with the given confidence, and the conditional value at
+    /// risk is the mean loss of the scenarios beyond it.
+    struct tail_risk {
+        double confidence;
+        std::vector<double> expected_return;
+        std::vector<double> volatility;
+        std::vector<double> value_at_risk;
+        std::vector<double> conditional_value_at_risk;
+
+        /// \brief Number of portfolios.
+        [[nodiscard]] size_t size() const;
+    };
+
+    /// \brief Monte Carlo simulation of portfolio returns with correlated
+    /// asset returns.
+    ///
+    /// Asset returns are the mean plus A z, plus independent specific
+    /// shocks, where z are standard normal shocks. A is the Cholesky
+    /// factor of a covariance matrix or the loadings of a factor model
+    /// scaled by the factor deviations. Portfolios are projected on the
+    /// shocks once, so a scenario of a portfolio costs O(q), where q is
+    /// the number of shocks, plus one draw for its specific shock, whose
+    /// sum over the assets is normal with the same variance. All
+    /// portfolios share the scenarios of z.
+    ///
+    /// Normals are drawn by Box-Muller from philox streams. The shocks z
+    /// of a block of scenarios come from the stream of the block and the
+    /// specific shocks of portfolio p from a stream of the block and p.
+    /// Scenarios of a portfolio thus do not depend on the portfolios
+    /// after it in the batch.
+    class monte_carlo_simulator {
+      public /* constructors */:
+        /// \brief Simulator of the returns of a covariance matrix
+        /// \param covariance Mean and covariance of the asset returns.
+        /// Assets with no variance left by the other assets get no shock.
+        /// \param options Scenarios of the simulation.
+        explicit monte_carlo_simulator(const covariance_matrix &covariance,
+                                       monte_carlo_options options = {});
+
+        /// \brief Simulator of the returns of a factor model
+        /// \param model Mean, factors and specific variance of the asset
+        /// returns. Scenarios cost O(n_factors) per portfolio.
+        /// \param options Scenarios of the simulation.
+        explicit monte_carlo_simulator(const factor_model &model,
+                                       monte_carlo_options options = {});
+
+        /// \brief Simulator of the returns of a window of market data,
+        /// with a Ledoit-Wolf shrunk covariance matrix
+        /// \param data Market data whose return panel is used.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \param options Scenarios of the simulation.
+        monte_carlo_simulator(const market_data &data,
+                              interval_points interval, int n_periods,
+                              monte_carlo_options options = {});
+
+      public /* simulation */:
+        /// \brief Simulate a batch of portfolios.
+        ///
+        /// Portfolios are simulated in chunks, so the returns in memory
+        /// are bounded for any number of portfolios and scenarios.
+        /// \param weights Row-major portfolios x assets matrix of weights.
+        /// \param confidence Confidence of the value at risk, in (0, 1).
+        /// \return Distribution statistics of each portfolio.
+        [[nodiscard]] tail_risk simulate(std::span<const double> weights,
+                                         double confidence = 0.95) const;
+
+      public /* getters */:
+        [[nodiscard]] size_t n_assets() const;
+
+        /// \brief Number of correlated shocks of each scenario.
+        [[nodiscard]] size_t n_shocks() const;
+
+        [[nodiscard]] const monte_carlo_options &options() const;
+
+      private:
+        /// \brief Check the options once the model is set.
+        void validate_options() const;
+
+        monte_carlo_options options_;
+        size_t n_assets_{0};
+        size_t n_shocks_{0};
+        /// \brief Row i only has shocks [0, i].
+        bool triangular_{false};
+        std::vector<double> mean_;
+        /// \brief Row-major n_assets x n_shocks matrix A.
+        std::vector<double> loadings_;
+        /// \brief Deviation of the specific shock of each asset, empty if
+        /// there are none.
+        std::vector<double> specific_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_MONTE_CARLO_SIMULATOR_H
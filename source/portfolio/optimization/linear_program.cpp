@@ -0,0 +1,55 @@
+#include "linear_program.h"
+#include <stdexcept>
+namespace portfolio {
+    linear_program::linear_program(size_t n_rows) : rhs_(n_rows, 0.0) {}
+
+    size_t linear_program::add_column(double cost,
+                                      std::span<const size_t> rows,
+                                      std::span<const double> values) {
+        if (rows.size() != values.size()) {
+            throw std::runtime_error("LINEAR_PROGRAM add_column error: rows "
+                                     "and values do not match.");
+        }
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i] >= rhs_.size()) {
+                throw std::runtime_error("LINEAR_PROGRAM add_column error: "
+                                         "row out of the program.");
+            }
+            if (values[i] != 0.0) {
+                row_index_.push_back(rows[i]);
+                value_.push_back(values[i]);
+            }
+        }
+        cost_.push_back(cost);
+        column_start_.push_back(row_index_.size());
+        return cost_.size() - 1;
+    }
+
+    void linear_program::set_rhs(size_t row, double value) {
+        rhs_[row] = value;
+    }
+
+    size_t linear_program::n_rows() const { return rhs_.size(); }
+
+    size_t linear_program::n_columns() const { return cost_.size(); }
+
+    size_t linear_program::n_nonzeros() const { return value_.size(); }
+
+    double linear_program::cost(size_t column) const { return cost_[column]; }
+
+    double linear_program::rhs(size_t row) const { return rhs_[row]; }
+
+    std::span<const size_t>
+    linear_program::column_rows(size_t column) const {
+        return std::span<const size_t>(row_index_)
+            .subspan(column_start_[column],
+                     column_start_[column + 1] - column_start_[column]);
+    }
+
+    std::span<const double>
+    linear_program::column_values(size_t column) const {
+        return std::span<const double>(value_).subspan(
+            column_start_[column],
+            column_start_[column + 1] - column_start_[column]);
+    }
+} // namespace portfolio
@@ -0,0 +1,55 @@
+#ifndef PORTFOLIO_LINEAR_PROGRAM_H
+#define PORTFOLIO_LINEAR_PROGRAM_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Sparse linear program in standard form.
+    ///
+    /// The program is to minimize c'x subject to Ax = b and x >= 0. The
+    /// columns of A are stored in compressed sparse column format, so a
+    /// column is added with its cost and its nonzero entries.
+    class linear_program {
+      public /* constructors */:
+        /// \brief Constructor of linear_program
+        /// \param n_rows Number of constraints. The right-hand sides start
+        /// at zero.
+        explicit linear_program(size_t n_rows);
+
+      public /* modifiers */:
+        /// \brief Add a variable to the program
+        /// \param cost Cost of the variable in the objective.
+        /// \param rows Constraints where the variable has a coefficient.
+        /// \param values Coefficients of the variable. Zeros are skipped.
+        /// \return Index of the new variable.
+        size_t add_column(double cost, std::span<const size_t> rows,
+                          std::span<const double> values);
+
+        /// \brief Set the right-hand side of a constraint.
+        void set_rhs(size_t row, double value);
+
+      public /* getters */:
+        [[nodiscard]] size_t n_rows() const;
+        [[nodiscard]] size_t n_columns() const;
+        [[nodiscard]] size_t n_nonzeros() const;
+        [[nodiscard]] double cost(size_t column) const;
+        [[nodiscard]] double rhs(size_t row) const;
+
+        /// \brief Constraints of the nonzero entries of a column.
+        [[nodiscard]] std::span<const size_t> column_rows(size_t column) const;
+
+        /// \brief Coefficients of the nonzero entries of a column.
+        [[nodiscard]] std::span<const double>
+        column_values(size_t column) const;
+
+      private:
+        std::vector<double> rhs_;
+        std::vector<double> cost_;
+        std::vector<size_t> column_start_{0};
+        std::vector<size_t> row_index_;
+        std::vector<double> value_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_LINEAR_PROGRAM_H
@@ -0,0 +1,199 @@
+#include "mad_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        /// Linear program of the minimum-MAD portfolio, with a zero target
+        linear_program mad_program(const return_panel &panel,
+                                   interval_points interval, int n_periods,
+                                   std::vector<double> &mean) {
+            size_t last = panel.find(interval);
+            if (last == panel.n_periods()) {
+                throw std::runtime_error(
+                    "MAD_OPTIMIZER constructor error: interval not found.");
+            }
+            if (n_periods < 1 || last + 1 < static_cast<size_t>(n_periods)) {
+                throw std::runtime_error("MAD_OPTIMIZER constructor error: "
+                                         "n_periods out of market_data.");
+            }
+            const size_t n_assets = panel.n_assets();
+            const size_t n = static_cast<size_t>(n_periods);
+            const size_t first = last + 1 - n;
+            const size_t budget_row = n;
+            const size_t target_row = n + 1;
+
+            // Weights have the centered returns of the asset, a 1 in the
+            // budget and the expected return in the target
+            linear_program program(n + 2);
+            mean.assign(n_assets, 0.0);
+            std::vector<size_t> rows;
+            std::vector<double> values;
+            for (size_t k = 0; k < n_assets; ++k) {
+                auto returns = panel.returns(k).subspan(first, n);
+                auto mask = panel.mask(k).subspan(first, n);
+                size_t count = 0;
+                double sum = 0.0;
+                for (size_t t = 0; t < n; ++t) {
+                    count += mask[t];
+                    sum += returns[t];
+                }
+                if (count == 0) {
+                    throw std::runtime_error("MAD_OPTIMIZER constructor "
+                                             "error: no returns in the "
+                                             "periods.");
+                }
+                mean[k] = sum / count;
+                rows.clear();
+                values.clear();
+                for (size_t t = 0; t < n; ++t) {
+                    if (mask[t]) {
+                        rows.push_back(t);
+                        values.push_back(returns[t] - mean[k]);
+                    }
+                }
+                rows.push_back(budget_row);
+                values.push_back(1.0);
+                rows.push_back(target_row);
+                values.push_back(mean[k]);
+                program.add_column(0.0, rows, values);
+            }
+
+            // Positive and negative parts of the centered returns of the
+            // portfolio, which are the only costs
+            for (size_t t = 0; t < n; ++t) {
+                size_t row = t;
+                double minus = -1.0;
+                double plus = 1.0;
+                program.add_column(1.0, {&row, 1}, {&minus, 1});
+                program.add_column(1.0, {&row, 1}, {&plus, 1});
+            }
+
+            // Surplus of the expected return over the target
+            size_t row = target_row;
+            double minus = -1.0;
+            program.add_column(0.0, {&row, 1}, {&minus, 1});
+            program.set_rhs(budget_row, 1.0);
+            return program;
+        }
+    } // namespace
+
+    mad_optimizer::mad_optimizer(const return_panel &panel,
+                                 interval_points interval, int n_periods)
+        : n_assets_(panel.n_assets()),
+          n_periods_(static_cast<size_t>(std::max(n_periods, 0))),
+          solver_(mad_program(panel, interval, n_periods, mean_)) {}
+
+    mad_optimizer::mad_optimizer(const market_data &data,
+                                 interval_points interval, int n_periods)
+        : mad_optimizer(data.returns(), interval, n_periods) {}
+
+    mad_solution mad_optimizer::minimize(double target_return) {
+        solver_.set_rhs(n_periods_ + 1, target_return);
+        lp_status status;
+        std::vector<size_t> basis;
+        if (solver_.status() == lp_status::not_solved &&
+            !(basis = starting_basis(target_return)).empty()) {
+            status = solver_.solve(basis);
+        } else {
+            status = solver_.resolve();
+        }
+        mad_solution solution{{},
+                              std::numeric_limits<double>::quiet_NaN(),
+                              std::numeric_limits<double>::quiet_NaN(),
+                              status,
+                              solver_.iterations()};
+        if (status != lp_status::optimal) {
+            return solution;
+        }
+        std::vector<double> x = solver_.solution();
+        solution.weights.assign(x.begin(), x.begin() + n_assets_);
+        // The costs are the absolute deviations, so the objective is the
+        // sum of the deviations in the window
+        solution.risk = solver_.objective() / n_periods_;
+        solution.expected_return = 0.0;
+        for (size_t k = 0; k < n_assets_; ++k) {
+            solution.expected_return += mean_[k] * solution.weights[k];
+        }
+        return solution;
+    }
+
+    mad_solution mad_optimizer::minimize() {
+        // No portfolio returns less than its worst asset
+        return minimize(*std::min_element(mean_.begin(), mean_.end()));
+    }
+
+    std::vector<mad_solution> mad_optimizer::frontier(size_t n_points) {
+        std::vector<mad_solution> points;
+        if (n_points == 0) {
+            return points;
+        }
+        points.reserve(n_points);
+        points.push_back(minimize());
+        if (points.front().status != lp_status::optimal) {
+            return points;
+        }
+        double lowest = points.front().expected_return;
+        double highest = *std::max_element(mean_.begin(), mean_.end());
+        for (size_t i = 1; i < n_points; ++i) {
+            double step = static_cast<double>(i) /
+                          static_cast<double>(n_points - 1);
+            double target = lowest + (highest - lowest) * step;
+            points.push_back(minimize(target));
+        }
+        return points;
+    }
+
+    std::vector<size_t>
+    mad_optimizer::starting_basis(double target_return) const {
+        const linear_program &program = solver_.program();
+        size_t best = n_assets_;
+        double lowest = std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < n_assets_; ++k) {
+            if (mean_[k] < target_return) {
+                continue;
+            }
+            // The budget and target entries come after the periods
+            auto values = program.column_values(k);
+            double mad = 0.0;
+            for (size_t e = 0; e + 2 < values.size(); ++e) {
+                mad += std::abs(values[e]);
+            }
+            if (mad < lowest) {
+                lowest = mad;
+                best = k;
+            }
+        }
+        if (best == n_assets_) {
+            return {};
+        }
+
+        // The positive or negative part of each period is basic, and the
+        // surplus is the return above the target
+        std::vector<size_t> basis(n_periods_ + 2);
+        for (size_t t = 0; t < n_periods_; ++t) {
+            basis[t] = n_assets_ + 2 * t + 1;
+        }
+        auto rows = program.column_rows(best);
+        auto values = program.column_values(best);
+        for (size_t e = 0; e + 2 < rows.size(); ++e) {
+            if (values[e] > 0.0) {
+                basis[rows[e]] = n_assets_ + 2 * rows[e];
+            }
+        }
+        basis[n_periods_] = best;
+        basis[n_periods_ + 1] = n_assets_ + 2 * n_periods_;
+        return basis;
+    }
+
+    size_t mad_optimizer::n_assets() const { return n_assets_; }
+
+    size_t mad_optimizer::n_periods() const { return n_periods_; }
+
+    double mad_optimizer::asset_return(size_t asset) const {
+        return mean_[asset];
+    }
+
+    const simplex_solver &mad_optimizer::solver() const { return solver_; }
+} // namespace portfolio
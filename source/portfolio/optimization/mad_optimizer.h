@@ -0,0 +1,93 @@
+#ifndef PORTFOLIO_MAD_OPTIMIZER_H
+#define PORTFOLIO_MAD_OPTIMIZER_H
+
+#include "portfolio/core/return_panel.h"
+#include "portfolio/market_data.h"
+#include "portfolio/optimization/simplex_solver.h"
+#include <vector>
+namespace portfolio {
+    /// \brief Minimum-MAD portfolio found by the mad_optimizer.
+    struct mad_solution {
+        /// \brief Weight of each asset. Empty if the target is infeasible.
+        std::vector<double> weights;
+        /// \brief MAD of the returns of the portfolio.
+        double risk;
+        /// \brief Expected return of the portfolio.
+        double expected_return;
+        /// \brief Outcome of the linear program.
+        lp_status status;
+        /// \brief Simplex pivots spent on this portfolio.
+        size_t iterations;
+    };
+
+    /// \brief Exact minimum-MAD long-only portfolios over a returns window.
+    ///
+    /// The MAD of the returns of a portfolio is linear after splitting
+    /// each centered period return into positive and negative parts
+    /// (Konno and Yamazaki, 1991). For T periods and n assets, the program
+    /// has T + 2 constraints and n + 2T + 1 variables:
+    ///
+    ///     min   sum_t (u_t + v_t) / T
+    ///     s.t.  sum_k d_kt w_k - u_t + v_t = 0  for each period t
+    ///           sum_k w_k = 1
+    ///           sum_k mu_k w_k - s = target
+    ///           w, u, v, s >= 0
+    ///
+    /// where d_kt are the centered returns. The risk is the same as
+    /// batch_evaluator with mad_kind::portfolio. The first solve starts
+    /// from the portfolio of a single asset, which avoids the degenerate
+    /// phase 1. Targets only change the right-hand side, so each later
+    /// solve starts the dual simplex from the previous optimal basis.
+    class mad_optimizer {
+      public /* constructors */:
+        /// \brief Constructor of mad_optimizer
+        /// \param panel Returns of the assets.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        mad_optimizer(const return_panel &panel, interval_points interval,
+                      int n_periods);
+
+        /// \brief Constructor of mad_optimizer from the returns of
+        /// market_data
+        mad_optimizer(const market_data &data, interval_points interval,
+                      int n_periods);
+
+      public /* optimization */:
+        /// \brief Portfolio with the lowest MAD among those whose expected
+        /// return is at least the target.
+        mad_solution minimize(double target_return);
+
+        /// \brief Portfolio with the lowest MAD.
+        mad_solution minimize();
+
+        /// \brief Efficient frontier of MAD and expected return
+        /// \param n_points Number of portfolios. Targets are evenly spaced
+        /// from the return of the minimum-MAD portfolio to the highest
+        /// expected return of an asset.
+        /// \return Portfolios by increasing target.
+        std::vector<mad_solution> frontier(size_t n_points);
+
+      public /* getters */:
+        [[nodiscard]] size_t n_assets() const;
+        [[nodiscard]] size_t n_periods() const;
+
+        /// \brief Expected return of an asset in the window.
+        [[nodiscard]] double asset_return(size_t asset) const;
+
+        /// \brief Solver of the linear program.
+        [[nodiscard]] const simplex_solver &solver() const;
+
+      private:
+        /// \brief Feasible basis of the asset with the lowest MAD among
+        /// those that reach the target, or an empty basis if none does
+        [[nodiscard]] std::vector<size_t>
+        starting_basis(double target_return) const;
+
+        size_t n_assets_;
+        size_t n_periods_;
+        std::vector<double> mean_;
+        simplex_solver solver_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_MAD_OPTIMIZER_H
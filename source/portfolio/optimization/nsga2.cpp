@@ -0,0 +1,384 @@
+#include "nsga2.h"
+#include "portfolio/common/parallel.h"
+#include "portfolio/common/philox.h"
+#include "portfolio/portfolio_sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        /// Points per task when counting dominations in parallel
+        constexpr size_t points_per_task = 64;
+        /// Pairs of offspring per task when generating them in parallel
+        constexpr size_t pairs_per_task = 16;
+
+        using clock_type = std::chrono::steady_clock;
+
+        /// Whether a dominates b when minimizing both objectives
+        bool dominates(double a1, double a2, double b1, double b2) {
+            return a1 <= b1 && a2 <= b2 && (a1 < b1 || a2 < b2);
+        }
+
+        /// A population with the rank and crowding distance of each
+        /// portfolio. Objectives are minimized, so f2 is the negated
+        /// expected return.
+        struct population {
+            std::vector<double> weights;
+            std::vector<double> f1;
+            std::vector<double> f2;
+            std::vector<size_t> rank;
+            std::vector<double> crowding;
+        };
+
+        /// Crowded comparison: lower rank first, then larger distance
+        bool crowded_less(const population &p, size_t a, size_t b) {
+            if (p.rank[a] != p.rank[b]) {
+                return p.rank[a] < p.rank[b];
+            }
+            return p.crowding[a] > p.crowding[b];
+        }
+
+        /// Binary tournament on the crowded comparison
+        size_t tournament(const population &p, philox_engine &engine) {
+            size_t n = p.rank.size();
+            auto a = static_cast<size_t>(engine.uniform() * n);
+            auto b = static_cast<size_t>(engine.uniform() * n);
+            return crowded_less(p, b, a) ? b : a;
+        }
+
+        /// Clip the weights to the long-only simplex
+        void normalize(std::span<double> weights) {
+            double total = 0.0;
+            for (double &w : weights) {
+                w = std::max(w, 0.0);
+                total += w;
+            }
+            if (total == 0.0) {
+                std::fill(weights.begin(), weights.end(),
+                          1.0 / static_cast<double>(weights.size()));
+                return;
+            }
+            for (double &w : weights) {
+                w /= total;
+            }
+        }
+
+        /// Perturb each weight with probability p by up to strength
+        void mutate(std::span<double> weights, double p, double strength,
+                    philox_engine &engine) {
+            for (double &w : weights) {
+                if (engine.uniform() < p) {
+                    w += strength * (2.0 * engine.uniform() - 1.0);
+                }
+            }
+        }
+    } // namespace
+
+    double nsga2_generation::evaluations_per_second() const {
+        if (duration.count() == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(evaluations) /
+               std::chrono::duration<double>(duration).count();
+    }
+
+    size_t nsga2_result::size() const { return risk.size(); }
+
+    std::span<const double> nsga2_result::portfolio(size_t i) const {
+        size_t n_assets = weights.size() / size();
+        return std::span<const double>(weights).subspan(i * n_assets,
+                                                        n_assets);
+    }
+
+    nsga2::nsga2(const batch_evaluator &evaluator, nsga2_options options)
+        : evaluator_(evaluator), options_(options) {
+        if (options_.population_size < 2) {
+            throw std::runtime_error("NSGA2 constructor error: the population "
+                                     "needs at least 2 portfolios.");
+        }
+        if (options_.crossover_probability < 0.0 ||
+            options_.crossover_probability > 1.0 ||
+            options_.mutation_probability < 0.0 ||
+            options_.mutation_probability > 1.0) {
+            throw std::runtime_error("NSGA2 constructor error: probabilities "
+                                     "should be in [0, 1].");
+        }
+    }
+
+    nsga2_result nsga2::run() const {
+        const size_t n = options_.population_size;
+        const size_t n_assets = evaluator_.n_assets();
+        const size_t n_threads = options_.n_threads;
+        const double mutation_probability =
+            options_.mutation_probability != 0.0
+                ? options_.mutation_probability
+                : 1.0 / static_cast<double>(std::max<size_t>(n_assets, 1));
+        nsga2_result result;
+        result.generations.reserve(options_.n_generations + 1);
+
+        // Evaluate portfolios into the objectives of a population
+        std::vector<double> risk(2 * n);
+        std::vector<double> expected_return(2 * n);
+        auto evaluate = [&](population &p, size_t first, size_t count) {
+            evaluator_.evaluate(
+                std::span<const double>(p.weights)
+                    .subspan(first * n_assets, count * n_assets),
+                std::span<double>(risk).first(count),
+                std::span<double>(expected_return).first(count),
+                options_.kind, n_threads);
+            for (size_t i = 0; i < count; ++i) {
+                p.f1[first + i] = risk[i];
+                p.f2[first + i] = -expected_return[i];
+            }
+        };
+
+        // Rank and crowding distance of the whole population
+        auto sort_fronts = [&](population &p) {
+            p.rank = non_dominated_sort(p.f1, p.f2, n_threads);
+            size_t n_fronts = *std::max_element(p.rank.begin(), p.rank.end());
+            std::vector<std::vector<size_t>> fronts(n_fronts + 1);
+            for (size_t i = 0; i < p.rank.size(); ++i) {
+                fronts[p.rank[i]].push_back(i);
+            }
+            p.crowding.assign(p.rank.size(), 0.0);
+            for (const auto &front : fronts) {
+                auto distance = crowding_distance(p.f1, p.f2, front);
+                for (size_t i = 0; i < front.size(); ++i) {
+                    p.crowding[front[i]] = distance[i];
+                }
+            }
+            return fronts;
+        };
+
+        // Initial population
+        auto start = clock_type::now();
+        population parents;
+        parents.weights.resize(n * n_assets);
+        parents.f1.resize(n);
+        parents.f2.resize(n);
+        portfolio_sampler(n_assets, options_.seed)
+            .sample(0, parents.weights, n_threads);
+        auto evaluation_start = clock_type::now();
+        evaluate(parents, 0, n);
+        auto evaluation_duration = clock_type::now() - evaluation_start;
+        auto fronts = sort_fronts(parents);
+        result.generations.push_back(
+            {n, fronts.front().size(), clock_type::now() - start,
+             evaluation_duration});
+
+        population combined;
+        const size_t n_pairs = (n + 1) / 2;
+        for (size_t generation = 1; generation <= options_.n_generations;
+             ++generation) {
+            start = clock_type::now();
+
+            // Parents are followed by their offspring
+            combined.weights.resize(2 * n * n_assets);
+            combined.f1.resize(2 * n);
+            combined.f2.resize(2 * n);
+            std::copy(parents.weights.begin(), parents.weights.end(),
+                      combined.weights.begin());
+            std::copy(parents.f1.begin(), parents.f1.end(),
+                      combined.f1.begin());
+            std::copy(parents.f2.begin(), parents.f2.end(),
+                      combined.f2.begin());
+
+            // Streams of the initial population are the portfolio indexes,
+            // so the streams of offspring start at 2^32
+            size_t n_tasks = (n_pairs + pairs_per_task - 1) / pairs_per_task;
+            parallel_for(n_tasks, n_threads, [&](size_t task) {
+                size_t end = std::min((task + 1) * pairs_per_task, n_pairs);
+                std::vector<double> second(n_assets);
+                for (size_t pair = task * pairs_per_task; pair < end; ++pair) {
+                    philox_engine engine(options_.seed,
+                                         uint64_t(generation) << 32 | pair);
+                    auto a = std::span<const double>(parents.weights)
+                                 .subspan(tournament(parents, engine) *
+                                              n_assets,
+                                          n_assets);
+                    auto b = std::span<const double>(parents.weights)
+                                 .subspan(tournament(parents, engine) *
+                                              n_assets,
+                                          n_assets);
+                    auto first = std::span<double>(combined.weights)
+                                     .subspan((n + 2 * pair) * n_assets,
+                                              n_assets);
+                    if (engine.uniform() < options_.crossover_probability) {
+                        // Each weight is a random convex combination of
+                        // the parents
+                        for (size_t k = 0; k < n_assets; ++k) {
+                            double alpha = engine.uniform();
+                            first[k] = alpha * a[k] + (1.0 - alpha) * b[k];
+                            second[k] = (1.0 - alpha) * a[k] + alpha * b[k];
+                        }
+                    } else {
+                        std::copy(a.begin(), a.end(), first.begin());
+                        std::copy(b.begin(), b.end(), second.begin());
+                    }
+                    mutate(first, mutation_probability,
+                           options_.mutation_strength, engine);
+                    normalize(first);
+                    // An odd population drops the last offspring
+                    if (n + 2 * pair + 1 < 2 * n) {
+                        auto last = std::span<double>(combined.weights)
+                                        .subspan((n + 2 * pair + 1) * n_assets,
+                                                 n_assets);
+                        mutate(second, mutation_probability,
+                               options_.mutation_strength, engine);
+                        normalize(second);
+                        std::copy(second.begin(), second.end(), last.begin());
+                    }
+                }
+            });
+            evaluation_start = clock_type::now();
+            evaluate(combined, n, n);
+            evaluation_duration = clock_type::now() - evaluation_start;
+
+            // Elitist survival: whole fronts while they fit, and the least
+            // crowded portfolios of the front that does not
+            fronts = sort_fronts(combined);
+            std::vector<size_t> survivors;
+            survivors.reserve(n);
+            for (auto &front : fronts) {
+                if (survivors.size() + front.size() > n) {
+                    std::stable_sort(front.begin(), front.end(),
+                                     [&](size_t a, size_t b) {
+                                         return combined.crowding[a] >
+                                                combined.crowding[b];
+                                     });
+                    front.resize(n - survivors.size());
+                }
+                survivors.insert(survivors.end(), front.begin(), front.end());
+                if (survivors.size() == n) {
+                    break;
+                }
+            }
+            // Distances are kept from the combined population, as in the
+            // original algorithm
+            size_t front_size = 0;
+            parents.rank.resize(n);
+            parents.crowding.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                size_t s = survivors[i];
+                std::copy_n(combined.weights.begin() + s * n_assets, n_assets,
+                            parents.weights.begin() + i * n_assets);
+                parents.f1[i] = combined.f1[s];
+                parents.f2[i] = combined.f2[s];
+                parents.rank[i] = combined.rank[s];
+                parents.crowding[i] = combined.crowding[s];
+                front_size += combined.rank[s] == 0;
+            }
+            result.generations.push_back({n, front_size,
+                                          clock_type::now() - start,
+                                          evaluation_duration});
+        }
+
+        // First front sorted by risk
+        std::vector<size_t> front;
+        for (size_t i = 0; i < n; ++i) {
+            if (parents.rank[i] == 0) {
+                front.push_back(i);
+            }
+        }
+        std::stable_sort(front.begin(), front.end(), [&](size_t a, size_t b) {
+            if (parents.f1[a] != parents.f1[b]) {
+                return parents.f1[a] < parents.f1[b];
+            }
+            return parents.f2[a] < parents.f2[b];
+        });
+        result.weights.reserve(front.size() * n_assets);
+        result.risk.reserve(front.size());
+        result.expected_return.reserve(front.size());
+        for (size_t i : front) {
+            result.weights.insert(result.weights.end(),
+                                  parents.weights.begin() + i * n_assets,
+                                  parents.weights.begin() +
+                                      (i + 1) * n_assets);
+            result.risk.push_back(parents.f1[i]);
+            result.expected_return.push_back(-parents.f2[i]);
+        }
+        return result;
+    }
+
+    const nsga2_options &nsga2::options() const { return options_; }
+
+    std::vector<size_t> nsga2::non_dominated_sort(std::span<const double> f1,
+                                                  std::span<const double> f2,
+                                                  size_t n_threads) {
+        const size_t n = f1.size();
+        // The dominations of each point are independent of the others
+        std::vector<size_t> dominated_by(n, 0);
+        std::vector<std::vector<size_t>> dominated(n);
+        size_t n_tasks = (n + points_per_task - 1) / points_per_task;
+        parallel_for(n_tasks, n_threads, [&](size_t task) {
+            size_t end = std::min((task + 1) * points_per_task, n);
+            for (size_t i = task * points_per_task; i < end; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    if (dominates(f1[i], f2[i], f1[j], f2[j])) {
+                        dominated[i].push_back(j);
+                    } else if (dominates(f1[j], f2[j], f1[i], f2[i])) {
+                        ++dominated_by[i];
+                    }
+                }
+            }
+        });
+
+        // Peel the fronts
+        std::vector<size_t> rank(n, 0);
+        std::vector<size_t> current;
+        for (size_t i = 0; i < n; ++i) {
+            if (dominated_by[i] == 0) {
+                current.push_back(i);
+            }
+        }
+        std::vector<size_t> next;
+        for (size_t r = 0; !current.empty(); ++r) {
+            next.clear();
+            for (size_t i : current) {
+                rank[i] = r;
+                for (size_t j : dominated[i]) {
+                    if (--dominated_by[j] == 0) {
+                        next.push_back(j);
+                    }
+                }
+            }
+            std::swap(current, next);
+        }
+        return rank;
+    }
+
+    std::vector<double>
+    nsga2::crowding_distance(std::span<const double> f1,
+                             std::span<const double> f2,
+                             std::span<const size_t> front) {
+        const size_t n = front.size();
+        std::vector<double> distance(n, 0.0);
+        if (n <= 2) {
+            std::fill(distance.begin(), distance.end(),
+                      std::numeric_limits<double>::infinity());
+            return distance;
+        }
+        std::vector<size_t> order(n);
+        for (std::span<const double> f : {f1, f2}) {
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return f[front[a]] < f[front[b]];
+            });
+            double lowest = f[front[order.front()]];
+            double highest = f[front[order.back()]];
+            distance[order.front()] = std::numeric_limits<double>::infinity();
+            distance[order.back()] = std::numeric_limits<double>::infinity();
+            if (highest == lowest) {
+                continue;
+            }
+            for (size_t i = 1; i + 1 < n; ++i) {
+                distance[order[i]] +=
+                    (f[front[order[i + 1]]] - f[front[order[i - 1]]]) /
+                    (highest - lowest);
+            }
+        }
+        return distance;
+    }
+} // namespace portfolio
@@ -0,0 +1,118 @@
+#ifndef PORTFOLIO_NSGA2_H
+#define PORTFOLIO_NSGA2_H
+
+#include "portfolio/batch_evaluator.h"
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Parameters of the NSGA-II optimizer.
+    struct nsga2_options {
+        /// \brief Number of portfolios in the population.
+        size_t population_size{100};
+        /// \brief Number of generations after the initial population.
+        size_t n_generations{100};
+        /// \brief Probability of recombining two parents.
+        double crossover_probability{0.9};
+        /// \brief Probability of mutating each weight. 0 uses 1 / n_assets.
+        double mutation_probability{0.0};
+        /// \brief Largest change of a weight in a mutation.
+        double mutation_strength{0.1};
+        /// \brief MAD used as risk measure.
+        mad_kind kind{mad_kind::asset_weighted};
+        /// \brief Seed of the random streams. The result only depends on the
+        /// seed, not on the number of threads.
+        uint64_t seed{0};
+        /// \brief Number of threads. 0 uses one thread per hardware thread.
+        size_t n_threads{1};
+    };
+
+    /// \brief Timing of one generation of the NSGA-II optimizer.
+    struct nsga2_generation {
+        /// \brief Portfolios evaluated in the generation.
+        size_t evaluations;
+        /// \brief Portfolios in the first front of the population.
+        size_t front_size;
+        /// \brief Wall time of the generation.
+        std::chrono::nanoseconds duration;
+        /// \brief Wall time spent evaluating portfolios.
+        std::chrono::nanoseconds evaluation_duration;
+
+        /// \brief Evaluations per second of wall time in the generation.
+        [[nodiscard]] double evaluations_per_second() const;
+    };
+
+    /// \brief Risk/return Pareto front found by the NSGA-II optimizer.
+    struct nsga2_result {
+        /// \brief Row-major front x assets matrix of weights, sorted by
+        /// risk.
+        std::vector<double> weights;
+        /// \brief Risk of each portfolio of the front.
+        std::vector<double> risk;
+        /// \brief Expected return of each portfolio of the front.
+        std::vector<double> expected_return;
+        /// \brief Timing of each generation, starting with the initial
+        /// population.
+        std::vector<nsga2_generation> generations;
+
+        /// \brief Number of portfolios in the front.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Weights of the i-th portfolio of the front.
+        [[nodiscard]] std::span<const double> portfolio(size_t i) const;
+    };
+
+    /// \brief Multi-objective evolutionary optimizer minimizing risk and
+    /// maximizing expected return.
+    ///
+    /// This is the NSGA-II of Deb et al. (2002). Parents are chosen by
+    /// binary tournaments on the rank and the crowding distance, and the
+    /// next population keeps the best fronts of parents and offspring.
+    /// Offspring are generated and evaluated in parallel. Each pair of
+    /// offspring draws from its own Philox stream, so the result is the
+    /// same for any number of threads.
+    class nsga2 {
+      public /* constructors */:
+        /// \brief Constructor of nsga2
+        /// \param evaluator Evaluator of the returns window. It must outlive
+        /// the optimizer.
+        /// \param options Parameters of the optimizer.
+        explicit nsga2(const batch_evaluator &evaluator,
+                       nsga2_options options = {});
+
+      public /* optimization */:
+        /// \brief Evolve a population and return its first front.
+        [[nodiscard]] nsga2_result run() const;
+
+      public /* getters */:
+        [[nodiscard]] const nsga2_options &options() const;
+
+      public /* algorithm steps */:
+        /// \brief Fast non-dominated sorting of points to be minimized.
+        /// \param f1 First objective of each point.
+        /// \param f2 Second objective of each point.
+        /// \param n_threads Number of threads counting the dominations.
+        /// \return Index of the front of each point, starting at 0.
+        static std::vector<size_t>
+        non_dominated_sort(std::span<const double> f1,
+                           std::span<const double> f2, size_t n_threads = 1);
+
+        /// \brief Crowding distance of the points of one front.
+        /// \param f1 First objective of all points.
+        /// \param f2 Second objective of all points.
+        /// \param front Indexes of the points in the front.
+        /// \return Distance of each point of the front, in the same order.
+        /// The boundary points have infinite distance.
+        static std::vector<double>
+        crowding_distance(std::span<const double> f1,
+                          std::span<const double> f2,
+                          std::span<const size_t> front);
+
+      private:
+        const batch_evaluator &evaluator_;
+        nsga2_options options_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_NSGA2_H
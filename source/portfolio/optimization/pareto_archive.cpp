@@ -0,0 +1,311 @@
+#include "pareto_archive.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        constexpr std::string_view pareto_file_magic = "PFPARETO";
+
+        /// Check the header and the size of a mapped front file
+        bool valid_pareto_file(const mapped_file &file) {
+            const auto *h = mapped_header<pareto_file_header>(
+                file, pareto_file_magic, pareto_archive::format_version);
+            if (h == nullptr) {
+                return false;
+            }
+            // Each point has its risk, expected return and weights. The
+            // sizes of a corrupt header might overflow their product.
+            uint64_t available = (file.size() - sizeof(*h)) / 8;
+            return h->n_assets <= available &&
+                   h->size <= available / (2 + h->n_assets);
+        }
+
+        /// The k points closest to a risk and return, for points sorted
+        /// by risk in [first, last) where middle is the first point with
+        /// at least that risk. The risk gap is a lower bound of the
+        /// distance and only grows away from middle, so the search
+        /// expands to the side with the smallest gap and stops when it
+        /// cannot beat the k-th closest point.
+        template <class Iterator, class RiskOf, class ReturnOf>
+        std::vector<Iterator>
+        nearest_points(Iterator first, Iterator middle, Iterator last,
+                       RiskOf risk_of, ReturnOf return_of, double risk,
+                       double expected_return, size_t k) {
+            using candidate = std::pair<double, Iterator>;
+            auto farther = [](const candidate &a, const candidate &b) {
+                return a.first < b.first;
+            };
+            std::vector<candidate> heap;
+            if (k == 0) {
+                return {};
+            }
+            heap.reserve(k);
+            constexpr double infinity = std::numeric_limits<double>::infinity();
+            Iterator left = middle;
+            Iterator right = middle;
+            while (left != first || right != last) {
+                double left_gap =
+                    left != first ? risk - risk_of(std::prev(left)) : infinity;
+                double right_gap =
+                    right != last ? risk_of(right) - risk : infinity;
+                bool go_left = left_gap < right_gap;
+                double gap = go_left ? left_gap : right_gap;
+                if (heap.size() == k && gap * gap >= heap.front().first) {
+                    break;
+                }
+                Iterator it = go_left ? --left : right++;
+                double dr = risk_of(it) - risk;
+                double de = return_of(it) - expected_return;
+                double d = dr * dr + de * de;
+                if (heap.size() < k) {
+                    heap.emplace_back(d, it);
+                    std::push_heap(heap.begin(), heap.end(), farther);
+                } else if (d < heap.front().first) {
+                    std::pop_heap(heap.begin(), heap.end(), farther);
+                    heap.back() = {d, it};
+                    std::push_heap(heap.begin(), heap.end(), farther);
+                }
+            }
+            std::sort_heap(heap.begin(), heap.end(), farther);
+            std::vector<Iterator> result;
+            result.reserve(heap.size());
+            for (const auto &c : heap) {
+                result.push_back(c.second);
+            }
+            return result;
+        }
+    } // namespace
+
+    pareto_archive::pareto_archive(size_t n_assets) : n_assets_(n_assets) {}
+
+    bool pareto_archive::insert(double risk, double expected_return,
+                                std::span<const double> weights) {
+        if (weights.size() != n_assets_) {
+            throw std::runtime_error("PARETO_ARCHIVE insert error: one "
+                                     "weight is needed per asset.");
+        }
+        if (std::isnan(risk) || std::isnan(expected_return) ||
+            dominates(risk, expected_return)) {
+            return false;
+        }
+        // Successors with no more return are dominated
+        auto it = points_.lower_bound(risk);
+        while (it != points_.end() &&
+               it->second.expected_return <= expected_return) {
+            free_slots_.push_back(it->second.slot);
+            it = points_.erase(it);
+        }
+        size_t slot;
+        if (free_slots_.empty()) {
+            slot = points_.size();
+            weights_.resize((slot + 1) * n_assets_);
+        } else {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        }
+        std::copy(weights.begin(), weights.end(),
+                  weights_.begin() + slot * n_assets_);
+        points_.emplace_hint(it, risk, entry{expected_return, slot});
+        return true;
+    }
+
+    void pareto_archive::clear() {
+        points_.clear();
+        weights_.clear();
+        free_slots_.clear();
+    }
+
+    bool pareto_archive::dominates(double risk, double expected_return) const {
+        // The predecessor has the best return up to this risk
+        auto it = points_.upper_bound(risk);
+        if (it == points_.begin()) {
+            return false;
+        }
+        return std::prev(it)->second.expected_return >= expected_return;
+    }
+
+    std::optional<pareto_point>
+    pareto_archive::best_return(double max_risk) const {
+        auto it = points_.upper_bound(max_risk);
+        if (it == points_.begin()) {
+            return std::nullopt;
+        }
+        return point(std::prev(it));
+    }
+
+    std::vector<pareto_point>
+    pareto_archive::nearest(double risk, double expected_return,
+                            size_t k) const {
+        auto closest = nearest_points(
+            points_.begin(), points_.lower_bound(risk), points_.end(),
+            [](tree_type::const_iterator it) { return it->first; },
+            [](tree_type::const_iterator it) {
+                return it->second.expected_return;
+            },
+            risk, expected_return, k);
+        std::vector<pareto_point> result;
+        result.reserve(closest.size());
+        for (auto it : closest) {
+            result.push_back(point(it));
+        }
+        return result;
+    }
+
+    std::vector<pareto_point> pareto_archive::points() const {
+        std::vector<pareto_point> result;
+        result.reserve(points_.size());
+        for (auto it = points_.begin(); it != points_.end(); ++it) {
+            result.push_back(point(it));
+        }
+        return result;
+    }
+
+    size_t pareto_archive::size() const { return points_.size(); }
+
+    bool pareto_archive::empty() const { return points_.empty(); }
+
+    size_t pareto_archive::n_assets() const { return n_assets_; }
+
+    bool pareto_archive::save(const std::filesystem::path &path) const {
+        pareto_file_header h{};
+        h.preamble = file_preamble::of(pareto_file_magic, format_version);
+        h.n_assets = n_assets_;
+        h.size = points_.size();
+
+        std::vector<double> risk;
+        std::vector<double> expected_return;
+        std::vector<double> weights;
+        risk.reserve(points_.size());
+        expected_return.reserve(points_.size());
+        weights.reserve(points_.size() * n_assets_);
+        for (const auto &[r, e] : points_) {
+            risk.push_back(r);
+            expected_return.push_back(e.expected_return);
+            weights.insert(weights.end(),
+                           weights_.begin() + e.slot * n_assets_,
+                           weights_.begin() + (e.slot + 1) * n_assets_);
+        }
+
+        const std::array<std::span<const std::byte>, 4> chunks = {
+            std::as_bytes(std::span(&h, 1)), std::as_bytes(std::span(risk)),
+            std::as_bytes(std::span(expected_return)),
+            std::as_bytes(std::span(weights))};
+        return write_file_atomically(path, chunks);
+    }
+
+    bool pareto_archive::load(const std::filesystem::path &path) {
+        pareto_snapshot snapshot;
+        if (!snapshot.open(path) || snapshot.n_assets() != n_assets_) {
+            return false;
+        }
+        // A front is strictly increasing in both objectives
+        auto risk = snapshot.risk();
+        auto expected_return = snapshot.expected_return();
+        for (size_t i = 1; i < snapshot.size(); ++i) {
+            if (!(risk[i - 1] < risk[i]) ||
+                !(expected_return[i - 1] < expected_return[i])) {
+                return false;
+            }
+        }
+        clear();
+        weights_.reserve(snapshot.size() * n_assets_);
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            pareto_point p = snapshot.point(i);
+            weights_.insert(weights_.end(), p.weights.begin(),
+                            p.weights.end());
+            points_.emplace_hint(points_.end(), p.risk,
+                                 entry{p.expected_return, i});
+        }
+        return true;
+    }
+
+    pareto_point pareto_archive::point(tree_type::const_iterator it) const {
+        return {it->first, it->second.expected_return,
+                std::span<const double>(weights_).subspan(
+                    it->second.slot * n_assets_, n_assets_)};
+    }
+
+    bool pareto_snapshot::open(const std::filesystem::path &path) {
+        if (!file_.open(path)) {
+            return false;
+        }
+        if (!valid_pareto_file(file_)) {
+            file_.close();
+            return false;
+        }
+        return true;
+    }
+
+    void pareto_snapshot::close() { file_.close(); }
+
+    bool pareto_snapshot::is_open() const { return file_.is_open(); }
+
+    std::optional<pareto_point>
+    pareto_snapshot::best_return(double max_risk) const {
+        auto r = risk();
+        size_t i = std::upper_bound(r.begin(), r.end(), max_risk) - r.begin();
+        if (i == 0) {
+            return std::nullopt;
+        }
+        return point(i - 1);
+    }
+
+    std::vector<pareto_point>
+    pareto_snapshot::nearest(double risk, double expected_return,
+                             size_t k) const {
+        auto r = this->risk();
+        auto e = this->expected_return();
+        const double *first = r.data();
+        const double *last = first + r.size();
+        auto closest = nearest_points(
+            first, std::lower_bound(first, last, risk), last,
+            [](const double *it) { return *it; },
+            [&](const double *it) { return e[it - first]; }, risk,
+            expected_return, k);
+        std::vector<pareto_point> result;
+        result.reserve(closest.size());
+        for (const double *it : closest) {
+            result.push_back(point(it - first));
+        }
+        return result;
+    }
+
+    pareto_point pareto_snapshot::point(size_t i) const {
+        const std::byte *weights = file_.data() + sizeof(pareto_file_header) +
+                                   (2 * size() + i * n_assets()) * 8;
+        return {risk()[i], expected_return()[i],
+                {reinterpret_cast<const double *>(weights), n_assets()}};
+    }
+
+    size_t pareto_snapshot::size() const {
+        return is_open() ? header().size : 0;
+    }
+
+    size_t pareto_snapshot::n_assets() const {
+        return is_open() ? header().n_assets : 0;
+    }
+
+    std::span<const double> pareto_snapshot::risk() const {
+        if (!is_open()) {
+            return {};
+        }
+        const std::byte *column = file_.data() + sizeof(pareto_file_header);
+        return {reinterpret_cast<const double *>(column), size()};
+    }
+
+    std::span<const double> pareto_snapshot::expected_return() const {
+        if (!is_open()) {
+            return {};
+        }
+        const std::byte *column =
+            file_.data() + sizeof(pareto_file_header) + size() * 8;
+        return {reinterpret_cast<const double *>(column), size()};
+    }
+
+    const pareto_file_header &pareto_snapshot::header() const {
+        return *reinterpret_cast<const pareto_file_header *>(file_.data());
+    }
+} // namespace portfolio
@@ -0,0 +1,165 @@
+#ifndef PORTFOLIO_PARETO_ARCHIVE_H
+#define PORTFOLIO_PARETO_ARCHIVE_H
+
+#include "portfolio/common/mapped_file.h"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Portfolio of a risk/return Pareto front.
+    struct pareto_point {
+        double risk;
+        double expected_return;
+        /// \brief Weights of the portfolio, valid until the archive
+        /// changes or the snapshot is closed.
+        std::span<const double> weights;
+    };
+
+    /// \brief Fixed header at the beginning of a Pareto front file.
+    ///
+    /// The header is followed by the risk and expected return columns
+    /// (double) of `size` points sorted by risk, and by the row-major
+    /// `size` x `n_assets` matrix of weights.
+    struct pareto_file_header {
+        file_preamble preamble;
+        uint64_t n_assets;
+        uint64_t size;
+        uint8_t reserved[32];
+    };
+    static_assert(sizeof(pareto_file_header) == 64);
+
+    /// \brief Non-dominated set of portfolios minimizing risk and
+    /// maximizing expected return.
+    ///
+    /// Points are kept in a tree ordered by risk. On a two-objective front,
+    /// the expected return increases with the risk, so a new point is
+    /// dominated only if its predecessor has at least its return, and the
+    /// points it dominates are its successors with at most its return.
+    /// Insertion is O(log n) amortized, since each point is pruned once.
+    class pareto_archive {
+      public /* constructors */:
+        /// \brief Constructor of pareto_archive
+        /// \param n_assets Number of weights of each portfolio.
+        explicit pareto_archive(size_t n_assets);
+
+      public /* modifiers */:
+        /// \brief Insert a portfolio unless another one dominates it
+        /// \param risk Risk of the portfolio.
+        /// \param expected_return Expected return of the portfolio.
+        /// \param weights Weights of the portfolio.
+        /// \return True if the portfolio is in the front or false if it is
+        /// dominated by or equal to a point of the front.
+        bool insert(double risk, double expected_return,
+                    std::span<const double> weights);
+
+        /// \brief Remove all points.
+        void clear();
+
+      public /* queries */:
+        /// \brief Check if a point of the front dominates or equals a risk
+        /// and return.
+        [[nodiscard]] bool dominates(double risk,
+                                     double expected_return) const;
+
+        /// \brief Point with the highest return among those with at most a
+        /// risk.
+        [[nodiscard]] std::optional<pareto_point>
+        best_return(double max_risk) const;
+
+        /// \brief The k points of the front closest to a risk and return.
+        /// \return Points by increasing Euclidean distance.
+        [[nodiscard]] std::vector<pareto_point>
+        nearest(double risk, double expected_return, size_t k) const;
+
+        /// \brief All points sorted by risk.
+        [[nodiscard]] std::vector<pareto_point> points() const;
+
+      public /* getters */:
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] bool empty() const;
+        [[nodiscard]] size_t n_assets() const;
+
+      public /* snapshots */:
+        /// \brief Current version of the file format.
+        static constexpr uint32_t format_version = 1;
+
+        /// \brief Write the front to a file with write_file_atomically.
+        /// \return True if not occurs errors or false otherwise.
+        bool save(const std::filesystem::path &path) const;
+
+        /// \brief Replace the front with the points of a file.
+        /// \return True if the file is a valid front of portfolios with
+        /// the same number of assets or false otherwise.
+        bool load(const std::filesystem::path &path);
+
+      private:
+        struct entry {
+            double expected_return;
+            size_t slot;
+        };
+        using tree_type = std::map<double, entry>;
+
+        [[nodiscard]] pareto_point
+        point(tree_type::const_iterator it) const;
+
+        size_t n_assets_;
+        tree_type points_;
+        /// Weights of all points, n_assets per slot
+        std::vector<double> weights_;
+        /// Slots of pruned points
+        std::vector<size_t> free_slots_;
+    };
+
+    /// \brief Pareto front file opened with mmap.
+    ///
+    /// Queries binary search the sorted columns of the file, so they
+    /// touch a few pages and do not load the front. A snapshot with no
+    /// open file has an empty front.
+    class pareto_snapshot {
+      public /* constructors */:
+        pareto_snapshot() = default;
+
+      public /* reading */:
+        /// \brief Map a front file into memory.
+        /// \return True if the file exists and has a valid header or false
+        /// otherwise.
+        bool open(const std::filesystem::path &path);
+
+        /// \brief Unmap the file.
+        void close();
+
+        /// \brief Check if a valid file is open.
+        [[nodiscard]] bool is_open() const;
+
+      public /* queries */:
+        /// \brief Point with the highest return among those with at most a
+        /// risk.
+        [[nodiscard]] std::optional<pareto_point>
+        best_return(double max_risk) const;
+
+        /// \brief The k points of the front closest to a risk and return.
+        /// \return Points by increasing Euclidean distance.
+        [[nodiscard]] std::vector<pareto_point>
+        nearest(double risk, double expected_return, size_t k) const;
+
+        /// \brief Point i of the front sorted by risk.
+        /// \param i Index of the point, less than size().
+        [[nodiscard]] pareto_point point(size_t i) const;
+
+      public /* getters */:
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] size_t n_assets() const;
+        [[nodiscard]] std::span<const double> risk() const;
+        [[nodiscard]] std::span<const double> expected_return() const;
+
+      private:
+        [[nodiscard]] const pareto_file_header &header() const;
+
+        mapped_file file_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_PARETO_ARCHIVE_H
@@ -0,0 +1,468 @@
+#include "simplex_solver.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        constexpr size_t npos = static_cast<size_t>(-1);
+        /// Largest violation of a bound considered feasible
+        constexpr double primal_tolerance = 1e-9;
+        /// Largest negative reduced cost considered optimal
+        constexpr double dual_tolerance = 1e-9;
+        /// Smallest pivot element
+        constexpr double pivot_tolerance = 1e-9;
+        /// Most pivots between refactorizations of the basis
+        constexpr size_t refactor_interval = 100;
+        /// Consecutive degenerate pivots before Bland's rule prevents
+        /// cycling
+        constexpr size_t degenerate_limit = 50;
+    } // namespace
+
+    simplex_solver::simplex_solver(linear_program program,
+                                   size_t max_iterations)
+        : program_(std::move(program)), max_iterations_(max_iterations),
+          n_rows_(program_.n_rows()), n_columns_(program_.n_columns()) {}
+
+    lp_status simplex_solver::solve() {
+        iterations_ = 0;
+        dual_feasible_ = false;
+
+        // Phase 1 minimizes the artificial variables
+        cost_.assign(n_columns_ + n_rows_, 0.0);
+        std::fill(cost_.begin() + n_columns_, cost_.end(), 1.0);
+        crash();
+        bool has_artificials = false;
+        for (size_t i = 0; i < n_rows_; ++i) {
+            has_artificials = has_artificials || basis_[i] >= n_columns_;
+        }
+        if (has_artificials) {
+            status_ = primal();
+            if (status_ != lp_status::optimal) {
+                return status_;
+            }
+            double scale = 1.0;
+            double infeasibility = 0.0;
+            for (size_t i = 0; i < n_rows_; ++i) {
+                scale = std::max(scale, std::abs(program_.rhs(i)));
+                if (basis_[i] >= n_columns_) {
+                    infeasibility += x_[i];
+                }
+            }
+            if (infeasibility > primal_tolerance * scale) {
+                status_ = lp_status::infeasible;
+                return status_;
+            }
+            drive_out_artificials();
+        }
+
+        // Phase 2
+        for (size_t j = 0; j < n_columns_; ++j) {
+            cost_[j] = program_.cost(j);
+        }
+        std::fill(cost_.begin() + n_columns_, cost_.end(), 0.0);
+        duals();
+        status_ = primal();
+        dual_feasible_ = status_ == lp_status::optimal;
+        return status_;
+    }
+
+    lp_status simplex_solver::solve(std::span<const size_t> basis) {
+        if (basis.size() != n_rows_) {
+            throw std::runtime_error(
+                "SIMPLEX_SOLVER solve error: one basic column per row.");
+        }
+        iterations_ = 0;
+        dual_feasible_ = false;
+        basis_.assign(basis.begin(), basis.end());
+        position_.assign(n_columns_ + n_rows_, npos);
+        artificial_sign_.assign(n_rows_, 1.0);
+        for (size_t i = 0; i < n_rows_; ++i) {
+            if (basis_[i] >= n_columns_ || position_[basis_[i]] != npos) {
+                throw std::runtime_error(
+                    "SIMPLEX_SOLVER solve error: invalid basis.");
+            }
+            position_[basis_[i]] = i;
+        }
+        cost_.assign(n_columns_ + n_rows_, 0.0);
+        for (size_t j = 0; j < n_columns_; ++j) {
+            cost_[j] = program_.cost(j);
+        }
+        refactor();
+        if (std::any_of(x_.begin(), x_.end(),
+                        [](double x) { return x < -primal_tolerance; })) {
+            return solve();
+        }
+        status_ = primal();
+        dual_feasible_ = status_ == lp_status::optimal;
+        return status_;
+    }
+
+    lp_status simplex_solver::resolve() {
+        if (!dual_feasible_) {
+            return solve();
+        }
+        iterations_ = 0;
+        refactor();
+        status_ = dual();
+        return status_;
+    }
+
+    void simplex_solver::set_rhs(size_t row, double value) {
+        program_.set_rhs(row, value);
+    }
+
+    const linear_program &simplex_solver::program() const { return program_; }
+
+    lp_status simplex_solver::status() const { return status_; }
+
+    double simplex_solver::objective() const {
+        double value = 0.0;
+        for (size_t i = 0; i < basis_.size(); ++i) {
+            value += cost_[basis_[i]] * x_[i];
+        }
+        return value;
+    }
+
+    std::vector<double> simplex_solver::solution() const {
+        std::vector<double> x(n_columns_, 0.0);
+        for (size_t i = 0; i < basis_.size(); ++i) {
+            if (basis_[i] < n_columns_) {
+                x[basis_[i]] = std::max(x_[i], 0.0);
+            }
+        }
+        return x;
+    }
+
+    size_t simplex_solver::iterations() const { return iterations_; }
+
+    void simplex_solver::crash() {
+        basis_.assign(n_rows_, npos);
+        position_.assign(n_columns_ + n_rows_, npos);
+        artificial_sign_.assign(n_rows_, 1.0);
+        // A singleton column is basic in its row if its value is not
+        // negative there
+        for (size_t j = 0; j < n_columns_; ++j) {
+            auto rows = program_.column_rows(j);
+            if (rows.size() != 1 || basis_[rows[0]] != npos) {
+                continue;
+            }
+            double b = program_.rhs(rows[0]);
+            double a = program_.column_values(j)[0];
+            if (b == 0.0 || (b > 0.0) == (a > 0.0)) {
+                basis_[rows[0]] = j;
+            }
+        }
+        for (size_t i = 0; i < n_rows_; ++i) {
+            if (basis_[i] == npos) {
+                artificial_sign_[i] = program_.rhs(i) < 0.0 ? -1.0 : 1.0;
+                basis_[i] = n_columns_ + i;
+            }
+            position_[basis_[i]] = i;
+        }
+        refactor();
+    }
+
+    lp_status simplex_solver::primal() {
+        std::vector<double> alpha(n_rows_);
+        size_t degenerate = 0;
+        while (true) {
+            if (iterations_ >= max_iterations_) {
+                return lp_status::iteration_limit;
+            }
+            // Dantzig's rule, or the first improving column with Bland's
+            // rule. Artificial variables never enter.
+            bool bland = degenerate >= degenerate_limit;
+            size_t q = npos;
+            double best = -dual_tolerance;
+            for (size_t j = 0; j < n_columns_; ++j) {
+                if (position_[j] != npos) {
+                    continue;
+                }
+                double d = cost_[j] - dot(y_.data(), j);
+                if (d < best) {
+                    best = d;
+                    q = j;
+                    if (bland) {
+                        break;
+                    }
+                }
+            }
+            if (q == npos) {
+                return lp_status::optimal;
+            }
+
+            // Ratio test, preferring large pivots among ties
+            basis_column(q, alpha);
+            size_t r = npos;
+            double theta = std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < n_rows_; ++i) {
+                if (alpha[i] <= pivot_tolerance) {
+                    continue;
+                }
+                double ratio = std::max(x_[i], 0.0) / alpha[i];
+                if (ratio < theta - primal_tolerance ||
+                    (ratio <= theta + primal_tolerance &&
+                     (bland ? basis_[i] < basis_[r] : alpha[i] > alpha[r]))) {
+                    r = i;
+                    theta = ratio;
+                }
+            }
+            if (r == npos) {
+                return lp_status::unbounded;
+            }
+            degenerate = theta <= primal_tolerance ? degenerate + 1 : 0;
+            pivot(r, q, alpha);
+        }
+    }
+
+    lp_status simplex_solver::dual() {
+        std::vector<double> alpha(n_rows_);
+        std::vector<double> row(n_rows_);
+        size_t degenerate = 0;
+        while (true) {
+            if (iterations_ >= max_iterations_) {
+                return lp_status::iteration_limit;
+            }
+            // The most infeasible row leaves, or the first one with
+            // Bland's rule
+            bool bland = degenerate >= degenerate_limit;
+            size_t r = npos;
+            double worst = -primal_tolerance;
+            for (size_t i = 0; i < n_rows_; ++i) {
+                if (basis_[i] < n_columns_ && x_[i] < worst) {
+                    worst = x_[i];
+                    r = i;
+                    if (bland) {
+                        break;
+                    }
+                }
+            }
+            if (r == npos) {
+                return lp_status::optimal;
+            }
+
+            // Dual ratio test keeps the reduced costs non-negative
+            basis_row(r, row);
+            const double *rho = row.data();
+            size_t q = npos;
+            double theta = std::numeric_limits<double>::infinity();
+            double pivot_size = 0.0;
+            for (size_t j = 0; j < n_columns_; ++j) {
+                if (position_[j] != npos) {
+                    continue;
+                }
+                double a = dot(rho, j);
+                if (a >= -pivot_tolerance) {
+                    continue;
+                }
+                double d = std::max(cost_[j] - dot(y_.data(), j), 0.0);
+                double ratio = d / -a;
+                if (ratio < theta - dual_tolerance ||
+                    (ratio <= theta + dual_tolerance &&
+                     (bland ? j < q : -a > pivot_size))) {
+                    q = j;
+                    theta = ratio;
+                    pivot_size = -a;
+                }
+            }
+            if (q == npos) {
+                return lp_status::infeasible;
+            }
+            degenerate = theta <= dual_tolerance ? degenerate + 1 : 0;
+            basis_column(q, alpha);
+            pivot(r, q, alpha);
+        }
+    }
+
+    void simplex_solver::drive_out_artificials() {
+        std::vector<double> alpha(n_rows_);
+        std::vector<double> row(n_rows_);
+        for (size_t r = 0; r < n_rows_; ++r) {
+            if (basis_[r] < n_columns_) {
+                continue;
+            }
+            // Rows where no column can replace the artificial variable are
+            // redundant, and the variable stays at zero
+            basis_row(r, row);
+            const double *rho = row.data();
+            size_t q = npos;
+            double largest = 1e-7;
+            for (size_t j = 0; j < n_columns_; ++j) {
+                if (position_[j] == npos && std::abs(dot(rho, j)) > largest) {
+                    largest = std::abs(dot(rho, j));
+                    q = j;
+                }
+            }
+            if (q != npos) {
+                basis_column(q, alpha);
+                pivot(r, q, alpha);
+            }
+        }
+    }
+
+    void simplex_solver::pivot(size_t r, size_t q,
+                               const std::vector<double> &alpha) {
+        double theta = x_[r] / alpha[r];
+        for (size_t i = 0; i < n_rows_; ++i) {
+            x_[i] -= theta * alpha[i];
+        }
+        x_[r] = theta;
+        add_eta(r, alpha);
+        position_[basis_[r]] = npos;
+        basis_[r] = q;
+        position_[q] = r;
+        ++iterations_;
+        // Refactor once the etas of the pivots cost as much to apply as
+        // the etas of the factorization
+        if (++updates_ >= refactor_interval ||
+            eta_index_.size() > 2 * factor_nonzeros_ + n_rows_) {
+            refactor();
+        } else {
+            duals();
+        }
+    }
+
+    void simplex_solver::refactor() {
+        // Singleton columns pivot in their own row first, with no fill.
+        // The other columns then pivot, in the product form built so far,
+        // on their largest entry among the rows left.
+        const size_t m = n_rows_;
+        eta_row_.clear();
+        eta_scale_.clear();
+        eta_start_.assign(1, 0);
+        eta_index_.clear();
+        eta_value_.clear();
+        std::vector<size_t> basis(m, npos);
+        std::vector<size_t> others;
+        for (size_t k = 0; k < m; ++k) {
+            size_t j = basis_[k];
+            size_t row;
+            double value;
+            if (j >= n_columns_) {
+                row = j - n_columns_;
+                value = artificial_sign_[row];
+            } else if (program_.column_rows(j).size() == 1) {
+                row = program_.column_rows(j)[0];
+                value = program_.column_values(j)[0];
+            } else {
+                others.push_back(j);
+                continue;
+            }
+            if (basis[row] != npos || std::abs(value) < pivot_tolerance) {
+                throw std::runtime_error(
+                    "SIMPLEX_SOLVER error: singular basis.");
+            }
+            basis[row] = j;
+            eta_row_.push_back(row);
+            eta_scale_.push_back(1.0 / value);
+            eta_start_.push_back(eta_index_.size());
+        }
+        std::vector<double> alpha(m);
+        for (size_t j : others) {
+            basis_column(j, alpha);
+            size_t r = npos;
+            double largest = pivot_tolerance;
+            for (size_t i = 0; i < m; ++i) {
+                if (basis[i] == npos && std::abs(alpha[i]) > largest) {
+                    largest = std::abs(alpha[i]);
+                    r = i;
+                }
+            }
+            if (r == npos) {
+                throw std::runtime_error(
+                    "SIMPLEX_SOLVER error: singular basis.");
+            }
+            basis[r] = j;
+            add_eta(r, alpha);
+        }
+        basis_ = std::move(basis);
+        for (size_t i = 0; i < m; ++i) {
+            position_[basis_[i]] = i;
+        }
+
+        x_.resize(m);
+        for (size_t i = 0; i < m; ++i) {
+            x_[i] = program_.rhs(i);
+        }
+        ftran(x_);
+        factor_nonzeros_ = eta_index_.size();
+        updates_ = 0;
+        duals();
+    }
+
+    void simplex_solver::duals() {
+        y_.resize(n_rows_);
+        for (size_t i = 0; i < n_rows_; ++i) {
+            y_[i] = cost_[basis_[i]];
+        }
+        btran(y_);
+    }
+
+    void simplex_solver::basis_column(size_t q,
+                                      std::vector<double> &alpha) const {
+        alpha.assign(n_rows_, 0.0);
+        if (q >= n_columns_) {
+            alpha[q - n_columns_] = artificial_sign_[q - n_columns_];
+        } else {
+            auto rows = program_.column_rows(q);
+            auto values = program_.column_values(q);
+            for (size_t e = 0; e < rows.size(); ++e) {
+                alpha[rows[e]] = values[e];
+            }
+        }
+        ftran(alpha);
+    }
+
+    void simplex_solver::basis_row(size_t r, std::vector<double> &rho) const {
+        rho.assign(n_rows_, 0.0);
+        rho[r] = 1.0;
+        btran(rho);
+    }
+
+    void simplex_solver::add_eta(size_t r, const std::vector<double> &alpha) {
+        double scale = 1.0 / alpha[r];
+        for (size_t i = 0; i < n_rows_; ++i) {
+            if (i != r && alpha[i] != 0.0) {
+                eta_index_.push_back(i);
+                eta_value_.push_back(-alpha[i] * scale);
+            }
+        }
+        eta_row_.push_back(r);
+        eta_scale_.push_back(scale);
+        eta_start_.push_back(eta_index_.size());
+    }
+
+    void simplex_solver::ftran(std::vector<double> &v) const {
+        for (size_t k = 0; k < eta_row_.size(); ++k) {
+            double t = v[eta_row_[k]];
+            if (t == 0.0) {
+                continue;
+            }
+            v[eta_row_[k]] = t * eta_scale_[k];
+            for (size_t e = eta_start_[k]; e < eta_start_[k + 1]; ++e) {
+                v[eta_index_[e]] += t * eta_value_[e];
+            }
+        }
+    }
+
+    void simplex_solver::btran(std::vector<double> &v) const {
+        for (size_t k = eta_row_.size(); k-- > 0;) {
+            double t = v[eta_row_[k]] * eta_scale_[k];
+            for (size_t e = eta_start_[k]; e < eta_start_[k + 1]; ++e) {
+                t += v[eta_index_[e]] * eta_value_[e];
+            }
+            v[eta_row_[k]] = t;
+        }
+    }
+
+    double simplex_solver::dot(const double *y, size_t j) const {
+        auto rows = program_.column_rows(j);
+        auto values = program_.column_values(j);
+        double d = 0.0;
+        for (size_t e = 0; e < rows.size(); ++e) {
+            d += y[rows[e]] * values[e];
+        }
+        return d;
+    }
+} // namespace portfolio
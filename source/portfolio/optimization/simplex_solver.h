@@ -0,0 +1,143 @@
+#ifndef PORTFOLIO_SIMPLEX_SOLVER_H
+#define PORTFOLIO_SIMPLEX_SOLVER_H
+
+#include "portfolio/optimization/linear_program.h"
+#include <cstddef>
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Outcome of solving a linear program.
+    enum class lp_status {
+        not_solved,
+        optimal,
+        infeasible,
+        unbounded,
+        iteration_limit
+    };
+
+    /// \brief Revised simplex solver for sparse linear programs.
+    ///
+    /// The columns of the program stay sparse and so does the inverse of
+    /// the basis, which is kept in product form: a sequence of eta
+    /// matrices, one per basic column from the last refactorization plus
+    /// one per pivot since then. Singleton columns, such as slacks and
+    /// artificial variables, pivot in their own row with an eta of one
+    /// entry, so memory and the work of each pivot grow with the nonzeros
+    /// of the other basic columns instead of with the square of the number
+    /// of rows. solve() runs the two-phase primal simplex
+    /// from a basis of singleton columns and artificial variables. When
+    /// only the right-hand side changes, resolve() starts the dual simplex
+    /// from the last basis, which is still dual feasible and usually a few
+    /// pivots away from the new optimum.
+    class simplex_solver {
+      public /* constructors */:
+        /// \brief Constructor of simplex_solver
+        /// \param program Program to solve.
+        /// \param max_iterations Most pivots of each solve.
+        explicit simplex_solver(linear_program program,
+                                size_t max_iterations = 100000);
+
+      public /* solving */:
+        /// \brief Solve the program from scratch.
+        lp_status solve();
+
+        /// \brief Solve the program from a starting basis
+        /// \param basis One column per row whose basic solution is
+        /// feasible. An infeasible basis falls back to solve().
+        lp_status solve(std::span<const size_t> basis);
+
+        /// \brief Solve the program after its right-hand side changed,
+        /// starting from the last basis. Falls back to solve() when there
+        /// is no dual feasible basis.
+        lp_status resolve();
+
+        /// \brief Change the right-hand side of a constraint.
+        void set_rhs(size_t row, double value);
+
+      public /* getters */:
+        [[nodiscard]] const linear_program &program() const;
+        [[nodiscard]] lp_status status() const;
+
+        /// \brief Objective value of the current basis.
+        [[nodiscard]] double objective() const;
+
+        /// \brief Values of the variables in the current basis.
+        [[nodiscard]] std::vector<double> solution() const;
+
+        /// \brief Pivots of the last solve or resolve.
+        [[nodiscard]] size_t iterations() const;
+
+      private:
+        /// \brief Basis of singleton columns and artificial variables
+        void crash();
+
+        /// \brief Primal simplex with the current costs
+        lp_status primal();
+
+        /// \brief Dual simplex with the current costs
+        lp_status dual();
+
+        /// \brief Replace artificial variables at zero in the basis
+        void drive_out_artificials();
+
+        /// \brief Replace the basic variable of row r by column q
+        void pivot(size_t r, size_t q, const std::vector<double> &alpha);
+
+        /// \brief Invert the basis and recompute the basic values
+        void refactor();
+
+        /// \brief Recompute the dual values of the current costs
+        void duals();
+
+        /// \brief Column of the program in the current basis
+        void basis_column(size_t q, std::vector<double> &alpha) const;
+
+        /// \brief Row r of the inverse of the basis
+        void basis_row(size_t r, std::vector<double> &rho) const;
+
+        /// \brief Append the eta matrix that pivots alpha on row r
+        void add_eta(size_t r, const std::vector<double> &alpha);
+
+        /// \brief Multiply a vector by the inverse of the basis
+        void ftran(std::vector<double> &v) const;
+
+        /// \brief Multiply a row vector by the inverse of the basis
+        void btran(std::vector<double> &v) const;
+
+        /// \brief Dot product of a vector over the rows and a column
+        [[nodiscard]] double dot(const double *y, size_t j) const;
+
+        linear_program program_;
+        size_t max_iterations_;
+        size_t n_rows_;
+        size_t n_columns_;
+        /// Costs of the current phase, including one artificial per row
+        std::vector<double> cost_;
+        /// Sign of the artificial variable of each row
+        std::vector<double> artificial_sign_;
+        /// Basic column of each row
+        std::vector<size_t> basis_;
+        /// Row of each basic column
+        std::vector<size_t> position_;
+        /// Eta matrices whose product is the inverse of the basis. Eta k
+        /// multiplies row eta_row_[k] by eta_scale_[k] and adds multiples
+        /// of it to the rows of its entries.
+        std::vector<size_t> eta_row_;
+        std::vector<double> eta_scale_;
+        std::vector<size_t> eta_start_{0};
+        std::vector<size_t> eta_index_;
+        std::vector<double> eta_value_;
+        /// Values of the basic variables
+        std::vector<double> x_;
+        /// Dual values, updated at each pivot
+        std::vector<double> y_;
+        /// Entries of the etas of the last refactorization
+        size_t factor_nonzeros_{0};
+        size_t updates_{0};
+        size_t iterations_{0};
+        lp_status status_{lp_status::not_solved};
+        bool dual_feasible_{false};
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_SIMPLEX_SOLVER_H
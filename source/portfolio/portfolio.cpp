@@ -5,6 +5,7 @@
 #include "portfolio.h"
 #include "portfolio/common/algorithm.h"
 #include <random>
+#include <stdexcept>
 #include <range/v3/core.hpp>
 #include <range/v3/numeric/accumulate.hpp>
 
@@ -14,80 +15,88 @@ namespace portfolio {
         double total = total_allocation();
         return almost_equal(total, 1.0);
     }
-    portfolio::portfolio(const market_data &data) {
-        static std::default_random_engine generator =
-            std::default_random_engine(
-                std::chrono::system_clock::now().time_since_epoch().count());
+    portfolio::portfolio(const market_data &data)
+        : symbols_(data.shared_symbols()),
+          assets_proportions_(data.n_assets(), 0.0) {
+        // One engine per thread, so portfolios can be created concurrently
+        static thread_local std::default_random_engine generator(
+            std::random_device{}());
         std::uniform_real_distribution<double> d_real(0.0, 1.0);
         std::binomial_distribution<int> d_binomial(1, 0.5);
-        for (auto a = data.assets_map_begin(); a != data.assets_map_end();
-             ++a) {
+        for (double &proportion : assets_proportions_) {
             if (1 == d_binomial(generator)) { // asset is selected or not
-                assets_proportions_[a->first] = d_real(generator);
-            } else {
-                assets_proportions_[a->first] = 0.0;
+                proportion = d_real(generator);
             }
         }
         normalize_allocation();
     }
+    portfolio::portfolio(const market_data &data,
+                         std::span<const double> weights)
+        : symbols_(data.shared_symbols()),
+          assets_proportions_(weights.begin(), weights.end()) {
+        if (weights.size() != data.n_assets()) {
+            throw std::runtime_error("PORTFOLIO constructor error: one weight "
+                                     "is needed per asset.");
+        }
+        normalize_allocation();
+    }
     void portfolio::normalize_allocation() {
         double total = total_allocation();
         if (almost_equal(total, 1.0, 5)) {
             return;
-        } else if (total > 1.0) {
-            std::transform(
-                assets_proportions_.begin(), assets_proportions_.end(),
-                std::inserter(assets_proportions_, assets_proportions_.begin()),
-                [&total](auto &p) {
-                    p.second = p.second / total;
-                    return p;
-                });
-            return;
-        } else {
-            for (auto &[key, value] : assets_proportions_)
-                assets_proportions_[key] = value / total;
-            return;
+        }
+        for (double &proportion : assets_proportions_) {
+            proportion /= total;
         }
     }
+    bool portfolio::same_assets(const symbol_table &symbols) const {
+        return &symbols == symbols_.get() ||
+               symbols.symbols() == symbols_->symbols();
+    }
     double portfolio::total_allocation() const {
-        double total;
-        total = ranges::accumulate(
-            std::begin(assets_proportions_), std::end(assets_proportions_), 0.0,
-            [](double value,
-               const std::map<std::string, double>::value_type &p) {
-                return value + p.second;
-            });
-        return total;
+        return ranges::accumulate(assets_proportions_, 0.0);
+    }
+    std::span<const double> portfolio::weights() const {
+        return assets_proportions_;
+    }
+    double portfolio::weight(std::string_view asset) const {
+        asset_id id = symbols_->find(asset);
+        return id == symbol_table::npos ? 0.0 : assets_proportions_[id];
     }
     std::pair<double, double> portfolio::evaluate_mad(const market_data &data,
                                                       interval_points interval,
                                                       int n_periods) {
-        if (mad_) {
-            if (mad_->n_periods() != n_periods ||
-                mad_->interval() != interval) {
-                mad_.reset();
-                mad_.emplace(data, interval, n_periods);
-            }
-        } else {
-            mad_.emplace(data, interval, n_periods);
+        if (!same_assets(data.symbols())) {
+            throw std::runtime_error("PORTFOLIO evaluate_mad error: the "
+                                     "market data has other assets.");
+        }
+        // The cached model might come from other market data
+        if (!mad_ || &mad_->symbols() != &data.symbols() ||
+            mad_->n_periods() != n_periods || mad_->interval() != interval) {
+            mad_ = data.mad(interval, n_periods);
         }
-        double total_risk = 0.0;
-        double total_return = 0.0;
-        for (auto &a : assets_proportions_) {
-            total_risk += a.second * mad_->risk(a.first);
-            total_return += a.second * mad_->expected_return(a.first);
+        return mad_->evaluate(assets_proportions_);
+    }
+    std::pair<double, double>
+    portfolio::evaluate(const risk_model &model) const {
+        if (!same_assets(model.symbols())) {
+            throw std::runtime_error("PORTFOLIO evaluate error: the model "
+                                     "has other assets.");
         }
-        return std::make_pair(total_risk, total_return);
+        return model.evaluate(assets_proportions_);
     }
     std::ostream &operator<<(std::ostream &os, const portfolio &portfolio1) {
         os << "Assets allocations:\n";
-        for (auto &a : portfolio1.assets_proportions_) {
-            if (!almost_equal(a.second, 0.0)) {
-                os << "Asset: " << a.first << " - Allocation " << a.second;
+        for (asset_id id = 0; id < portfolio1.assets_proportions_.size();
+             ++id) {
+            double proportion = portfolio1.assets_proportions_[id];
+            if (!almost_equal(proportion, 0.0)) {
+                os << "Asset: " << portfolio1.symbols_->symbol(id)
+                   << " - Allocation " << proportion;
                 if (portfolio1.mad_) {
                     os << " - Expect return: "
-                       << portfolio1.mad_->expected_return(a.first);
-                    os << " - Risk: " << portfolio1.mad_->risk(a.first);
+                       << portfolio1.mad_->expected_return(id);
+                    os << " - Risk: " << portfolio1.mad_->risk(id);
                 }
                 os << "\n";
             }
@@ -7,14 +7,24 @@
 
 #include "market_data.h"
 #include "portfolio_mad.h"
-#include <map>
-#include <optional>
+#include "risk_model.h"
+#include <memory>
 #include <ostream>
+#include <span>
 #include <string>
+#include <utility>
+#include <vector>
 namespace portfolio {
     class portfolio {
       public:
         explicit portfolio(const market_data &data);
+
+        /// @brief Portfolio with the given allocations, which are normalized.
+        /// \param data Market data of assets.
+        /// \param weights Allocation of each asset, indexed by asset id, such
+        /// as a row generated by a portfolio_sampler.
+        portfolio(const market_data &data, std::span<const double> weights);
+
         /// @brief Evaluate portfolio using MAD as risk measure.
         /// \param data Market data of assets.
         /// \param interval Time interval for which you want to calculate MAD.
@@ -23,15 +33,36 @@ namespace portfolio {
         std::pair<double, double> evaluate_mad(const market_data &data,
                                                interval_points interval,
                                                int n_periods);
+
+        /// @brief Evaluate portfolio with the risk measure of a model,
+        /// such as an ewma_model, portfolio_risk or factor_model.
+        /// \param model Model of the assets of the market data.
+        /// \return Risk and expected return of the portfolio.
+        [[nodiscard]] std::pair<double, double>
+        evaluate(const risk_model &model) const;
+
+        /// @brief Allocation of each asset, indexed by asset id.
+        [[nodiscard]] std::span<const double> weights() const;
+
+        /// @brief Allocation of an asset.
+        /// \param asset Asset code.
+        /// \return Allocation or 0 if the asset is not in the portfolio.
+        [[nodiscard]] double weight(std::string_view asset) const;
+
         friend std::ostream &operator<<(std::ostream &os,
                                         const portfolio &portfolio1);
 
       private:
         void normalize_allocation();
         [[nodiscard]] double total_allocation() const;
+        /// \brief Check if a model indexes the assets by the same ids.
+        [[nodiscard]] bool same_assets(const symbol_table &symbols) const;
         [[nodiscard]] bool invariants() const;
-        std::optional<portfolio_mad> mad_;
-        std::map<std::string, double> assets_proportions_;
+        /// \brief Model shared through the risk model cache of the data.
+        std::shared_ptr<const portfolio_mad> mad_;
+        std::shared_ptr<const symbol_table> symbols_;
+        /// \brief Allocation of each asset, indexed by asset id.
+        std::vector<double> assets_proportions_;
     };
 } // namespace portfolio
 #endif // PORTFOLIO_PORTFOLIO_H
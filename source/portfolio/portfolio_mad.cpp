@@ -7,52 +7,73 @@
 #include <iostream>
 #include <numeric>
 #include <random>
+#include <stdexcept>
 #include <range/v3/core.hpp>
 #include <range/v3/numeric/accumulate.hpp>
 namespace portfolio {
     portfolio_mad::portfolio_mad(const market_data &data,
                                  interval_points interval, int n_periods)
-        : interval_(std::move(interval)) {
+        : interval_(std::move(interval)), symbols_(data.shared_symbols()) {
         n_periods_ = n_periods;
-        for (auto a = data.assets_map_begin(); a != data.assets_map_end();
-             ++a) {
-            data_feed_result df = a->second;
-            auto price_it = df.find_prices_from(interval_);
-            if (price_it == df.end()) {
-                throw std::runtime_error(
-                    "MAD_PORTFOLIO constructor error: interval not found.");
-            }
-            for (size_t i = 0; i < n_periods_; ++i) {
-                if (price_it != df.begin())
-                    price_it--;
-                else
-                    throw std::runtime_error("MAD_PORTFOLIO constructor error: "
-                                             "n_periods out of market_data.");
+        const return_panel &panel = data.returns();
+        size_t last = panel.find(interval_);
+        if (last == panel.n_periods()) {
+            throw std::runtime_error(
+                "MAD_PORTFOLIO constructor error: interval not found.");
+        }
+        if (n_periods_ < 1 || last + 1 < static_cast<size_t>(n_periods_)) {
+            throw std::runtime_error("MAD_PORTFOLIO constructor error: "
+                                     "n_periods out of market_data.");
+        }
+        size_t first = last + 1 - n_periods_;
+        assets_risk_return_.resize(panel.n_assets());
+        for (size_t k = 0; k < panel.n_assets(); ++k) {
+            auto returns = panel.returns(k).subspan(first, n_periods_);
+            auto mask = panel.mask(k).subspan(first, n_periods_);
+            size_t n = ranges::accumulate(mask, size_t(0));
+            if (n == 0) {
+                throw std::runtime_error("MAD_PORTFOLIO constructor error: "
+                                         "no returns in the periods.");
             }
-            std::vector<double> asset_returns;
-            for (size_t i = 0; i < n_periods_; ++i) {
-                double price_0 = price_it->second.close();
-                price_it++;
-                double price_1 = price_it->second.close();
-                asset_returns.push_back((price_1 - price_0) / price_0);
+            // Masked returns are zero, so they do not change the sum
+            double mean = ranges::accumulate(returns, 0.0) / n;
+            double mad = 0.0;
+            for (size_t i = 0; i < returns.size(); ++i) {
+                if (mask[i]) {
+                    mad += std::abs(returns[i] - mean);
+                }
             }
-            double mean =
-                ranges::accumulate(asset_returns, 0.0) / asset_returns.size();
-            double mad = ranges::accumulate(asset_returns, 0.0,
-                                            [mean](double mad, double d) {
-                                                return mad + std::abs(d - mean);
-                                            }) /
-                         asset_returns.size();
-            assets_risk_return_[a->first] = std::make_pair(mad, mean);
+            assets_risk_return_[k] = std::make_pair(mad / n, mean);
         }
     }
     interval_points portfolio_mad::interval() const { return interval_; }
     int portfolio_mad::n_periods() const { return n_periods_; }
     double portfolio_mad::risk(std::string_view asset) const {
-        return assets_risk_return_.at(std::string(asset)).first;
+        return risk(id_of(asset));
     }
     double portfolio_mad::expected_return(std::string_view asset) const {
-        return assets_risk_return_.at(std::string(asset)).second;
+        return expected_return(id_of(asset));
+    }
+    double portfolio_mad::risk(asset_id id) const {
+        return assets_risk_return_[id].first;
+    }
+    double portfolio_mad::expected_return(asset_id id) const {
+        return assets_risk_return_[id].second;
+    }
+    std::pair<double, double>
+    portfolio_mad::evaluate(std::span<const double> weights) const {
+        return weighted_sums(weights);
+    }
+    size_t portfolio_mad::n_assets() const {
+        return assets_risk_return_.size();
+    }
+    const symbol_table &portfolio_mad::symbols() const { return *symbols_; }
+    asset_id portfolio_mad::id_of(std::string_view asset) const {
+        asset_id id = symbols_->find(asset);
+        if (id == symbol_table::npos) {
+            throw std::out_of_range("MAD_PORTFOLIO error: asset not found.");
+        }
+        return id;
     }
 
 } // namespace portfolio
\ No newline at end of file
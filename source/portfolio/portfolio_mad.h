@@ -6,9 +6,14 @@
 #define PORTFOLIO_PORTFOLIO_MAD_H
 
 #include "market_data.h"
+#include "risk_model.h"
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace portfolio {
-    class portfolio_mad {
+    class portfolio_mad : public risk_model {
       public:
         /// @brief Class constructor
         /// \param data Market_data used for calculating MAD.
@@ -36,10 +41,38 @@ namespace portfolio {
         /// or mean of past returns.
         [[nodiscard]] double expected_return(std::string_view asset) const;
 
+        /// @brief Gets calculated risk of an asset.
+        /// \param id Id of the asset in the market data.
+        /// \return The risk of adjustment using MAD.
+        [[nodiscard]] double risk(asset_id id) const override;
+
+        /// @brief Gets the expected return of an asset.
+        /// \param id Id of the asset in the market data.
+        /// \return The expected return or mean of past returns.
+        [[nodiscard]] double expected_return(asset_id id) const override;
+
+        /// @brief Gets the risk and expected return of a portfolio.
+        /// \param weights Weight of each asset by id.
+        /// \return Weighted sums of the MADs and expected returns of the
+        /// assets.
+        [[nodiscard]] std::pair<double, double>
+        evaluate(std::span<const double> weights) const override;
+
+        /// @brief Gets the number of assets in the model.
+        [[nodiscard]] size_t n_assets() const override;
+
+        /// @brief Gets the ids of the assets in the model.
+        [[nodiscard]] const symbol_table &symbols() const override;
+
       private:
+        /// @brief Id of an asset, which must be in the market data.
+        [[nodiscard]] asset_id id_of(std::string_view asset) const;
+
         interval_points interval_;
         int n_periods_;
-        std::map<std::string, std::pair<double, double>> assets_risk_return_;
+        std::shared_ptr<const symbol_table> symbols_;
+        /// @brief Risk and expected return, indexed by asset id.
+        std::vector<std::pair<double, double>> assets_risk_return_;
     };
 } // namespace portfolio
 #endif // PORTFOLIO_PORTFOLIO_MAD_H
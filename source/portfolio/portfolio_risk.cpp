@@ -0,0 +1,262 @@
+#include "portfolio_risk.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        /// Check if the kernel computes a metric
+        bool computes(const risk_options &options, risk_metric metric) {
+            switch (metric) {
+            case risk_metric::mad:
+                return options.mad;
+            case risk_metric::standard_deviation:
+                return options.standard_deviation || options.sharpe_ratio;
+            case risk_metric::semi_deviation:
+                return options.semi_deviation;
+            case risk_metric::max_drawdown:
+                return options.max_drawdown;
+            case risk_metric::value_at_risk:
+            case risk_metric::conditional_value_at_risk:
+                return options.conditional_value_at_risk;
+            }
+            return false;
+        }
+    } // namespace
+
+    double risk_report::risk(risk_metric metric) const {
+        switch (metric) {
+        case risk_metric::mad:
+            return mad;
+        case risk_metric::standard_deviation:
+            return standard_deviation;
+        case risk_metric::semi_deviation:
+            return semi_deviation;
+        case risk_metric::max_drawdown:
+            return max_drawdown;
+        case risk_metric::value_at_risk:
+            return value_at_risk;
+        case risk_metric::conditional_value_at_risk:
+            return conditional_value_at_risk;
+        }
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    risk_kernel::risk_kernel(risk_options options) : options_(options) {
+        if (!(options_.confidence > 0.0 && options_.confidence < 1.0)) {
+            throw std::runtime_error("RISK_KERNEL constructor error: "
+                                     "confidence out of (0, 1).");
+        }
+    }
+
+    risk_report risk_kernel::operator()(std::span<const double> returns,
+                                        std::span<const uint8_t> mask) {
+        if (!mask.empty() && mask.size() != returns.size()) {
+            throw std::runtime_error("RISK_KERNEL error: one mask value is "
+                                     "needed per return.");
+        }
+        constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+        auto known = [&](size_t t) { return mask.empty() || mask[t]; };
+
+        // First pass. Sums are shifted by the first return, which keeps
+        // the variance accurate when the mean is far from zero.
+        size_t n = 0;
+        double shift = 0.0;
+        double sum = 0.0;
+        double squares = 0.0;
+        double shortfalls = 0.0;
+        double wealth = 1.0;
+        double peak = 1.0;
+        double drawdown = 0.0;
+        for (size_t t = 0; t < returns.size(); ++t) {
+            if (!known(t)) {
+                continue;
+            }
+            double r = returns[t];
+            if (n == 0) {
+                shift = r;
+            }
+            ++n;
+            double d = r - shift;
+            sum += d;
+            squares += d * d;
+            double shortfall = std::min(r - options_.target_return, 0.0);
+            shortfalls += shortfall * shortfall;
+            if (options_.max_drawdown) {
+                wealth *= 1.0 + r;
+                peak = std::max(peak, wealth);
+                drawdown = std::max(drawdown, 1.0 - wealth / peak);
+            }
+        }
+        if (n == 0) {
+            throw std::runtime_error("RISK_KERNEL error: no returns.");
+        }
+
+        risk_report report{n,   nan, nan, nan, nan,
+                           nan, nan, nan, nan};
+        report.mean = shift + sum / n;
+        double deviation =
+            n > 1 ? std::sqrt(std::max(squares - sum * sum / n, 0.0) /
+                              (n - 1.0))
+                  : 0.0;
+        if (options_.standard_deviation || options_.sharpe_ratio) {
+            report.standard_deviation = deviation;
+        }
+        if (options_.semi_deviation) {
+            report.semi_deviation = std::sqrt(shortfalls / n);
+        }
+        if (options_.max_drawdown) {
+            report.max_drawdown = drawdown;
+        }
+        if (options_.sharpe_ratio) {
+            report.sharpe_ratio =
+                deviation > 0.0
+                    ? (report.mean - options_.risk_free_return) / deviation
+                    : nan;
+        }
+
+        // Second pass, around the mean and over a copy to select from
+        if (options_.mad || options_.conditional_value_at_risk) {
+            double absolute = 0.0;
+            scratch_.clear();
+            for (size_t t = 0; t < returns.size(); ++t) {
+                if (!known(t)) {
+                    continue;
+                }
+                absolute += std::abs(returns[t] - report.mean);
+                if (options_.conditional_value_at_risk) {
+                    scratch_.push_back(returns[t]);
+                }
+            }
+            if (options_.mad) {
+                report.mad = absolute / n;
+            }
+        }
+        if (options_.conditional_value_at_risk) {
+            // The tail is the 1 - confidence worst periods
+            size_t n_tail = static_cast<size_t>(
+                std::ceil((1.0 - options_.confidence) * n - 1e-9));
+            n_tail = std::clamp<size_t>(n_tail, 1, n);
+            auto tail_end = scratch_.begin() + n_tail;
+            std::nth_element(scratch_.begin(), tail_end - 1, scratch_.end());
+            double tail = 0.0;
+            for (auto it = scratch_.begin(); it != tail_end; ++it) {
+                tail += *it;
+            }
+            report.value_at_risk = -*(tail_end - 1);
+            report.conditional_value_at_risk = -tail / n_tail;
+        }
+        return report;
+    }
+
+    const risk_options &risk_kernel::options() const { return options_; }
+
+    portfolio_risk::portfolio_risk(const market_data &data,
+                                   interval_points interval, int n_periods,
+                                   risk_options options)
+        : interval_(interval), n_periods_(n_periods), options_(options),
+          symbols_(data.shared_symbols()) {
+        if (!computes(options_, options_.metric)) {
+            throw std::runtime_error("PORTFOLIO_RISK constructor error: "
+                                     "the risk metric is not computed.");
+        }
+        const return_panel &panel = data.returns();
+        size_t last = panel.find(interval_);
+        if (last == panel.n_periods()) {
+            throw std::runtime_error(
+                "PORTFOLIO_RISK constructor error: interval not found.");
+        }
+        if (n_periods_ < 1 || last + 1 < static_cast<size_t>(n_periods_)) {
+            throw std::runtime_error("PORTFOLIO_RISK constructor error: "
+                                     "n_periods out of market_data.");
+        }
+        size_t first = last + 1 - n_periods_;
+        risk_kernel kernel(options_);
+        reports_.reserve(panel.n_assets());
+        returns_.reserve(panel.n_assets() * n_periods_);
+        for (size_t k = 0; k < panel.n_assets(); ++k) {
+            auto returns = panel.returns(k).subspan(first, n_periods_);
+            auto mask = panel.mask(k).subspan(first, n_periods_);
+            if (std::find(mask.begin(), mask.end(), 1) == mask.end()) {
+                throw std::runtime_error("PORTFOLIO_RISK constructor error: "
+                                         "no returns in the periods.");
+            }
+            reports_.push_back(kernel(returns, mask));
+            returns_.insert(returns_.end(), returns.begin(), returns.end());
+        }
+    }
+
+    const risk_report &portfolio_risk::report(asset_id id) const {
+        return reports_[id];
+    }
+
+    const risk_report &portfolio_risk::report(std::string_view asset) const {
+        return report(id_of(asset));
+    }
+
+    double portfolio_risk::risk(asset_id id) const {
+        return reports_[id].risk(options_.metric);
+    }
+
+    double portfolio_risk::risk(asset_id id, risk_metric metric) const {
+        return reports_[id].risk(metric);
+    }
+
+    double portfolio_risk::risk(std::string_view asset,
+                                risk_metric metric) const {
+        return risk(id_of(asset), metric);
+    }
+
+    double portfolio_risk::expected_return(asset_id id) const {
+        return reports_[id].mean;
+    }
+
+    double portfolio_risk::expected_return(std::string_view asset) const {
+        return expected_return(id_of(asset));
+    }
+
+    risk_report
+    portfolio_risk::report(std::span<const double> weights) const {
+        if (weights.size() != n_assets()) {
+            throw std::runtime_error("PORTFOLIO_RISK report error: one "
+                                     "weight is needed per asset.");
+        }
+        // Masked returns are zero, so they do not change the stream
+        std::vector<double> stream(n_periods_, 0.0);
+        for (size_t k = 0; k < n_assets(); ++k) {
+            if (weights[k] == 0.0) {
+                continue;
+            }
+            const double *r = returns_.data() + k * n_periods_;
+            for (int t = 0; t < n_periods_; ++t) {
+                stream[t] += weights[k] * r[t];
+            }
+        }
+        return risk_kernel(options_)(stream);
+    }
+
+    std::pair<double, double>
+    portfolio_risk::evaluate(std::span<const double> weights) const {
+        risk_report portfolio_report = report(weights);
+        return std::make_pair(portfolio_report.risk(options_.metric),
+                              portfolio_report.mean);
+    }
+
+    interval_points portfolio_risk::interval() const { return interval_; }
+
+    int portfolio_risk::n_periods() const { return n_periods_; }
+
+    const risk_options &portfolio_risk::options() const { return options_; }
+
+    size_t portfolio_risk::n_assets() const { return reports_.size(); }
+
+    const symbol_table &portfolio_risk::symbols() const { return *symbols_; }
+
+    asset_id portfolio_risk::id_of(std::string_view asset) const {
+        asset_id id = symbols_->find(asset);
+        if (id == symbol_table::npos) {
+            throw std::out_of_range("PORTFOLIO_RISK error: asset not found.");
+        }
+        return id;
+    }
+} // namespace portfolio
@@ -0,0 +1,163 @@
+#ifndef PORTFOLIO_PORTFOLIO_RISK_H
+#define PORTFOLIO_PORTFOLIO_RISK_H
+
+#include "market_data.h"
+#include "risk_model.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    /// \brief Risk measures of a return stream.
+    enum class risk_metric {
+        /// \brief Mean absolute deviation from the mean.
+        mad,
+        /// \brief Sample standard deviation.
+        standard_deviation,
+        /// \brief Root mean square of the shortfalls below the target
+        /// return.
+        semi_deviation,
+        /// \brief Largest relative fall of the compounded wealth from a
+        /// previous peak.
+        max_drawdown,
+        /// \brief Loss not exceeded with the confidence level.
+        value_at_risk,
+        /// \brief Mean loss of the periods beyond the value at risk.
+        conditional_value_at_risk
+    };
+
+    /// \brief Metrics computed by the risk_kernel. The mean is always
+    /// computed.
+    struct risk_options {
+        bool mad{true};
+        bool standard_deviation{true};
+        bool semi_deviation{true};
+        bool max_drawdown{true};
+        /// \brief Also computes the value at risk.
+        bool conditional_value_at_risk{true};
+        /// \brief Also computes the standard deviation.
+        bool sharpe_ratio{true};
+        /// \brief Return below which the semi-deviation counts shortfalls.
+        double target_return{0.0};
+        /// \brief Risk-free return per period of the Sharpe ratio.
+        double risk_free_return{0.0};
+        /// \brief Confidence of the value at risk, in (0, 1).
+        double confidence{0.95};
+        /// \brief Metric portfolio_risk reports as the risk of a
+        /// risk_model, which must be computed.
+        risk_metric metric{risk_metric::mad};
+    };
+
+    /// \brief Metrics of a return stream. Metrics that were not requested
+    /// are NaN.
+    struct risk_report {
+        size_t n_periods{0};
+        double mean;
+        double mad;
+        double standard_deviation;
+        double semi_deviation;
+        double max_drawdown;
+        double value_at_risk;
+        double conditional_value_at_risk;
+        double sharpe_ratio;
+
+        /// \brief Value of a risk measure.
+        [[nodiscard]] double risk(risk_metric metric) const;
+    };
+
+    /// \brief Fused computation of a set of metrics of a return stream.
+    ///
+    /// The mean, standard deviation, semi-deviation and max drawdown are
+    /// accumulated in one pass. The MAD needs the mean and the conditional
+    /// value at risk needs the tail of the stream, so when they are
+    /// requested a second pass accumulates the MAD while copying the
+    /// stream, and the tail is found by selection instead of sorting.
+    class risk_kernel {
+      public /* constructors */:
+        /// \brief Constructor of risk_kernel
+        /// \param options Metrics to compute.
+        explicit risk_kernel(risk_options options = {});
+
+      public /* computation */:
+        /// \brief Metrics of a return stream
+        /// \param returns Return of each period.
+        /// \param mask 1 for the known returns and 0 for the masked ones,
+        /// which are skipped. Empty means all returns are known.
+        /// \return Metrics of the known returns.
+        risk_report operator()(std::span<const double> returns,
+                               std::span<const uint8_t> mask = {});
+
+      public /* getters */:
+        [[nodiscard]] const risk_options &options() const;
+
+      private:
+        risk_options options_;
+        /// \brief Copy of the stream for the selection of the tail.
+        std::vector<double> scratch_;
+    };
+
+    /// \brief Risk measures of each asset over a window, and of the
+    /// portfolios of these assets, as portfolio_mad computes the MAD.
+    ///
+    /// As a risk_model, the risk is the metric of the options.
+    class portfolio_risk : public risk_model {
+      public /* constructors */:
+        /// \brief Constructor of portfolio_risk
+        /// \param data Market data of the assets.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \param options Metrics to compute.
+        portfolio_risk(const market_data &data, interval_points interval,
+                       int n_periods, risk_options options = {});
+
+      public /* assets */:
+        /// \brief Metrics of the known returns of an asset.
+        [[nodiscard]] const risk_report &report(asset_id id) const;
+        [[nodiscard]] const risk_report &report(std::string_view asset) const;
+
+        /// \brief Risk measure of an asset.
+        [[nodiscard]] double risk(asset_id id) const override;
+        [[nodiscard]] double risk(asset_id id, risk_metric metric) const;
+        [[nodiscard]] double risk(std::string_view asset,
+                                  risk_metric metric) const;
+
+        /// \brief Mean return of an asset.
+        [[nodiscard]] double expected_return(asset_id id) const override;
+        [[nodiscard]] double expected_return(std::string_view asset) const;
+
+      public /* portfolios */:
+        /// \brief Metrics of the returns of a portfolio in the window.
+        /// Masked returns count as zero.
+        /// \param weights Weight of each asset by id.
+        [[nodiscard]] risk_report
+        report(std::span<const double> weights) const;
+
+        /// \brief Risk metric and mean return of a portfolio.
+        /// \param weights Weight of each asset by id.
+        [[nodiscard]] std::pair<double, double>
+        evaluate(std::span<const double> weights) const override;
+
+      public /* getters */:
+        [[nodiscard]] interval_points interval() const;
+        [[nodiscard]] int n_periods() const;
+        [[nodiscard]] const risk_options &options() const;
+        [[nodiscard]] size_t n_assets() const override;
+        [[nodiscard]] const symbol_table &symbols() const override;
+
+      private:
+        /// \brief Id of an asset, which must be in the market data.
+        [[nodiscard]] asset_id id_of(std::string_view asset) const;
+
+        interval_points interval_;
+        int n_periods_;
+        risk_options options_;
+        std::shared_ptr<const symbol_table> symbols_;
+        std::vector<risk_report> reports_;
+        /// \brief Returns of the window, one row of n_periods per asset.
+        std::vector<double> returns_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_PORTFOLIO_RISK_H
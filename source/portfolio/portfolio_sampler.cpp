@@ -0,0 +1,86 @@
+#include "portfolio_sampler.h"
+#include "portfolio/common/parallel.h"
+#include "portfolio/common/philox.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+namespace portfolio {
+    namespace {
+        /// Portfolios per task when sampling in parallel
+        constexpr size_t portfolios_per_task = 1024;
+    } // namespace
+
+    portfolio_sampler::portfolio_sampler(size_t n_assets, uint64_t seed,
+                                         sampling_method method)
+        : n_assets_(n_assets), seed_(seed), method_(method) {}
+
+    void portfolio_sampler::sample(uint64_t first, std::span<double> weights,
+                                   size_t n_threads) const {
+        if (n_assets_ == 0) {
+            return;
+        }
+        if (weights.size() % n_assets_ != 0) {
+            throw std::runtime_error("PORTFOLIO_SAMPLER sample error: weights "
+                                     "are not a whole number of portfolios.");
+        }
+        size_t n_portfolios = weights.size() / n_assets_;
+        size_t n_tasks =
+            (n_portfolios + portfolios_per_task - 1) / portfolios_per_task;
+        parallel_for(n_tasks, n_threads, [&](size_t task) {
+            size_t begin = task * portfolios_per_task;
+            size_t end = std::min(begin + portfolios_per_task, n_portfolios);
+            for (size_t p = begin; p < end; ++p) {
+                sample_one(first + p,
+                           weights.subspan(p * n_assets_, n_assets_));
+            }
+        });
+    }
+
+    std::vector<double> portfolio_sampler::sample(size_t n_portfolios,
+                                                  size_t n_threads) const {
+        std::vector<double> weights(n_portfolios * n_assets_);
+        sample(0, weights, n_threads);
+        return weights;
+    }
+
+    void portfolio_sampler::sample_one(uint64_t index,
+                                       std::span<double> weights) const {
+        if (weights.empty()) {
+            return;
+        }
+        philox_engine engine(seed_, index);
+        double total = 0.0;
+        if (method_ == sampling_method::uniform_simplex) {
+            // Normalized exponentials are uniform on the simplex
+            for (double &w : weights) {
+                w = -std::log1p(-engine.uniform());
+                total += w;
+            }
+        } else {
+            while (total == 0.0) {
+                for (double &w : weights) {
+                    // The lowest bit selects the asset and the highest 53
+                    // bits are the weight
+                    uint64_t hi = engine();
+                    uint64_t lo = engine();
+                    uint64_t bits = hi << 32 | lo;
+                    w = bits & 1 ? static_cast<double>(bits >> 11) * 0x1.0p-53
+                                 : 0.0;
+                    total += w;
+                }
+            }
+        }
+        if (total == 0.0) {
+            return;
+        }
+        for (double &w : weights) {
+            w /= total;
+        }
+    }
+
+    size_t portfolio_sampler::n_assets() const { return n_assets_; }
+
+    uint64_t portfolio_sampler::seed() const { return seed_; }
+
+    sampling_method portfolio_sampler::method() const { return method_; }
+} // namespace portfolio
@@ -0,0 +1,63 @@
+#ifndef PORTFOLIO_PORTFOLIO_SAMPLER_H
+#define PORTFOLIO_PORTFOLIO_SAMPLER_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Distribution of the weights of random portfolios.
+    enum class sampling_method {
+        /// \brief Uniform on the simplex of weights summing to 1.
+        uniform_simplex,
+        /// \brief Each asset is selected with probability 0.5 and gets a
+        /// uniform weight, as the portfolio constructor does. Weights are
+        /// then normalized. At least one asset is selected.
+        binomial_selection
+    };
+
+    /// \brief Generate random portfolios into a dense weights matrix.
+    ///
+    /// Portfolio i is drawn from its own Philox stream of the seed, so the
+    /// weights only depend on the seed and i. Any range of portfolios can
+    /// be generated by any number of threads with the same result.
+    class portfolio_sampler {
+      public /* constructors */:
+        /// \brief Constructor of portfolio_sampler
+        /// \param n_assets Number of weights of each portfolio.
+        /// \param seed Seed of the streams.
+        /// \param method Distribution of the weights.
+        portfolio_sampler(size_t n_assets, uint64_t seed,
+                          sampling_method method =
+                              sampling_method::uniform_simplex);
+
+      public /* sampling */:
+        /// \brief Generate portfolios [first, first + n) into weights.
+        /// \param first Index of the first portfolio.
+        /// \param weights Row-major portfolios x assets matrix to fill,
+        /// whose size defines n.
+        /// \param n_threads Number of threads. 0 uses one thread per
+        /// hardware thread.
+        void sample(uint64_t first, std::span<double> weights,
+                    size_t n_threads = 1) const;
+
+        /// \brief Generate portfolios [0, n_portfolios).
+        /// \return Row-major portfolios x assets matrix.
+        [[nodiscard]] std::vector<double> sample(size_t n_portfolios,
+                                                 size_t n_threads = 1) const;
+
+        /// \brief Generate the weights of one portfolio.
+        void sample_one(uint64_t index, std::span<double> weights) const;
+
+      public /* getters */:
+        [[nodiscard]] size_t n_assets() const;
+        [[nodiscard]] uint64_t seed() const;
+        [[nodiscard]] sampling_method method() const;
+
+      private:
+        size_t n_assets_;
+        uint64_t seed_;
+        sampling_method method_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_PORTFOLIO_SAMPLER_H
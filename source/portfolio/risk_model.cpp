@@ -0,0 +1,18 @@
+#include "risk_model.h"
+#include <stdexcept>
+namespace portfolio {
+    std::pair<double, double>
+    risk_model::weighted_sums(std::span<const double> weights) const {
+        if (weights.size() != n_assets()) {
+            throw std::runtime_error("RISK_MODEL evaluate error: one weight "
+                                     "is needed per asset.");
+        }
+        double total_risk = 0.0;
+        double total_return = 0.0;
+        for (asset_id id = 0; id < weights.size(); ++id) {
+            total_risk += weights[id] * risk(id);
+            total_return += weights[id] * expected_return(id);
+        }
+        return std::make_pair(total_risk, total_return);
+    }
+} // namespace portfolio
@@ -0,0 +1,43 @@
+#ifndef PORTFOLIO_RISK_MODEL_H
+#define PORTFOLIO_RISK_MODEL_H
+
+#include "portfolio/core/symbol_table.h"
+#include <span>
+#include <utility>
+namespace portfolio {
+    /// \brief Risk and expected return of the assets of a model and of
+    /// the portfolios of these assets.
+    ///
+    /// portfolio evaluates its weights with any model of its assets, such
+    /// as portfolio_mad, ewma_model, portfolio_risk or factor_model. Each
+    /// model defines its own measure of risk.
+    class risk_model {
+      public:
+        virtual ~risk_model() = default;
+
+        /// \brief Number of assets, whose ids are [0, n_assets).
+        [[nodiscard]] virtual size_t n_assets() const = 0;
+
+        /// \brief Ids of the assets in the model.
+        [[nodiscard]] virtual const symbol_table &symbols() const = 0;
+
+        /// \brief Risk of an asset.
+        [[nodiscard]] virtual double risk(asset_id id) const = 0;
+
+        /// \brief Expected return of an asset.
+        [[nodiscard]] virtual double expected_return(asset_id id) const = 0;
+
+        /// \brief Risk and expected return of a portfolio.
+        /// \param weights Weight of each asset by id.
+        [[nodiscard]] virtual std::pair<double, double>
+        evaluate(std::span<const double> weights) const = 0;
+
+      protected:
+        /// \brief Sums of the risks and expected returns of the assets
+        /// weighted by a portfolio. The sum of the risks is an upper bound
+        /// of deviations such as the MAD.
+        [[nodiscard]] std::pair<double, double>
+        weighted_sums(std::span<const double> weights) const;
+    };
+} // namespace portfolio
+#endif // PORTFOLIO_RISK_MODEL_H
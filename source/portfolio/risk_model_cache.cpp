@@ -0,0 +1,68 @@
+#include "risk_model_cache.h"
+#include "portfolio_mad.h"
+#include <stdexcept>
+namespace portfolio {
+    risk_model_cache::risk_model_cache(size_t capacity)
+        : capacity_(capacity) {
+        if (capacity == 0) {
+            throw std::runtime_error("RISK_MODEL_CACHE constructor error: "
+                                     "capacity must be at least 1.");
+        }
+    }
+
+    std::shared_ptr<const portfolio_mad>
+    risk_model_cache::mad(const market_data &data, interval_points interval,
+                          int n_periods) {
+        key_type key(interval, n_periods);
+        size_t generation;
+        {
+            std::lock_guard lock(mutex_);
+            auto it = index_.find(key);
+            if (it != index_.end()) {
+                ++hits_;
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return it->second->second;
+            }
+            generation = generation_;
+        }
+        // Models are computed outside the lock, so other windows are not
+        // blocked. If two threads miss the same window, the first model
+        // inserted is the one both return.
+        ++misses_;
+        auto model =
+            std::make_shared<const portfolio_mad>(data, interval, n_periods);
+        std::lock_guard lock(mutex_);
+        if (generation != generation_) {
+            return model;
+        }
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            return it->second->second;
+        }
+        entries_.emplace_front(key, model);
+        index_.emplace(key, entries_.begin());
+        while (entries_.size() > capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        return model;
+    }
+
+    void risk_model_cache::invalidate() {
+        std::lock_guard lock(mutex_);
+        entries_.clear();
+        index_.clear();
+        ++generation_;
+    }
+
+    size_t risk_model_cache::hits() const { return hits_; }
+
+    size_t risk_model_cache::misses() const { return misses_; }
+
+    size_t risk_model_cache::size() const {
+        std::lock_guard lock(mutex_);
+        return entries_.size();
+    }
+
+    size_t risk_model_cache::capacity() const { return capacity_; }
+} // namespace portfolio
@@ -0,0 +1,73 @@
+#ifndef PORTFOLIO_RISK_MODEL_CACHE_H
+#define PORTFOLIO_RISK_MODEL_CACHE_H
+
+#include "portfolio/data_feed/data_feed_result.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+namespace portfolio {
+    class market_data;
+    class portfolio_mad;
+
+    /// \brief Risk models of a market_data shared by all portfolios.
+    ///
+    /// Models are kept in a bounded LRU list keyed by the interval and the
+    /// number of periods. Portfolios evaluated on the same window share
+    /// one model instead of computing their own. Models are immutable, so
+    /// a model stays valid for the portfolios holding it even after it
+    /// leaves the cache.
+    class risk_model_cache {
+      public /* constructors */:
+        /// \brief Constructor of risk_model_cache
+        /// \param capacity Maximum number of models in the cache.
+        explicit risk_model_cache(size_t capacity = 16);
+
+      public /* models */:
+        /// \brief Get the MAD model of a window, computing it on a miss.
+        /// \param data Market data the models are computed from.
+        /// \param interval Interval of the last period of the window.
+        /// \param n_periods Number of periods in the window.
+        /// \return Model shared with other portfolios.
+        std::shared_ptr<const portfolio_mad> mad(const market_data &data,
+                                                 interval_points interval,
+                                                 int n_periods);
+
+        /// \brief Remove all models. This must be called when the data the
+        /// models were computed from changes.
+        void invalidate();
+
+      public /* getters */:
+        /// \brief Number of requests served without computing a model.
+        [[nodiscard]] size_t hits() const;
+
+        /// \brief Number of requests that computed a model.
+        [[nodiscard]] size_t misses() const;
+
+        /// \brief Number of models in the cache.
+        [[nodiscard]] size_t size() const;
+
+        /// \brief Maximum number of models in the cache.
+        [[nodiscard]] size_t capacity() const;
+
+      private:
+        using key_type = std::pair<interval_points, int>;
+        using entry = std::pair<key_type, std::shared_ptr<const portfolio_mad>>;
+        using entry_list = std::list<entry>;
+
+        size_t capacity_;
+        mutable std::mutex mutex_;
+        /// \brief Models from the most to the least recently used.
+        entry_list entries_;
+        std::map<key_type, entry_list::iterator> index_;
+        /// \brief Incremented on invalidation, so models computed from old
+        /// data are not inserted.
+        size_t generation_{0};
+        std::atomic<size_t> hits_{0};
+        std::atomic<size_t> misses_{0};
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_RISK_MODEL_CACHE_H
@@ -0,0 +1,157 @@
+#include "rolling_mad.h"
+#include "portfolio/common/parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+namespace portfolio {
+    namespace {
+        /// Fenwick tree of the count and sum of the returns in the window,
+        /// indexed by rank, so that the returns ranked below any rank are
+        /// found in O(log T)
+        class rank_tree {
+          public:
+            explicit rank_tree(size_t n) : nodes_(n + 1) {}
+
+            void add(size_t rank, int64_t count, double value) {
+                for (size_t i = rank + 1; i < nodes_.size(); i += i & -i) {
+                    nodes_[i].count += count;
+                    nodes_[i].sum += value;
+                }
+            }
+
+            /// Count and sum of the returns ranked below rank
+            std::pair<int64_t, double> prefix(size_t rank) const {
+                int64_t count = 0;
+                double sum = 0.0;
+                for (size_t i = rank; i > 0; i -= i & -i) {
+                    count += nodes_[i].count;
+                    sum += nodes_[i].sum;
+                }
+                return std::make_pair(count, sum);
+            }
+
+          private:
+            struct node {
+                int64_t count{0};
+                double sum{0.0};
+            };
+            std::vector<node> nodes_;
+        };
+    } // namespace
+
+    rolling_mad::rolling_mad(const return_panel &panel, int n_periods,
+                             size_t n_threads)
+        : n_periods_(n_periods), n_assets_(panel.n_assets()) {
+        if (n_periods < 1) {
+            throw std::runtime_error(
+                "ROLLING_MAD constructor error: n_periods must be positive.");
+        }
+        size_t n = static_cast<size_t>(n_periods);
+        size_t total = panel.n_periods();
+        n_windows_ = total < n ? 0 : total - n + 1;
+        auto intervals = panel.intervals();
+        intervals_.assign(intervals.begin() + (n_windows_ ? n - 1 : total),
+                          intervals.end());
+        risk_.resize(n_assets_ * n_windows_);
+        return_.resize(n_assets_ * n_windows_);
+
+        parallel_for(n_assets_, n_threads, [&](size_t k) {
+            auto returns = panel.returns(k);
+            auto mask = panel.mask(k);
+            // Rank of each return among all returns of the asset
+            std::vector<std::pair<double, size_t>> sorted(total);
+            for (size_t t = 0; t < total; ++t) {
+                sorted[t] = std::make_pair(returns[t], t);
+            }
+            std::sort(sorted.begin(), sorted.end());
+            std::vector<size_t> rank(total);
+            std::vector<double> values(total);
+            for (size_t i = 0; i < total; ++i) {
+                rank[sorted[i].second] = i;
+                values[i] = sorted[i].first;
+            }
+            // Returns in the window by rank, and their count and sum
+            rank_tree window(total);
+            size_t count = 0;
+            double sum = 0.0;
+            auto insert = [&](size_t t) {
+                if (mask[t]) {
+                    window.add(rank[t], 1, returns[t]);
+                    ++count;
+                    sum += returns[t];
+                }
+            };
+            auto remove = [&](size_t t) {
+                if (mask[t]) {
+                    window.add(rank[t], -1, -returns[t]);
+                    --count;
+                    sum -= returns[t];
+                }
+            };
+            double *risk = risk_.data() + k * n_windows_;
+            double *expected_return = return_.data() + k * n_windows_;
+            for (size_t t = 0; t < total; ++t) {
+                insert(t);
+                if (t >= n) {
+                    remove(t - n);
+                }
+                if (t + 1 < n) {
+                    continue;
+                }
+                size_t w = t + 1 - n;
+                if (count == 0) {
+                    risk[w] = std::numeric_limits<double>::quiet_NaN();
+                    expected_return[w] = risk[w];
+                    continue;
+                }
+                // Returns ranked below the mean are below the mean
+                double mean = sum / count;
+                size_t mean_rank =
+                    std::lower_bound(values.begin(), values.end(), mean) -
+                    values.begin();
+                auto [below, sum_below] = window.prefix(mean_rank);
+                // sum |r - mean| = (mean * below - sum below) +
+                //                  (sum above - mean * above)
+                double above = static_cast<double>(count) - below;
+                double mad = (mean * below - sum_below) +
+                             ((sum - sum_below) - mean * above);
+                risk[w] = std::max(mad, 0.0) / count;
+                expected_return[w] = mean;
+            }
+        });
+    }
+
+    rolling_mad::rolling_mad(const market_data &data, int n_periods,
+                             size_t n_threads)
+        : rolling_mad(data.returns(), n_periods, n_threads) {}
+
+    size_t rolling_mad::n_assets() const { return n_assets_; }
+
+    int rolling_mad::n_periods() const { return n_periods_; }
+
+    size_t rolling_mad::n_windows() const { return n_windows_; }
+
+    interval_points rolling_mad::interval(size_t window) const {
+        return intervals_[window];
+    }
+
+    size_t rolling_mad::find(interval_points interval) const {
+        auto it =
+            std::lower_bound(intervals_.begin(), intervals_.end(), interval);
+        if (it != intervals_.end() && *it == interval) {
+            return it - intervals_.begin();
+        }
+        return n_windows_;
+    }
+
+    std::span<const double> rolling_mad::risk(size_t asset) const {
+        return {risk_.data() + asset * n_windows_, n_windows_};
+    }
+
+    std::span<const double> rolling_mad::expected_return(size_t asset) const {
+        return {return_.data() + asset * n_windows_, n_windows_};
+    }
+} // namespace portfolio
@@ -0,0 +1,73 @@
+#ifndef PORTFOLIO_ROLLING_MAD_H
+#define PORTFOLIO_ROLLING_MAD_H
+
+#include "market_data.h"
+#include "portfolio/core/return_panel.h"
+#include <span>
+#include <vector>
+namespace portfolio {
+    /// \brief Risk and expected return of each asset in every window of
+    /// n_periods returns, as portfolio_mad computes for one window.
+    ///
+    /// All windows are computed in one pass over the return panel. Each
+    /// asset ranks its returns once and keeps the returns of the window in
+    /// a Fenwick tree of counts and sums indexed by rank. The MAD around
+    /// the mean only needs the count and sum of the returns below the
+    /// mean, so sliding the window and computing the MAD costs O(log T)
+    /// per asset instead of O(n_periods), where T is the number of periods
+    /// of the panel.
+    class rolling_mad {
+      public /* constructors */:
+        /// \brief Constructor of rolling_mad
+        /// \param panel Returns of the assets.
+        /// \param n_periods Number of periods in each window.
+        /// \param n_threads Number of assets computed in parallel. 0 uses
+        /// one thread per hardware thread.
+        rolling_mad(const return_panel &panel, int n_periods,
+                    size_t n_threads = 1);
+
+        /// \brief Constructor of rolling_mad
+        /// \param data Market data whose return panel is used.
+        /// \param n_periods Number of periods in each window.
+        /// \param n_threads Number of assets computed in parallel.
+        rolling_mad(const market_data &data, int n_periods,
+                    size_t n_threads = 1);
+
+      public /* getters */:
+        /// \brief Number of assets, in the order of the return panel.
+        [[nodiscard]] size_t n_assets() const;
+
+        /// \brief Number of periods in each window.
+        [[nodiscard]] int n_periods() const;
+
+        /// \brief Number of windows.
+        [[nodiscard]] size_t n_windows() const;
+
+        /// \brief Interval of the last period of a window.
+        [[nodiscard]] interval_points interval(size_t window) const;
+
+        /// \brief Find the window whose last period ends with this interval.
+        /// \return Index of the window or n_windows() if not found.
+        [[nodiscard]] size_t find(interval_points interval) const;
+
+        /// \brief MAD of an asset in every window. Windows where all
+        /// returns are masked are NaN.
+        [[nodiscard]] std::span<const double> risk(size_t asset) const;
+
+        /// \brief Mean return of an asset in every window. Windows where
+        /// all returns are masked are NaN.
+        [[nodiscard]] std::span<const double>
+        expected_return(size_t asset) const;
+
+      private:
+        int n_periods_;
+        size_t n_assets_;
+        size_t n_windows_;
+        std::vector<interval_points> intervals_;
+        /// \brief Assets x windows matrices.
+        std::vector<double> risk_;
+        std::vector<double> return_;
+    };
+} // namespace portfolio
+
+#endif // PORTFOLIO_ROLLING_MAD_H
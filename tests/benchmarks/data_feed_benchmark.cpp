@@ -4,6 +4,11 @@
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <sstream>
+#include <string>
+
+#include "portfolio/common/algorithm.h"
+#include "portfolio/core/ohlc_prices.h"
 
 void create_vector(benchmark::State &state) {
     for (auto _ : state) {
@@ -14,4 +19,90 @@ void create_vector(benchmark::State &state) {
 
 BENCHMARK(create_vector)->Range(2,2000);
 
+// Bars in the format of the cache files: "<interval>" and "<ohlc>"
+std::vector<std::pair<std::string, std::string>> generate_bars(size_t n) {
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<double> price(10.0, 100.0);
+    std::vector<std::pair<std::string, std::string>> bars;
+    bars.reserve(n);
+    portfolio::minute_point mp =
+        date::sys_days{date::year(2000) / 1 / 1} + std::chrono::hours(10);
+    for (size_t i = 0; i < n; ++i) {
+        portfolio::interval_points interval =
+            std::make_pair(mp, mp + std::chrono::hours(8));
+        portfolio::ohlc_prices ohlc(price(generator), price(generator),
+                                    price(generator), price(generator));
+        bars.emplace_back(portfolio::interval_points_to_string(interval),
+                          ohlc.to_string());
+        mp += std::chrono::hours(24);
+    }
+    return bars;
+}
+
+// Parsing as it was done before std::from_chars
+bool legacy_parse_bar(const std::string &str_interval,
+                      const std::string &str_ohlc,
+                      portfolio::interval_points &interval,
+                      portfolio::ohlc_prices &ohlc) {
+    std::string str(str_interval);
+    std::replace(str.begin(), str.end(), '|', ' ');
+    std::istringstream iss(str);
+    std::vector<std::string> times(std::istream_iterator<std::string>{iss},
+                                   std::istream_iterator<std::string>());
+    for (size_t i = 0; i < 2; ++i) {
+        std::chrono::system_clock::time_point dt;
+        std::stringstream ss(times[i]);
+        ss >> date::parse("%Y-%m-%d_%H-%M", dt);
+        portfolio::minute_point mp =
+            std::chrono::floor<std::chrono::minutes>(dt);
+        (i == 0 ? interval.first : interval.second) = mp;
+    }
+    std::istringstream iss_ohlc(str_ohlc);
+    std::vector<std::string> result(
+        std::istream_iterator<std::string>{iss_ohlc},
+        std::istream_iterator<std::string>());
+    double prices[4];
+    for (size_t i = 0; i < 4; ++i) {
+        if (!portfolio::is_floating(result[i])) {
+            return false;
+        }
+        prices[i] = std::stod(result[i]);
+    }
+    ohlc.set_prices(prices[0], prices[1], prices[2], prices[3]);
+    return true;
+}
+
+void parse_bars_legacy(benchmark::State &state) {
+    auto bars = generate_bars(state.range(0));
+    portfolio::interval_points interval;
+    portfolio::ohlc_prices ohlc;
+    for (auto _ : state) {
+        for (const auto &[str_interval, str_ohlc] : bars) {
+            legacy_parse_bar(str_interval, str_ohlc, interval, ohlc);
+            benchmark::DoNotOptimize(interval);
+            benchmark::DoNotOptimize(ohlc);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * bars.size());
+}
+
+BENCHMARK(parse_bars_legacy)->Range(64, 4096);
+
+void parse_bars(benchmark::State &state) {
+    auto bars = generate_bars(state.range(0));
+    portfolio::interval_points interval;
+    portfolio::ohlc_prices ohlc;
+    for (auto _ : state) {
+        for (const auto &[str_interval, str_ohlc] : bars) {
+            interval = portfolio::string_to_interval_points(str_interval);
+            ohlc.from_string(str_ohlc);
+            benchmark::DoNotOptimize(interval);
+            benchmark::DoNotOptimize(ohlc);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * bars.size());
+}
+
+BENCHMARK(parse_bars)->Range(64, 4096);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,510 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <filesystem>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "portfolio/batch_evaluator.h"
+#include "portfolio/covariance_matrix.h"
+#include "portfolio/data_feed/mock_data_feed.h"
+#include "portfolio/delta_evaluator.h"
+#include "portfolio/ewma_model.h"
+#include "portfolio/factor_model.h"
+#include "portfolio/market_data.h"
+#include "portfolio/monte_carlo_simulator.h"
+#include "portfolio/optimization/mad_optimizer.h"
+#include "portfolio/optimization/nsga2.h"
+#include "portfolio/optimization/pareto_archive.h"
+#include "portfolio/portfolio_risk.h"
+#include "portfolio/portfolio.h"
+#include "portfolio/portfolio_sampler.h"
+#include "portfolio/rolling_mad.h"
+
+// Market data shared by the benchmarks: 64 assets over two years
+const portfolio::market_data &benchmark_market_data() {
+    using namespace std::chrono_literals;
+    static portfolio::mock_data_feed df;
+    static portfolio::market_data md = []() {
+        std::vector<std::string> assets;
+        for (int i = 0; i < 64; ++i) {
+            assets.emplace_back("ASSET" + std::to_string(i));
+        }
+        portfolio::minute_point mp_start =
+            date::sys_days{date::year(2019) / 1 / 1} + 10h;
+        portfolio::minute_point mp_end =
+            date::sys_days{date::year(2020) / 12 / 31} + 18h;
+        return portfolio::market_data(assets, df, mp_start, mp_end,
+                                      portfolio::timeframe::daily);
+    }();
+    return md;
+}
+
+portfolio::interval_points benchmark_interval() {
+    const portfolio::return_panel &panel = benchmark_market_data().returns();
+    return panel.intervals()[panel.n_periods() - 1];
+}
+
+// One portfolio at a time, with string-keyed lookups per asset
+void evaluate_mad(benchmark::State &state) {
+    const portfolio::market_data &md = benchmark_market_data();
+    portfolio::portfolio p(md);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            p.evaluate_mad(md, benchmark_interval(), state.range(0)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(evaluate_mad)->Arg(60)->Arg(250);
+
+// Hill climbing on the risk with transfers between two assets
+void delta_hill_climbing(benchmark::State &state) {
+    const portfolio::market_data &md = benchmark_market_data();
+    std::vector<double> weights(md.n_assets(), 1.0 / md.n_assets());
+    portfolio::delta_evaluator evaluator(md, benchmark_interval(),
+                                         state.range(0), weights);
+    std::default_random_engine generator(42);
+    std::uniform_int_distribution<portfolio::asset_id> asset(
+        0, md.n_assets() - 1);
+    std::uniform_real_distribution<double> ud(0.0, 0.01);
+    for (auto _ : state) {
+        portfolio::asset_id from = asset(generator);
+        portfolio::asset_id to = asset(generator);
+        double amount = ud(generator);
+        if (evaluator.evaluate_transfer(from, to, amount).first <
+            evaluator.risk()) {
+            evaluator.transfer(from, to, amount);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(delta_hill_climbing)->Arg(60)->Arg(250);
+
+// Dense weights matrix evaluated in blocks
+void batch_evaluate(benchmark::State &state, portfolio::mad_kind kind) {
+    const portfolio::market_data &md = benchmark_market_data();
+    portfolio::batch_evaluator evaluator(md, benchmark_interval(),
+                                         state.range(0));
+    const size_t n_portfolios = 1024;
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    std::vector<double> weights(n_portfolios * evaluator.n_assets());
+    for (double &w : weights) {
+        w = ud(generator);
+    }
+    std::vector<double> risk(n_portfolios);
+    std::vector<double> expected_return(n_portfolios);
+    for (auto _ : state) {
+        evaluator.evaluate(weights, risk, expected_return, kind);
+        benchmark::DoNotOptimize(risk.data());
+        benchmark::DoNotOptimize(expected_return.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n_portfolios);
+}
+
+BENCHMARK_CAPTURE(batch_evaluate, asset_weighted,
+                  portfolio::mad_kind::asset_weighted)
+    ->Arg(60)
+    ->Arg(250);
+BENCHMARK_CAPTURE(batch_evaluate, portfolio, portfolio::mad_kind::portfolio)
+    ->Arg(60)
+    ->Arg(250);
+
+// Risk and return of every window, one portfolio_mad per window
+void sliding_portfolio_mad(benchmark::State &state) {
+    const portfolio::market_data &md = benchmark_market_data();
+    const portfolio::return_panel &panel = md.returns();
+    int n_periods = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        for (size_t t = n_periods - 1; t < panel.n_periods(); ++t) {
+            portfolio::portfolio_mad mad(md, panel.intervals()[t], n_periods);
+            benchmark::DoNotOptimize(mad);
+        }
+    }
+}
+
+BENCHMARK(sliding_portfolio_mad)->Arg(60)->Arg(250);
+
+// Risk and return of every window in one pass
+void sliding_rolling_mad(benchmark::State &state) {
+    const portfolio::market_data &md = benchmark_market_data();
+    for (auto _ : state) {
+        portfolio::rolling_mad rolling(md, static_cast<int>(state.range(0)));
+        benchmark::DoNotOptimize(rolling);
+    }
+}
+
+BENCHMARK(sliding_rolling_mad)->Arg(60)->Arg(250);
+
+// Long history shared by the benchmarks: 8 assets x 50000 hourly returns
+const portfolio::return_panel &benchmark_long_history() {
+    using namespace std::chrono_literals;
+    static portfolio::return_panel panel = []() {
+        const int n_assets = 8;
+        const int n_bars = 50001;
+        std::default_random_engine generator(42);
+        std::normal_distribution<double> nd(0.0, 0.002);
+        std::vector<std::string> assets;
+        std::vector<portfolio::price_series> series(n_assets);
+        for (int i = 0; i < n_assets; ++i) {
+            assets.emplace_back("ASSET" + std::to_string(i));
+            double price = 100.0;
+            for (int hour = 0; hour < n_bars; ++hour) {
+                portfolio::minute_point start =
+                    date::sys_days{date::year(2015) / 1 / 1} + 1h * hour;
+                price *= 1.0 + nd(generator);
+                series[i].push_back(std::make_pair(start, start + 1h),
+                                    portfolio::ohlc_prices(price, price,
+                                                           price, price));
+            }
+        }
+        std::vector<portfolio::price_view> views(series.begin(),
+                                                 series.end());
+        return portfolio::return_panel(assets, views);
+    }();
+    return panel;
+}
+
+// Short windows over a long history
+void rolling_mad_long_history(benchmark::State &state) {
+    const portfolio::return_panel &panel = benchmark_long_history();
+    for (auto _ : state) {
+        portfolio::rolling_mad rolling(panel, int(state.range(0)));
+        benchmark::DoNotOptimize(rolling);
+    }
+    state.SetItemsProcessed(state.iterations() * panel.n_assets() *
+                            panel.n_periods());
+}
+
+BENCHMARK(rolling_mad_long_history)
+    ->Arg(20)
+    ->Arg(250)
+    ->Unit(benchmark::kMillisecond);
+
+// Random portfolios built one at a time
+void construct_portfolios(benchmark::State &state) {
+    const portfolio::market_data &md = benchmark_market_data();
+    for (auto _ : state) {
+        for (int i = 0; i < 1024; ++i) {
+            portfolio::portfolio p(md);
+            benchmark::DoNotOptimize(p);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+
+BENCHMARK(construct_portfolios);
+
+// Random portfolios generated into a weights matrix
+void sample_portfolios(benchmark::State &state) {
+    portfolio::portfolio_sampler sampler(
+        64, 42, portfolio::sampling_method::binomial_selection);
+    const size_t n_portfolios = 16384;
+    std::vector<double> weights(n_portfolios * sampler.n_assets());
+    for (auto _ : state) {
+        sampler.sample(0, weights, state.range(0));
+        benchmark::DoNotOptimize(weights.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n_portfolios);
+}
+
+BENCHMARK(sample_portfolios)->Arg(1)->Arg(4)->UseRealTime();
+
+// Generations of NSGA-II with the portfolio MAD, by number of threads
+void nsga2_generations(benchmark::State &state) {
+    portfolio::batch_evaluator evaluator(benchmark_market_data(),
+                                         benchmark_interval(), 250);
+    portfolio::nsga2_options options;
+    options.population_size = 512;
+    options.n_generations = 10;
+    options.kind = portfolio::mad_kind::portfolio;
+    options.n_threads = state.range(0);
+    portfolio::nsga2 optimizer(evaluator, options);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(optimizer.run());
+    }
+    state.SetItemsProcessed(state.iterations() * options.population_size *
+                            (options.n_generations + 1));
+}
+
+BENCHMARK(nsga2_generations)->Arg(1)->Arg(4)->UseRealTime();
+
+// Exact 100-point MAD frontier, warm started along the targets
+void mad_frontier(benchmark::State &state) {
+    for (auto _ : state) {
+        portfolio::mad_optimizer optimizer(benchmark_market_data(),
+                                           benchmark_interval(),
+                                           state.range(0));
+        benchmark::DoNotOptimize(optimizer.frontier(100));
+    }
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+
+BENCHMARK(mad_frontier)->Arg(60)->Arg(250)->Unit(benchmark::kMillisecond);
+
+// The same targets solved from scratch
+void mad_frontier_cold(benchmark::State &state) {
+    const portfolio::market_data &md = benchmark_market_data();
+    std::vector<double> targets;
+    for (const auto &point :
+         portfolio::mad_optimizer(md, benchmark_interval(), state.range(0))
+             .frontier(100)) {
+        targets.push_back(point.expected_return);
+    }
+    for (auto _ : state) {
+        for (double target : targets) {
+            portfolio::mad_optimizer optimizer(md, benchmark_interval(),
+                                               state.range(0));
+            benchmark::DoNotOptimize(optimizer.minimize(target));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * targets.size());
+}
+
+BENCHMARK(mad_frontier_cold)
+    ->Arg(60)
+    ->Arg(250)
+    ->Unit(benchmark::kMillisecond);
+
+// Frontier of an intraday window of thousands of periods
+void mad_frontier_long_window(benchmark::State &state) {
+    const portfolio::return_panel &panel = benchmark_long_history();
+    for (auto _ : state) {
+        portfolio::mad_optimizer optimizer(panel, panel.intervals().back(),
+                                           state.range(0));
+        benchmark::DoNotOptimize(optimizer.frontier(20));
+    }
+    state.SetItemsProcessed(state.iterations() * 20);
+}
+
+BENCHMARK(mad_frontier_long_window)->Arg(5000)->Unit(benchmark::kMillisecond);
+
+// Front of millions of portfolios of 16 assets near a concave curve
+const portfolio::pareto_archive &benchmark_front() {
+    static portfolio::pareto_archive archive = []() {
+        portfolio::pareto_archive archive(16);
+        std::default_random_engine generator(42);
+        std::uniform_real_distribution<double> ud(0.0, 1.0);
+        std::vector<double> weights(16, 1.0 / 16);
+        for (int i = 0; i < 4000000; ++i) {
+            double risk = ud(generator);
+            archive.insert(risk, std::sqrt(risk) - 1e-7 * ud(generator),
+                           weights);
+        }
+        return archive;
+    }();
+    return archive;
+}
+
+void pareto_insert(benchmark::State &state) {
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    std::vector<double> weights(16, 1.0 / 16);
+    portfolio::pareto_archive archive(16);
+    for (auto _ : state) {
+        double risk = ud(generator);
+        benchmark::DoNotOptimize(archive.insert(
+            risk, std::sqrt(risk) - 1e-7 * ud(generator), weights));
+    }
+    state.counters["front"] = static_cast<double>(archive.size());
+}
+
+BENCHMARK(pareto_insert);
+
+// Queries on a front file opened with mmap
+void pareto_snapshot_queries(benchmark::State &state) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() /
+                                 "portfolio_benchmark_front.pareto";
+    benchmark_front().save(path);
+    portfolio::pareto_snapshot snapshot;
+    snapshot.open(path);
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    for (auto _ : state) {
+        double risk = ud(generator);
+        benchmark::DoNotOptimize(snapshot.best_return(risk));
+        benchmark::DoNotOptimize(
+            snapshot.nearest(risk, std::sqrt(risk), state.range(0)));
+    }
+    state.counters["front"] = static_cast<double>(snapshot.size());
+    snapshot.close();
+    std::filesystem::remove(path);
+}
+
+BENCHMARK(pareto_snapshot_queries)->Arg(1)->Arg(10);
+
+// Returns of 2000 assets over 1000 daily bars
+const portfolio::return_panel &benchmark_large_panel() {
+    using namespace std::chrono_literals;
+    static portfolio::return_panel panel = []() {
+        const int n_assets = 2000;
+        const int n_bars = 1001;
+        std::default_random_engine generator(42);
+        std::normal_distribution<double> nd(0.0, 0.01);
+        std::vector<std::string> assets;
+        std::vector<portfolio::price_series> series(n_assets);
+        for (int i = 0; i < n_assets; ++i) {
+            assets.emplace_back("ASSET" + std::to_string(i));
+            double price = 100.0;
+            for (int day = 0; day < n_bars; ++day) {
+                portfolio::minute_point start =
+                    date::sys_days{date::year(2018) / 1 / 1} + 24h * day;
+                price *= 1.0 + nd(generator);
+                series[i].push_back(std::make_pair(start, start + 8h),
+                                    portfolio::ohlc_prices(price, price,
+                                                           price, price));
+            }
+        }
+        std::vector<portfolio::price_view> views(series.begin(),
+                                                 series.end());
+        return portfolio::return_panel(assets, views);
+    }();
+    return panel;
+}
+
+void covariance(benchmark::State &state) {
+    const portfolio::return_panel &panel = benchmark_large_panel();
+    portfolio::covariance_options options;
+    options.shrinkage = portfolio::shrinkage_method::ledoit_wolf;
+    options.n_threads = state.range(0);
+    for (auto _ : state) {
+        portfolio::covariance_matrix cov(panel, panel.intervals().back(),
+                                         int(panel.n_periods()), options);
+        benchmark::DoNotOptimize(cov.variance(0));
+    }
+}
+
+BENCHMARK(covariance)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// One new bar per iteration, as in a streaming deployment
+void ewma_update(benchmark::State &state) {
+    using namespace std::chrono_literals;
+    const portfolio::return_panel &panel = benchmark_large_panel();
+    const size_t n_assets = state.range(0);
+    std::vector<std::string> assets(panel.assets().begin(),
+                                    panel.assets().begin() + n_assets);
+    portfolio::ewma_model model(
+        std::make_shared<const portfolio::symbol_table>(assets));
+    std::vector<double> returns(n_assets);
+    portfolio::interval_points interval = panel.intervals().front();
+    size_t t = 0;
+    for (auto _ : state) {
+        for (size_t k = 0; k < n_assets; ++k) {
+            returns[k] = panel.returns(k)[t];
+        }
+        interval.first += 15min;
+        interval.second += 15min;
+        model.update(interval, returns);
+        t = (t + 1) % panel.n_periods();
+    }
+    benchmark::DoNotOptimize(model.variance(0));
+}
+
+BENCHMARK(ewma_update)->Arg(64)->Arg(500)->Arg(2000);
+
+void factor_model_fit(benchmark::State &state) {
+    const portfolio::return_panel &panel = benchmark_large_panel();
+    portfolio::factor_model_options options;
+    options.n_factors = 20;
+    options.n_threads = state.range(0);
+    for (auto _ : state) {
+        portfolio::factor_model model(panel, panel.intervals().back(),
+                                      int(panel.n_periods()), options);
+        benchmark::DoNotOptimize(model.factor_variance(0));
+    }
+}
+
+BENCHMARK(factor_model_fit)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// O(n k) per portfolio, against O(n^2) with the full covariance matrix
+void factor_model_variance(benchmark::State &state) {
+    const portfolio::return_panel &panel = benchmark_large_panel();
+    static portfolio::factor_model model(panel, panel.intervals().back(),
+                                         int(panel.n_periods()),
+                                         {.n_factors = 20});
+    std::vector<double> weights(model.n_assets(), 1.0 / model.n_assets());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.portfolio_variance(weights));
+    }
+}
+
+BENCHMARK(factor_model_variance);
+
+// VaR and CVaR of 1000 portfolios of 2000 assets over 10000 scenarios
+void monte_carlo_tail_risk(benchmark::State &state) {
+    const portfolio::return_panel &panel = benchmark_large_panel();
+    static portfolio::factor_model model(panel, panel.intervals().back(),
+                                         int(panel.n_periods()),
+                                         {.n_factors = 20});
+    portfolio::monte_carlo_options options;
+    options.n_threads = state.range(0);
+    portfolio::monte_carlo_simulator simulator(model, options);
+    const size_t n_portfolios = 1000;
+    portfolio::portfolio_sampler sampler(model.n_assets(), 42);
+    std::vector<double> weights = sampler.sample(n_portfolios);
+    for (auto _ : state) {
+        portfolio::tail_risk risk = simulator.simulate(weights);
+        benchmark::DoNotOptimize(risk.value_at_risk.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n_portfolios);
+}
+
+BENCHMARK(monte_carlo_tail_risk)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// All metrics of a stream of 10000 returns in one kernel (0), against
+// one kernel per metric (1)
+void risk_kernel_metrics(benchmark::State &state) {
+    std::default_random_engine generator(42);
+    std::normal_distribution<double> nd(0.0005, 0.01);
+    std::vector<double> returns(10000);
+    for (double &r : returns) {
+        r = nd(generator);
+    }
+    const portfolio::risk_options none{.mad = false,
+                                       .standard_deviation = false,
+                                       .semi_deviation = false,
+                                       .max_drawdown = false,
+                                       .conditional_value_at_risk = false,
+                                       .sharpe_ratio = false};
+    std::vector<portfolio::risk_kernel> kernels;
+    if (state.range(0) == 0) {
+        kernels.emplace_back();
+    } else {
+        for (auto metric : {&portfolio::risk_options::mad,
+                            &portfolio::risk_options::standard_deviation,
+                            &portfolio::risk_options::semi_deviation,
+                            &portfolio::risk_options::max_drawdown,
+                            &portfolio::risk_options::conditional_value_at_risk,
+                            &portfolio::risk_options::sharpe_ratio}) {
+            portfolio::risk_options options = none;
+            options.*metric = true;
+            kernels.emplace_back(options);
+        }
+    }
+    for (auto _ : state) {
+        for (auto &kernel : kernels) {
+            benchmark::DoNotOptimize(kernel(returns).mean);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * returns.size());
+}
+
+BENCHMARK(risk_kernel_metrics)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
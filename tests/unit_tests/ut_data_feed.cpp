@@ -1,11 +1,23 @@
 #define CATCH_CONFIG_MAIN
 
 #include "portfolio/common/algorithm.h"
+#include "portfolio/common/token_bucket.h"
 #include "portfolio/data_feed/alphavantage_data_feed.h"
+#include "portfolio/data_feed/alphavantage_parser.h"
+#include "portfolio/data_feed/cache_manifest.h"
+#include "portfolio/data_feed/cached_data_feed.h"
 #include "portfolio/data_feed/mock_data_feed.h"
+#include "portfolio/data_feed/request_scheduler.h"
+#include "portfolio/data_feed/series_file.h"
 #include "portfolio/market_data.h"
+#include <algorithm>
 #include <catch2/catch.hpp>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <nlohmann/json.hpp>
 TEST_CASE("Mock Data Feed") {
     using namespace portfolio;
     using namespace date::literals;
@@ -316,6 +328,294 @@ TEST_CASE("Data Feed") {
                 r_hourly.find_prices_from(interval)->second);
     }
 }
+TEST_CASE("Price Series") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    mock_data_feed m;
+
+    minute_point mp_start = date::sys_days{2019_y / 01 / 01} + 10h + 0min;
+    minute_point mp_end = date::sys_days{2019_y / 12 / 31} + 18h + 0min;
+
+    data_feed_result r_daily =
+        m.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+    const price_view &s = r_daily.series();
+
+    // The columns and the compatibility iterators describe the same bars
+    SECTION("COLUMNS") {
+        REQUIRE(s.size() == s.closes().size());
+        REQUIRE(static_cast<size_t>(r_daily.end() - r_daily.begin()) ==
+                s.size());
+        size_t i = 0;
+        for (auto it = r_daily.begin(); it != r_daily.end(); ++it, ++i) {
+            REQUIRE(it->first == s.interval(i));
+            REQUIRE(it->second.close() == s.closes()[i]);
+        }
+        REQUIRE(std::is_sorted(s.starts().begin(), s.starts().end()));
+    }
+
+    // Lookups by interval are binary searches over the start column
+    SECTION("FIND") {
+        interval_points interval =
+            std::make_pair(date::sys_days{2019_y / 06 / 03} + 10h,
+                           date::sys_days{2019_y / 06 / 03} + 18h);
+        size_t i = s.find(interval);
+        REQUIRE(i != s.size());
+        REQUIRE(r_daily.find_prices_from(interval).index() == i);
+        REQUIRE(s.lower_bound(interval.first) == i);
+        interval.second += 1min;
+        REQUIRE(s.find(interval) == s.size());
+    }
+
+    // Bars can only be appended in chronological order
+    SECTION("ORDER") {
+        price_series ps;
+        ps.push_back(mp_end, mp_end + 8h, 1, 2, 0.5, 1.5);
+        REQUIRE_THROWS(ps.push_back(mp_start, mp_start + 8h, 1, 2, 0.5, 1.5));
+        REQUIRE(ps.size() == 1);
+    }
+}
+TEST_CASE("Price View") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    mock_data_feed m;
+
+    minute_point mp_start = date::sys_days{2019_y / 01 / 01} + 10h + 0min;
+    minute_point mp_end = date::sys_days{2019_y / 12 / 31} + 18h + 0min;
+
+    data_feed_result r_daily =
+        m.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+    const price_view &all = r_daily.series();
+    minute_point s_start = date::sys_days{2019_y / 03 / 01} + 10h;
+    minute_point s_end = date::sys_days{2019_y / 06 / 30} + 18h;
+
+    // Slices and copies share the bars of the series
+    SECTION("SHARING") {
+        price_view v = all.slice(s_start, s_end);
+        REQUIRE(v.shared_series() == all.shared_series());
+        REQUIRE(v.closes().data() ==
+                all.closes().data() + all.lower_bound(s_start));
+        data_feed_result copy = r_daily;
+        REQUIRE(copy.series().shared_series() == all.shared_series());
+        REQUIRE(v == all.to_series().slice(s_start, s_end));
+    }
+
+    // Indexes are relative to the view
+    SECTION("INDEXES") {
+        price_view v = all.slice(s_start, s_end);
+        REQUIRE(!v.empty());
+        REQUIRE(v.starts().front() >= s_start);
+        REQUIRE(v.ends().back() <= s_end);
+        REQUIRE(v.find(v.interval(2)) == 2);
+        REQUIRE(v.find(all.interval(0)) == v.size());
+        price_view sub = v.subview(1, 3);
+        REQUIRE(sub.size() == 2);
+        REQUIRE(sub.prices(0) == v.prices(1));
+        REQUIRE(static_cast<size_t>(sub.end() - sub.begin()) == 2);
+        REQUIRE_THROWS(v.subview(0, v.size() + 1));
+        REQUIRE(all.slice(s_end, s_start).empty());
+    }
+}
+
+TEST_CASE("Series File") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "portfolio_ut_series_file";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    mock_data_feed m;
+    minute_point mp_start = date::sys_days{2019_y / 01 / 01} + 10h + 0min;
+    minute_point mp_end = date::sys_days{2019_y / 12 / 31} + 18h + 0min;
+    data_feed_result r_daily =
+        m.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+
+    // Series written to disk are read back bar by bar
+    SECTION("ROUND TRIP") {
+        std::filesystem::path fp =
+            dir / series_filename("PETR4", timeframe::daily);
+        REQUIRE(series_file::write(fp, r_daily.series(), timeframe::daily));
+        series_file f;
+        REQUIRE(f.open(fp));
+        REQUIRE(f.tf() == timeframe::daily);
+        REQUIRE(f.size() == r_daily.series().size());
+        REQUIRE(f.read() == r_daily.series());
+        REQUIRE(f.covers(mp_start, mp_end));
+        REQUIRE_FALSE(f.covers(mp_start - 24h, mp_end));
+
+        // Slices only keep bars inside the period
+        minute_point s_start = date::sys_days{2019_y / 03 / 01} + 0h;
+        minute_point s_end = date::sys_days{2019_y / 03 / 31} + 0h;
+        price_series s = f.slice(s_start, s_end);
+        REQUIRE_FALSE(s.empty());
+        REQUIRE(s.starts().front() >= s_start);
+        REQUIRE(s.ends().back() <= s_end);
+        size_t first = r_daily.series().lower_bound(s_start);
+        REQUIRE(s.interval(0) == r_daily.series().interval(first));
+        REQUIRE(f.slice(s_end, s_start).empty());
+    }
+
+    // Anything that is not a series file is rejected
+    SECTION("INVALID FILE") {
+        std::filesystem::path fp = dir / "invalid.series";
+        std::ofstream(fp) << "not a series file";
+        series_file f;
+        REQUIRE_FALSE(f.open(fp));
+        REQUIRE_FALSE(f.open(dir / "missing.series"));
+    }
+
+    // JSON data files from older versions are converted
+    SECTION("JSON CONVERSION") {
+        std::filesystem::path fp = dir / set_filename("PETR4.SAO",
+                                                      "2019-01-02_10-00",
+                                                      "2019-01-03_18-00",
+                                                      timeframe::daily);
+        std::ofstream(fp)
+            << R"({"2019-01-02_10-00|2019-01-02_18-00":"1.0 2.0 0.5 1.5",)"
+            << R"("2019-01-03_10-00|2019-01-03_18-00":"1.5 2.5 1.0 2.0"})";
+        REQUIRE(convert_json_cache(dir) == 1);
+        REQUIRE_FALSE(std::filesystem::exists(fp));
+        series_file f;
+        REQUIRE(f.open(dir / series_filename("PETR4.SAO", timeframe::daily)));
+        price_series s = f.read();
+        REQUIRE(s.size() == 2);
+        REQUIRE(s.prices(1) == ohlc_prices(1.5, 2.5, 1.0, 2.0));
+        REQUIRE(s.interval(0).first ==
+                date::sys_days{2019_y / 01 / 02} + 10h + 0min);
+    }
+
+    // New bars are merged into the slack of the columns or grow the file
+    SECTION("EXTEND") {
+        std::filesystem::path fp =
+            dir / series_filename("PETR4", timeframe::daily);
+        const price_series all = r_daily.series().to_series();
+        size_t half = all.size() / 2;
+        price_series head = all.slice(all.starts().front(),
+                                      all.ends()[half - 1]);
+        REQUIRE(head.size() == half);
+        REQUIRE(series_file::write(fp, head, timeframe::daily, half + 10));
+        auto file_size = std::filesystem::file_size(fp);
+
+        // The last bar is replaced, older bars are ignored
+        price_series tail =
+            all.slice(all.starts()[half - 5], all.ends()[half + 4]);
+        REQUIRE(series_file::extend(fp, tail));
+        REQUIRE(std::filesystem::file_size(fp) == file_size);
+        series_file f;
+        REQUIRE(f.open(fp));
+        REQUIRE(f.size() == half + 5);
+        REQUIRE(f.read() == all.slice(all.starts().front(),
+                                      all.ends()[half + 4]));
+        f.close();
+
+        // A bar with the same start updates the last bar. The file is
+        // replaced, so a reader that mapped it still sees the whole old bar.
+        price_series update;
+        update.push_back(all.interval(half + 4), ohlc_prices(1., 2., .5, 1.5));
+        series_file reader;
+        REQUIRE(reader.open(fp));
+        REQUIRE(series_file::extend(fp, update));
+        REQUIRE(reader.read().prices(half + 4) == all.prices(half + 4));
+        REQUIRE(f.open(fp));
+        REQUIRE(f.size() == half + 5);
+        REQUIRE(std::filesystem::file_size(fp) == file_size);
+        REQUIRE(f.read().prices(half + 4) == ohlc_prices(1., 2., .5, 1.5));
+        f.close();
+        reader.close();
+        for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+            REQUIRE(entry.path().extension() != ".tmp");
+        }
+
+        // Bars beyond the capacity grow the file
+        REQUIRE(series_file::extend(fp, all));
+        REQUIRE(std::filesystem::file_size(fp) > file_size);
+        REQUIRE(f.open(fp));
+        REQUIRE(f.read() == all);
+    }
+    std::filesystem::remove_all(dir);
+}
+TEST_CASE("Cache Manifest") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "portfolio_ut_manifest";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    mock_data_feed m;
+    minute_point mp_start = date::sys_days{2019_y / 01 / 01} + 10h + 0min;
+    minute_point mp_end = date::sys_days{2019_y / 12 / 31} + 18h + 0min;
+    data_feed_result r_weekly =
+        m.fetch("VALE3.SAO", mp_start, mp_end, timeframe::weekly);
+    std::string filename = series_filename("VALE3.SAO", timeframe::weekly);
+    REQUIRE(series_file::write(dir / filename, r_weekly.series(),
+                               timeframe::weekly));
+
+    {
+        // Without a manifest file, the manifest is rebuilt from the
+        // directory and the same manifest is shared by all users
+        auto manifest = cache_manifest::open(dir);
+        REQUIRE(manifest == cache_manifest::open(dir));
+        REQUIRE(std::filesystem::exists(dir /
+                                        cache_manifest::manifest_filename));
+        auto entry = manifest->find("VALE3.SAO", timeframe::weekly);
+        REQUIRE(entry.has_value());
+        REQUIRE(entry->filename == filename);
+        REQUIRE(entry->size == r_weekly.series().size());
+        REQUIRE(entry->first_start == r_weekly.series().starts().front());
+        REQUIRE(entry->last_end == r_weekly.series().ends().back());
+        REQUIRE(entry->covers(r_weekly.series().starts().front(),
+                              r_weekly.series().ends().back()));
+        REQUIRE_FALSE(manifest->find("VALE3.SAO", timeframe::daily));
+        manifest->insert("PETR4.SAO", timeframe::daily,
+                         cache_entry{"PETR4.SAO.DAILY.series", mp_start,
+                                     mp_end, 10});
+        manifest->erase("VALE3.SAO", timeframe::weekly);
+    }
+
+    // Once saved, the manifest is loaded from its file without looking at
+    // the series files
+    std::filesystem::remove(dir / filename);
+    auto manifest = cache_manifest::open(dir);
+    REQUIRE(manifest->size() == 1);
+    auto entry = manifest->find("PETR4.SAO", timeframe::daily);
+    REQUIRE(entry.has_value());
+    REQUIRE(entry->first_start == mp_start);
+    REQUIRE(entry->last_end == mp_end);
+    REQUIRE(entry->size == 10);
+    REQUIRE_FALSE(manifest->find("VALE3.SAO", timeframe::weekly));
+
+    // Manifests of other processes append their entries to the same file
+    cache_manifest other(dir);
+    other.insert("ITUB4.SAO", timeframe::daily,
+                 cache_entry{"ITUB4.SAO.DAILY.series", mp_start, mp_end, 20});
+    REQUIRE(manifest->find("ITUB4.SAO", timeframe::daily).has_value());
+    manifest->insert("BBDC4.SAO", timeframe::daily,
+                     cache_entry{"BBDC4.SAO.DAILY.series", mp_start, mp_end,
+                                 30});
+    REQUIRE(other.size() == 3);
+    other.erase("PETR4.SAO", timeframe::daily);
+    REQUIRE_FALSE(manifest->find("PETR4.SAO", timeframe::daily));
+
+    // Compacting the file keeps the entries of all processes
+    for (size_t i = 1; i <= 200; ++i) {
+        other.insert("ITUB4.SAO", timeframe::daily,
+                     cache_entry{"ITUB4.SAO.DAILY.series", mp_start, mp_end,
+                                 20 + i});
+    }
+    REQUIRE(std::filesystem::file_size(dir /
+                                       cache_manifest::manifest_filename) <
+            100 * 64);
+    REQUIRE(manifest->size() == 2);
+    REQUIRE(manifest->find("ITUB4.SAO", timeframe::daily)->size == 220);
+    REQUIRE(manifest->find("BBDC4.SAO", timeframe::daily)->size == 30);
+    manifest.reset();
+    std::filesystem::remove_all(dir);
+}
 TEST_CASE("Is_floating") {
     std::string_view valid1("2");
     std::string_view valid2("+2");
@@ -351,6 +651,388 @@ TEST_CASE("Is_floating") {
         REQUIRE_FALSE(portfolio::is_floating(invalid6));
     }
 }
+TEST_CASE("Parsing") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    SECTION("DOUBLES") {
+        double value = 0.0;
+        REQUIRE(parse_double("227.909", value));
+        REQUIRE(value == 227.909);
+        REQUIRE(parse_double("+2", value));
+        REQUIRE(value == 2.0);
+        REQUIRE(parse_double("-227.909", value));
+        REQUIRE(value == -227.909);
+        REQUIRE(parse_double("1.5e-3", value));
+        REQUIRE(value == 1.5e-3);
+        REQUIRE(parse_double("2E2", value));
+        REQUIRE(value == 200.0);
+        REQUIRE(parse_double(".5", value));
+        REQUIRE(value == 0.5);
+        REQUIRE_FALSE(parse_double("", value));
+        REQUIRE_FALSE(parse_double("a", value));
+        REQUIRE_FALSE(parse_double("2a.9", value));
+        REQUIRE_FALSE(parse_double("2.9.9", value));
+        REQUIRE_FALSE(parse_double("+-2", value));
+        REQUIRE_FALSE(parse_double(" 2", value));
+        REQUIRE_FALSE(parse_double("2,5", value));
+        REQUIRE_FALSE(parse_double("inf", value));
+        REQUIRE_FALSE(parse_double("nan", value));
+        REQUIRE(value == 0.5);
+    }
+    SECTION("TIME POINTS") {
+        date::sys_days day;
+        REQUIRE(parse_date("2021-03-15", day));
+        REQUIRE(day == date::sys_days{2021_y / 03 / 15});
+        REQUIRE_FALSE(parse_date("2021-02-30", day));
+        REQUIRE_FALSE(parse_date("2021-3-15", day));
+        REQUIRE_FALSE(parse_date("2021/03/15", day));
+        minute_point mp;
+        REQUIRE(parse_minute_point("2021-03-15_10-30", mp));
+        REQUIRE(mp == date::sys_days{2021_y / 03 / 15} + 10h + 30min);
+        REQUIRE(string_to_minute_point(minute_point_to_string(mp)) == mp);
+        REQUIRE_FALSE(parse_minute_point("2021-03-15_24-00", mp));
+        REQUIRE_FALSE(parse_minute_point("2021-03-15 10-30", mp));
+        REQUIRE_FALSE(parse_minute_point("2021-03-15_10-30x", mp));
+        interval_points interval = std::make_pair(mp, mp + 8h);
+        REQUIRE(string_to_interval_points(
+                    interval_points_to_string(interval)) == interval);
+    }
+    SECTION("OHLC") {
+        ohlc_prices ohlc;
+        REQUIRE(ohlc.from_string("1.0 2.5e1 +0.5 1.5"));
+        REQUIRE(ohlc == ohlc_prices(1.0, 25.0, 0.5, 1.5));
+        REQUIRE(ohlc.from_string(ohlc_prices(3., 4., 2., 3.5).to_string()));
+        REQUIRE(ohlc == ohlc_prices(3., 4., 2., 3.5));
+        REQUIRE_FALSE(ohlc.from_string("1.0 2.0 0.5"));
+        REQUIRE_FALSE(ohlc.from_string("1.0 2.0 0.5 1.5 2.0"));
+        REQUIRE_FALSE(ohlc.from_string("1.0 2.0 a 1.5"));
+        REQUIRE(ohlc == ohlc_prices(3., 4., 2., 3.5));
+    }
+}
+TEST_CASE("Alphavantage Parser") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    SECTION("DAILY") {
+        std::string response = R"json({
+            "Meta Data": {"1. Information": "Daily Prices", "2. Symbol": "IBM"},
+            "Time Series (Daily)": {
+                "2021-03-12": {"1. open": "127.19", "2. high": "127.68",
+                               "3. low": "126.61", "4. close": "127.61",
+                               "6. volume": "3934220"},
+                "2021-03-11": {"1. open": "1.25e2", "2. high": "127.2",
+                               "3. low": "124.72", "4. close": "126.93"}
+            }
+        })json";
+        alphavantage_parser parser(timeframe::daily);
+        REQUIRE(nlohmann::json::sax_parse(response, &parser));
+        REQUIRE(parser.has_meta_data());
+        REQUIRE(parser.valid());
+        price_series s = parser.release_series();
+        REQUIRE(s.size() == 2);
+        REQUIRE(s.interval(0).first ==
+                date::sys_days{2021_y / 03 / 11} + 10h + 0min);
+        REQUIRE(s.interval(0).second ==
+                date::sys_days{2021_y / 03 / 11} + 18h + 0min);
+        REQUIRE(s.prices(0) == ohlc_prices(125.0, 127.2, 124.72, 126.93));
+        REQUIRE(s.prices(1) == ohlc_prices(127.19, 127.68, 126.61, 127.61));
+    }
+    SECTION("WEEKLY AND MONTHLY") {
+        std::string response = R"json({
+            "Meta Data": {},
+            "Weekly Adjusted Time Series": {
+                "2021-03-12": {"1. open": "1", "2. high": "2",
+                               "3. low": "0.5", "4. close": "1.5"}
+            }
+        })json";
+        alphavantage_parser weekly(timeframe::weekly);
+        REQUIRE(nlohmann::json::sax_parse(response, &weekly));
+        price_series s = weekly.release_series();
+        REQUIRE(s.size() == 1);
+        REQUIRE(s.interval(0).first ==
+                date::sys_days{2021_y / 3 / 8} + 10h + 0min);
+        REQUIRE(s.interval(0).second ==
+                date::sys_days{2021_y / 03 / 12} + 18h + 0min);
+
+        // The key of the series depends on the timeframe
+        alphavantage_parser monthly(timeframe::monthly);
+        REQUIRE(nlohmann::json::sax_parse(response, &monthly));
+        REQUIRE(monthly.release_series().empty());
+        interval_points interval = alphavantage_parser::bar_interval(
+            date::sys_days{2021_y / 04 / 30}, timeframe::monthly);
+        REQUIRE(interval.first == date::sys_days{2021_y / 04 / 01} + 10h);
+        REQUIRE(interval.second == date::sys_days{2021_y / 04 / 30} + 18h);
+    }
+    SECTION("ERRORS") {
+        std::string error_response = R"json({
+            "Error Message": "Invalid API call."
+        })json";
+        alphavantage_parser error(timeframe::daily);
+        REQUIRE(nlohmann::json::sax_parse(error_response, &error));
+        REQUIRE_FALSE(error.has_meta_data());
+        REQUIRE(error.message() == "Invalid API call.");
+
+        std::string invalid_response = R"json({
+            "Meta Data": {},
+            "Time Series (Daily)": {
+                "2021-03-12": {"1. open": "a", "2. high": "2",
+                               "3. low": "0.5", "4. close": "1.5"}
+            }
+        })json";
+        alphavantage_parser invalid(timeframe::daily);
+        REQUIRE(nlohmann::json::sax_parse(invalid_response, &invalid));
+        REQUIRE_FALSE(invalid.valid());
+
+        std::string truncated_response = R"json({"Meta Data": {)json";
+        alphavantage_parser truncated(timeframe::daily);
+        REQUIRE_FALSE(
+            nlohmann::json::sax_parse(truncated_response, &truncated));
+    }
+}
+TEST_CASE("Token Bucket") {
+    using namespace portfolio;
+    using namespace std::chrono_literals;
+    token_bucket::clock::time_point t0 = token_bucket::clock::now();
+    // 5 tokens per minute
+    token_bucket bucket(5.0, 5.0 / 60.0, t0);
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(bucket.try_acquire(t0));
+    }
+    REQUIRE_FALSE(bucket.try_acquire(t0));
+    REQUIRE(bucket.available_at(t0) >= t0 + 12s);
+    REQUIRE(bucket.available_at(t0) < t0 + 12s + 1ms);
+    REQUIRE_FALSE(bucket.try_acquire(t0 + 11s));
+    REQUIRE(bucket.try_acquire(t0 + 12s));
+    // The bucket never holds more than its capacity
+    REQUIRE(bucket.tokens(t0 + 1h) == 5.0);
+    REQUIRE_THROWS(token_bucket(0.0, 1.0));
+}
+TEST_CASE("Request Scheduler") {
+    using namespace portfolio;
+    using namespace std::chrono_literals;
+    std::mutex m;
+    std::vector<std::string> sent;
+    auto transport = [&](const std::string &url) {
+        if (url == "error") {
+            throw std::runtime_error("Cannot connect");
+        }
+        std::lock_guard lock(m);
+        sent.emplace_back(url);
+        return http_response{200, "response to " + url};
+    };
+
+    SECTION("RESPONSES") {
+        request_scheduler scheduler(token_bucket(10.0, 100.0), 2, transport);
+        std::future<http_response> r = scheduler.submit("a");
+        REQUIRE(r.get().text == "response to a");
+        REQUIRE_THROWS_AS(scheduler.submit("error").get(),
+                          std::runtime_error);
+        std::promise<http_response> p;
+        scheduler.submit("b", request_priority::bulk,
+                         [&p](const http_response &r) { p.set_value(r); });
+        REQUIRE(p.get_future().get().status_code == 200);
+    }
+
+    // Interactive requests go before the bulk requests in the queue
+    SECTION("PRIORITIES") {
+        // 1 request in a burst and then 1 request every 100ms
+        request_scheduler scheduler(token_bucket(1.0, 10.0), 1, transport);
+        std::vector<std::future<http_response>> responses;
+        responses.emplace_back(scheduler.submit("first"));
+        responses.front().wait();
+        for (int i = 0; i < 3; ++i) {
+            responses.emplace_back(scheduler.submit(
+                "bulk" + std::to_string(i), request_priority::bulk));
+        }
+        responses.emplace_back(scheduler.submit("interactive"));
+        for (auto &r : responses) {
+            r.wait();
+        }
+        REQUIRE(sent.size() == 5);
+        REQUIRE(sent[1] == "interactive");
+        REQUIRE(sent[2] == "bulk0");
+        REQUIRE(sent[4] == "bulk2");
+    }
+
+    // Requests do not go over the rate limit
+    SECTION("RATE") {
+        auto t0 = std::chrono::steady_clock::now();
+        // 2 requests in a burst and then 1 request every 50ms
+        request_scheduler scheduler(token_bucket(2.0, 20.0), 4, transport);
+        std::vector<std::future<http_response>> responses;
+        for (int i = 0; i < 8; ++i) {
+            responses.emplace_back(scheduler.submit(std::to_string(i)));
+        }
+        for (auto &r : responses) {
+            r.wait();
+        }
+        REQUIRE(std::chrono::steady_clock::now() - t0 >= 300ms);
+        REQUIRE(sent.size() == 8);
+
+        // No closed window of the quota holds more requests than the
+        // quota, when each request is sent as soon as there is a token
+        {
+            const auto minute = std::chrono::minutes(1);
+            auto now = std::chrono::steady_clock::time_point{};
+            token_bucket bucket = request_scheduler::quota_bucket(5, minute);
+            bucket = token_bucket(bucket.capacity(),
+                                  bucket.tokens_per_second(), now);
+            std::vector<std::chrono::steady_clock::time_point> sends;
+            while (sends.size() < 30) {
+                now = bucket.available_at(now);
+                if (bucket.try_acquire(now)) {
+                    sends.emplace_back(now);
+                }
+            }
+            size_t too_many = 0;
+            for (size_t i = 0; i < sends.size(); ++i) {
+                too_many += std::count_if(sends.begin() + i, sends.end(),
+                                          [&](auto t) {
+                                              return t <= sends[i] + minute;
+                                          }) > 5;
+            }
+            REQUIRE(too_many == 0);
+            REQUIRE(sends.back() - sends.front() < 6 * minute);
+        }
+
+        // Nor when the requests are sent by the connections
+        std::vector<std::chrono::steady_clock::time_point> times;
+        auto timed_transport = [&](const std::string &url) {
+            std::lock_guard lock(m);
+            times.emplace_back(std::chrono::steady_clock::now());
+            return http_response{200, url};
+        };
+        const int quota = 5;
+        const auto window = 250ms;
+        request_scheduler paced(request_scheduler::quota_bucket(quota, window),
+                                4, timed_transport);
+        responses.clear();
+        for (int i = 0; i < 3 * quota; ++i) {
+            responses.emplace_back(paced.submit(std::to_string(i)));
+        }
+        for (auto &r : responses) {
+            r.wait();
+        }
+        REQUIRE(times.size() == 3 * quota);
+        std::sort(times.begin(), times.end());
+        // Some slack for the time between taking a token and sending
+        for (size_t i = 0; i < times.size(); ++i) {
+            auto in_window = std::count_if(
+                times.begin() + i, times.end(), [&](auto t) {
+                    return t - times[i] < window - 10ms;
+                });
+            REQUIRE(in_window <= quota);
+        }
+    }
+
+    // Users of a key share its scheduler and its rate limit
+    SECTION("API KEYS") {
+        auto scheduler = request_scheduler::for_api_key("ut-key", 5.0);
+        REQUIRE(request_scheduler::for_api_key("ut-key", 5.0) == scheduler);
+        REQUIRE(request_scheduler::for_api_key("ut-other-key", 5.0) !=
+                scheduler);
+        REQUIRE_THROWS(request_scheduler::for_api_key("ut-key", 75.0));
+    }
+}
+TEST_CASE("Cached Data Feed") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    // Mock data feed counting the fetches
+    struct counting_data_feed : public data_feed {
+        data_feed_result fetch(std::string_view asset_code,
+                               minute_point start_period,
+                               minute_point end_period,
+                               timeframe tf) override {
+            ++fetches;
+            std::this_thread::sleep_for(20ms);
+            if (asset_code == "INVALID") {
+                throw std::runtime_error("Invalid asset");
+            }
+            return m.fetch(asset_code, start_period, end_period, tf);
+        }
+        mock_data_feed m;
+        std::atomic<int> fetches{0};
+    };
+    counting_data_feed upstream;
+    cached_data_feed cache(upstream, 2);
+    minute_point mp_start = date::sys_days{2019_y / 01 / 01} + 10h + 0min;
+    minute_point mp_end = date::sys_days{2019_y / 12 / 31} + 18h + 0min;
+
+    SECTION("HITS AND MISSES") {
+        data_feed_result r1 =
+            cache.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+        data_feed_result r2 =
+            cache.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+        REQUIRE(upstream.fetches == 1);
+        REQUIRE(cache.misses() == 1);
+        REQUIRE(cache.hits() == 1);
+        REQUIRE(r1.series() == r2.series());
+
+        // Sub-ranges are sliced from the cached series
+        minute_point s_start = date::sys_days{2019_y / 03 / 01} + 0h + 0min;
+        minute_point s_end = date::sys_days{2019_y / 03 / 31} + 23h + 0min;
+        data_feed_result r3 =
+            cache.fetch("PETR4", s_start, s_end, timeframe::daily);
+        REQUIRE(upstream.fetches == 1);
+        REQUIRE(r3.series() == r1.series().slice(s_start, s_end));
+
+        // The timeframe is part of the key
+        cache.fetch("PETR4", mp_start, mp_end, timeframe::weekly);
+        REQUIRE(upstream.fetches == 2);
+    }
+
+    SECTION("EVICTIONS") {
+        cache.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+        cache.fetch("VALE3", mp_start, mp_end, timeframe::daily);
+        // PETR4 becomes the most recently used series
+        cache.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+        cache.fetch("ITUB4", mp_start, mp_end, timeframe::daily);
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.evictions() == 1);
+        cache.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+        REQUIRE(upstream.fetches == 3);
+        cache.fetch("VALE3", mp_start, mp_end, timeframe::daily);
+        REQUIRE(upstream.fetches == 4);
+
+        // A larger period replaces the series it contains
+        cache.clear();
+        cache.fetch("PETR4", mp_start + 24h, mp_end, timeframe::daily);
+        cache.fetch("PETR4", mp_start, mp_end, timeframe::daily);
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("SINGLE FLIGHT") {
+        std::vector<std::thread> threads;
+        std::vector<price_view> results(8);
+        for (size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&, i]() {
+                results[i] =
+                    cache.fetch("PETR4", mp_start, mp_end, timeframe::daily)
+                        .series();
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        REQUIRE(upstream.fetches == 1);
+        REQUIRE(cache.misses() == 1);
+        REQUIRE(cache.hits() == 7);
+        for (const auto &r : results) {
+            REQUIRE(r.shared_series() == results.front().shared_series());
+        }
+    }
+
+    SECTION("ERRORS") {
+        REQUIRE_THROWS(
+            cache.fetch("INVALID", mp_start, mp_end, timeframe::daily));
+        REQUIRE_THROWS(
+            cache.fetch("INVALID", mp_start, mp_end, timeframe::daily));
+        REQUIRE(upstream.fetches == 2);
+        REQUIRE(cache.size() == 0);
+    }
+}
 TEST_CASE("Alphavantage") {
     using namespace portfolio;
     using namespace date::literals;
@@ -1,12 +1,101 @@
 #define CATCH_CONFIG_MAIN
 
+#include "portfolio/batch_evaluator.h"
 #include "portfolio/common/algorithm.h"
+#include "portfolio/common/philox.h"
+#include "portfolio/covariance_matrix.h"
+#include "portfolio/delta_evaluator.h"
+#include "portfolio/ewma_model.h"
+#include "portfolio/factor_model.h"
 #include "portfolio/data_feed/alphavantage_data_feed.h"
 #include "portfolio/data_feed/mock_data_feed.h"
 #include "portfolio/market_data.h"
+#include "portfolio/monte_carlo_simulator.h"
+#include "portfolio/optimization/mad_optimizer.h"
+#include "portfolio/optimization/nsga2.h"
+#include "portfolio/optimization/pareto_archive.h"
 #include "portfolio/portfolio.h"
+#include "portfolio/portfolio_risk.h"
+#include "portfolio/portfolio_sampler.h"
+#include "portfolio/rolling_mad.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <catch2/catch.hpp>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+// Data feed whose prices only depend on the asset code
+class deterministic_data_feed : public portfolio::data_feed {
+  public:
+    portfolio::data_feed_result fetch(std::string_view asset_code,
+                                      portfolio::minute_point start_period,
+                                      portfolio::minute_point end_period,
+                                      portfolio::timeframe) override {
+        using namespace std::chrono_literals;
+        if (asset_code == "INVALID") {
+            throw std::runtime_error("Invalid asset");
+        }
+        size_t running = ++running_;
+        size_t max = max_running_;
+        while (running > max &&
+               !max_running_.compare_exchange_weak(max, running)) {
+        }
+        std::this_thread::sleep_for(2ms);
+        std::default_random_engine generator(
+            std::hash<std::string_view>{}(asset_code));
+        std::uniform_real_distribution<double> ud(10.0, 20.0);
+        portfolio::price_series series;
+        for (portfolio::minute_point i = start_period; i <= end_period;
+             i += 24h) {
+            double price = ud(generator);
+            series.push_back(
+                std::make_pair(i, i + 8h),
+                portfolio::ohlc_prices(price, price, price, price));
+        }
+        --running_;
+        return portfolio::data_feed_result(series);
+    }
+
+    std::atomic<size_t> running_{0};
+    std::atomic<size_t> max_running_{0};
+};
+
+// Codes ASSET0, ASSET1, ... of n mock assets
+std::vector<std::string> mock_assets(size_t n) {
+    std::vector<std::string> assets;
+    for (size_t i = 0; i < n; ++i) {
+        assets.emplace_back("ASSET" + std::to_string(i));
+    }
+    return assets;
+}
+
+// Daily market data of mock assets from 10h of the first day to 18h of
+// the last day
+struct mock_market {
+    explicit mock_market(
+        std::vector<std::string> codes,
+        date::year_month_day first = date::year{2020} / 1 / 1,
+        date::year_month_day last = date::year{2020} / 12 / 31)
+        : assets(std::move(codes)),
+          mp_start(date::sys_days{first} + std::chrono::hours{10}),
+          mp_end(date::sys_days{last} + std::chrono::hours{18}),
+          md(assets, mock_df, mp_start, mp_end, portfolio::timeframe::daily) {}
+
+    std::vector<std::string> assets;
+    portfolio::minute_point mp_start;
+    portfolio::minute_point mp_end;
+    portfolio::mock_data_feed mock_df;
+    portfolio::market_data md;
+};
 
 TEST_CASE("Portfolio and Market Data") {
     using namespace date::literals;
@@ -39,6 +128,18 @@ TEST_CASE("Portfolio and Market Data") {
         auto risk_return = port.evaluate_mad(md, interval, 40);
         REQUIRE(risk_return.first > 0);
         REQUIRE(risk_return.second != 0);
+        REQUIRE(port.evaluate(*md.mad(interval, 40)) == risk_return);
+        // Other market data of the same assets has its own model, and
+        // market data of other assets is rejected
+        portfolio::market_data same(assets, mock_df, mp_start, mp_end,
+                                    portfolio::timeframe::daily);
+        REQUIRE(port.evaluate_mad(same, interval, 40) ==
+                port.evaluate(*same.mad(interval, 40)));
+        std::vector<std::string> replaced = assets;
+        replaced[0] = "PETR3.SAO";
+        portfolio::market_data other(replaced, mock_df, mp_start, mp_end,
+                                     portfolio::timeframe::daily);
+        REQUIRE_THROWS(port.evaluate_mad(other, interval, 40));
         end_interval = date::sys_days{2020_y / 01 / 01} + 18h + 01min;
         interval = std::make_pair(start_interval, end_interval);
         // If the interval is not valid, it throws an exception and ends the
@@ -51,4 +152,1467 @@ TEST_CASE("Portfolio and Market Data") {
         // market_data, it throws an exception and ends the execution.
         REQUIRE_THROWS(port.evaluate_mad(md, interval, 30));
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Parallel Market Data") {
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    std::vector<std::string> assets = mock_assets(40);
+    assets.emplace_back("ASSET0");
+    portfolio::minute_point mp_start =
+        date::sys_days{2020_y / 01 / 01} + 10h + 0min;
+    portfolio::minute_point mp_end =
+        date::sys_days{2020_y / 12 / 31} + 18h + 0min;
+    deterministic_data_feed sequential_df;
+    portfolio::market_data sequential(assets, sequential_df, mp_start, mp_end,
+                                      portfolio::timeframe::daily);
+    REQUIRE(sequential_df.max_running_ == 1);
+
+    // The same data is fetched with any number of threads
+    deterministic_data_feed parallel_df;
+    portfolio::market_data parallel(assets, parallel_df, mp_start, mp_end,
+                                    portfolio::timeframe::daily, 4);
+    REQUIRE(parallel_df.max_running_ <= 4);
+    REQUIRE(std::distance(parallel.assets_map_begin(),
+                          parallel.assets_map_end()) == 40);
+    auto it = sequential.assets_map_begin();
+    for (auto p = parallel.assets_map_begin(); p != parallel.assets_map_end();
+         ++p, ++it) {
+        REQUIRE(p->first == it->first);
+        REQUIRE(p->second.series() == it->second.series());
+    }
+
+    // Errors are thrown as in the sequential construction
+    assets[20] = "INVALID";
+    deterministic_data_feed invalid_df;
+    REQUIRE_THROWS_AS(portfolio::market_data(assets, invalid_df, mp_start,
+                                             mp_end,
+                                             portfolio::timeframe::daily, 0),
+                      std::runtime_error);
+}
+TEST_CASE("Return Panel") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+    auto bar = [](int day) {
+        minute_point start = date::sys_days{2021_y / 03 / 01} + 24h * day;
+        return std::make_pair(start, start + 8h);
+    };
+    // "B" has no bar on day 2 and starts one day later
+    price_series a;
+    price_series b;
+    for (int day = 0; day < 5; ++day) {
+        double price = 10. + day;
+        a.push_back(bar(day), ohlc_prices(price, price, price, price));
+        if (day != 0 && day != 2) {
+            b.push_back(bar(day), ohlc_prices(2 * price, 2 * price,
+                                              2 * price, 2 * price));
+        }
+    }
+    std::vector<price_view> series = {price_view(a), price_view(b)};
+
+    SECTION("DROP") {
+        return_panel p({"A", "B"}, series, missing_bar_policy::drop);
+        REQUIRE(p.n_assets() == 2);
+        REQUIRE(p.n_periods() == 2);
+        REQUIRE(p.stride() % 8 == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(p.data()) % 64 == 0);
+        REQUIRE(p.intervals()[0] == bar(3));
+        REQUIRE(p.find(bar(4)) == 1);
+        REQUIRE(p.find(bar(2)) == p.n_periods());
+        REQUIRE(p.returns(0)[0] == Approx((13. - 11.) / 11.));
+        REQUIRE(p.returns(1)[1] == Approx((28. - 26.) / 26.));
+        REQUIRE(p.valid(1, 0));
+    }
+
+    SECTION("FORWARD FILL") {
+        return_panel p({"A", "B"}, series, missing_bar_policy::forward_fill);
+        REQUIRE(p.n_periods() == 3);
+        REQUIRE(p.intervals()[0] == bar(2));
+        REQUIRE(p.returns(0)[0] == Approx((12. - 11.) / 11.));
+        REQUIRE(p.returns(1)[0] == 0.);
+        REQUIRE(p.returns(1)[1] == Approx((26. - 22.) / 22.));
+        REQUIRE(p.valid(1, 0));
+
+        // "C" has no bar on day 1, where the calendar starts, so its close
+        // comes from day 0. "D" closes at zero on day 1.
+        price_series c;
+        price_series d;
+        for (int day = 0; day < 5; ++day) {
+            double price = 10. + day;
+            if (day != 1) {
+                c.push_back(bar(day), ohlc_prices(price, price, price, price));
+            }
+            double close = day == 1 ? 0. : price;
+            d.push_back(bar(day), ohlc_prices(price, price, price, close));
+        }
+        std::vector<price_view> filled = {price_view(a), price_view(b),
+                                          price_view(c), price_view(d)};
+        return_panel q({"A", "B", "C", "D"}, filled,
+                       missing_bar_policy::forward_fill);
+        REQUIRE(q.n_periods() == 3);
+        REQUIRE(q.intervals()[0] == bar(2));
+        REQUIRE(q.valid(2, 0));
+        REQUIRE(q.returns(2)[0] == Approx((12. - 10.) / 10.));
+        REQUIRE_FALSE(q.valid(3, 0));
+        REQUIRE(q.returns(3)[0] == 0.);
+        REQUIRE(q.valid(3, 1));
+    }
+
+    SECTION("MASK") {
+        return_panel p({"A", "B"}, series, missing_bar_policy::mask);
+        REQUIRE(p.n_periods() == 4);
+        REQUIRE(p.asset_index("B") == 1);
+        REQUIRE(p.asset_index("C") == 2);
+        REQUIRE(p.valid(0, 0));
+        REQUIRE_FALSE(p.valid(1, 0));
+        REQUIRE_FALSE(p.valid(1, 1));
+        REQUIRE_FALSE(p.valid(1, 2));
+        REQUIRE(p.valid(1, 3));
+        REQUIRE(p.returns(1)[1] == 0.);
+    }
+
+    REQUIRE_THROWS(return_panel({"A"}, series));
+}
+TEST_CASE("Batch Evaluator") {
+    using namespace portfolio;
+    mock_market market(mock_assets(11));
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    const return_panel &panel = md.returns();
+    interval_points interval = panel.intervals()[200];
+    const int n_periods = 45;
+    portfolio_mad mad(md, interval, n_periods);
+    batch_evaluator evaluator(md, interval, n_periods);
+    REQUIRE(evaluator.n_assets() == assets.size());
+    REQUIRE(evaluator.n_periods() == n_periods);
+
+    // Seven portfolios cover the vectorized blocks and the remainder
+    const size_t n_portfolios = 7;
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    std::vector<double> weights(n_portfolios * assets.size());
+    for (double &w : weights) {
+        w = ud(generator);
+    }
+    std::vector<double> risk(n_portfolios);
+    std::vector<double> expected_return(n_portfolios);
+
+    SECTION("ASSET WEIGHTED") {
+        evaluator.evaluate(weights, risk, expected_return);
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            double r = 0.0;
+            double e = 0.0;
+            for (size_t k = 0; k < assets.size(); ++k) {
+                double w = weights[p * assets.size() + k];
+                r += w * mad.risk(panel.assets()[k]);
+                e += w * mad.expected_return(panel.assets()[k]);
+            }
+            REQUIRE(risk[p] == Approx(r));
+            REQUIRE(expected_return[p] == Approx(e));
+        }
+    }
+
+    SECTION("PORTFOLIO") {
+        evaluator.evaluate(weights, risk, expected_return, mad_kind::portfolio,
+                           2);
+        size_t first = panel.find(interval) + 1 - n_periods;
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            std::vector<double> returns(n_periods, 0.0);
+            for (size_t k = 0; k < assets.size(); ++k) {
+                for (size_t t = 0; t < n_periods; ++t) {
+                    returns[t] += weights[p * assets.size() + k] *
+                                  panel.returns(k)[first + t];
+                }
+            }
+            double mean = 0.0;
+            for (double r : returns) {
+                mean += r / n_periods;
+            }
+            double deviations = 0.0;
+            for (double r : returns) {
+                deviations += std::abs(r - mean);
+            }
+            REQUIRE(risk[p] == Approx(deviations / n_periods));
+            REQUIRE(expected_return[p] == Approx(mean));
+        }
+    }
+
+    std::vector<double> too_few(n_portfolios - 1);
+    REQUIRE_THROWS(evaluator.evaluate(weights, too_few, expected_return));
+    REQUIRE_THROWS(batch_evaluator(md, interval, 500));
+}
+TEST_CASE("Rolling MAD") {
+    using namespace portfolio;
+    using namespace date::literals;
+    mock_market market(
+        {"PETR4.SAO", "VALE3.SAO", "ITUB4.SAO"}, 2019_y / 01 / 01);
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    const int n_periods = 30;
+    rolling_mad rolling(md, n_periods, 2);
+    const return_panel &panel = md.returns();
+    REQUIRE(rolling.n_assets() == assets.size());
+    REQUIRE(rolling.n_windows() == panel.n_periods() - n_periods + 1);
+
+    // Every window matches a portfolio_mad computed from scratch
+    for (size_t w = 0; w < rolling.n_windows(); w += 37) {
+        portfolio_mad mad(md, rolling.interval(w), n_periods);
+        REQUIRE(rolling.find(rolling.interval(w)) == w);
+        for (size_t k = 0; k < assets.size(); ++k) {
+            REQUIRE(rolling.risk(k)[w] ==
+                    Approx(mad.risk(panel.assets()[k])));
+            REQUIRE(rolling.expected_return(k)[w] ==
+                    Approx(mad.expected_return(panel.assets()[k])));
+        }
+    }
+    REQUIRE(rolling.find(panel.intervals()[0]) == rolling.n_windows());
+    REQUIRE(rolling_mad(md, 10000).n_windows() == 0);
+    REQUIRE_THROWS(rolling_mad(md, 0));
+}
+TEST_CASE("Risk Model Cache") {
+    using namespace portfolio;
+    mock_market market({"PETR4.SAO", "VALE3.SAO", "ITUB4.SAO"});
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals()[100];
+    risk_model_cache &cache = md.risk_models();
+
+    // Portfolios evaluated on the same window share one model
+    std::vector<portfolio::portfolio> portfolios(20, portfolio::portfolio(md));
+    for (auto &p : portfolios) {
+        p.evaluate_mad(md, interval, 40);
+    }
+    REQUIRE(cache.misses() == 1);
+    REQUIRE(cache.hits() == 19);
+    REQUIRE(md.mad(interval, 40) == md.mad(interval, 40));
+    REQUIRE(md.mad(interval, 40) != md.mad(interval, 30));
+    REQUIRE(cache.size() == 2);
+
+    // Concurrent requests get the same model
+    std::vector<std::shared_ptr<const portfolio_mad>> models(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < models.size(); ++i) {
+        threads.emplace_back(
+            [&, i]() { models[i] = md.mad(md.returns().intervals()[50], 20); });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (const auto &m : models) {
+        REQUIRE(m == models.front());
+    }
+
+    // The cache is bounded and invalidated explicitly
+    for (int n = 1; n <= 30; ++n) {
+        REQUIRE(md.mad(interval, n)->n_periods() == n);
+    }
+    REQUIRE(cache.size() == cache.capacity());
+    auto model = md.mad(interval, 40);
+    cache.invalidate();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(md.mad(interval, 40) != model);
+    REQUIRE(model->risk("PETR4.SAO") ==
+            md.mad(interval, 40)->risk("PETR4.SAO"));
+    REQUIRE_THROWS(md.mad(interval, 500));
+    REQUIRE_THROWS(risk_model_cache(0));
+}
+TEST_CASE("Symbol Table") {
+    using namespace portfolio;
+    using namespace date::literals;
+    symbol_table symbols({"VALE3.SAO", "PETR4.SAO", "VALE3.SAO"});
+    REQUIRE(symbols.size() == 2);
+    REQUIRE(symbols.find("PETR4.SAO") == 1);
+    REQUIRE(symbols.find(std::string_view("ITUB4.SAO")) == symbol_table::npos);
+    REQUIRE(symbols.insert("ITUB4.SAO") == 2);
+    REQUIRE(symbols.insert("VALE3.SAO") == 0);
+    REQUIRE(symbols.symbol(2) == "ITUB4.SAO");
+
+    // Market data ids follow the symbols and the rows of the return panel
+    mock_market market({"VALE3.SAO", "PETR4.SAO", "ITUB4.SAO"},
+                       2020_y / 01 / 01, 2020_y / 06 / 30);
+    market_data &md = market.md;
+    REQUIRE(md.n_assets() == 3);
+    REQUIRE(md.symbols().symbols() ==
+            std::vector<std::string>{"ITUB4.SAO", "PETR4.SAO", "VALE3.SAO"});
+    REQUIRE(md.returns().assets() == md.symbols().symbols());
+    asset_id vale = md.symbols().find("VALE3.SAO");
+    REQUIRE(md.asset(vale).series().shared_series() ==
+            std::prev(md.assets_map_end())->second.series().shared_series());
+
+    // String accessors are a thin layer over the ids
+    interval_points interval = md.returns().intervals()[50];
+    portfolio_mad mad(md, interval, 20);
+    REQUIRE(mad.risk("VALE3.SAO") == mad.risk(vale));
+    REQUIRE(mad.expected_return("VALE3.SAO") == mad.expected_return(vale));
+    REQUIRE_THROWS_AS(mad.risk("ABEV3.SAO"), std::out_of_range);
+    portfolio::portfolio p(md);
+    while (std::isnan(p.weights()[0])) {
+        // No asset was selected
+        p = portfolio::portfolio(md);
+    }
+    REQUIRE(p.weights().size() == 3);
+    REQUIRE(p.weight("VALE3.SAO") == p.weights()[vale]);
+    REQUIRE(p.weight("ABEV3.SAO") == 0.0);
+}
+TEST_CASE("Portfolio Sampler") {
+    using namespace portfolio;
+    // Known answers of Philox4x32-10 from the Random123 test vectors
+    auto block = philox_engine::block({0, 0}, 0, 0);
+    REQUIRE(block == philox_engine::block_type{0x6627e8d5, 0xe169c58d,
+                                               0xbc57ac4c, 0x9b00dbd8});
+    block = philox_engine::block({0xffffffff, 0xffffffff}, ~uint64_t(0),
+                                 ~uint64_t(0));
+    REQUIRE(block == philox_engine::block_type{0x408f276d, 0x41c83b0e,
+                                               0xa20bc7c6, 0x6d5451fd});
+    philox_engine e(42, 3);
+    philox_engine skipped(42, 3);
+    for (int i = 0; i < 7; ++i) {
+        e();
+    }
+    skipped.discard(7);
+    REQUIRE(e() == skipped());
+
+    const size_t n_assets = 13;
+    const size_t n_portfolios = 3000;
+    for (auto method : {sampling_method::uniform_simplex,
+                        sampling_method::binomial_selection}) {
+        portfolio_sampler sampler(n_assets, 2021, method);
+        std::vector<double> weights = sampler.sample(n_portfolios);
+
+        // The weights do not depend on the number of threads or the range
+        REQUIRE(sampler.sample(n_portfolios, 4) == weights);
+        std::vector<double> tail(10 * n_assets);
+        sampler.sample(n_portfolios - 10, tail, 2);
+        REQUIRE(std::equal(tail.begin(), tail.end(),
+                           weights.end() - tail.size()));
+        REQUIRE(portfolio_sampler(n_assets, 2022, method).sample(10) !=
+                sampler.sample(10));
+
+        size_t zeros = 0;
+        size_t negative = 0;
+        size_t not_normalized = 0;
+        double mean = 0.0;
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            double total = 0.0;
+            for (size_t k = 0; k < n_assets; ++k) {
+                double w = weights[p * n_assets + k];
+                total += w;
+                zeros += w == 0.0;
+                negative += w < 0.0;
+                mean += w;
+            }
+            not_normalized += std::abs(total - 1.0) > 1e-12;
+        }
+        REQUIRE(negative == 0);
+        REQUIRE(not_normalized == 0);
+        REQUIRE(mean / weights.size() == Approx(1.0 / n_assets));
+        if (method == sampling_method::uniform_simplex) {
+            REQUIRE(zeros == 0);
+        } else {
+            // Half of the assets are not selected
+            REQUIRE(zeros == Approx(weights.size() / 2).epsilon(0.05));
+        }
+    }
+}
+
+TEST_CASE("NSGA-II") {
+    using namespace portfolio;
+    // Fronts of a few points with known ranks
+    std::vector<double> f1 = {1.0, 2.0, 3.0, 2.0, 3.0, 1.0};
+    std::vector<double> f2 = {3.0, 2.0, 1.0, 3.0, 3.0, 3.0};
+    std::vector<size_t> rank = nsga2::non_dominated_sort(f1, f2, 2);
+    REQUIRE(rank == std::vector<size_t>{0, 0, 0, 1, 2, 0});
+    std::vector<size_t> front = {0, 1, 2};
+    std::vector<double> distance = nsga2::crowding_distance(f1, f2, front);
+    REQUIRE(std::isinf(distance[0]));
+    REQUIRE(distance[1] == Approx(2.0));
+    REQUIRE(std::isinf(distance[2]));
+
+    mock_market market(mock_assets(9));
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals()[200];
+    batch_evaluator evaluator(md, interval, 60);
+
+    for (auto kind : {mad_kind::asset_weighted, mad_kind::portfolio}) {
+        nsga2_options options;
+        options.population_size = 41;
+        options.n_generations = 30;
+        options.kind = kind;
+        options.seed = 2021;
+        nsga2_result result = nsga2(evaluator, options).run();
+        REQUIRE(result.generations.size() == options.n_generations + 1);
+        REQUIRE(result.generations.back().evaluations ==
+                options.population_size);
+        // A single asset may dominate all others in random data
+        REQUIRE_FALSE(result.risk.empty());
+        REQUIRE(result.size() <= options.population_size);
+        REQUIRE(result.weights.size() == result.size() * assets.size());
+
+        // The front is sorted by risk and no portfolio dominates another
+        size_t dominated = 0;
+        size_t not_normalized = 0;
+        for (size_t i = 0; i < result.size(); ++i) {
+            for (size_t j = 0; j < result.size(); ++j) {
+                dominated += result.risk[j] <= result.risk[i] &&
+                             result.expected_return[j] >=
+                                 result.expected_return[i] &&
+                             (result.risk[j] < result.risk[i] ||
+                              result.expected_return[j] >
+                                  result.expected_return[i]);
+            }
+            auto w = result.portfolio(i);
+            double total = std::accumulate(w.begin(), w.end(), 0.0);
+            not_normalized += std::abs(total - 1.0) > 1e-12 ||
+                              *std::min_element(w.begin(), w.end()) < 0.0;
+        }
+        REQUIRE(dominated == 0);
+        REQUIRE(not_normalized == 0);
+        REQUIRE(std::is_sorted(result.risk.begin(), result.risk.end()));
+
+        // Elitism keeps the best return of the initial population, which
+        // is at most the return of the best asset
+        std::vector<double> initial =
+            portfolio_sampler(assets.size(), options.seed)
+                .sample(options.population_size);
+        std::vector<double> risk(options.population_size);
+        std::vector<double> expected_return(options.population_size);
+        evaluator.evaluate(initial, risk, expected_return, kind);
+        double best_asset = evaluator.asset_return(0);
+        for (size_t k = 1; k < assets.size(); ++k) {
+            best_asset = std::max(best_asset, evaluator.asset_return(k));
+        }
+        REQUIRE(result.expected_return.back() >=
+                *std::max_element(expected_return.begin(),
+                                  expected_return.end()));
+        REQUIRE(result.expected_return.back() <= best_asset + 1e-12);
+
+        // The result does not depend on the number of threads
+        options.n_threads = 4;
+        nsga2_result parallel = nsga2(evaluator, options).run();
+        REQUIRE(parallel.weights == result.weights);
+        REQUIRE(parallel.risk == result.risk);
+        REQUIRE(parallel.expected_return == result.expected_return);
+    }
+
+    nsga2_options options;
+    options.population_size = 1;
+    REQUIRE_THROWS(nsga2(evaluator, options));
+}
+
+TEST_CASE("MAD Optimizer") {
+    using namespace portfolio;
+    // max x1 + x2 s.t. x1 + 2 x2 <= 4 and 3 x1 + x2 <= 6
+    linear_program lp(2);
+    std::vector<size_t> rows = {0, 1};
+    lp.add_column(-1.0, rows, std::vector<double>{1.0, 3.0});
+    lp.add_column(-1.0, rows, std::vector<double>{2.0, 1.0});
+    lp.add_column(0.0, std::vector<size_t>{0}, std::vector<double>{1.0});
+    lp.add_column(0.0, std::vector<size_t>{1}, std::vector<double>{1.0});
+    lp.set_rhs(0, 4.0);
+    lp.set_rhs(1, 6.0);
+    REQUIRE(lp.n_nonzeros() == 6);
+    REQUIRE_THROWS(lp.add_column(0.0, rows, std::vector<double>{1.0}));
+    simplex_solver solver(lp);
+    REQUIRE(solver.solve() == lp_status::optimal);
+    REQUIRE(solver.objective() == Approx(-2.8));
+    REQUIRE(solver.solution()[0] == Approx(1.6));
+    REQUIRE(solver.solution()[1] == Approx(1.2));
+
+    // A new right-hand side starts from the last basis
+    solver.set_rhs(1, 3.0);
+    REQUIRE(solver.resolve() == lp_status::optimal);
+    lp.set_rhs(1, 3.0);
+    simplex_solver cold(lp);
+    REQUIRE(cold.solve() == lp_status::optimal);
+    REQUIRE(solver.objective() == Approx(cold.objective()));
+    solver.set_rhs(1, -1.0);
+    REQUIRE(solver.resolve() == lp_status::infeasible);
+    lp.set_rhs(1, -1.0);
+    REQUIRE(simplex_solver(lp).solve() == lp_status::infeasible);
+
+    mock_market market(mock_assets(9));
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals()[200];
+    const int n_periods = 60;
+    mad_optimizer optimizer(md, interval, n_periods);
+    batch_evaluator evaluator(md, interval, n_periods);
+    REQUIRE(optimizer.n_assets() == assets.size());
+    REQUIRE(optimizer.n_periods() == n_periods);
+
+    // The risk of the optimum is the portfolio MAD of its weights
+    mad_solution lowest = optimizer.minimize();
+    REQUIRE(lowest.status == lp_status::optimal);
+    REQUIRE(std::accumulate(lowest.weights.begin(), lowest.weights.end(),
+                            0.0) == Approx(1.0));
+    double risk;
+    double expected_return;
+    evaluator.evaluate(lowest.weights, {&risk, 1}, {&expected_return, 1},
+                       mad_kind::portfolio);
+    REQUIRE(risk == Approx(lowest.risk));
+    REQUIRE(expected_return == Approx(lowest.expected_return));
+
+    // No random portfolio beats the frontier
+    const size_t n_portfolios = 2000;
+    std::vector<double> weights =
+        portfolio_sampler(assets.size(), 2021).sample(n_portfolios);
+    std::vector<double> sampled_risk(n_portfolios);
+    std::vector<double> sampled_return(n_portfolios);
+    evaluator.evaluate(weights, sampled_risk, sampled_return,
+                       mad_kind::portfolio);
+    const size_t n_points = 25;
+    std::vector<mad_solution> frontier = optimizer.frontier(n_points);
+    REQUIRE(frontier.size() == n_points);
+    REQUIRE(frontier.front().risk == Approx(lowest.risk));
+    size_t not_optimal = 0;
+    size_t beaten = 0;
+    size_t warm_iterations = 0;
+    for (size_t i = 0; i < n_points; ++i) {
+        const mad_solution &point = frontier[i];
+        not_optimal += point.status != lp_status::optimal;
+        if (i > 0) {
+            warm_iterations += point.iterations;
+            not_optimal += point.risk < frontier[i - 1].risk - 1e-12;
+        }
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            beaten += sampled_return[p] >= point.expected_return &&
+                      sampled_risk[p] < point.risk - 1e-12;
+        }
+    }
+    REQUIRE(not_optimal == 0);
+    REQUIRE(beaten == 0);
+    size_t best_asset = 0;
+    for (size_t k = 1; k < assets.size(); ++k) {
+        if (optimizer.asset_return(k) > optimizer.asset_return(best_asset)) {
+            best_asset = k;
+        }
+    }
+    REQUIRE(frontier.back().weights[best_asset] == Approx(1.0));
+
+    // Warm starts take a fraction of the pivots of cold solves
+    mad_optimizer cold_optimizer(md, interval, n_periods);
+    mad_solution middle =
+        cold_optimizer.minimize(frontier[n_points / 2].expected_return);
+    REQUIRE(middle.risk == Approx(frontier[n_points / 2].risk));
+    REQUIRE(warm_iterations < (n_points - 1) * middle.iterations / 2);
+
+    // Targets above the best asset are infeasible
+    mad_solution above =
+        optimizer.minimize(optimizer.asset_return(best_asset) + 0.01);
+    REQUIRE(above.status == lp_status::infeasible);
+    REQUIRE(above.weights.empty());
+    REQUIRE(optimizer.minimize().risk == Approx(lowest.risk));
+}
+
+TEST_CASE("Pareto Archive") {
+    using namespace portfolio;
+    const size_t n_assets = 3;
+    pareto_archive archive(n_assets);
+    REQUIRE(archive.empty());
+    REQUIRE_FALSE(archive.best_return(1.0));
+    REQUIRE(archive.nearest(0.5, 0.5, 3).empty());
+    REQUIRE_THROWS(archive.insert(0.5, 0.5, std::vector<double>{1.0}));
+
+    // Random points, half of them close to a concave front
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    const size_t n_points = 5000;
+    std::vector<std::array<double, 2>> inserted;
+    size_t wrong_insertions = 0;
+    for (size_t i = 0; i < n_points; ++i) {
+        double risk = ud(generator);
+        double expected_return = i % 2 == 0
+                                     ? std::sqrt(risk) - 0.01 * ud(generator)
+                                     : ud(generator);
+        std::vector<double> weights = {risk, expected_return,
+                                       static_cast<double>(i)};
+        bool was_dominated = archive.dominates(risk, expected_return);
+        wrong_insertions +=
+            archive.insert(risk, expected_return, weights) == was_dominated;
+        inserted.push_back({risk, expected_return});
+    }
+    REQUIRE(wrong_insertions == 0);
+    REQUIRE_FALSE(
+        archive.insert(0.5, std::nan(""), std::vector<double>(n_assets)));
+
+    // The archive is the non-dominated subset of the inserted points
+    auto dominated = [&](double risk, double expected_return) {
+        return std::any_of(inserted.begin(), inserted.end(),
+                           [&](const std::array<double, 2> &p) {
+                               return p[0] <= risk &&
+                                      p[1] >= expected_return &&
+                                      (p[0] < risk || p[1] > expected_return);
+                           });
+    };
+    size_t n_front = 0;
+    for (const auto &p : inserted) {
+        n_front += !dominated(p[0], p[1]);
+    }
+    std::vector<pareto_point> front = archive.points();
+    REQUIRE(front.size() == n_front);
+    REQUIRE(archive.size() == n_front);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < front.size(); ++i) {
+        mismatches += dominated(front[i].risk, front[i].expected_return);
+        mismatches += front[i].weights[0] != front[i].risk ||
+                      front[i].weights[1] != front[i].expected_return;
+        if (i > 0) {
+            mismatches += front[i - 1].risk >= front[i].risk ||
+                          front[i - 1].expected_return >=
+                              front[i].expected_return;
+        }
+    }
+    REQUIRE(mismatches == 0);
+
+    // Queries match a linear scan of the front
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "portfolio_ut_front.pareto";
+    REQUIRE(archive.save(path));
+    pareto_snapshot snapshot;
+    // A snapshot with no file has an empty front
+    REQUIRE(snapshot.size() == 0);
+    REQUIRE(snapshot.risk().empty());
+    REQUIRE_FALSE(snapshot.best_return(1.0));
+    REQUIRE(snapshot.nearest(0.5, 0.5, 3).empty());
+    REQUIRE(snapshot.open(path));
+    REQUIRE(snapshot.size() == front.size());
+    REQUIRE(snapshot.n_assets() == n_assets);
+    pareto_archive loaded(n_assets);
+    REQUIRE(loaded.load(path));
+    REQUIRE(loaded.size() == front.size());
+    REQUIRE_FALSE(pareto_archive(n_assets + 1).load(path));
+    {
+        // A size whose columns overflow the file size check is rejected
+        std::filesystem::path corrupt =
+            std::filesystem::temp_directory_path() /
+            "portfolio_ut_corrupt.pareto";
+        std::filesystem::copy_file(
+            path, corrupt, std::filesystem::copy_options::overwrite_existing);
+        uint64_t size = (uint64_t(1) << 63) / (2 + n_assets) + 1;
+        std::fstream fout(corrupt,
+                          std::ios::binary | std::ios::in | std::ios::out);
+        fout.seekp(offsetof(pareto_file_header, size));
+        fout.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        fout.close();
+        pareto_snapshot corrupt_snapshot;
+        REQUIRE_FALSE(corrupt_snapshot.open(corrupt));
+        REQUIRE_FALSE(pareto_archive(n_assets).load(corrupt));
+        std::filesystem::remove(corrupt);
+    }
+    for (int i = 0; i < 50; ++i) {
+        double risk = ud(generator);
+        double expected_return = ud(generator);
+        double best = -1.0;
+        for (const auto &p : front) {
+            if (p.risk <= risk) {
+                best = std::max(best, p.expected_return);
+            }
+        }
+        auto from_archive = archive.best_return(risk);
+        auto from_snapshot = snapshot.best_return(risk);
+        auto from_loaded = loaded.best_return(risk);
+        mismatches += !from_archive || !from_snapshot || !from_loaded ||
+                      from_archive->expected_return != best ||
+                      from_snapshot->expected_return != best ||
+                      from_loaded->expected_return != best ||
+                      !std::equal(from_archive->weights.begin(),
+                                  from_archive->weights.end(),
+                                  from_snapshot->weights.begin());
+
+        const size_t k = 7;
+        std::vector<double> distances;
+        for (const auto &p : front) {
+            distances.push_back(std::hypot(p.risk - risk,
+                                           p.expected_return -
+                                               expected_return));
+        }
+        std::sort(distances.begin(), distances.end());
+        auto closest = archive.nearest(risk, expected_return, k);
+        auto closest_snapshot = snapshot.nearest(risk, expected_return, k);
+        mismatches += closest.size() != k || closest_snapshot.size() != k;
+        for (size_t j = 0; j < std::min(k, closest.size()); ++j) {
+            double d = std::hypot(closest[j].risk - risk,
+                                  closest[j].expected_return -
+                                      expected_return);
+            double ds = std::hypot(closest_snapshot[j].risk - risk,
+                                   closest_snapshot[j].expected_return -
+                                       expected_return);
+            mismatches += d != Approx(distances[j]);
+            mismatches += ds != Approx(distances[j]);
+        }
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE_FALSE(archive.best_return(-1.0));
+    REQUIRE(archive.nearest(0.5, 0.5, n_front + 10).size() == n_front);
+    snapshot.close();
+    REQUIRE(snapshot.n_assets() == 0);
+    REQUIRE(snapshot.expected_return().empty());
+    std::filesystem::remove(path);
+    REQUIRE_FALSE(snapshot.open(path));
+}
+
+TEST_CASE("Delta Evaluator") {
+    using namespace portfolio;
+    using namespace date::literals;
+    mock_market market(mock_assets(12), 2020_y / 01 / 01, 2020_y / 06 / 30);
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals()[100];
+    const int n_periods = 30;
+    std::vector<double> weights(assets.size());
+    portfolio_sampler(assets.size(), 2021).sample_one(0, weights);
+    delta_evaluator evaluator(md, interval, n_periods, weights);
+    REQUIRE(evaluator.n_assets() == assets.size());
+    REQUIRE(&evaluator.model() == md.mad(interval, n_periods).get());
+
+    // The totals are the same as evaluate_mad for the current weights
+    auto full_evaluation = [&]() {
+        portfolio::portfolio p(md, evaluator.weights());
+        return p.evaluate_mad(md, interval, n_periods);
+    };
+    auto [risk, expected_return] = full_evaluation();
+    REQUIRE(evaluator.risk() == Approx(risk));
+    REQUIRE(evaluator.expected_return() == Approx(expected_return));
+    REQUIRE(evaluator.weight("ASSET3") ==
+            Approx(weights[md.symbols().find("ASSET3")]));
+    REQUIRE_THROWS_AS(evaluator.weight("ABEV3.SAO"), std::out_of_range);
+
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<asset_id> asset(0, assets.size() - 1);
+    std::uniform_real_distribution<double> ud(-0.3, 0.3);
+    size_t mismatches = 0;
+    for (int i = 0; i < 2000; ++i) {
+        asset_id from = asset(generator);
+        asset_id to = asset(generator);
+        if (i % 5 == 0) {
+            evaluator.set_weight(from, std::abs(ud(generator)));
+        } else {
+            auto expected = evaluator.evaluate_transfer(from, to,
+                                                        ud(generator));
+            double before = evaluator.weight(from) + evaluator.weight(to);
+            double moved = evaluator.transfer(from, to, ud(generator));
+            mismatches += std::abs(moved) > 0.3;
+            mismatches += std::abs(evaluator.weight(from) +
+                                   evaluator.weight(to) - before) > 1e-12;
+            mismatches += std::isnan(expected.first);
+        }
+        std::tie(risk, expected_return) = full_evaluation();
+        std::vector<double> current = evaluator.weights();
+        mismatches += std::abs(evaluator.risk() - risk) > 1e-12;
+        mismatches +=
+            std::abs(evaluator.expected_return() - expected_return) > 1e-12;
+        mismatches +=
+            std::abs(std::accumulate(current.begin(), current.end(), 0.0) -
+                     1.0) > 1e-12;
+        mismatches += *std::min_element(current.begin(), current.end()) < 0.0;
+    }
+    REQUIRE(mismatches == 0);
+
+    // A transfer is evaluated without changing the weights
+    std::vector<double> before = evaluator.weights();
+    auto expected = evaluator.evaluate_transfer(0, 1, 0.05);
+    REQUIRE(evaluator.weights() == before);
+    evaluator.transfer(0, 1, 0.05);
+    REQUIRE(evaluator.risk() == Approx(expected.first));
+    REQUIRE(evaluator.expected_return() == Approx(expected.second));
+
+    // Setting all weight on one asset and moving away from it
+    evaluator.set_weight(4, 1.0);
+    REQUIRE(evaluator.risk() == Approx(evaluator.model().risk(4)));
+    evaluator.set_weight(4, 0.5);
+    REQUIRE(evaluator.weight(5) == Approx(0.5 / (assets.size() - 1)));
+    REQUIRE_THROWS(evaluator.set_weight(4, 1.5));
+    REQUIRE_THROWS(
+        delta_evaluator(md, interval, n_periods, std::vector<double>(3)));
+    REQUIRE_THROWS(delta_evaluator(md, interval, n_periods,
+                                   std::vector<double>(assets.size())));
+}
+
+TEST_CASE("Covariance Matrix") {
+    using namespace portfolio;
+    using namespace date::literals;
+    using namespace std::chrono_literals;
+
+    SECTION("SAMPLE") {
+        // More than one tile of assets and one block of periods
+        mock_market market(mock_assets(70), 2019_y / 01 / 01);
+        const std::vector<std::string> &assets = market.assets;
+        market_data &md = market.md;
+        const return_panel &panel = md.returns();
+        const int n_periods = 300;
+        REQUIRE(panel.n_periods() > n_periods);
+        interval_points interval = panel.intervals().back();
+        covariance_matrix cov(md, interval, n_periods, {.n_threads = 2});
+        REQUIRE(cov.n_assets() == assets.size());
+        REQUIRE(cov.n_periods() == n_periods);
+        REQUIRE(cov.shrinkage_intensity() == 0.0);
+
+        size_t first = panel.n_periods() - n_periods;
+        std::vector<double> mean(assets.size(), 0.0);
+        for (size_t k = 0; k < assets.size(); ++k) {
+            auto r = panel.returns(k).subspan(first, n_periods);
+            mean[k] = std::accumulate(r.begin(), r.end(), 0.0) / n_periods;
+            REQUIRE(cov.mean(k) == Approx(mean[k]));
+        }
+        size_t wrong = 0;
+        for (size_t i = 0; i < assets.size(); ++i) {
+            auto ri = panel.returns(i).subspan(first, n_periods);
+            for (size_t j = 0; j < assets.size(); ++j) {
+                auto rj = panel.returns(j).subspan(first, n_periods);
+                double expected = 0.0;
+                for (size_t t = 0; t < n_periods; ++t) {
+                    expected += (ri[t] - mean[i]) * (rj[t] - mean[j]);
+                }
+                expected /= n_periods - 1;
+                wrong += cov(i, j) != Approx(expected).margin(1e-15);
+                wrong += cov(i, j) != cov(j, i);
+            }
+        }
+        REQUIRE(wrong == 0);
+        REQUIRE(cov.row(3).size() == assets.size());
+        REQUIRE(cov.row(3)[5] == cov(3, 5));
+        REQUIRE(cov.correlation(4, 4) == Approx(1.0));
+        REQUIRE(std::abs(cov.correlation(4, 9)) <= 1.0);
+        std::vector<double> correlation = cov.correlation_matrix();
+        REQUIRE(correlation[9 * assets.size() + 4] ==
+                Approx(cov.correlation(9, 4)));
+
+        SECTION("SHRINKAGE") {
+            double average_variance = 0.0;
+            for (size_t i = 0; i < assets.size(); ++i) {
+                average_variance += cov.variance(i);
+            }
+            average_variance /= assets.size();
+            for (auto method : {shrinkage_method::ledoit_wolf,
+                                shrinkage_method::oracle_approximating}) {
+                covariance_matrix shrunk(md, interval, n_periods,
+                                         {.shrinkage = method});
+                double d = shrunk.shrinkage_intensity();
+                REQUIRE(d > 0.0);
+                REQUIRE(d <= 1.0);
+                REQUIRE(shrunk(2, 7) == Approx((1 - d) * cov(2, 7)));
+                REQUIRE(shrunk.variance(2) ==
+                        Approx((1 - d) * cov.variance(2) +
+                               d * average_variance));
+            }
+            covariance_matrix fixed(
+                md, interval, n_periods,
+                {.shrinkage = shrinkage_method::fixed, .intensity = 1.0});
+            REQUIRE(fixed(2, 7) == 0.0);
+            REQUIRE(fixed.variance(5) == Approx(average_variance));
+            REQUIRE_THROWS(covariance_matrix(
+                md, interval, n_periods,
+                {.shrinkage = shrinkage_method::fixed, .intensity = 2.0}));
+        }
+
+        REQUIRE_THROWS(covariance_matrix(md, interval, 1));
+        REQUIRE_THROWS(
+            covariance_matrix(md, interval, int(panel.n_periods()) + 1));
+    }
+
+    SECTION("MASK") {
+        // "B" has no bars on days 0 and 2
+        price_series a;
+        price_series b;
+        std::array<double, 6> prices_a = {10, 11, 13, 12, 15, 14};
+        std::array<double, 6> prices_b = {20, 23, 21, 24, 22, 26};
+        for (int day = 0; day < 6; ++day) {
+            minute_point start = date::sys_days{2021_y / 03 / 01} + 24h * day;
+            auto bar = std::make_pair(start, start + 8h);
+            double pa = prices_a[day];
+            double pb = prices_b[day];
+            a.push_back(bar, ohlc_prices(pa, pa, pa, pa));
+            if (day != 0 && day != 2) {
+                b.push_back(bar, ohlc_prices(pb, pb, pb, pb));
+            }
+        }
+        std::vector<price_view> series = {price_view(a), price_view(b)};
+        return_panel p({"A", "B"}, series, missing_bar_policy::mask);
+        covariance_matrix cov(p, p.intervals().back(), int(p.n_periods()));
+        std::vector<double> mean(2, 0.0);
+        std::vector<size_t> n(2, 0);
+        for (size_t k = 0; k < 2; ++k) {
+            for (size_t t = 0; t < p.n_periods(); ++t) {
+                if (p.valid(k, t)) {
+                    mean[k] += p.returns(k)[t];
+                    ++n[k];
+                }
+            }
+            mean[k] /= n[k];
+        }
+        double cross = 0.0;
+        double variance = 0.0;
+        size_t common = 0;
+        for (size_t t = 0; t < p.n_periods(); ++t) {
+            if (p.valid(1, t)) {
+                variance += std::pow(p.returns(1)[t] - mean[1], 2);
+                cross += (p.returns(0)[t] - mean[0]) *
+                         (p.returns(1)[t] - mean[1]);
+                ++common;
+            }
+        }
+        REQUIRE(common < p.n_periods());
+        REQUIRE(cov.variance(1) == Approx(variance / (n[1] - 1)));
+        REQUIRE(cov(0, 1) == Approx(cross / (common - 1)));
+    }
+}
+
+TEST_CASE("EWMA Model") {
+    using namespace portfolio;
+    using namespace std::chrono_literals;
+    mock_market market(mock_assets(9));
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    const return_panel &panel = md.returns();
+    const double decay = 0.9;
+    ewma_model model(md, decay);
+    REQUIRE(model.n_assets() == assets.size());
+    REQUIRE(model.n_bars() == panel.n_periods());
+    REQUIRE(model.interval() == panel.intervals().back());
+
+    // The first return initializes the mean
+    const size_t n_periods = panel.n_periods();
+    for (asset_id k = 0; k < assets.size(); ++k) {
+        auto r = panel.returns(k);
+        double mean = std::pow(decay, n_periods - 1) * r[0];
+        for (size_t t = 1; t < n_periods; ++t) {
+            mean += (1 - decay) * std::pow(decay, n_periods - 1 - t) * r[t];
+        }
+        REQUIRE(model.expected_return(k) == Approx(mean));
+        REQUIRE(model.risk(k) > 0.0);
+        REQUIRE(model.variance(k) > 0.0);
+    }
+    REQUIRE(model.covariance(2, 5) == model.covariance(5, 2));
+
+    SECTION("STREAMING") {
+        // Bars given one by one and then the rest of the panel
+        ewma_model streaming(md.shared_symbols(), decay);
+        REQUIRE(streaming.n_bars() == 0);
+        std::vector<double> returns(assets.size());
+        const size_t half = n_periods / 2;
+        for (size_t t = 0; t < half; ++t) {
+            for (size_t k = 0; k < assets.size(); ++k) {
+                returns[k] = panel.returns(k)[t];
+            }
+            streaming.update(panel.intervals()[t], returns);
+        }
+        REQUIRE_THROWS(streaming.update(panel.intervals()[half - 1], returns));
+        REQUIRE(streaming.update(panel) == n_periods - half);
+        REQUIRE(streaming.update(panel) == 0);
+        for (asset_id i = 0; i < assets.size(); ++i) {
+            REQUIRE(streaming.risk(i) == Approx(model.risk(i)));
+            REQUIRE(streaming.expected_return(i) ==
+                    Approx(model.expected_return(i)));
+            for (asset_id j = 0; j <= i; ++j) {
+                REQUIRE(streaming.covariance(i, j) ==
+                        Approx(model.covariance(i, j)));
+            }
+        }
+    }
+
+    SECTION("MASK") {
+        ewma_model masked = model;
+        std::vector<double> returns(assets.size(), 0.01);
+        std::vector<uint8_t> mask(assets.size(), 1);
+        mask[3] = 0;
+        returns[3] = 1.0;
+        auto next = panel.intervals().back();
+        next.first += 24h;
+        next.second += 24h;
+        masked.update(next, returns, mask);
+        REQUIRE(masked.n_bars() == model.n_bars() + 1);
+        REQUIRE(masked.expected_return(3) == model.expected_return(3));
+        REQUIRE(masked.risk(3) == model.risk(3));
+        REQUIRE(masked.covariance(3, 6) == model.covariance(3, 6));
+        REQUIRE(masked.variance(3) == model.variance(3));
+        REQUIRE(masked.variance(6) != model.variance(6));
+    }
+
+    SECTION("EVALUATION") {
+        portfolio::portfolio p(md);
+        auto [risk, expected_return] = p.evaluate(model);
+        double r = 0.0;
+        double e = 0.0;
+        double variance = 0.0;
+        for (asset_id i = 0; i < assets.size(); ++i) {
+            r += p.weights()[i] * model.risk(i);
+            e += p.weights()[i] * model.expected_return(i);
+            for (asset_id j = 0; j < assets.size(); ++j) {
+                variance +=
+                    p.weights()[i] * p.weights()[j] * model.covariance(i, j);
+            }
+        }
+        REQUIRE(risk == Approx(r));
+        REQUIRE(expected_return == Approx(e));
+        REQUIRE(model.portfolio_variance(p.weights()) == Approx(variance));
+        REQUIRE(model.portfolio_variance(p.weights()) >= 0.0);
+
+        // Models of as many other assets are rejected, and models of
+        // other market data with the same assets are not
+        std::vector<std::string> replaced = assets;
+        replaced[4] = "OTHER";
+        mock_market other(replaced);
+        REQUIRE_THROWS(p.evaluate(ewma_model(other.md, decay)));
+        mock_market same(assets);
+        REQUIRE_NOTHROW(p.evaluate(ewma_model(same.md, decay)));
+    }
+
+    REQUIRE(std::pow(ewma_model::decay_from_half_life(10), 10) ==
+            Approx(0.5));
+    REQUIRE_THROWS(ewma_model(md, 1.0));
+    REQUIRE_THROWS(model.risk("UNKNOWN"));
+}
+
+TEST_CASE("Factor Model") {
+    using namespace portfolio;
+    mock_market market(mock_assets(24));
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals().back();
+    const int n_periods = 150;
+    covariance_matrix sample(md, interval, n_periods);
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    std::vector<double> weights(assets.size());
+    for (double &w : weights) {
+        w = ud(generator);
+    }
+
+    SECTION("ALL FACTORS") {
+        // With one factor per asset, the model is the sample covariance
+        factor_model model(md, interval, n_periods,
+                           {.n_factors = assets.size()});
+        REQUIRE(model.n_assets() == assets.size());
+        REQUIRE(model.n_factors() == assets.size());
+        REQUIRE(model.n_periods() == n_periods);
+        REQUIRE(model.assets() == md.returns().assets());
+        REQUIRE(&model.symbols() == &md.symbols());
+        REQUIRE(model.explained_variance() == Approx(1.0));
+
+        // Portfolios evaluate the deviation and mean of the model
+        portfolio::portfolio p(md, weights);
+        auto [risk, expected_return] = p.evaluate(model);
+        REQUIRE(risk == Approx(model.portfolio_risk(p.weights())));
+        REQUIRE(expected_return ==
+                Approx(model.portfolio_return(p.weights())));
+        REQUIRE(model.risk(2) == Approx(std::sqrt(model.variance(2))));
+        size_t wrong = 0;
+        for (size_t i = 0; i < assets.size(); ++i) {
+            wrong += model.expected_return(i) != Approx(sample.mean(i));
+            for (size_t j = 0; j < assets.size(); ++j) {
+                wrong += model.covariance(i, j) !=
+                         Approx(sample(i, j)).margin(1e-12);
+            }
+        }
+        REQUIRE(wrong == 0);
+        for (size_t f = 1; f < model.n_factors(); ++f) {
+            REQUIRE(model.factor_variance(f - 1) >= model.factor_variance(f));
+        }
+    }
+
+    SECTION("FEW FACTORS") {
+        factor_model_options options;
+        options.n_factors = 4;
+        options.n_power_iterations = 4;
+        factor_model model(md, interval, n_periods, options);
+        factor_model exact(md, interval, n_periods,
+                           {.n_factors = assets.size()});
+        // Factor variances are Rayleigh quotients, which approach the
+        // eigenvalues from below. Mock returns have close eigenvalues, so
+        // the approximation is loose.
+        REQUIRE(model.factor_variance(0) <=
+                exact.factor_variance(0) * (1 + 1e-9));
+        REQUIRE(model.factor_variance(0) >= 0.9 * exact.factor_variance(0));
+        REQUIRE(model.explained_variance() > 0.0);
+        REQUIRE(model.explained_variance() < 1.0);
+
+        // The portfolio variance is w' (L F L' + D) w
+        double variance = 0.0;
+        for (size_t i = 0; i < assets.size(); ++i) {
+            REQUIRE(model.variance(i) == Approx(sample.variance(i)));
+            for (size_t j = 0; j < assets.size(); ++j) {
+                variance += weights[i] * weights[j] * model.covariance(i, j);
+            }
+        }
+        REQUIRE(model.portfolio_variance(weights) == Approx(variance));
+        REQUIRE(model.portfolio_risk(weights) == Approx(std::sqrt(variance)));
+        REQUIRE(model.exposures(weights).size() == 4);
+
+        // The fit does not depend on the number of threads
+        options.n_threads = 3;
+        factor_model parallel(md, interval, n_periods, options);
+        for (size_t i = 0; i < assets.size(); ++i) {
+            REQUIRE(std::equal(model.loadings(i).begin(),
+                               model.loadings(i).end(),
+                               parallel.loadings(i).begin()));
+        }
+
+        SECTION("FILES") {
+            auto path = std::filesystem::temp_directory_path() /
+                        "portfolio_ut_model.factors";
+            REQUIRE(model.save(path));
+            factor_model loaded;
+            REQUIRE(loaded.load(path));
+            REQUIRE(loaded.assets() == model.assets());
+            REQUIRE(loaded.n_factors() == model.n_factors());
+            REQUIRE(loaded.n_periods() == model.n_periods());
+            REQUIRE(loaded.portfolio_variance(weights) ==
+                    model.portfolio_variance(weights));
+            REQUIRE(loaded.portfolio_return(weights) ==
+                    model.portfolio_return(weights));
+            REQUIRE(loaded.evaluate(weights) == model.evaluate(weights));
+
+            {
+                // Counts whose product wraps around to the file size
+                // are rejected
+                auto corrupt = std::filesystem::temp_directory_path() /
+                               "portfolio_ut_corrupt.factors";
+                std::filesystem::copy_file(
+                    path, corrupt,
+                    std::filesystem::copy_options::overwrite_existing);
+                factor_model_file_header h{};
+                std::ifstream(corrupt, std::ios::binary)
+                    .read(reinterpret_cast<char *>(&h), sizeof(h));
+                h.n_assets = (uint64_t(1) << 63) + 1;
+                h.n_factors = 0;
+                h.symbols_size =
+                    std::filesystem::file_size(corrupt) - sizeof(h) - 16;
+                std::fstream fout(corrupt, std::ios::binary | std::ios::in |
+                                               std::ios::out);
+                fout.write(reinterpret_cast<const char *>(&h), sizeof(h));
+                fout.close();
+                REQUIRE_FALSE(loaded.load(corrupt));
+                std::filesystem::remove(corrupt);
+            }
+
+            // Truncated files are rejected
+            std::filesystem::resize_file(path,
+                                         std::filesystem::file_size(path) - 1);
+            REQUIRE_FALSE(loaded.load(path));
+            REQUIRE(loaded.n_factors() == model.n_factors());
+            std::filesystem::remove(path);
+            REQUIRE_FALSE(loaded.load(path));
+        }
+    }
+
+    REQUIRE_THROWS(factor_model(md, interval, n_periods, {.n_factors = 0}));
+    REQUIRE_THROWS(factor_model(md, interval, n_periods, {.n_factors = 25}));
+}
+
+TEST_CASE("Monte Carlo Simulator") {
+    using namespace portfolio;
+    mock_market market(mock_assets(12));
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals().back();
+    const int n_periods = 120;
+    covariance_matrix cov(md, interval, n_periods);
+
+    // One portfolio per asset and a few random ones
+    const size_t n = assets.size();
+    const size_t n_portfolios = n + 5;
+    std::vector<double> weights(n_portfolios * n, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        weights[i * n + i] = 1.0;
+    }
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<double> ud(0.0, 1.0);
+    for (size_t k = n * n; k < weights.size(); ++k) {
+        weights[k] = ud(generator);
+    }
+    auto portfolio_mean = [&](size_t p) {
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            total += weights[p * n + i] * cov.mean(i);
+        }
+        return total;
+    };
+    auto portfolio_deviation = [&](size_t p) {
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                total += weights[p * n + i] * weights[p * n + j] * cov(i, j);
+            }
+        }
+        return std::sqrt(total);
+    };
+
+    monte_carlo_options options;
+    options.n_scenarios = 20000;
+    options.seed = 3;
+
+    // A batch of copies of the portfolios larger than one chunk
+    std::vector<double> batch;
+    for (size_t k = 0; k < 30; ++k) {
+        batch.insert(batch.end(), weights.begin(), weights.end());
+    }
+    const size_t batch_size = 30 * n_portfolios;
+
+    // Gaussian quantile and tail mean at 95%
+    const double z = 1.6448536;
+    const double tail_mean = 2.0627128;
+    auto check_gaussian = [&](const tail_risk &risk) {
+        REQUIRE(risk.size() == n_portfolios);
+        REQUIRE(risk.confidence == 0.95);
+        size_t wrong = 0;
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            double mu = portfolio_mean(p);
+            double sigma = portfolio_deviation(p);
+            wrong += risk.expected_return[p] != Approx(mu).margin(0.05 * sigma);
+            wrong += risk.volatility[p] != Approx(sigma).epsilon(0.03);
+            wrong += risk.value_at_risk[p] !=
+                     Approx(-mu + z * sigma).margin(0.06 * sigma);
+            wrong += risk.conditional_value_at_risk[p] !=
+                     Approx(-mu + tail_mean * sigma).margin(0.08 * sigma);
+            wrong += risk.conditional_value_at_risk[p] <
+                     risk.value_at_risk[p];
+        }
+        REQUIRE(wrong == 0);
+    };
+
+    SECTION("COVARIANCE") {
+        monte_carlo_simulator simulator(cov, options);
+        REQUIRE(simulator.n_assets() == n);
+        REQUIRE(simulator.n_shocks() == n);
+        tail_risk risk = simulator.simulate(weights);
+        check_gaussian(risk);
+
+        // The same scenarios for any number of threads
+        options.n_threads = 3;
+        tail_risk parallel =
+            monte_carlo_simulator(cov, options).simulate(weights);
+        REQUIRE(parallel.value_at_risk == risk.value_at_risk);
+        REQUIRE(parallel.conditional_value_at_risk ==
+                risk.conditional_value_at_risk);
+        REQUIRE(parallel.expected_return == risk.expected_return);
+        options.seed = 4;
+        tail_risk other = monte_carlo_simulator(cov, options).simulate(weights);
+        REQUIRE(other.value_at_risk != risk.value_at_risk);
+
+        // Without specific shocks, copies of a portfolio get the same
+        // scenarios anywhere in a batch
+        tail_risk copies = simulator.simulate(batch);
+        REQUIRE(copies.size() == batch_size);
+        size_t mismatches = 0;
+        for (size_t p = 0; p < batch_size; ++p) {
+            mismatches += copies.value_at_risk[p] !=
+                              risk.value_at_risk[p % n_portfolios] ||
+                          copies.conditional_value_at_risk[p] !=
+                              risk.conditional_value_at_risk[p % n_portfolios];
+        }
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("FACTOR MODEL") {
+        // Few factors plus specific risk keep the variance of each asset
+        factor_model model(md, interval, n_periods, {.n_factors = 3});
+        monte_carlo_simulator simulator(model, options);
+        REQUIRE(simulator.n_shocks() == 3);
+        tail_risk risk = simulator.simulate(weights);
+        size_t wrong = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double sigma = std::sqrt(model.variance(i));
+            wrong += risk.volatility[i] != Approx(sigma).epsilon(0.03);
+            wrong += risk.value_at_risk[i] !=
+                     Approx(-model.expected_return(i) + z * sigma)
+                         .margin(0.06 * sigma);
+        }
+        REQUIRE(wrong == 0);
+        for (size_t p = n; p < n_portfolios; ++p) {
+            std::span<const double> w(weights.data() + p * n, n);
+            REQUIRE(risk.volatility[p] ==
+                    Approx(model.portfolio_risk(w)).epsilon(0.03));
+        }
+
+        // A portfolio gets the same scenarios alone as first in a batch,
+        // and the first portfolios of a batch do not depend on the rest
+        tail_risk alone =
+            simulator.simulate(std::span<const double>(weights).first(n));
+        REQUIRE(alone.value_at_risk[0] == risk.value_at_risk[0]);
+        REQUIRE(alone.conditional_value_at_risk[0] ==
+                risk.conditional_value_at_risk[0]);
+        REQUIRE(alone.expected_return[0] == risk.expected_return[0]);
+        tail_risk copies = simulator.simulate(batch);
+        size_t mismatches = 0;
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            mismatches += copies.value_at_risk[p] != risk.value_at_risk[p] ||
+                          copies.volatility[p] != risk.volatility[p];
+        }
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("STUDENT T") {
+        monte_carlo_simulator gaussian(cov, options);
+        options.degrees_of_freedom = 5;
+        monte_carlo_simulator student(cov, options);
+        tail_risk normal_tail = gaussian.simulate(weights, 0.99);
+        tail_risk heavy_tail = student.simulate(weights, 0.99);
+        for (size_t p = 0; p < n_portfolios; ++p) {
+            REQUIRE(heavy_tail.volatility[p] ==
+                    Approx(portfolio_deviation(p)).epsilon(0.1));
+            REQUIRE(heavy_tail.conditional_value_at_risk[p] >
+                    normal_tail.conditional_value_at_risk[p]);
+        }
+    }
+
+    SECTION("MARKET DATA") {
+        monte_carlo_simulator simulator(md, interval, n_periods, options);
+        tail_risk risk = simulator.simulate(weights, 0.9);
+        REQUIRE(risk.size() == n_portfolios);
+        REQUIRE(risk.value_at_risk[0] < risk.conditional_value_at_risk[0]);
+    }
+
+    monte_carlo_simulator simulator(cov, options);
+    REQUIRE_THROWS(simulator.simulate(weights, 1.0));
+    REQUIRE_THROWS(
+        simulator.simulate(std::span<const double>(weights).first(n + 1)));
+    options.degrees_of_freedom = 2;
+    REQUIRE_THROWS(monte_carlo_simulator(cov, options));
+}
+
+TEST_CASE("Portfolio Risk") {
+    using namespace portfolio;
+    mock_market market({"PETR4", "VALE3", "ITUB4", "BBDC4", "ABEV3"});
+    const std::vector<std::string> &assets = market.assets;
+    market_data &md = market.md;
+    interval_points interval = md.returns().intervals().back();
+    const int n_periods = 100;
+
+    // Each metric in its own pass over the known returns
+    auto check_metrics = [](const risk_report &report,
+                            std::vector<double> r) {
+        const double n = static_cast<double>(r.size());
+        REQUIRE(report.n_periods == r.size());
+        double mean = std::accumulate(r.begin(), r.end(), 0.0) / n;
+        REQUIRE(report.mean == Approx(mean));
+        double mad = 0.0;
+        double variance = 0.0;
+        double downside = 0.0;
+        for (double x : r) {
+            mad += std::abs(x - mean);
+            variance += (x - mean) * (x - mean);
+            downside += std::min(x, 0.0) * std::min(x, 0.0);
+        }
+        REQUIRE(report.mad == Approx(mad / n));
+        REQUIRE(report.standard_deviation ==
+                Approx(std::sqrt(variance / (n - 1))));
+        REQUIRE(report.semi_deviation == Approx(std::sqrt(downside / n)));
+        REQUIRE(report.sharpe_ratio ==
+                Approx(mean / report.standard_deviation));
+        double wealth = 1.0;
+        double peak = 1.0;
+        double drawdown = 0.0;
+        for (double x : r) {
+            wealth *= 1.0 + x;
+            peak = std::max(peak, wealth);
+            drawdown = std::max(drawdown, (peak - wealth) / peak);
+        }
+        REQUIRE(report.max_drawdown == Approx(drawdown).margin(1e-12));
+        size_t n_tail = static_cast<size_t>(std::ceil(0.05 * n));
+        std::sort(r.begin(), r.end());
+        double tail = std::accumulate(r.begin(), r.begin() + n_tail, 0.0);
+        REQUIRE(report.value_at_risk == Approx(-r[n_tail - 1]));
+        REQUIRE(report.conditional_value_at_risk == Approx(-tail / n_tail));
+        REQUIRE(report.conditional_value_at_risk >= report.value_at_risk);
+    };
+
+    portfolio_risk model(md, interval, n_periods);
+    REQUIRE(model.n_assets() == assets.size());
+    REQUIRE(model.n_periods() == n_periods);
+    const return_panel &panel = md.returns();
+    size_t last = panel.find(interval);
+    size_t first = last + 1 - n_periods;
+
+    SECTION("ASSETS") {
+        portfolio_mad mad(md, interval, n_periods);
+        for (asset_id id = 0; id < model.n_assets(); ++id) {
+            auto returns = panel.returns(id).subspan(first, n_periods);
+            auto mask = panel.mask(id).subspan(first, n_periods);
+            std::vector<double> known;
+            for (size_t t = 0; t < returns.size(); ++t) {
+                if (mask[t]) {
+                    known.push_back(returns[t]);
+                }
+            }
+            check_metrics(model.report(id), known);
+            REQUIRE(model.risk(id, risk_metric::mad) ==
+                    Approx(mad.risk(id)));
+            REQUIRE(model.expected_return(id) ==
+                    Approx(mad.expected_return(id)));
+        }
+        asset_id vale = model.symbols().find("VALE3");
+        REQUIRE(model.risk("VALE3", risk_metric::value_at_risk) ==
+                model.report(vale).value_at_risk);
+        REQUIRE_THROWS_AS(model.report("XXXX"), std::out_of_range);
+    }
+
+    SECTION("PORTFOLIOS") {
+        std::default_random_engine generator(5);
+        std::uniform_real_distribution<double> ud(0.0, 1.0);
+        std::vector<double> weights(assets.size());
+        for (double &w : weights) {
+            w = ud(generator);
+        }
+        double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+        for (double &w : weights) {
+            w /= total;
+        }
+        std::vector<double> stream(n_periods, 0.0);
+        for (size_t k = 0; k < assets.size(); ++k) {
+            auto returns = panel.returns(k).subspan(first, n_periods);
+            for (int t = 0; t < n_periods; ++t) {
+                stream[t] += weights[k] * returns[t];
+            }
+        }
+        risk_report report = model.report(weights);
+        check_metrics(report, stream);
+        portfolio::portfolio p(md, weights);
+        auto [risk, expected_return] = p.evaluate(model);
+        REQUIRE(risk == report.mad);
+        REQUIRE(expected_return == report.mean);
+        portfolio_risk tail(md, interval, n_periods,
+                            {.metric = risk_metric::conditional_value_at_risk});
+        REQUIRE(p.evaluate(tail).first == report.conditional_value_at_risk);
+        REQUIRE(tail.risk(0) == model.report(0).conditional_value_at_risk);
+        REQUIRE_THROWS(
+            model.report(std::span<const double>(weights).first(2)));
+        REQUIRE_THROWS(portfolio_risk(md, interval, n_periods,
+                                      {.mad = false}));
+    }
+
+    SECTION("KERNEL") {
+        // Only the requested metrics, over the known returns
+        std::vector<double> returns = {0.1, -0.2, 0.3, 9.0, -0.1, 0.05};
+        std::vector<uint8_t> mask = {1, 1, 1, 0, 1, 1};
+        risk_kernel kernel({.mad = false,
+                            .standard_deviation = false,
+                            .max_drawdown = false,
+                            .sharpe_ratio = false,
+                            .target_return = 0.01,
+                            .confidence = 0.6});
+        risk_report report = kernel(returns, mask);
+        REQUIRE(report.n_periods == 5);
+        REQUIRE(report.mean == Approx(0.03));
+        REQUIRE(std::isnan(report.mad));
+        REQUIRE(std::isnan(report.standard_deviation));
+        REQUIRE(std::isnan(report.max_drawdown));
+        REQUIRE(std::isnan(report.sharpe_ratio));
+        REQUIRE(std::isnan(report.risk(risk_metric::mad)));
+        REQUIRE(report.semi_deviation ==
+                Approx(std::sqrt((0.21 * 0.21 + 0.11 * 0.11) / 5)));
+        // The two worst of five returns
+        REQUIRE(report.value_at_risk == Approx(0.1));
+        REQUIRE(report.conditional_value_at_risk == Approx(0.15));
+
+        risk_kernel all;
+        report = all(returns, mask);
+        // Wealth goes 1.1, 0.88, 1.144, 1.0296, 1.08108
+        REQUIRE(report.max_drawdown == Approx(0.2));
+        REQUIRE(report.mad == Approx(0.144));
+        REQUIRE_THROWS(all(returns, std::vector<uint8_t>(5, 1)));
+        REQUIRE_THROWS(all(returns, std::vector<uint8_t>(6, 0)));
+        REQUIRE_THROWS(risk_kernel({.confidence = 1.0}));
+    }
+
+    REQUIRE_THROWS(portfolio_risk(md, interval, 100000));
+}